@@ -0,0 +1,230 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef __SPDM_APPRAISAL_LIB_H__
+#define __SPDM_APPRAISAL_LIB_H__
+
+#include "hal/base.h"
+
+/* An SPDM measurement index is one byte.*/
+#define SPDM_APPRAISAL_MAX_INDEX_COUNT 256
+/* The digests accepted for one measurement index, such as the ones of several firmware versions.*/
+#define SPDM_APPRAISAL_MAX_DIGEST_COUNT 4
+/* SHA-512*/
+#define SPDM_APPRAISAL_MAX_DIGEST_SIZE 64
+
+/* CoRIM hash algorithms, from the IANA Named Information Hash Algorithm Registry.*/
+#define SPDM_APPRAISAL_HASH_ALG_SHA256 1
+#define SPDM_APPRAISAL_HASH_ALG_SHA384 7
+#define SPDM_APPRAISAL_HASH_ALG_SHA512 8
+
+/* The reason of the first failure of an appraisal.*/
+#define SPDM_APPRAISAL_REASON_NONE 0
+/* A digest of the evidence is not a reference digest of its index.*/
+#define SPDM_APPRAISAL_REASON_DIGEST_MISMATCH 1
+/* The SVN of the evidence is not the reference SVN, or is below the reference minimum SVN.*/
+#define SPDM_APPRAISAL_REASON_SVN_MISMATCH 2
+/* An index with reference values has no measurement in the evidence.*/
+#define SPDM_APPRAISAL_REASON_MISSING_MEASUREMENT 3
+/* A measurement of the evidence has no reference value.*/
+#define SPDM_APPRAISAL_REASON_UNKNOWN_MEASUREMENT 4
+
+typedef struct {
+    uint32_t hash_alg;
+    uint32_t digest_size;
+    uint8_t digest[SPDM_APPRAISAL_MAX_DIGEST_SIZE];
+} spdm_appraisal_digest_t;
+
+typedef struct {
+    uint8_t digest_count;
+    bool has_svn;
+    /* The SVN is a minimum (CoRIM tagged-min-svn), not an exact value.*/
+    bool svn_is_min;
+    uint64_t svn;
+    spdm_appraisal_digest_t digest[SPDM_APPRAISAL_MAX_DIGEST_COUNT];
+} spdm_appraisal_reference_t;
+
+/* The reference values of a CoRIM, indexed by SPDM measurement index.*/
+typedef struct {
+    uint32_t reference_count;
+    spdm_appraisal_reference_t reference[SPDM_APPRAISAL_MAX_INDEX_COUNT];
+} spdm_appraisal_reference_index_t;
+
+/* The kinds of reference value of a CoRIM.*/
+#define SPDM_APPRAISAL_VALUE_DIGEST 0
+#define SPDM_APPRAISAL_VALUE_SVN 1
+#define SPDM_APPRAISAL_VALUE_MIN_SVN 2
+
+/* One reference value of a CoRIM, as it is parsed.*/
+typedef struct {
+    uint8_t measurement_index;
+    uint8_t type;
+    uint8_t reserved[6];
+    /* for SPDM_APPRAISAL_VALUE_SVN and SPDM_APPRAISAL_VALUE_MIN_SVN*/
+    uint64_t svn;
+    /* for SPDM_APPRAISAL_VALUE_DIGEST*/
+    spdm_appraisal_digest_t digest;
+} spdm_appraisal_reference_value_t;
+
+typedef libspdm_return_t (*spdm_appraisal_reference_value_func)(
+    void *context, const spdm_appraisal_reference_value_t *value);
+
+/* A reference value database, built from CoRIMs with spdm_appraisal_db_build. It is used
+ * where it is, such as in a mapped file, without any parsing.
+ *
+ * The digests are grouped by measurement index and hash algorithm. The digests of a group are
+ * sorted, and the first bits of a digest select a bucket, the range of the digests with these
+ * first bits. As the digests are uniformly distributed, a bucket holds one or two digests.*/
+#define SPDM_APPRAISAL_DB_MAGIC "SPDMRVDB"
+#define SPDM_APPRAISAL_DB_VERSION 1
+/* the most bucket bits of a group, 16M buckets*/
+#define SPDM_APPRAISAL_DB_MAX_BUCKET_BITS 24
+
+typedef struct {
+    uint8_t has_svn;
+    uint8_t svn_is_min;
+    uint8_t reserved[6];
+    uint64_t svn;
+} spdm_appraisal_db_svn_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t group_count;
+    uint64_t digest_count;
+    uint64_t db_size;
+    /* The groups of index i are group_start[i] to group_start[i + 1] - 1.*/
+    uint16_t group_start[SPDM_APPRAISAL_MAX_INDEX_COUNT + 1];
+    uint16_t reserved[3];
+    spdm_appraisal_db_svn_t svn[SPDM_APPRAISAL_MAX_INDEX_COUNT];
+    /* spdm_appraisal_db_group_t group[group_count], then the buckets and digests*/
+} spdm_appraisal_db_header_t;
+
+typedef struct {
+    uint8_t measurement_index;
+    uint8_t bucket_bits;
+    uint8_t reserved[2];
+    uint32_t hash_alg;
+    uint32_t digest_size;
+    uint32_t reserved2;
+    uint64_t digest_count;
+    /* the offsets from the start of the database*/
+    /* uint64_t bucket[(1 << bucket_bits) + 1], the index of the first digest of each bucket*/
+    uint64_t bucket_offset;
+    /* uint8_t digest[digest_count][digest_size], sorted*/
+    uint64_t digest_offset;
+} spdm_appraisal_db_group_t;
+
+typedef struct {
+    /* the SPDM_HASH_CHECK and SPDM_SVN_CHECK of SpdmSamplePolicy.rego*/
+    bool hash_check;
+    bool svn_check;
+    uint8_t reason;
+    /* the measurement index of the first failure*/
+    uint8_t failed_index;
+    uint32_t measurement_count;
+} spdm_appraisal_result_t;
+
+/**
+ * Parse the reference values of a CoRIM.
+ *
+ * The CoRIM is a CBOR tagged-corim-map (#6.500), holding either an unsigned-corim-map (#6.501)
+ * or a signed-corim (#6.502) COSE_Sign1 message, as generated by CoRimTool.py. The reference
+ * triples of its CoMID tags are parsed, keyed by their comid.index.
+ *
+ * @param  corim                         The CoRIM.
+ * @param  corim_size                    The size in bytes of the CoRIM.
+ * @param  public_key                    The DER SubjectPublicKeyInfo of the EC key that signed the
+ *                                       CoRIM, NULL to accept only an unsigned CoRIM.
+ * @param  public_key_size               The size in bytes of the public key.
+ * @param  func                          Called for each reference value, in the CoRIM order.
+ *                                       An error stops the parsing and is returned.
+ * @param  context                       The context of func.
+ *
+ * @retval LIBSPDM_STATUS_SUCCESS            The reference values are parsed.
+ * @retval LIBSPDM_STATUS_INVALID_MSG_FIELD  The CoRIM or the public key is malformed.
+ * @retval LIBSPDM_STATUS_UNSUPPORTED_CAP    The signature or hash algorithm is not supported.
+ * @retval LIBSPDM_STATUS_VERIF_FAIL         The signature does not verify, or is not checked.
+ **/
+libspdm_return_t spdm_appraisal_parse_corim(const void *corim, size_t corim_size,
+                                            const void *public_key, size_t public_key_size,
+                                            spdm_appraisal_reference_value_func func,
+                                            void *context);
+
+/**
+ * Add the reference values of a CoRIM to a reference index, see spdm_appraisal_parse_corim.
+ *
+ * A later SVN of an index replaces the earlier one.
+ *
+ * @param  reference_index               The reference index, zeroed before the first CoRIM.
+ *
+ * @retval LIBSPDM_STATUS_BUFFER_FULL        An index has more than SPDM_APPRAISAL_MAX_DIGEST_COUNT
+ *                                           digests.
+ **/
+libspdm_return_t spdm_appraisal_load_corim(spdm_appraisal_reference_index_t *reference_index,
+                                           const void *corim, size_t corim_size,
+                                           const void *public_key, size_t public_key_size);
+
+/**
+ * Appraise an SPDM measurement record, the DMTF measurement blocks of a MEASUREMENTS response.
+ *
+ * A digest passes if it is a reference digest of its index, in the hash algorithm of the same
+ * size. A raw secure version number passes if it is the reference SVN, or at least the minimum
+ * SVN. Every index with reference values must be measured. The other raw bit streams are not
+ * appraised.
+ *
+ * @retval LIBSPDM_STATUS_SUCCESS            The record is appraised, see result.
+ * @retval LIBSPDM_STATUS_INVALID_MSG_FIELD  The record is malformed.
+ **/
+libspdm_return_t spdm_appraisal_appraise_measurement(
+    const spdm_appraisal_reference_index_t *reference_index,
+    const void *measurement_record, size_t measurement_record_size,
+    spdm_appraisal_result_t *result);
+
+/**
+ * Build a reference value database.
+ *
+ * @param  values                        The reference values of spdm_appraisal_parse_corim. They
+ *                                       are sorted in place once the database is built. A later
+ *                                       SVN of an index replaces the earlier one, and the same
+ *                                       digest is only kept once.
+ * @param  value_count                   The number of values.
+ * @param  db                            The database, 8 bytes aligned. NULL to get its size.
+ * @param  db_size                       On input, the size in bytes of db.
+ *                                       On output, the size in bytes of the database. The size
+ *                                       required first is an upper bound, as the duplicated
+ *                                       digests are only found while building.
+ *
+ * @retval LIBSPDM_STATUS_SUCCESS            The database is built.
+ * @retval LIBSPDM_STATUS_BUFFER_TOO_SMALL   db is too small, db_size is the required size.
+ * @retval LIBSPDM_STATUS_INVALID_PARAMETER  A digest is not of a SPDM_APPRAISAL_HASH_ALG_*.
+ **/
+libspdm_return_t spdm_appraisal_db_build(spdm_appraisal_reference_value_t *values,
+                                         size_t value_count, void *db, size_t *db_size);
+
+/**
+ * Check the header and the group table of a reference value database, before it is used.
+ *
+ * This does not read the digests, so that a large database is usable as soon as it is mapped.
+ * The lookups stay within the database even if a digest or bucket is corrupted.
+ *
+ * @param  db                            The database, 8 bytes aligned.
+ * @param  db_size                       The size in bytes of the database.
+ *
+ * @retval LIBSPDM_STATUS_SUCCESS            The database can be used.
+ * @retval LIBSPDM_STATUS_INVALID_MSG_FIELD  The database is malformed, or of another version.
+ **/
+libspdm_return_t spdm_appraisal_db_check(const void *db, size_t db_size);
+
+/**
+ * Appraise an SPDM measurement record with a reference value database checked with
+ * spdm_appraisal_db_check, as spdm_appraisal_appraise_measurement does with a reference index.
+ **/
+libspdm_return_t spdm_appraisal_db_appraise_measurement(
+    const void *db, const void *measurement_record, size_t measurement_record_size,
+    spdm_appraisal_result_t *result);
+
+#endif
@@ -0,0 +1,874 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "hal/base.h"
+#include "hal/library/memlib.h"
+#include "hal/library/debuglib.h"
+#include "hal/library/cryptlib.h"
+#include "library/spdm_crypt_lib.h"
+#include "library/spdm_appraisal_lib.h"
+
+/* Only the parts of CBOR (RFC 8949) used by CoRimTool.py are read: definite lengths,
+ * integers, byte and text strings, arrays, maps and tags. The other items are skipped.*/
+
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_NINT 1
+#define CBOR_MAJOR_BSTR 2
+#define CBOR_MAJOR_TSTR 3
+#define CBOR_MAJOR_ARRAY 4
+#define CBOR_MAJOR_MAP 5
+#define CBOR_MAJOR_TAG 6
+#define CBOR_MAJOR_SIMPLE 7
+
+#define CBOR_MAX_DEPTH 16
+
+/* draft-ietf-rats-corim tags*/
+#define CORIM_TAG_CORIM 500
+#define CORIM_TAG_UNSIGNED_CORIM_MAP 501
+#define CORIM_TAG_SIGNED_CORIM 502
+#define CORIM_TAG_CONCISE_MID_TAG 506
+#define CORIM_TAG_SVN 552
+#define CORIM_TAG_MIN_SVN 553
+/* RFC 8152*/
+#define COSE_TAG_SIGN1 18
+#define COSE_HEADER_ALG 1
+#define COSE_ALG_ES256 -7
+#define COSE_ALG_ES384 -35
+#define COSE_ALG_ES512 -36
+
+/* map keys, see CoRimTool.py*/
+#define CORIM_UNSIGNED_MAP_TAGS 1
+#define COMID_TRIPLES 4
+#define COMID_TRIPLES_REFERENCE 0
+#define COMID_ENVIRONMENT_CLASS 0
+#define COMID_CLASS_INDEX 4
+#define COMID_MEASUREMENT_MVAL 1
+#define COMID_MVAL_SVN 1
+#define COMID_MVAL_DIGESTS 2
+
+#define DER_TAG_SEQUENCE 0x30
+#define DER_TAG_BIT_STRING 0x03
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+} corim_cbor_t;
+
+/* where the reference values of the CoRIM go*/
+typedef struct {
+    spdm_appraisal_reference_value_func func;
+    void *context;
+} corim_sink_t;
+
+static void cbor_init(corim_cbor_t *cbor, const void *data, size_t size)
+{
+    cbor->data = data;
+    cbor->size = size;
+    cbor->offset = 0;
+}
+
+static bool cbor_read_head(corim_cbor_t *cbor, uint8_t *major, uint64_t *argument)
+{
+    uint8_t info;
+    size_t count;
+
+    if (cbor->offset >= cbor->size) {
+        return false;
+    }
+    *major = cbor->data[cbor->offset] >> 5;
+    info = cbor->data[cbor->offset] & 0x1f;
+    cbor->offset++;
+    if (info < 24) {
+        *argument = info;
+        return true;
+    }
+    /* 28 to 30 are reserved, 31 is an indefinite length.*/
+    if (info > 27) {
+        return false;
+    }
+    count = (size_t)1 << (info - 24);
+    if (cbor->size - cbor->offset < count) {
+        return false;
+    }
+    *argument = 0;
+    while (count-- > 0) {
+        *argument = (*argument << 8) | cbor->data[cbor->offset++];
+    }
+    return true;
+}
+
+static bool cbor_peek_head(corim_cbor_t *cbor, uint8_t *major, uint64_t *argument)
+{
+    size_t offset;
+    bool result;
+
+    offset = cbor->offset;
+    result = cbor_read_head(cbor, major, argument);
+    cbor->offset = offset;
+    return result;
+}
+
+static bool cbor_read_int(corim_cbor_t *cbor, int64_t *value)
+{
+    uint8_t major;
+    uint64_t argument;
+
+    if (!cbor_read_head(cbor, &major, &argument) || (argument > INT64_MAX)) {
+        return false;
+    }
+    if (major == CBOR_MAJOR_UINT) {
+        *value = (int64_t)argument;
+        return true;
+    }
+    if (major == CBOR_MAJOR_NINT) {
+        *value = -1 - (int64_t)argument;
+        return true;
+    }
+    return false;
+}
+
+static bool cbor_read_string(corim_cbor_t *cbor, uint8_t expected_major,
+                             const uint8_t **string, size_t *string_size)
+{
+    uint8_t major;
+    uint64_t argument;
+
+    if (!cbor_read_head(cbor, &major, &argument) || (major != expected_major) ||
+        (argument > cbor->size - cbor->offset)) {
+        return false;
+    }
+    *string = cbor->data + cbor->offset;
+    *string_size = (size_t)argument;
+    cbor->offset += (size_t)argument;
+    return true;
+}
+
+/* Read the head of an array or a map. Each item takes a byte at least, which bounds the count.*/
+static bool cbor_read_container(corim_cbor_t *cbor, uint8_t expected_major, size_t *count)
+{
+    uint8_t major;
+    uint64_t argument;
+
+    if (!cbor_read_head(cbor, &major, &argument) || (major != expected_major) ||
+        (argument > cbor->size - cbor->offset)) {
+        return false;
+    }
+    *count = (size_t)argument;
+    return true;
+}
+
+static bool cbor_skip(corim_cbor_t *cbor, uint32_t depth)
+{
+    uint8_t major;
+    uint64_t argument;
+    uint64_t index;
+
+    if ((depth > CBOR_MAX_DEPTH) || !cbor_read_head(cbor, &major, &argument)) {
+        return false;
+    }
+    switch (major) {
+    case CBOR_MAJOR_BSTR:
+    case CBOR_MAJOR_TSTR:
+        if (argument > cbor->size - cbor->offset) {
+            return false;
+        }
+        cbor->offset += (size_t)argument;
+        return true;
+    case CBOR_MAJOR_MAP:
+        if (argument > (cbor->size - cbor->offset) / 2) {
+            return false;
+        }
+        argument *= 2;
+    /* fall through*/
+    case CBOR_MAJOR_ARRAY:
+        if (argument > cbor->size - cbor->offset) {
+            return false;
+        }
+        for (index = 0; index < argument; index++) {
+            if (!cbor_skip(cbor, depth + 1)) {
+                return false;
+            }
+        }
+        return true;
+    case CBOR_MAJOR_TAG:
+        return cbor_skip(cbor, depth + 1);
+    default:
+        return true;
+    }
+}
+
+static size_t cbor_write_head(uint8_t *buffer, uint8_t major, uint64_t argument)
+{
+    size_t count;
+    size_t index;
+
+    if (argument < 24) {
+        buffer[0] = (uint8_t)((major << 5) | argument);
+        return 1;
+    }
+    if (argument <= 0xFF) {
+        buffer[0] = (uint8_t)((major << 5) | 24);
+        count = 1;
+    } else if (argument <= 0xFFFF) {
+        buffer[0] = (uint8_t)((major << 5) | 25);
+        count = 2;
+    } else if (argument <= 0xFFFFFFFF) {
+        buffer[0] = (uint8_t)((major << 5) | 26);
+        count = 4;
+    } else {
+        buffer[0] = (uint8_t)((major << 5) | 27);
+        count = 8;
+    }
+    for (index = 0; index < count; index++) {
+        buffer[1 + index] = (uint8_t)(argument >> (8 * (count - 1 - index)));
+    }
+    return 1 + count;
+}
+
+static bool der_read(const uint8_t *der, size_t der_size, size_t *offset, uint8_t expected_tag,
+                     size_t *length)
+{
+    size_t count;
+
+    if ((der_size - *offset < 2) || (der[*offset] != expected_tag)) {
+        return false;
+    }
+    *length = der[*offset + 1];
+    *offset += 2;
+    if (*length >= 0x80) {
+        count = *length & 0x7f;
+        if ((count == 0) || (count > 2) || (der_size - *offset < count)) {
+            return false;
+        }
+        *length = 0;
+        while (count-- > 0) {
+            *length = (*length << 8) | der[(*offset)++];
+        }
+    }
+    return *length <= der_size - *offset;
+}
+
+/* Get the uncompressed point of a DER SubjectPublicKeyInfo.*/
+static bool corim_get_ec_point(const uint8_t *public_key, size_t public_key_size,
+                               const uint8_t **point, size_t *point_size)
+{
+    size_t offset;
+    size_t length;
+
+    offset = 0;
+    if (!der_read(public_key, public_key_size, &offset, DER_TAG_SEQUENCE, &length) ||
+        !der_read(public_key, public_key_size, &offset, DER_TAG_SEQUENCE, &length)) {
+        return false;
+    }
+    /* the AlgorithmIdentifier, the curve follows from the point size*/
+    offset += length;
+    if (!der_read(public_key, public_key_size, &offset, DER_TAG_BIT_STRING, &length) ||
+        (length < 2) || (public_key[offset] != 0) || (public_key[offset + 1] != 0x04)) {
+        return false;
+    }
+    *point = public_key + offset + 1;
+    *point_size = length - 1;
+    return true;
+}
+
+/**
+ * Verify a COSE_Sign1 message and get its payload.
+ **/
+static libspdm_return_t corim_verify_sign1(corim_cbor_t *cbor, const uint8_t *public_key,
+                                           size_t public_key_size, const uint8_t **payload,
+                                           size_t *payload_size)
+{
+    corim_cbor_t header;
+    const uint8_t *protected_header;
+    size_t protected_header_size;
+    const uint8_t *signature;
+    size_t signature_size;
+    const uint8_t *point;
+    size_t point_size;
+    uint8_t major;
+    uint64_t argument;
+    size_t count;
+    int64_t key;
+    int64_t alg;
+    uint32_t base_hash_algo;
+    size_t hash_nid;
+    size_t curve_nid;
+    size_t curve_point_size;
+    void *hash_context;
+    /* an array head, then a bstr head and a tstr or bstr head*/
+    uint8_t head[2 * 9];
+    size_t head_size;
+    uint8_t hash[LIBSPDM_MAX_HASH_SIZE];
+    void *ec_context;
+    bool result;
+
+    if (cbor_peek_head(cbor, &major, &argument) && (major == CBOR_MAJOR_TAG)) {
+        if (!cbor_read_head(cbor, &major, &argument) || (argument != COSE_TAG_SIGN1)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+    }
+    if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &count) || (count != 4) ||
+        !cbor_read_string(cbor, CBOR_MAJOR_BSTR, &protected_header, &protected_header_size) ||
+        !cbor_skip(cbor, 0) ||
+        !cbor_read_string(cbor, CBOR_MAJOR_BSTR, payload, payload_size) ||
+        !cbor_read_string(cbor, CBOR_MAJOR_BSTR, &signature, &signature_size)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+
+    alg = 0;
+    cbor_init(&header, protected_header, protected_header_size);
+    if (!cbor_read_container(&header, CBOR_MAJOR_MAP, &count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    while (count-- > 0) {
+        if (!cbor_read_int(&header, &key)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        if (key == COSE_HEADER_ALG) {
+            if (!cbor_read_int(&header, &alg)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+        } else if (!cbor_skip(&header, 0)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+    }
+    switch (alg) {
+    case COSE_ALG_ES256:
+        base_hash_algo = SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_256;
+        hash_nid = LIBSPDM_CRYPTO_NID_SHA256;
+        curve_nid = LIBSPDM_CRYPTO_NID_SECP256R1;
+        curve_point_size = 32;
+        break;
+    case COSE_ALG_ES384:
+        base_hash_algo = SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_384;
+        hash_nid = LIBSPDM_CRYPTO_NID_SHA384;
+        curve_nid = LIBSPDM_CRYPTO_NID_SECP384R1;
+        curve_point_size = 48;
+        break;
+    case COSE_ALG_ES512:
+        base_hash_algo = SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_512;
+        hash_nid = LIBSPDM_CRYPTO_NID_SHA512;
+        curve_nid = LIBSPDM_CRYPTO_NID_SECP521R1;
+        curve_point_size = 66;
+        break;
+    default:
+        LIBSPDM_DEBUG((LIBSPDM_DEBUG_INFO, "CoRIM alg %d is not supported\n", (int32_t)alg));
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+    if (!corim_get_ec_point(public_key, public_key_size, &point, &point_size) ||
+        (point_size != 1 + 2 * curve_point_size) ||
+        (signature_size != 2 * curve_point_size)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+
+    /* Sig_structure = ["Signature1", protected, external_aad, payload], external_aad is empty.
+     * It is hashed piece by piece, so that the payload is not copied.*/
+    hash_context = libspdm_hash_new(base_hash_algo);
+    if (hash_context == NULL) {
+        return LIBSPDM_STATUS_CRYPTO_ERROR;
+    }
+    head_size = cbor_write_head(head, CBOR_MAJOR_ARRAY, 4);
+    head_size += cbor_write_head(head + head_size, CBOR_MAJOR_TSTR, sizeof("Signature1") - 1);
+    result = libspdm_hash_init(base_hash_algo, hash_context) &&
+             libspdm_hash_update(base_hash_algo, hash_context, head, head_size) &&
+             libspdm_hash_update(base_hash_algo, hash_context, "Signature1",
+                                 sizeof("Signature1") - 1);
+    head_size = cbor_write_head(head, CBOR_MAJOR_BSTR, protected_header_size);
+    result = result &&
+             libspdm_hash_update(base_hash_algo, hash_context, head, head_size) &&
+             libspdm_hash_update(base_hash_algo, hash_context, protected_header,
+                                 protected_header_size);
+    head_size = cbor_write_head(head, CBOR_MAJOR_BSTR, 0);
+    head_size += cbor_write_head(head + head_size, CBOR_MAJOR_BSTR, *payload_size);
+    result = result &&
+             libspdm_hash_update(base_hash_algo, hash_context, head, head_size) &&
+             libspdm_hash_update(base_hash_algo, hash_context, *payload, *payload_size) &&
+             libspdm_hash_final(base_hash_algo, hash_context, hash);
+    libspdm_hash_free(base_hash_algo, hash_context);
+    if (!result) {
+        return LIBSPDM_STATUS_CRYPTO_ERROR;
+    }
+
+    ec_context = libspdm_ec_new_by_nid(curve_nid);
+    if (ec_context == NULL) {
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+    result = libspdm_ec_set_pub_key(ec_context, point + 1, point_size - 1) &&
+             libspdm_ecdsa_verify(ec_context, hash_nid, hash,
+                                  libspdm_get_hash_size(base_hash_algo), signature,
+                                  signature_size);
+    libspdm_ec_free(ec_context);
+    return result ? LIBSPDM_STATUS_SUCCESS : LIBSPDM_STATUS_VERIF_FAIL;
+}
+
+static bool corim_decode_hex(const uint8_t *text, size_t text_size, uint8_t *digest,
+                             size_t digest_size)
+{
+    size_t index;
+    uint8_t value;
+    uint8_t character;
+
+    if (text_size != digest_size * 2) {
+        return false;
+    }
+    for (index = 0; index < text_size; index++) {
+        character = text[index];
+        if ((character >= '0') && (character <= '9')) {
+            value = character - '0';
+        } else if ((character >= 'a') && (character <= 'f')) {
+            value = character - 'a' + 10;
+        } else if ((character >= 'A') && (character <= 'F')) {
+            value = character - 'A' + 10;
+        } else {
+            return false;
+        }
+        if ((index & 1) == 0) {
+            digest[index / 2] = (uint8_t)(value << 4);
+        } else {
+            digest[index / 2] |= value;
+        }
+    }
+    return true;
+}
+
+/* digests = [+ [alg, value]], the value in hex text (CoRimTool.py) or in bytes*/
+static libspdm_return_t corim_parse_digests(const corim_sink_t *sink, uint8_t measurement_index,
+                                            corim_cbor_t *cbor)
+{
+    libspdm_return_t status;
+    size_t digest_count;
+    size_t count;
+    int64_t hash_alg;
+    uint32_t digest_size;
+    uint8_t major;
+    uint64_t argument;
+    const uint8_t *value;
+    size_t value_size;
+    spdm_appraisal_reference_value_t reference_value;
+    spdm_appraisal_digest_t *digest;
+
+    if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &digest_count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    while (digest_count-- > 0) {
+        if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &count) || (count != 2) ||
+            !cbor_read_int(cbor, &hash_alg) || !cbor_peek_head(cbor, &major, &argument) ||
+            !cbor_read_string(cbor, major, &value, &value_size)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        switch (hash_alg) {
+        case SPDM_APPRAISAL_HASH_ALG_SHA256:
+            digest_size = 32;
+            break;
+        case SPDM_APPRAISAL_HASH_ALG_SHA384:
+            digest_size = 48;
+            break;
+        case SPDM_APPRAISAL_HASH_ALG_SHA512:
+            digest_size = 64;
+            break;
+        default:
+            LIBSPDM_DEBUG((LIBSPDM_DEBUG_INFO, "CoRIM hash alg %d is not supported\n",
+                           (int32_t)hash_alg));
+            return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+        }
+        libspdm_zero_mem(&reference_value, sizeof(reference_value));
+        reference_value.measurement_index = measurement_index;
+        reference_value.type = SPDM_APPRAISAL_VALUE_DIGEST;
+        digest = &reference_value.digest;
+        digest->hash_alg = (uint32_t)hash_alg;
+        digest->digest_size = digest_size;
+        if (major == CBOR_MAJOR_TSTR) {
+            if (!corim_decode_hex(value, value_size, digest->digest, digest_size)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+        } else if ((major == CBOR_MAJOR_BSTR) && (value_size == digest_size)) {
+            libspdm_copy_mem(digest->digest, sizeof(digest->digest), value, value_size);
+        } else {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        status = sink->func(sink->context, &reference_value);
+        if (LIBSPDM_STATUS_IS_ERROR(status)) {
+            return status;
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/* svn = uint / #6.552(uint) / #6.553(uint), the last one a minimum*/
+static libspdm_return_t corim_parse_svn(const corim_sink_t *sink, uint8_t measurement_index,
+                                        corim_cbor_t *cbor)
+{
+    uint8_t major;
+    uint64_t argument;
+    bool svn_is_min;
+    spdm_appraisal_reference_value_t reference_value;
+
+    svn_is_min = false;
+    if (!cbor_read_head(cbor, &major, &argument)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    if (major == CBOR_MAJOR_TAG) {
+        if ((argument != CORIM_TAG_SVN) && (argument != CORIM_TAG_MIN_SVN)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        svn_is_min = (argument == CORIM_TAG_MIN_SVN);
+        if (!cbor_read_head(cbor, &major, &argument)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+    }
+    if (major != CBOR_MAJOR_UINT) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    libspdm_zero_mem(&reference_value, sizeof(reference_value));
+    reference_value.measurement_index = measurement_index;
+    reference_value.type = svn_is_min ? SPDM_APPRAISAL_VALUE_MIN_SVN : SPDM_APPRAISAL_VALUE_SVN;
+    reference_value.svn = argument;
+    return sink->func(sink->context, &reference_value);
+}
+
+static libspdm_return_t corim_parse_measurement(const corim_sink_t *sink,
+                                                uint8_t measurement_index, corim_cbor_t *cbor)
+{
+    libspdm_return_t status;
+    size_t count;
+    size_t mval_count;
+    int64_t key;
+
+    if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    while (count-- > 0) {
+        if (!cbor_read_int(cbor, &key)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        if (key != COMID_MEASUREMENT_MVAL) {
+            if (!cbor_skip(cbor, 0)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+            continue;
+        }
+        if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &mval_count)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        while (mval_count-- > 0) {
+            if (!cbor_read_int(cbor, &key)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+            if (key == COMID_MVAL_SVN) {
+                status = corim_parse_svn(sink, measurement_index, cbor);
+            } else if (key == COMID_MVAL_DIGESTS) {
+                status = corim_parse_digests(sink, measurement_index, cbor);
+            } else {
+                status = cbor_skip(cbor, 0) ? LIBSPDM_STATUS_SUCCESS :
+                         LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+            if (LIBSPDM_STATUS_IS_ERROR(status)) {
+                return status;
+            }
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/* Get comid.index from environment-map = {comid.class: {comid.index: uint}}.*/
+static bool corim_parse_environment(corim_cbor_t *cbor, uint64_t *measurement_index)
+{
+    size_t count;
+    size_t class_count;
+    int64_t key;
+    bool found;
+
+    found = false;
+    if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &count)) {
+        return false;
+    }
+    while (count-- > 0) {
+        if (!cbor_read_int(cbor, &key)) {
+            return false;
+        }
+        if (key != COMID_ENVIRONMENT_CLASS) {
+            if (!cbor_skip(cbor, 0)) {
+                return false;
+            }
+            continue;
+        }
+        if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &class_count)) {
+            return false;
+        }
+        while (class_count-- > 0) {
+            if (!cbor_read_int(cbor, &key)) {
+                return false;
+            }
+            if (key == COMID_CLASS_INDEX) {
+                if (!cbor_read_int(cbor, &key) || (key < 0) ||
+                    (key >= SPDM_APPRAISAL_MAX_INDEX_COUNT)) {
+                    return false;
+                }
+                *measurement_index = (uint64_t)key;
+                found = true;
+            } else if (!cbor_skip(cbor, 0)) {
+                return false;
+            }
+        }
+    }
+    return found;
+}
+
+/* reference-triple = [environment-map, measurement-map / [+ measurement-map]]*/
+static libspdm_return_t corim_parse_reference_triple(const corim_sink_t *sink,
+                                                     corim_cbor_t *cbor)
+{
+    libspdm_return_t status;
+    size_t count;
+    size_t measurement_count;
+    uint64_t measurement_index;
+    uint8_t major;
+    uint64_t argument;
+
+    if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &count) || (count != 2) ||
+        !corim_parse_environment(cbor, &measurement_index) ||
+        !cbor_peek_head(cbor, &major, &argument)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    if (major == CBOR_MAJOR_MAP) {
+        return corim_parse_measurement(sink, (uint8_t)measurement_index, cbor);
+    }
+    if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &measurement_count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    while (measurement_count-- > 0) {
+        status = corim_parse_measurement(sink, (uint8_t)measurement_index, cbor);
+        if (LIBSPDM_STATUS_IS_ERROR(status)) {
+            return status;
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+static libspdm_return_t corim_parse_comid(const corim_sink_t *sink, corim_cbor_t *cbor)
+{
+    libspdm_return_t status;
+    size_t count;
+    size_t triples_count;
+    size_t triple_count;
+    int64_t key;
+
+    if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    while (count-- > 0) {
+        if (!cbor_read_int(cbor, &key)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        if (key != COMID_TRIPLES) {
+            if (!cbor_skip(cbor, 0)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+            continue;
+        }
+        if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &triples_count)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        while (triples_count-- > 0) {
+            if (!cbor_read_int(cbor, &key)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+            /* The endorsed, identity and attest key triples are not used for appraisal.*/
+            if (key != COMID_TRIPLES_REFERENCE) {
+                if (!cbor_skip(cbor, 0)) {
+                    return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+                }
+                continue;
+            }
+            if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &triple_count)) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+            while (triple_count-- > 0) {
+                status = corim_parse_reference_triple(sink, cbor);
+                if (LIBSPDM_STATUS_IS_ERROR(status)) {
+                    return status;
+                }
+            }
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/* corim.tags holds the CoMIDs: CoRimTool.py tags the whole array #6.506, the draft tags each
+ * CoMID #6.506 and wraps it in a bstr. Both are accepted, the other tags (CoSWID) are skipped.*/
+static libspdm_return_t corim_parse_tags(const corim_sink_t *sink, corim_cbor_t *cbor,
+                                         uint32_t depth)
+{
+    libspdm_return_t status;
+    corim_cbor_t comid;
+    uint8_t major;
+    uint64_t argument;
+    const uint8_t *string;
+    size_t string_size;
+    size_t count;
+
+    if ((depth > CBOR_MAX_DEPTH) || !cbor_peek_head(cbor, &major, &argument)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    switch (major) {
+    case CBOR_MAJOR_TAG:
+        cbor_read_head(cbor, &major, &argument);
+        if (argument != CORIM_TAG_CONCISE_MID_TAG) {
+            return cbor_skip(cbor, depth) ? LIBSPDM_STATUS_SUCCESS :
+                   LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        return corim_parse_tags(sink, cbor, depth + 1);
+    case CBOR_MAJOR_BSTR:
+        if (!cbor_read_string(cbor, CBOR_MAJOR_BSTR, &string, &string_size)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        cbor_init(&comid, string, string_size);
+        return corim_parse_tags(sink, &comid, depth + 1);
+    case CBOR_MAJOR_ARRAY:
+        if (!cbor_read_container(cbor, CBOR_MAJOR_ARRAY, &count)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        while (count-- > 0) {
+            status = corim_parse_tags(sink, cbor, depth + 1);
+            if (LIBSPDM_STATUS_IS_ERROR(status)) {
+                return status;
+            }
+        }
+        return LIBSPDM_STATUS_SUCCESS;
+    case CBOR_MAJOR_MAP:
+        return corim_parse_comid(sink, cbor);
+    default:
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+}
+
+static libspdm_return_t corim_parse_unsigned_map(const corim_sink_t *sink, corim_cbor_t *cbor)
+{
+    libspdm_return_t status;
+    size_t count;
+    int64_t key;
+
+    if (!cbor_read_container(cbor, CBOR_MAJOR_MAP, &count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    while (count-- > 0) {
+        if (!cbor_read_int(cbor, &key)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        if (key == CORIM_UNSIGNED_MAP_TAGS) {
+            status = corim_parse_tags(sink, cbor, 0);
+            if (LIBSPDM_STATUS_IS_ERROR(status)) {
+                return status;
+            }
+        } else if (!cbor_skip(cbor, 0)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/* Read #6.500, if there, and the tag that follows it.*/
+static bool corim_read_tag(corim_cbor_t *cbor, uint64_t *tag)
+{
+    uint8_t major;
+
+    if (!cbor_read_head(cbor, &major, tag) || (major != CBOR_MAJOR_TAG)) {
+        return false;
+    }
+    if (*tag == CORIM_TAG_CORIM) {
+        if (!cbor_read_head(cbor, &major, tag) || (major != CBOR_MAJOR_TAG)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+libspdm_return_t spdm_appraisal_parse_corim(const void *corim, size_t corim_size,
+                                            const void *public_key, size_t public_key_size,
+                                            spdm_appraisal_reference_value_func func,
+                                            void *context)
+{
+    libspdm_return_t status;
+    corim_sink_t sink;
+    corim_cbor_t cbor;
+    const uint8_t *payload;
+    size_t payload_size;
+    uint64_t tag;
+
+    sink.func = func;
+    sink.context = context;
+    cbor_init(&cbor, corim, corim_size);
+    if (!corim_read_tag(&cbor, &tag)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    if (tag == CORIM_TAG_UNSIGNED_CORIM_MAP) {
+        /* With a key, the reference values must be signed with it.*/
+        if (public_key != NULL) {
+            return LIBSPDM_STATUS_VERIF_FAIL;
+        }
+        return corim_parse_unsigned_map(&sink, &cbor);
+    }
+    if (tag != CORIM_TAG_SIGNED_CORIM) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    if (public_key == NULL) {
+        return LIBSPDM_STATUS_VERIF_FAIL;
+    }
+    status = corim_verify_sign1(&cbor, public_key, public_key_size, &payload, &payload_size);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        return status;
+    }
+    cbor_init(&cbor, payload, payload_size);
+    if (!corim_read_tag(&cbor, &tag) || (tag != CORIM_TAG_UNSIGNED_CORIM_MAP)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+    return corim_parse_unsigned_map(&sink, &cbor);
+}
+
+static libspdm_return_t corim_add_to_index(void *context,
+                                           const spdm_appraisal_reference_value_t *value)
+{
+    spdm_appraisal_reference_index_t *reference_index;
+    spdm_appraisal_reference_t *reference;
+    uint8_t index;
+
+    reference_index = context;
+    reference = &reference_index->reference[value->measurement_index];
+    if (value->type == SPDM_APPRAISAL_VALUE_DIGEST) {
+        for (index = 0; index < reference->digest_count; index++) {
+            if ((reference->digest[index].digest_size == value->digest.digest_size) &&
+                (libspdm_const_compare_mem(reference->digest[index].digest,
+                                           value->digest.digest,
+                                           value->digest.digest_size) == 0)) {
+                return LIBSPDM_STATUS_SUCCESS;
+            }
+        }
+        if (reference->digest_count == SPDM_APPRAISAL_MAX_DIGEST_COUNT) {
+            return LIBSPDM_STATUS_BUFFER_FULL;
+        }
+    }
+
+    if ((reference->digest_count == 0) && !reference->has_svn) {
+        reference_index->reference_count++;
+    }
+    if (value->type == SPDM_APPRAISAL_VALUE_DIGEST) {
+        reference->digest[reference->digest_count++] = value->digest;
+    } else {
+        reference->has_svn = true;
+        reference->svn_is_min = (value->type == SPDM_APPRAISAL_VALUE_MIN_SVN);
+        reference->svn = value->svn;
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+libspdm_return_t spdm_appraisal_load_corim(spdm_appraisal_reference_index_t *reference_index,
+                                           const void *corim, size_t corim_size,
+                                           const void *public_key, size_t public_key_size)
+{
+    return spdm_appraisal_parse_corim(corim, corim_size, public_key, public_key_size,
+                                      corim_add_to_index, reference_index);
+}
@@ -0,0 +1,438 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_appraisal_lib_internal.h"
+
+/* One group per measurement index and hash algorithm.*/
+#define APPRAISAL_DB_MAX_GROUP_COUNT (SPDM_APPRAISAL_MAX_INDEX_COUNT * 3)
+
+static uint32_t appraisal_db_get_digest_size(uint32_t hash_alg)
+{
+    switch (hash_alg) {
+    case SPDM_APPRAISAL_HASH_ALG_SHA256:
+        return 32;
+    case SPDM_APPRAISAL_HASH_ALG_SHA384:
+        return 48;
+    case SPDM_APPRAISAL_HASH_ALG_SHA512:
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+/* libspdm_const_compare_mem only tells if the buffers differ, the sort needs an order.*/
+static int32_t appraisal_db_compare_digest(const uint8_t *digest1, const uint8_t *digest2,
+                                           size_t digest_size)
+{
+    size_t index;
+
+    for (index = 0; index < digest_size; index++) {
+        if (digest1[index] != digest2[index]) {
+            return (digest1[index] < digest2[index]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+/* The SVNs go last, the digests are sorted by index, hash algorithm and value.*/
+static int32_t appraisal_db_compare(const spdm_appraisal_reference_value_t *value1,
+                                    const spdm_appraisal_reference_value_t *value2)
+{
+    bool is_digest1;
+    bool is_digest2;
+
+    is_digest1 = (value1->type == SPDM_APPRAISAL_VALUE_DIGEST);
+    is_digest2 = (value2->type == SPDM_APPRAISAL_VALUE_DIGEST);
+    if (is_digest1 != is_digest2) {
+        return is_digest1 ? -1 : 1;
+    }
+    if (!is_digest1) {
+        return 0;
+    }
+    if (value1->measurement_index != value2->measurement_index) {
+        return (value1->measurement_index < value2->measurement_index) ? -1 : 1;
+    }
+    if (value1->digest.hash_alg != value2->digest.hash_alg) {
+        return (value1->digest.hash_alg < value2->digest.hash_alg) ? -1 : 1;
+    }
+    return appraisal_db_compare_digest(value1->digest.digest, value2->digest.digest,
+                                       value1->digest.digest_size);
+}
+
+static bool appraisal_db_is_same_group(const spdm_appraisal_reference_value_t *value1,
+                                       const spdm_appraisal_reference_value_t *value2)
+{
+    return (value1->measurement_index == value2->measurement_index) &&
+           (value1->digest.hash_alg == value2->digest.hash_alg);
+}
+
+static void appraisal_db_swap(spdm_appraisal_reference_value_t *value1,
+                              spdm_appraisal_reference_value_t *value2)
+{
+    spdm_appraisal_reference_value_t temp;
+
+    temp = *value1;
+    *value1 = *value2;
+    *value2 = temp;
+}
+
+static void appraisal_db_sift_down(spdm_appraisal_reference_value_t *values, size_t root,
+                                   size_t count)
+{
+    size_t child;
+
+    while ((child = root * 2 + 1) < count) {
+        if ((child + 1 < count) &&
+            (appraisal_db_compare(&values[child], &values[child + 1]) < 0)) {
+            child++;
+        }
+        if (appraisal_db_compare(&values[root], &values[child]) >= 0) {
+            return;
+        }
+        appraisal_db_swap(&values[root], &values[child]);
+        root = child;
+    }
+}
+
+/* heap sort, in place and without recursion for millions of digests*/
+static void appraisal_db_sort(spdm_appraisal_reference_value_t *values, size_t count)
+{
+    size_t index;
+
+    if (count < 2) {
+        return;
+    }
+    for (index = count / 2; index > 0; index--) {
+        appraisal_db_sift_down(values, index - 1, count);
+    }
+    for (index = count - 1; index > 0; index--) {
+        appraisal_db_swap(&values[0], &values[index]);
+        appraisal_db_sift_down(values, 0, index);
+    }
+}
+
+/* The first bucket_bits bits of a digest.*/
+static uint32_t appraisal_db_get_bucket(const uint8_t *digest, uint8_t bucket_bits)
+{
+    uint32_t prefix;
+
+    if (bucket_bits == 0) {
+        return 0;
+    }
+    prefix = ((uint32_t)digest[0] << 24) | ((uint32_t)digest[1] << 16) |
+             ((uint32_t)digest[2] << 8) | digest[3];
+    return prefix >> (32 - bucket_bits);
+}
+
+/* About one digest per bucket.*/
+static uint8_t appraisal_db_get_bucket_bits(uint64_t digest_count)
+{
+    uint8_t bucket_bits;
+
+    bucket_bits = 0;
+    while ((bucket_bits < SPDM_APPRAISAL_DB_MAX_BUCKET_BITS) &&
+           (((uint64_t)1 << (bucket_bits + 1)) <= digest_count)) {
+        bucket_bits++;
+    }
+    return bucket_bits;
+}
+
+static void appraisal_db_fill_group(uint8_t *db, spdm_appraisal_db_group_t *group,
+                                    const spdm_appraisal_reference_value_t *values,
+                                    size_t value_count, size_t *offset)
+{
+    uint64_t *bucket;
+    uint8_t *digest;
+    uint64_t digest_index;
+    uint32_t bucket_index;
+    uint32_t bucket_count;
+    size_t index;
+
+    group->bucket_bits = appraisal_db_get_bucket_bits(group->digest_count);
+    bucket_count = (uint32_t)1 << group->bucket_bits;
+    group->bucket_offset = *offset;
+    *offset += (bucket_count + 1) * sizeof(uint64_t);
+    group->digest_offset = *offset;
+    *offset += (size_t)group->digest_count * group->digest_size;
+
+    bucket = (uint64_t *)(db + group->bucket_offset);
+    digest = db + group->digest_offset;
+    digest_index = 0;
+    bucket_index = 0;
+    for (index = 0; index < value_count; index++) {
+        if ((index != 0) && (appraisal_db_compare(&values[index - 1], &values[index]) == 0)) {
+            continue;
+        }
+        while (bucket_index <= appraisal_db_get_bucket(values[index].digest.digest,
+                                                       group->bucket_bits)) {
+            bucket[bucket_index++] = digest_index;
+        }
+        libspdm_copy_mem(digest + digest_index * group->digest_size, group->digest_size,
+                         values[index].digest.digest, group->digest_size);
+        digest_index++;
+    }
+    while (bucket_index <= bucket_count) {
+        bucket[bucket_index++] = digest_index;
+    }
+}
+
+libspdm_return_t spdm_appraisal_db_build(spdm_appraisal_reference_value_t *values,
+                                         size_t value_count, void *db, size_t *db_size)
+{
+    spdm_appraisal_db_header_t *header;
+    spdm_appraisal_db_group_t *group;
+    size_t required_size;
+    size_t digest_value_count;
+    size_t group_start;
+    size_t offset;
+    size_t index;
+    uint32_t group_index;
+    uint32_t measurement_index;
+
+    /* The bound counts the duplicated digests and the largest group table.*/
+    required_size = sizeof(spdm_appraisal_db_header_t) +
+                    APPRAISAL_DB_MAX_GROUP_COUNT * (sizeof(spdm_appraisal_db_group_t) +
+                                                    sizeof(uint64_t));
+    for (index = 0; index < value_count; index++) {
+        if (values[index].type != SPDM_APPRAISAL_VALUE_DIGEST) {
+            continue;
+        }
+        if ((values[index].digest.digest_size == 0) ||
+            (appraisal_db_get_digest_size(values[index].digest.hash_alg) !=
+             values[index].digest.digest_size)) {
+            return LIBSPDM_STATUS_INVALID_PARAMETER;
+        }
+        required_size += values[index].digest.digest_size + sizeof(uint64_t);
+    }
+    if ((db == NULL) || (*db_size < required_size)) {
+        *db_size = required_size;
+        return LIBSPDM_STATUS_BUFFER_TOO_SMALL;
+    }
+
+    header = db;
+    libspdm_zero_mem(header, sizeof(spdm_appraisal_db_header_t));
+    libspdm_copy_mem(header->magic, sizeof(header->magic),
+                     SPDM_APPRAISAL_DB_MAGIC, sizeof(header->magic));
+    header->version = SPDM_APPRAISAL_DB_VERSION;
+
+    /* The SVNs are taken in the CoRIM order, before the sort.*/
+    for (index = 0; index < value_count; index++) {
+        if (values[index].type == SPDM_APPRAISAL_VALUE_DIGEST) {
+            continue;
+        }
+        header->svn[values[index].measurement_index].has_svn = 1;
+        header->svn[values[index].measurement_index].svn_is_min =
+            (values[index].type == SPDM_APPRAISAL_VALUE_MIN_SVN) ? 1 : 0;
+        header->svn[values[index].measurement_index].svn = values[index].svn;
+    }
+
+    appraisal_db_sort(values, value_count);
+    digest_value_count = 0;
+    while ((digest_value_count < value_count) &&
+           (values[digest_value_count].type == SPDM_APPRAISAL_VALUE_DIGEST)) {
+        digest_value_count++;
+    }
+
+    /* the group table, then the buckets and digests of each group*/
+    group = (void *)(header + 1);
+    for (index = 0; index < digest_value_count; index++) {
+        if ((index != 0) && appraisal_db_is_same_group(&values[index - 1], &values[index])) {
+            if (appraisal_db_compare(&values[index - 1], &values[index]) != 0) {
+                group[header->group_count - 1].digest_count++;
+            }
+            continue;
+        }
+        libspdm_zero_mem(&group[header->group_count], sizeof(spdm_appraisal_db_group_t));
+        group[header->group_count].measurement_index = values[index].measurement_index;
+        group[header->group_count].hash_alg = values[index].digest.hash_alg;
+        group[header->group_count].digest_size = values[index].digest.digest_size;
+        group[header->group_count].digest_count = 1;
+        header->group_count++;
+    }
+
+    offset = sizeof(spdm_appraisal_db_header_t) +
+             header->group_count * sizeof(spdm_appraisal_db_group_t);
+    group_start = 0;
+    for (group_index = 0; group_index < header->group_count; group_index++) {
+        for (index = group_start + 1; index < digest_value_count; index++) {
+            if (!appraisal_db_is_same_group(&values[group_start], &values[index])) {
+                break;
+            }
+        }
+        appraisal_db_fill_group(db, &group[group_index], &values[group_start],
+                                index - group_start, &offset);
+        header->digest_count += group[group_index].digest_count;
+        group_start = index;
+    }
+
+    group_index = 0;
+    for (measurement_index = 0; measurement_index <= SPDM_APPRAISAL_MAX_INDEX_COUNT;
+         measurement_index++) {
+        while ((group_index < header->group_count) &&
+               (group[group_index].measurement_index < measurement_index)) {
+            group_index++;
+        }
+        header->group_start[measurement_index] = (uint16_t)group_index;
+    }
+
+    header->db_size = offset;
+    *db_size = offset;
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+libspdm_return_t spdm_appraisal_db_check(const void *db, size_t db_size)
+{
+    const spdm_appraisal_db_header_t *header;
+    const spdm_appraisal_db_group_t *group;
+    const uint64_t *bucket;
+    uint32_t measurement_index;
+    uint32_t group_index;
+    uint64_t bucket_size;
+
+    header = db;
+    if ((db_size < sizeof(spdm_appraisal_db_header_t)) || (((size_t)db & 7) != 0) ||
+        (libspdm_const_compare_mem(header->magic, SPDM_APPRAISAL_DB_MAGIC,
+                                   sizeof(header->magic)) != 0) ||
+        (header->version != SPDM_APPRAISAL_DB_VERSION) || (header->db_size != db_size) ||
+        (header->group_count > APPRAISAL_DB_MAX_GROUP_COUNT) ||
+        (header->group_count * sizeof(spdm_appraisal_db_group_t) >
+         db_size - sizeof(spdm_appraisal_db_header_t)) ||
+        (header->group_start[0] != 0) ||
+        (header->group_start[SPDM_APPRAISAL_MAX_INDEX_COUNT] != header->group_count)) {
+        return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+    }
+
+    group = (const void *)(header + 1);
+    for (measurement_index = 0; measurement_index < SPDM_APPRAISAL_MAX_INDEX_COUNT;
+         measurement_index++) {
+        if (header->group_start[measurement_index] >
+            header->group_start[measurement_index + 1]) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        for (group_index = header->group_start[measurement_index];
+             group_index < header->group_start[measurement_index + 1]; group_index++) {
+            if (group[group_index].measurement_index != measurement_index) {
+                return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+            }
+        }
+    }
+
+    for (group_index = 0; group_index < header->group_count; group_index++) {
+        if ((group[group_index].digest_size == 0) ||
+            (appraisal_db_get_digest_size(group[group_index].hash_alg) !=
+             group[group_index].digest_size) ||
+            (group[group_index].bucket_bits > SPDM_APPRAISAL_DB_MAX_BUCKET_BITS) ||
+            ((group[group_index].bucket_offset & 7) != 0) ||
+            (group[group_index].bucket_offset > db_size) ||
+            (group[group_index].digest_offset > db_size)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        bucket_size = (((uint64_t)1 << group[group_index].bucket_bits) + 1) * sizeof(uint64_t);
+        if ((bucket_size > db_size - group[group_index].bucket_offset) ||
+            (group[group_index].digest_count >
+             (db_size - group[group_index].digest_offset) / group[group_index].digest_size)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        /* The last bucket ends at the last digest. The others are clamped when used.*/
+        bucket = (const void *)((const uint8_t *)db + group[group_index].bucket_offset);
+        if (bucket[(size_t)1 << group[group_index].bucket_bits] !=
+            group[group_index].digest_count) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+static uint8_t appraisal_db_match_digest(const void *context, uint8_t measurement_index,
+                                         const uint8_t *digest, size_t digest_size)
+{
+    const spdm_appraisal_db_header_t *header;
+    const spdm_appraisal_db_group_t *group;
+    const uint64_t *bucket;
+    const uint8_t *digests;
+    uint32_t group_index;
+    uint32_t bucket_index;
+    uint64_t low;
+    uint64_t high;
+    uint64_t middle;
+    int32_t result;
+
+    header = context;
+    if (header->group_start[measurement_index] == header->group_start[measurement_index + 1]) {
+        return SPDM_APPRAISAL_MATCH_NO_REFERENCE;
+    }
+    group = (const void *)(header + 1);
+    for (group_index = header->group_start[measurement_index];
+         group_index < header->group_start[measurement_index + 1]; group_index++) {
+        if (group[group_index].digest_size == digest_size) {
+            break;
+        }
+    }
+    if (group_index == header->group_start[measurement_index + 1]) {
+        return SPDM_APPRAISAL_MATCH_MISMATCH;
+    }
+    group = &group[group_index];
+
+    bucket = (const void *)((const uint8_t *)header + group->bucket_offset);
+    bucket_index = appraisal_db_get_bucket(digest, group->bucket_bits);
+    high = bucket[bucket_index + 1];
+    if (high > group->digest_count) {
+        high = group->digest_count;
+    }
+    low = bucket[bucket_index];
+    if (low > high) {
+        low = high;
+    }
+
+    digests = (const uint8_t *)header + group->digest_offset;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        result = appraisal_db_compare_digest(digests + middle * digest_size, digest,
+                                             digest_size);
+        if (result == 0) {
+            return SPDM_APPRAISAL_MATCH_FOUND;
+        }
+        if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return SPDM_APPRAISAL_MATCH_MISMATCH;
+}
+
+static bool appraisal_db_has_digest(const void *context, uint8_t measurement_index)
+{
+    const spdm_appraisal_db_header_t *header;
+
+    header = context;
+    return header->group_start[measurement_index] != header->group_start[measurement_index + 1];
+}
+
+static bool appraisal_db_get_svn(const void *context, uint8_t measurement_index,
+                                 bool *svn_is_min, uint64_t *svn)
+{
+    const spdm_appraisal_db_header_t *header;
+
+    header = context;
+    *svn_is_min = (header->svn[measurement_index].svn_is_min != 0);
+    *svn = header->svn[measurement_index].svn;
+    return header->svn[measurement_index].has_svn != 0;
+}
+
+libspdm_return_t spdm_appraisal_db_appraise_measurement(
+    const void *db, const void *measurement_record, size_t measurement_record_size,
+    spdm_appraisal_result_t *result)
+{
+    spdm_appraisal_lookup_t lookup;
+
+    lookup.context = db;
+    lookup.match_digest = appraisal_db_match_digest;
+    lookup.has_digest = appraisal_db_has_digest;
+    lookup.get_svn = appraisal_db_get_svn;
+    return spdm_appraisal_appraise_with_lookup(&lookup, measurement_record,
+                                               measurement_record_size, result);
+}
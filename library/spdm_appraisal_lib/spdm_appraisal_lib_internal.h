@@ -0,0 +1,36 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef __SPDM_APPRAISAL_LIB_INTERNAL_H__
+#define __SPDM_APPRAISAL_LIB_INTERNAL_H__
+
+#include "hal/base.h"
+#include "hal/library/memlib.h"
+#include "industry_standard/spdm.h"
+#include "library/spdm_appraisal_lib.h"
+
+#define SPDM_APPRAISAL_MATCH_FOUND 0
+/* The index has reference digests, but not this one.*/
+#define SPDM_APPRAISAL_MATCH_MISMATCH 1
+/* The index has no reference digest.*/
+#define SPDM_APPRAISAL_MATCH_NO_REFERENCE 2
+
+/* The reference values that a measurement record is appraised with, a reference index or a
+ * reference value database.*/
+typedef struct {
+    const void *context;
+    uint8_t (*match_digest)(const void *context, uint8_t measurement_index,
+                            const uint8_t *digest, size_t digest_size);
+    bool (*has_digest)(const void *context, uint8_t measurement_index);
+    bool (*get_svn)(const void *context, uint8_t measurement_index, bool *svn_is_min,
+                    uint64_t *svn);
+} spdm_appraisal_lookup_t;
+
+libspdm_return_t spdm_appraisal_appraise_with_lookup(
+    const spdm_appraisal_lookup_t *lookup, const void *measurement_record,
+    size_t measurement_record_size, spdm_appraisal_result_t *result);
+
+#endif
@@ -0,0 +1,195 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_appraisal_lib_internal.h"
+
+/* A raw SVN is a little endian uint64.*/
+#define APPRAISAL_SVN_SIZE 8
+
+static void appraisal_fail(spdm_appraisal_result_t *result, bool is_svn, uint8_t reason,
+                           uint8_t measurement_index)
+{
+    if (is_svn) {
+        result->svn_check = false;
+    } else {
+        result->hash_check = false;
+    }
+    if (result->reason == SPDM_APPRAISAL_REASON_NONE) {
+        result->reason = reason;
+        result->failed_index = measurement_index;
+    }
+}
+
+static uint8_t appraisal_index_match_digest(const void *context, uint8_t measurement_index,
+                                            const uint8_t *digest, size_t digest_size)
+{
+    const spdm_appraisal_reference_index_t *reference_index;
+    const spdm_appraisal_reference_t *reference;
+    uint8_t index;
+
+    reference_index = context;
+    reference = &reference_index->reference[measurement_index];
+    if (reference->digest_count == 0) {
+        return SPDM_APPRAISAL_MATCH_NO_REFERENCE;
+    }
+    for (index = 0; index < reference->digest_count; index++) {
+        if ((reference->digest[index].digest_size == digest_size) &&
+            (libspdm_const_compare_mem(reference->digest[index].digest, digest,
+                                       digest_size) == 0)) {
+            return SPDM_APPRAISAL_MATCH_FOUND;
+        }
+    }
+    return SPDM_APPRAISAL_MATCH_MISMATCH;
+}
+
+static bool appraisal_index_has_digest(const void *context, uint8_t measurement_index)
+{
+    const spdm_appraisal_reference_index_t *reference_index;
+
+    reference_index = context;
+    return reference_index->reference[measurement_index].digest_count != 0;
+}
+
+static bool appraisal_index_get_svn(const void *context, uint8_t measurement_index,
+                                    bool *svn_is_min, uint64_t *svn)
+{
+    const spdm_appraisal_reference_index_t *reference_index;
+    const spdm_appraisal_reference_t *reference;
+
+    reference_index = context;
+    reference = &reference_index->reference[measurement_index];
+    *svn_is_min = reference->svn_is_min;
+    *svn = reference->svn;
+    return reference->has_svn;
+}
+
+static void appraisal_check_svn(const spdm_appraisal_lookup_t *lookup,
+                                const uint8_t *value, size_t value_size,
+                                uint8_t measurement_index, spdm_appraisal_result_t *result)
+{
+    uint64_t svn;
+    uint64_t reference_svn;
+    bool svn_is_min;
+    size_t index;
+
+    if (!lookup->get_svn(lookup->context, measurement_index, &svn_is_min, &reference_svn)) {
+        appraisal_fail(result, true, SPDM_APPRAISAL_REASON_UNKNOWN_MEASUREMENT,
+                       measurement_index);
+        return;
+    }
+    if (value_size != APPRAISAL_SVN_SIZE) {
+        appraisal_fail(result, true, SPDM_APPRAISAL_REASON_SVN_MISMATCH, measurement_index);
+        return;
+    }
+    svn = 0;
+    for (index = APPRAISAL_SVN_SIZE; index > 0; index--) {
+        svn = (svn << 8) | value[index - 1];
+    }
+    if (svn_is_min ? (svn < reference_svn) : (svn != reference_svn)) {
+        appraisal_fail(result, true, SPDM_APPRAISAL_REASON_SVN_MISMATCH, measurement_index);
+    }
+}
+
+libspdm_return_t spdm_appraisal_appraise_with_lookup(
+    const spdm_appraisal_lookup_t *lookup, const void *measurement_record,
+    size_t measurement_record_size, spdm_appraisal_result_t *result)
+{
+    const uint8_t *record;
+    const spdm_measurement_block_dmtf_t *block;
+    size_t offset;
+    size_t block_size;
+    size_t value_size;
+    uint8_t value_type;
+    uint8_t measurement_index;
+    uint8_t match;
+    uint32_t index;
+    /* the indexes measured with a digest, and with an SVN*/
+    uint8_t digest_measured[SPDM_APPRAISAL_MAX_INDEX_COUNT / 8];
+    uint8_t svn_measured[SPDM_APPRAISAL_MAX_INDEX_COUNT / 8];
+    bool svn_is_min;
+    uint64_t svn;
+
+    libspdm_zero_mem(result, sizeof(spdm_appraisal_result_t));
+    result->hash_check = true;
+    result->svn_check = true;
+    libspdm_zero_mem(digest_measured, sizeof(digest_measured));
+    libspdm_zero_mem(svn_measured, sizeof(svn_measured));
+
+    record = measurement_record;
+    for (offset = 0; offset < measurement_record_size;
+         offset += sizeof(spdm_measurement_block_common_header_t) + block_size) {
+        if (measurement_record_size - offset < sizeof(spdm_measurement_block_common_header_t)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        block = (const void *)(record + offset);
+        block_size = block->measurement_block_common_header.measurement_size;
+        if (measurement_record_size - offset - sizeof(spdm_measurement_block_common_header_t) <
+            block_size) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        if ((block->measurement_block_common_header.measurement_specification &
+             SPDM_MEASUREMENT_SPECIFICATION_DMTF) == 0) {
+            continue;
+        }
+        if (block_size < sizeof(spdm_measurement_block_dmtf_header_t)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        value_size = block->measurement_block_dmtf_header.dmtf_spec_measurement_value_size;
+        if (value_size > block_size - sizeof(spdm_measurement_block_dmtf_header_t)) {
+            return LIBSPDM_STATUS_INVALID_MSG_FIELD;
+        }
+        value_type = block->measurement_block_dmtf_header.dmtf_spec_measurement_value_type;
+        measurement_index = block->measurement_block_common_header.index;
+        result->measurement_count++;
+
+        if ((value_type & SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_RAW_BIT_STREAM) == 0) {
+            digest_measured[measurement_index / 8] |= (uint8_t)(1 << (measurement_index % 8));
+            match = lookup->match_digest(lookup->context, measurement_index,
+                                         (const uint8_t *)(block + 1), value_size);
+            if (match != SPDM_APPRAISAL_MATCH_FOUND) {
+                appraisal_fail(result, false,
+                               (match == SPDM_APPRAISAL_MATCH_NO_REFERENCE) ?
+                               SPDM_APPRAISAL_REASON_UNKNOWN_MEASUREMENT :
+                               SPDM_APPRAISAL_REASON_DIGEST_MISMATCH,
+                               measurement_index);
+            }
+        } else if ((value_type & SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_MASK) ==
+                   SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_SECURE_VERSION_NUMBER) {
+            svn_measured[measurement_index / 8] |= (uint8_t)(1 << (measurement_index % 8));
+            appraisal_check_svn(lookup, (const uint8_t *)(block + 1), value_size,
+                                measurement_index, result);
+        }
+    }
+
+    for (index = 0; index < SPDM_APPRAISAL_MAX_INDEX_COUNT; index++) {
+        if (((digest_measured[index / 8] & (1 << (index % 8))) == 0) &&
+            lookup->has_digest(lookup->context, (uint8_t)index)) {
+            appraisal_fail(result, false, SPDM_APPRAISAL_REASON_MISSING_MEASUREMENT,
+                           (uint8_t)index);
+        }
+        if (((svn_measured[index / 8] & (1 << (index % 8))) == 0) &&
+            lookup->get_svn(lookup->context, (uint8_t)index, &svn_is_min, &svn)) {
+            appraisal_fail(result, true, SPDM_APPRAISAL_REASON_MISSING_MEASUREMENT,
+                           (uint8_t)index);
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+libspdm_return_t spdm_appraisal_appraise_measurement(
+    const spdm_appraisal_reference_index_t *reference_index,
+    const void *measurement_record, size_t measurement_record_size,
+    spdm_appraisal_result_t *result)
+{
+    spdm_appraisal_lookup_t lookup;
+
+    lookup.context = reference_index;
+    lookup.match_digest = appraisal_index_match_digest;
+    lookup.has_digest = appraisal_index_has_digest;
+    lookup.get_svn = appraisal_index_get_svn;
+    return spdm_appraisal_appraise_with_lookup(&lookup, measurement_record,
+                                               measurement_record_size, result);
+}
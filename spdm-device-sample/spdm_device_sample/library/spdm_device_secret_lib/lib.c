@@ -89,6 +89,33 @@ bool libspdm_get_responder_private_key_from_raw_data(uint32_t base_asym_algo, vo
 }
 
 #if LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP
+/* The measurements of this sample are constant, so the measurement record and the summary hashes
+ * are computed once and kept. The responder calls the library from a single thread.*/
+#define LIBSPDM_MEASUREMENT_SUMMARY_CACHE_COUNT 4
+
+typedef struct {
+    bool valid;
+    uint32_t measurement_hash_algo;
+    bool use_bit_stream;
+    size_t measurements_size;
+    uint8_t measurements[LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE];
+} libspdm_measurement_record_cache_t;
+
+typedef struct {
+    bool valid;
+    uint32_t measurement_hash_algo;
+    uint32_t base_hash_algo;
+    uint8_t measurement_summary_hash_type;
+    /* SPDM 1.2 and later hash the common header of each block too.*/
+    bool include_common_header;
+    uint8_t measurement_summary_hash[LIBSPDM_MAX_HASH_SIZE];
+} libspdm_measurement_summary_cache_t;
+
+static libspdm_measurement_record_cache_t m_libspdm_measurement_record_cache;
+static libspdm_measurement_summary_cache_t
+    m_libspdm_measurement_summary_cache[LIBSPDM_MEASUREMENT_SUMMARY_CACHE_COUNT];
+static size_t m_libspdm_measurement_summary_cache_next;
+
 /**
  * Fill image hash measurement block.
  *
@@ -362,6 +389,21 @@ libspdm_return_t libspdm_measurement_collection(
     } else if (measurements_index ==
                SPDM_GET_MEASUREMENTS_REQUEST_MEASUREMENT_OPERATION_ALL_MEASUREMENTS) {
 
+        if (m_libspdm_measurement_record_cache.valid &&
+            (m_libspdm_measurement_record_cache.measurement_hash_algo == measurement_hash_algo) &&
+            (m_libspdm_measurement_record_cache.use_bit_stream == use_bit_stream)) {
+            total_size_needed = m_libspdm_measurement_record_cache.measurements_size;
+            LIBSPDM_ASSERT(total_size_needed <= *measurements_size);
+            if (total_size_needed > *measurements_size) {
+                return LIBSPDM_STATUS_BUFFER_TOO_SMALL;
+            }
+            libspdm_copy_mem(measurements, *measurements_size,
+                             m_libspdm_measurement_record_cache.measurements, total_size_needed);
+            *measurements_size = total_size_needed;
+            *measurements_count = LIBSPDM_MEASUREMENT_BLOCK_NUMBER;
+            goto successful_return;
+        }
+
         /* Calculate total_size_needed based on hash algo selected.
          * If we have an hash algo, then the first HASH_NUMBER elements will be
          * hash values, otherwise HASH_NUMBER raw bitstream values.*/
@@ -421,6 +463,16 @@ libspdm_return_t libspdm_measurement_collection(
             measurement_block = (void *)((uint8_t *)measurement_block + measurement_block_size);
         }
 
+        if (total_size_needed <= sizeof(m_libspdm_measurement_record_cache.measurements)) {
+            libspdm_copy_mem(m_libspdm_measurement_record_cache.measurements,
+                             sizeof(m_libspdm_measurement_record_cache.measurements),
+                             measurements, total_size_needed);
+            m_libspdm_measurement_record_cache.measurements_size = total_size_needed;
+            m_libspdm_measurement_record_cache.measurement_hash_algo = measurement_hash_algo;
+            m_libspdm_measurement_record_cache.use_bit_stream = use_bit_stream;
+            m_libspdm_measurement_record_cache.valid = true;
+        }
+
         goto successful_return;
     } else {
         /* One Index */
@@ -554,11 +606,14 @@ bool libspdm_generate_measurement_summary_hash(
     spdm_measurement_block_dmtf_t *cached_measurment_block;
     size_t measurment_data_size;
     size_t measurment_block_size;
+    size_t measurment_hash_data_size;
     uint8_t device_measurement[LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE];
     uint8_t device_measurement_count;
     size_t device_measurement_size;
     libspdm_return_t status;
     bool result;
+    bool include_common_header;
+    libspdm_measurement_summary_cache_t *summary_cache;
 
     switch (measurement_summary_hash_type) {
     case SPDM_CHALLENGE_REQUEST_NO_MEASUREMENT_SUMMARY_HASH:
@@ -570,6 +625,23 @@ bool libspdm_generate_measurement_summary_hash(
             return false;
         }
 
+        include_common_header =
+            (spdm_version >= (SPDM_MESSAGE_VERSION_12 << SPDM_VERSION_NUMBER_SHIFT_BIT));
+        for (index = 0; index < LIBSPDM_MEASUREMENT_SUMMARY_CACHE_COUNT; index++) {
+            summary_cache = &m_libspdm_measurement_summary_cache[index];
+            if (summary_cache->valid &&
+                (summary_cache->measurement_hash_algo == measurement_hash_algo) &&
+                (summary_cache->base_hash_algo == base_hash_algo) &&
+                (summary_cache->measurement_summary_hash_type ==
+                 measurement_summary_hash_type) &&
+                (summary_cache->include_common_header == include_common_header)) {
+                libspdm_copy_mem(measurement_summary_hash, measurement_summary_hash_size,
+                                 summary_cache->measurement_summary_hash,
+                                 measurement_summary_hash_size);
+                return true;
+            }
+        }
+
         /* get all measurement data*/
         device_measurement_size = sizeof(device_measurement);
         status = libspdm_measurement_collection(
@@ -584,15 +656,10 @@ bool libspdm_generate_measurement_summary_hash(
             return false;
         }
 
-        /* double confirm that MeasurmentData internal size is correct*/
-        measurment_data_size = 0;
+        /* get required data and hash them, double confirming the block sizes on the way*/
         cached_measurment_block = (void *)device_measurement;
+        measurment_data_size = 0;
         for (index = 0; index < device_measurement_count; index++) {
-            measurment_block_size =
-                sizeof(spdm_measurement_block_common_header_t) +
-                cached_measurment_block
-                ->measurement_block_common_header
-                .measurement_size;
             LIBSPDM_ASSERT(cached_measurment_block
                            ->measurement_block_common_header
                            .measurement_size ==
@@ -600,22 +667,6 @@ bool libspdm_generate_measurement_summary_hash(
                            cached_measurment_block
                            ->measurement_block_dmtf_header
                            .dmtf_spec_measurement_value_size);
-            measurment_data_size +=
-                cached_measurment_block
-                ->measurement_block_common_header
-                .measurement_size;
-            cached_measurment_block =
-                (void *)((size_t)cached_measurment_block +
-                         measurment_block_size);
-        }
-
-        LIBSPDM_ASSERT(measurment_data_size <=
-                       LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE);
-
-        /* get required data and hash them*/
-        cached_measurment_block = (void *)device_measurement;
-        measurment_data_size = 0;
-        for (index = 0; index < device_measurement_count; index++) {
             measurment_block_size =
                 sizeof(spdm_measurement_block_common_header_t) +
                 cached_measurment_block
@@ -629,44 +680,51 @@ bool libspdm_generate_measurement_summary_hash(
                   .dmtf_spec_measurement_value_type &
                   SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_MASK) ==
                  SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_IMMUTABLE_ROM)) {
-                if (spdm_version < (SPDM_MESSAGE_VERSION_12 << SPDM_VERSION_NUMBER_SHIFT_BIT)) {
-                    libspdm_copy_mem(&measurement_data[measurment_data_size],
-                                     sizeof(measurement_data)
-                                     - (&measurement_data[measurment_data_size] - measurement_data),
-                                     &cached_measurment_block->measurement_block_dmtf_header,
-                                     cached_measurment_block->measurement_block_common_header
-                                     .measurement_size);
-
-                    measurment_data_size +=
+                if (!include_common_header) {
+                    measurment_hash_data_size =
                         cached_measurment_block
                         ->measurement_block_common_header
                         .measurement_size;
+                    libspdm_copy_mem(&measurement_data[measurment_data_size],
+                                     sizeof(measurement_data) - measurment_data_size,
+                                     &cached_measurment_block->measurement_block_dmtf_header,
+                                     measurment_hash_data_size);
                 } else {
+                    measurment_hash_data_size = measurment_block_size;
                     libspdm_copy_mem(&measurement_data[measurment_data_size],
-                                     sizeof(measurement_data)
-                                     - (&measurement_data[measurment_data_size] - measurement_data),
+                                     sizeof(measurement_data) - measurment_data_size,
                                      cached_measurment_block,
-                                     sizeof(cached_measurment_block->measurement_block_common_header) +
-                                     cached_measurment_block->measurement_block_common_header
-                                     .measurement_size);
-
-                    measurment_data_size +=
-                        sizeof(cached_measurment_block->measurement_block_common_header) +
-                        cached_measurment_block
-                        ->measurement_block_common_header
-                        .measurement_size;
+                                     measurment_hash_data_size);
                 }
+                measurment_data_size += measurment_hash_data_size;
             }
             cached_measurment_block =
                 (void *)((size_t)cached_measurment_block +
                          measurment_block_size);
         }
 
+        LIBSPDM_ASSERT(measurment_data_size <=
+                       LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE);
+
         result = libspdm_hash_all(base_hash_algo, measurement_data,
                                   measurment_data_size, measurement_summary_hash);
         if (!result) {
             return false;
         }
+
+        summary_cache =
+            &m_libspdm_measurement_summary_cache[m_libspdm_measurement_summary_cache_next];
+        m_libspdm_measurement_summary_cache_next =
+            (m_libspdm_measurement_summary_cache_next + 1) %
+            LIBSPDM_MEASUREMENT_SUMMARY_CACHE_COUNT;
+        summary_cache->measurement_hash_algo = measurement_hash_algo;
+        summary_cache->base_hash_algo = base_hash_algo;
+        summary_cache->measurement_summary_hash_type = measurement_summary_hash_type;
+        summary_cache->include_common_header = include_common_header;
+        libspdm_copy_mem(summary_cache->measurement_summary_hash,
+                         sizeof(summary_cache->measurement_summary_hash),
+                         measurement_summary_hash, measurement_summary_hash_size);
+        summary_cache->valid = true;
         break;
     default:
         return false;
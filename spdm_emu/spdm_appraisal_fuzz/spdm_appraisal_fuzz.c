@@ -0,0 +1,280 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "hal/base.h"
+#include "hal/library/memlib.h"
+#include "library/spdm_appraisal_lib.h"
+
+#include "os_include.h"
+#include "stdio.h"
+#include "spdm_emu.h"
+
+/* A fuzz input is 1 byte target, then the data of the target:
+ *   0 - an unsigned CoRIM. Its reference values are loaded in a reference index, and built in
+ *       a reference value database that must pass spdm_appraisal_db_check.
+ *   1 - a signed CoRIM, a COSE_Sign1 message checked with a fixed ES256 key. The signature
+ *       never verifies, this covers the COSE and the protected header parsing.
+ *   2 - 2 byte little endian measurement record size, the measurement record, then a reference
+ *       value database, appraised if spdm_appraisal_db_check accepts it.*/
+
+#define FUZZ_TARGET_UNSIGNED_CORIM 0
+#define FUZZ_TARGET_SIGNED_CORIM 1
+#define FUZZ_TARGET_DB 2
+#define FUZZ_TARGET_COUNT 3
+
+/* Largest input read from a file or the standard input.*/
+#define FUZZ_MAX_INPUT_SIZE (1024 * 1024)
+
+/* Inputs run by one AFL persistent mode process before it restarts.*/
+#define FUZZ_AFL_LOOP_COUNT 10000
+
+/* the reference values kept from one CoRIM, the others are only parsed*/
+#define FUZZ_MAX_VALUE_COUNT 4096
+
+/* the DER SubjectPublicKeyInfo of a P-256 key*/
+const uint8_t m_fuzz_corim_key[] = {
+    0x30, 0x59, 0x30, 0x13, 0x06, 0x07, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x02,
+    0x01, 0x06, 0x08, 0x2a, 0x86, 0x48, 0xce, 0x3d, 0x03, 0x01, 0x07, 0x03,
+    0x42, 0x00, 0x04, 0x45, 0x0d, 0xe1, 0x38, 0x08, 0xfa, 0x2d, 0x91, 0x5c,
+    0x2e, 0x2d, 0xd1, 0xf9, 0x46, 0xc3, 0x49, 0x38, 0x72, 0x1a, 0xc9, 0x7d,
+    0xdf, 0xf9, 0x66, 0x2e, 0x60, 0xa2, 0xa1, 0xa6, 0xb5, 0x27, 0xd5, 0xfe,
+    0xee, 0xde, 0xa0, 0x03, 0x67, 0x09, 0x60, 0x35, 0x01, 0xc2, 0xad, 0xd6,
+    0x97, 0x71, 0xf5, 0xfb, 0x77, 0xbc, 0x98, 0x84, 0xd0, 0x40, 0xc7, 0x3a,
+    0xba, 0xc0, 0x2e, 0x2a, 0x42, 0xa8, 0xaa,
+};
+
+char *m_fuzz_input_file_name;
+uint32_t m_fuzz_loop_count = 1;
+
+spdm_appraisal_reference_index_t m_fuzz_reference_index;
+spdm_appraisal_reference_value_t m_fuzz_value[FUZZ_MAX_VALUE_COUNT];
+size_t m_fuzz_value_count;
+
+void print_fuzz_usage(const char *name)
+{
+    printf("\n%s [--input <fuzz_input_file_name>]\n", name);
+    printf("   [--loop <count>]\n");
+    printf("\n");
+    printf("NOTE:\n");
+    printf(
+        "   A fuzz input is 1 byte target, then its data. The target is taken modulo 3:\n");
+    printf(
+        "           0 - an unsigned CoRIM, loaded in a reference index and built in a reference value database.\n");
+    printf(
+        "           1 - a signed CoRIM, checked with a fixed ES256 key.\n");
+    printf(
+        "           2 - 2 byte little endian size, a measurement record of that size, then a reference value database to appraise it with.\n");
+    printf(
+        "   [--input] is the fuzz input to run. By default, it is read from the standard input. In an AFL persistent mode build, it is read again for each run.\n");
+    printf(
+        "   [--loop] is used to run the input several times and print the executions per second. By default, it is 1.\n");
+}
+
+static libspdm_return_t spdm_fuzz_add_value(void *context,
+                                            const spdm_appraisal_reference_value_t *value)
+{
+    if (m_fuzz_value_count < FUZZ_MAX_VALUE_COUNT) {
+        m_fuzz_value[m_fuzz_value_count++] = *value;
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/* A database built from any parsed CoRIM must be accepted by its own check.*/
+static void spdm_fuzz_build_db(void)
+{
+    void *db;
+    size_t db_size;
+
+    db_size = 0;
+    if (spdm_appraisal_db_build(m_fuzz_value, m_fuzz_value_count, NULL, &db_size) !=
+        LIBSPDM_STATUS_BUFFER_TOO_SMALL) {
+        return;
+    }
+    db = (void *)malloc(db_size);
+    if (db == NULL) {
+        return;
+    }
+    if (LIBSPDM_STATUS_IS_SUCCESS(spdm_appraisal_db_build(m_fuzz_value, m_fuzz_value_count,
+                                                          db, &db_size)) &&
+        LIBSPDM_STATUS_IS_ERROR(spdm_appraisal_db_check(db, db_size))) {
+        printf("a built reference value database fails its check\n");
+        abort();
+    }
+    free(db);
+}
+
+static void spdm_fuzz_appraise_db(const uint8_t *data, size_t size)
+{
+    spdm_appraisal_result_t result;
+    size_t record_size;
+    void *db;
+
+    if (size < 2) {
+        return;
+    }
+    record_size = data[0] | ((size_t)data[1] << 8);
+    data += 2;
+    size -= 2;
+    if (record_size > size) {
+        record_size = size;
+    }
+    /* The database must be 8 bytes aligned, as it is when mapped.*/
+    db = (void *)malloc(size - record_size + 1);
+    if (db == NULL) {
+        return;
+    }
+    libspdm_copy_mem(db, size - record_size + 1, data + record_size, size - record_size);
+    if (LIBSPDM_STATUS_IS_SUCCESS(spdm_appraisal_db_check(db, size - record_size))) {
+        spdm_appraisal_db_appraise_measurement(db, data, record_size, &result);
+    }
+    free(db);
+}
+
+void spdm_fuzz_run_input(const uint8_t *data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    switch (data[0] % FUZZ_TARGET_COUNT) {
+    case FUZZ_TARGET_UNSIGNED_CORIM:
+        m_fuzz_value_count = 0;
+        if (LIBSPDM_STATUS_IS_SUCCESS(spdm_appraisal_parse_corim(data + 1, size - 1, NULL, 0,
+                                                                 spdm_fuzz_add_value, NULL))) {
+            spdm_fuzz_build_db();
+        }
+        libspdm_zero_mem(&m_fuzz_reference_index, sizeof(m_fuzz_reference_index));
+        spdm_appraisal_load_corim(&m_fuzz_reference_index, data + 1, size - 1, NULL, 0);
+        break;
+    case FUZZ_TARGET_SIGNED_CORIM:
+        m_fuzz_value_count = 0;
+        spdm_appraisal_parse_corim(data + 1, size - 1, m_fuzz_corim_key,
+                                   sizeof(m_fuzz_corim_key), spdm_fuzz_add_value, NULL);
+        break;
+    case FUZZ_TARGET_DB:
+        spdm_fuzz_appraise_db(data + 1, size - 1);
+        break;
+    }
+}
+
+void process_fuzz_args(char *program_name, int argc, char *argv[])
+{
+    int index;
+
+    for (index = 1; index < argc; index++) {
+        if ((strcmp(argv[index], "-h") == 0) || (strcmp(argv[index], "--help") == 0)) {
+            print_fuzz_usage(program_name);
+            exit(0);
+        }
+        if (((strcmp(argv[index], "--input") != 0) && (strcmp(argv[index], "--loop") != 0)) ||
+            (index + 1 >= argc)) {
+            printf("invalid %s\n", argv[index]);
+            print_fuzz_usage(program_name);
+            exit(0);
+        }
+
+        if (strcmp(argv[index], "--input") == 0) {
+            m_fuzz_input_file_name = argv[index + 1];
+            printf("input - %s\n", m_fuzz_input_file_name);
+        } else {
+            m_fuzz_loop_count = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            if (m_fuzz_loop_count == 0) {
+                printf("invalid --loop %s\n", argv[index + 1]);
+                print_fuzz_usage(program_name);
+                exit(0);
+            }
+            printf("loop - %d\n", m_fuzz_loop_count);
+        }
+        index++;
+    }
+}
+
+#ifdef TEST_WITH_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    spdm_fuzz_run_input(data, size);
+    return 0;
+}
+
+#else
+
+static bool spdm_fuzz_read_input(uint8_t *buffer, size_t *size)
+{
+    FILE *file;
+
+    if (m_fuzz_input_file_name == NULL) {
+        *size = fread(buffer, 1, FUZZ_MAX_INPUT_SIZE, stdin);
+        return !ferror(stdin);
+    }
+    file = fopen(m_fuzz_input_file_name, "rb");
+    if (file == NULL) {
+        printf("!!!Unable to open file %s\n", m_fuzz_input_file_name);
+        return false;
+    }
+    *size = fread(buffer, 1, FUZZ_MAX_INPUT_SIZE, file);
+    fclose(file);
+    return true;
+}
+
+#ifndef __AFL_LOOP
+static void spdm_fuzz_run_loop(const uint8_t *input, size_t input_size)
+{
+    uint32_t loop;
+    uint64_t start;
+    uint64_t elapsed;
+    char value[16];
+
+    start = spdm_emu_get_monotonic_ns();
+    for (loop = 0; loop < m_fuzz_loop_count; loop++) {
+        spdm_fuzz_run_input(input, input_size);
+    }
+    elapsed = spdm_emu_get_monotonic_ns() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    printf("%u executions of %u bytes in %s: %.0f exec/s\n", m_fuzz_loop_count,
+           (uint32_t)input_size, spdm_emu_format_duration(value, sizeof(value), elapsed),
+           (double)m_fuzz_loop_count * 1000000000 / (double)elapsed);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    uint8_t *input;
+    size_t input_size;
+    bool result;
+
+    printf("%s version 0.1\n", "spdm_appraisal_fuzz");
+
+    process_fuzz_args("spdm_appraisal_fuzz", argc, argv);
+
+    input = (void *)malloc(FUZZ_MAX_INPUT_SIZE);
+    if (input == NULL) {
+        return 1;
+    }
+    result = true;
+
+#ifdef __AFL_LOOP
+    while (__AFL_LOOP(FUZZ_AFL_LOOP_COUNT)) {
+        if (spdm_fuzz_read_input(input, &input_size)) {
+            spdm_fuzz_run_input(input, input_size);
+        }
+        if (m_fuzz_input_file_name == NULL) {
+            clearerr(stdin);
+        }
+    }
+#else
+    result = spdm_fuzz_read_input(input, &input_size);
+    if (result) {
+        spdm_fuzz_run_loop(input, input_size);
+    }
+#endif
+
+    free(input);
+    return result ? 0 : 1;
+}
+
+#endif /* TEST_WITH_LIBFUZZER*/
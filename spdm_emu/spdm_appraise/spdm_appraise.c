@@ -0,0 +1,563 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_appraise.h"
+
+#define APPRAISE_MAX_FILE_COUNT 64
+#define APPRAISE_MAX_LINE_SIZE 1024
+
+/* error_code of SpdmSamplePolicy.rego*/
+#define APPRAISE_ERROR_CODE_SUCCESS 0
+#define APPRAISE_ERROR_CODE_FAIL 1
+
+char *m_appraise_corim_file_name[APPRAISE_MAX_FILE_COUNT];
+uint32_t m_appraise_corim_count;
+char *m_appraise_corim_key_file_name;
+char *m_appraise_evidence_file_name[APPRAISE_MAX_FILE_COUNT];
+uint32_t m_appraise_evidence_count;
+char *m_appraise_evidence_list_file_name;
+char *m_appraise_build_db_file_name;
+char *m_appraise_reference_db_file_name;
+
+spdm_appraisal_reference_index_t m_appraise_reference_index;
+/* With --build_db or --reference_db, the appraisals use the database instead of the index.*/
+const void *m_appraise_db;
+void *m_appraise_built_db;
+spdm_emu_file_view_t *m_appraise_db_view;
+
+spdm_appraisal_reference_value_t *m_appraise_value;
+size_t m_appraise_value_count;
+size_t m_appraise_value_capacity;
+uint8_t *m_appraise_corim_key;
+size_t m_appraise_corim_key_size;
+
+spdm_emu_stats_t m_appraise_stats;
+uint32_t m_appraise_pass_count;
+uint32_t m_appraise_fail_count;
+uint32_t m_appraise_error_count;
+
+void print_appraise_usage(const char *name)
+{
+    printf("\n%s --corim <corim_file_name> [--corim <corim_file_name>]|--reference_db <db_file_name>\n", name);
+    printf("   [--corim_key <pem_or_der_file_name>]\n");
+    printf("   [--build_db <db_file_name>]\n");
+    printf("   [--evidence <measurement_file_name>] [--evidence_list <list_file_name>]\n");
+    printf("   [--evidence_store <DIR>] [--log_level ERROR|INFO|DEBUG|VERBOSE]\n");
+    printf("\n");
+    printf("NOTE:\n");
+    printf(
+        "   [--corim] is a CoRIM generated by CoRimTool.py. Its reference values are loaded once, before any appraisal.\n");
+    printf(
+        "           It may be repeated, the reference digests of one index are then accepted from all the CoRIMs.\n");
+    printf(
+        "   [--corim_key] is the EC public key that signed the CoRIMs, in PEM or DER. Without it, only unsigned CoRIMs are accepted.\n");
+    printf(
+        "   [--build_db] writes the reference values of the CoRIMs to a reference value database, with no limit on the digests per index.\n");
+    printf(
+        "           A JSON CoRIM is converted to CBOR with CoRimTool.py json_to_cbor first.\n");
+    printf(
+        "   [--reference_db] is a database written by --build_db. It is mapped and used without parsing, instead of --corim.\n");
+    printf(
+        "   [--evidence] is an SPDM measurement record, such as the device_measurement.bin of spdm_device_attester_sample. It may be repeated.\n");
+    printf(
+        "   [--evidence_list] is a text file with the name of one measurement record per line.\n");
+    printf(
+        "   [--evidence_store] appraises the last measurement record of each device of the store written by spdm_device_attester_sample.\n");
+    printf(
+        "           One line is printed per device, with the error_code, SPDM_HASH_CHECK and SPDM_SVN_CHECK of SpdmSamplePolicy.rego.\n");
+}
+
+/**
+ * Decode the base64 lines between the BEGIN and END lines of a PEM file, in place.
+ *
+ * @return the size of the DER, or 0 if the file is not PEM.
+ **/
+static size_t appraise_decode_pem(uint8_t *data, size_t size)
+{
+    size_t offset;
+    size_t der_size;
+    uint32_t bits;
+    uint32_t bit_count;
+    int32_t value;
+    uint8_t c;
+
+    if ((size < 11) || (libspdm_const_compare_mem(data, "-----BEGIN ", 11) != 0)) {
+        return 0;
+    }
+    for (offset = 0; (offset < size) && (data[offset] != '\n'); offset++) {
+    }
+
+    der_size = 0;
+    bits = 0;
+    bit_count = 0;
+    for (; offset < size; offset++) {
+        c = data[offset];
+        if (c == '-') {
+            break;
+        }
+        if ((c >= 'A') && (c <= 'Z')) {
+            value = c - 'A';
+        } else if ((c >= 'a') && (c <= 'z')) {
+            value = c - 'a' + 26;
+        } else if ((c >= '0') && (c <= '9')) {
+            value = c - '0' + 52;
+        } else if (c == '+') {
+            value = 62;
+        } else if (c == '/') {
+            value = 63;
+        } else {
+            /* line breaks and '=' padding*/
+            continue;
+        }
+        bits = (bits << 6) | (uint32_t)value;
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            /* der_size stays behind offset, 3 bytes are decoded from 4 characters*/
+            data[der_size++] = (uint8_t)(bits >> bit_count);
+        }
+    }
+    return der_size;
+}
+
+static bool appraise_load_corim_key(void)
+{
+    size_t der_size;
+
+    if (m_appraise_corim_key_file_name == NULL) {
+        return true;
+    }
+    if (!libspdm_read_input_file(m_appraise_corim_key_file_name,
+                                 (void **)&m_appraise_corim_key,
+                                 &m_appraise_corim_key_size)) {
+        return false;
+    }
+    der_size = appraise_decode_pem(m_appraise_corim_key, m_appraise_corim_key_size);
+    if (der_size != 0) {
+        m_appraise_corim_key_size = der_size;
+    }
+    return true;
+}
+
+static libspdm_return_t appraise_add_value(void *context,
+                                           const spdm_appraisal_reference_value_t *value)
+{
+    spdm_appraisal_reference_value_t *new_value;
+
+    if (m_appraise_value_count == m_appraise_value_capacity) {
+        m_appraise_value_capacity =
+            (m_appraise_value_capacity == 0) ? 256 : m_appraise_value_capacity * 2;
+        new_value = (void *)realloc(m_appraise_value, m_appraise_value_capacity *
+                                    sizeof(spdm_appraisal_reference_value_t));
+        if (new_value == NULL) {
+            printf("No sufficient memory to load %s\n", (const char *)context);
+            return LIBSPDM_STATUS_BUFFER_FULL;
+        }
+        m_appraise_value = new_value;
+    }
+    m_appraise_value[m_appraise_value_count++] = *value;
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/**
+ * Build the reference value database of --build_db from the values of the CoRIMs, and write it.
+ **/
+static bool appraise_build_db(void)
+{
+    libspdm_return_t status;
+    size_t db_size;
+    uint64_t start;
+    char duration[32];
+
+    start = spdm_emu_get_monotonic_ns();
+    db_size = 0;
+    status = spdm_appraisal_db_build(m_appraise_value, m_appraise_value_count, NULL, &db_size);
+    if (status == LIBSPDM_STATUS_BUFFER_TOO_SMALL) {
+        m_appraise_built_db = (void *)malloc(db_size);
+        if (m_appraise_built_db == NULL) {
+            printf("No sufficient memory to build %s\n", m_appraise_build_db_file_name);
+            return false;
+        }
+        status = spdm_appraisal_db_build(m_appraise_value, m_appraise_value_count,
+                                         m_appraise_built_db, &db_size);
+    }
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        printf("spdm_appraisal_db_build - %x\n", (uint32_t)status);
+        return false;
+    }
+    if (!libspdm_write_output_file(m_appraise_build_db_file_name, m_appraise_built_db, db_size)) {
+        printf("Unable to write file %s\n", m_appraise_build_db_file_name);
+        return false;
+    }
+    m_appraise_db = m_appraise_built_db;
+    printf("%llu digests in %u groups written to %s (%llu bytes) in %s\n",
+           (unsigned long long)((const spdm_appraisal_db_header_t *)m_appraise_db)->digest_count,
+           ((const spdm_appraisal_db_header_t *)m_appraise_db)->group_count,
+           m_appraise_build_db_file_name, (unsigned long long)db_size,
+           spdm_emu_format_duration(duration, sizeof(duration),
+                                    spdm_emu_get_monotonic_ns() - start));
+    return true;
+}
+
+/**
+ * Map the reference value database of --reference_db. Only its header and groups are checked,
+ * so the time does not depend on the number of digests.
+ **/
+static bool appraise_map_db(void)
+{
+    const void *data;
+    size_t size;
+    libspdm_return_t status;
+    uint64_t start;
+    char duration[32];
+
+    start = spdm_emu_get_monotonic_ns();
+    m_appraise_db_view = spdm_emu_map_input_file(m_appraise_reference_db_file_name, &data,
+                                                 &size);
+    if (m_appraise_db_view == NULL) {
+        return false;
+    }
+    status = spdm_appraisal_db_check(data, size);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        printf("spdm_appraisal_db_check (%s) - %x\n", m_appraise_reference_db_file_name,
+               (uint32_t)status);
+        return false;
+    }
+    m_appraise_db = data;
+    printf("%llu digests in %u groups mapped from %s in %s\n",
+           (unsigned long long)((const spdm_appraisal_db_header_t *)data)->digest_count,
+           ((const spdm_appraisal_db_header_t *)data)->group_count,
+           m_appraise_reference_db_file_name,
+           spdm_emu_format_duration(duration, sizeof(duration),
+                                    spdm_emu_get_monotonic_ns() - start));
+    return true;
+}
+
+static bool appraise_load_corims(void)
+{
+    spdm_emu_file_view_t *view;
+    const void *data;
+    size_t size;
+    libspdm_return_t status;
+    uint32_t index;
+    uint64_t start;
+    char duration[32];
+
+    start = spdm_emu_get_monotonic_ns();
+    for (index = 0; index < m_appraise_corim_count; index++) {
+        view = spdm_emu_map_input_file(m_appraise_corim_file_name[index], &data, &size);
+        if (view == NULL) {
+            return false;
+        }
+        /* The index keeps a few digests per measurement index, the database has no limit.*/
+        if (m_appraise_build_db_file_name != NULL) {
+            status = spdm_appraisal_parse_corim(data, size, m_appraise_corim_key,
+                                                m_appraise_corim_key_size, appraise_add_value,
+                                                m_appraise_corim_file_name[index]);
+        } else {
+            status = spdm_appraisal_load_corim(&m_appraise_reference_index, data, size,
+                                               m_appraise_corim_key, m_appraise_corim_key_size);
+        }
+        spdm_emu_release_file_view(view);
+        if (LIBSPDM_STATUS_IS_ERROR(status)) {
+            printf("spdm_appraisal_load_corim (%s) - %x\n", m_appraise_corim_file_name[index],
+                   (uint32_t)status);
+            return false;
+        }
+    }
+    if (m_appraise_build_db_file_name != NULL) {
+        printf("%llu reference values parsed from %u CoRIM in %s\n",
+               (unsigned long long)m_appraise_value_count, m_appraise_corim_count,
+               spdm_emu_format_duration(duration, sizeof(duration),
+                                        spdm_emu_get_monotonic_ns() - start));
+        return appraise_build_db();
+    }
+    printf("%u reference values loaded from %u CoRIM in %s\n",
+           m_appraise_reference_index.reference_count, m_appraise_corim_count,
+           spdm_emu_format_duration(duration, sizeof(duration),
+                                    spdm_emu_get_monotonic_ns() - start));
+    return true;
+}
+
+static const char *appraise_get_reason_name(uint8_t reason)
+{
+    switch (reason) {
+    case SPDM_APPRAISAL_REASON_DIGEST_MISMATCH:
+        return "digest mismatch";
+    case SPDM_APPRAISAL_REASON_SVN_MISMATCH:
+        return "svn mismatch";
+    case SPDM_APPRAISAL_REASON_MISSING_MEASUREMENT:
+        return "missing measurement";
+    case SPDM_APPRAISAL_REASON_UNKNOWN_MEASUREMENT:
+        return "unknown measurement";
+    default:
+        return "none";
+    }
+}
+
+/**
+ * Appraise one measurement record and print the result of the device.
+ **/
+static void appraise_measurement(const char *device_name, const void *data, size_t size)
+{
+    spdm_appraisal_result_t result;
+    libspdm_return_t status;
+    uint64_t start;
+
+    start = spdm_emu_get_monotonic_ns();
+    if (m_appraise_db != NULL) {
+        status = spdm_appraisal_db_appraise_measurement(m_appraise_db, data, size, &result);
+    } else {
+        status = spdm_appraisal_appraise_measurement(&m_appraise_reference_index, data, size,
+                                                     &result);
+    }
+    spdm_emu_stats_record(&m_appraise_stats, spdm_emu_get_monotonic_ns() - start);
+
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        printf("%-32s ERROR malformed measurement record - %x\n", device_name, (uint32_t)status);
+        m_appraise_error_count++;
+        return;
+    }
+    if (result.hash_check && result.svn_check) {
+        printf("%-32s PASS error_code %d SPDM_HASH_CHECK 1 SPDM_SVN_CHECK 1\n", device_name,
+               APPRAISE_ERROR_CODE_SUCCESS);
+        m_appraise_pass_count++;
+        return;
+    }
+    printf("%-32s FAIL error_code %d SPDM_HASH_CHECK %d SPDM_SVN_CHECK %d - %s (index %d)\n",
+           device_name, APPRAISE_ERROR_CODE_FAIL, result.hash_check ? 1 : 0,
+           result.svn_check ? 1 : 0, appraise_get_reason_name(result.reason),
+           result.failed_index);
+    m_appraise_fail_count++;
+}
+
+static void appraise_evidence_file(const char *file_name)
+{
+    spdm_emu_file_view_t *view;
+    const void *data;
+    size_t size;
+
+    view = spdm_emu_map_input_file(file_name, &data, &size);
+    if (view == NULL) {
+        m_appraise_error_count++;
+        return;
+    }
+    appraise_measurement(file_name, data, size);
+    spdm_emu_release_file_view(view);
+}
+
+static bool appraise_evidence_list(void)
+{
+    FILE *file;
+    char line[APPRAISE_MAX_LINE_SIZE];
+    size_t size;
+
+    file = fopen(m_appraise_evidence_list_file_name, "r");
+    if (file == NULL) {
+        printf("Unable to open file %s\n", m_appraise_evidence_list_file_name);
+        return false;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size = strlen(line);
+        while ((size != 0) && ((line[size - 1] == '\n') || (line[size - 1] == '\r') ||
+                               (line[size - 1] == ' '))) {
+            line[--size] = '\0';
+        }
+        if ((size == 0) || (line[0] == '#')) {
+            continue;
+        }
+        appraise_evidence_file(line);
+    }
+    fclose(file);
+    return true;
+}
+
+/**
+ * Appraise the last measurement record of each device of --evidence_store.
+ **/
+static bool appraise_evidence_store(void)
+{
+    const spdm_emu_evidence_record_t *record;
+    const spdm_emu_evidence_record_t *measurement;
+    const void *data;
+    size_t size;
+    size_t record_count;
+    size_t index;
+    char device_name[SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE + 1];
+
+    if (!spdm_emu_evidence_store_open(false)) {
+        return false;
+    }
+
+    /* The records are sorted by device then time, so the last measurement record of a device
+     * is the one seen just before the next device.*/
+    record = spdm_emu_evidence_store_get_records(&record_count);
+    measurement = NULL;
+    for (index = 0; index < record_count; index++) {
+        if (record[index].kind == SPDM_EMU_EVIDENCE_KIND_MEASUREMENT) {
+            measurement = &record[index];
+        }
+        if ((index + 1 < record_count) &&
+            (strncmp(record[index].device, record[index + 1].device,
+                     SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE) == 0)) {
+            continue;
+        }
+        if (measurement == NULL) {
+            continue;
+        }
+        libspdm_copy_mem(device_name, sizeof(device_name), measurement->device,
+                         SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE);
+        device_name[SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE] = '\0';
+        if (spdm_emu_evidence_store_get_data(measurement, &data, &size)) {
+            appraise_measurement(device_name, data, size);
+        } else {
+            printf("%-32s ERROR the measurement record is missing\n", device_name);
+            m_appraise_error_count++;
+        }
+        measurement = NULL;
+    }
+
+    spdm_emu_evidence_store_close();
+    return true;
+}
+
+void process_appraise_args(char *program_name, int *argc, char *argv[])
+{
+    int index;
+    int common_argc;
+
+    common_argc = 1;
+    for (index = 1; index < *argc; index++) {
+        if ((strcmp(argv[index], "-h") == 0) || (strcmp(argv[index], "--help") == 0)) {
+            print_appraise_usage(program_name);
+            exit(0);
+        }
+
+        if ((strcmp(argv[index], "--corim") == 0) ||
+            (strcmp(argv[index], "--corim_key") == 0) ||
+            (strcmp(argv[index], "--evidence") == 0) ||
+            (strcmp(argv[index], "--evidence_list") == 0) ||
+            (strcmp(argv[index], "--build_db") == 0) ||
+            (strcmp(argv[index], "--reference_db") == 0)) {
+            if (index + 1 >= *argc) {
+                printf("invalid %s\n", argv[index]);
+                print_appraise_usage(program_name);
+                exit(0);
+            }
+        } else {
+            argv[common_argc++] = argv[index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--corim") == 0) {
+            if (m_appraise_corim_count == APPRAISE_MAX_FILE_COUNT) {
+                printf("too many --corim\n");
+                exit(0);
+            }
+            m_appraise_corim_file_name[m_appraise_corim_count++] = argv[index + 1];
+            printf("corim - %s\n", argv[index + 1]);
+        } else if (strcmp(argv[index], "--corim_key") == 0) {
+            m_appraise_corim_key_file_name = argv[index + 1];
+            printf("corim_key - %s\n", m_appraise_corim_key_file_name);
+        } else if (strcmp(argv[index], "--evidence") == 0) {
+            if (m_appraise_evidence_count == APPRAISE_MAX_FILE_COUNT) {
+                printf("too many --evidence, use --evidence_list\n");
+                exit(0);
+            }
+            m_appraise_evidence_file_name[m_appraise_evidence_count++] = argv[index + 1];
+        } else if (strcmp(argv[index], "--evidence_list") == 0) {
+            m_appraise_evidence_list_file_name = argv[index + 1];
+            printf("evidence_list - %s\n", m_appraise_evidence_list_file_name);
+        } else if (strcmp(argv[index], "--build_db") == 0) {
+            m_appraise_build_db_file_name = argv[index + 1];
+            printf("build_db - %s\n", m_appraise_build_db_file_name);
+        } else {
+            m_appraise_reference_db_file_name = argv[index + 1];
+            printf("reference_db - %s\n", m_appraise_reference_db_file_name);
+        }
+        index++;
+    }
+    *argc = common_argc;
+
+    if ((m_appraise_corim_count == 0) == (m_appraise_reference_db_file_name == NULL)) {
+        printf("either --corim or --reference_db is required\n");
+        print_appraise_usage(program_name);
+        exit(0);
+    }
+    if ((m_appraise_build_db_file_name != NULL) && (m_appraise_corim_count == 0)) {
+        printf("--build_db requires --corim\n");
+        print_appraise_usage(program_name);
+        exit(0);
+    }
+}
+
+static void appraise_free(void)
+{
+    if (m_appraise_db_view != NULL) {
+        spdm_emu_release_file_view(m_appraise_db_view);
+    }
+    free(m_appraise_built_db);
+    free(m_appraise_value);
+    free(m_appraise_corim_key);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t index;
+    bool result;
+    uint64_t start;
+    char duration[32];
+
+    printf("%s version 0.1\n", "spdm_appraise");
+
+    process_appraise_args("spdm_appraise", &argc, argv);
+    process_args("spdm_appraise", argc, argv);
+
+    if ((m_appraise_evidence_count == 0) && (m_appraise_evidence_list_file_name == NULL) &&
+        (m_evidence_store_dir == NULL) && (m_appraise_build_db_file_name == NULL)) {
+        printf("--evidence, --evidence_list or --evidence_store is required\n");
+        print_appraise_usage("spdm_appraise");
+        return 1;
+    }
+
+    if (m_appraise_reference_db_file_name != NULL) {
+        result = appraise_map_db();
+    } else {
+        result = appraise_load_corim_key() && appraise_load_corims();
+    }
+    if (!result) {
+        appraise_free();
+        return 1;
+    }
+
+    if ((m_appraise_evidence_count == 0) && (m_appraise_evidence_list_file_name == NULL) &&
+        (m_evidence_store_dir == NULL)) {
+        appraise_free();
+        return 0;
+    }
+
+    spdm_emu_stats_init(&m_appraise_stats);
+    start = spdm_emu_get_monotonic_ns();
+    for (index = 0; index < m_appraise_evidence_count; index++) {
+        appraise_evidence_file(m_appraise_evidence_file_name[index]);
+    }
+    if ((m_appraise_evidence_list_file_name != NULL) && !appraise_evidence_list()) {
+        m_appraise_error_count++;
+    }
+    if ((m_evidence_store_dir != NULL) && !appraise_evidence_store()) {
+        m_appraise_error_count++;
+    }
+
+    printf("\n%u pass, %u fail, %u error in %s\n", m_appraise_pass_count,
+           m_appraise_fail_count, m_appraise_error_count,
+           spdm_emu_format_duration(duration, sizeof(duration),
+                                    spdm_emu_get_monotonic_ns() - start));
+    spdm_emu_stats_print_header("appraisal");
+    spdm_emu_stats_print_row("measurement", &m_appraise_stats);
+
+    appraise_free();
+    return ((m_appraise_fail_count == 0) && (m_appraise_error_count == 0)) ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef __SPDM_APPRAISE_H__
+#define __SPDM_APPRAISE_H__
+
+#include "hal/base.h"
+#include "hal/library/memlib.h"
+#include "library/spdm_appraisal_lib.h"
+
+#include "os_include.h"
+#include "stdio.h"
+#include "spdm_emu.h"
+
+#endif
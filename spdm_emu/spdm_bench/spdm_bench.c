@@ -0,0 +1,691 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "spdm_requester_emu.h"
+
+#ifndef _MSC_VER
+#include "fcntl.h"
+#include "signal.h"
+#include "sys/wait.h"
+#endif
+
+/* Statistics are kept per SPDM request code, plus one class for the application messages
+ * of a session.*/
+#define BENCH_MESSAGE_CLASS_APP 256
+#define BENCH_MESSAGE_CLASS_COUNT 257
+#define BENCH_MESSAGE_CLASS_NONE BENCH_MESSAGE_CLASS_COUNT
+
+#define BENCH_ALGO_HASH 0
+#define BENCH_ALGO_ASYM 1
+#define BENCH_ALGO_DHE 2
+#define BENCH_ALGO_AEAD 3
+#define BENCH_ALGO_COUNT 4
+
+#define BENCH_MAX_ALGO_VALUE_COUNT 16
+#define BENCH_MAX_RESPONDER_ARG_COUNT 32
+
+/* How long to wait for a spawned responder to listen, in milliseconds.*/
+#define BENCH_RESPONDER_START_TIMEOUT_MS 5000
+
+const char *m_bench_algo_option[BENCH_ALGO_COUNT] = {
+    "--hash", "--asym", "--dhe", "--aead"
+};
+
+/* The values of each algorithm option. An option that is not given has no value and keeps
+ * the default of the requester and the responder.*/
+char *m_bench_algo_value[BENCH_ALGO_COUNT][BENCH_MAX_ALGO_VALUE_COUNT];
+uint32_t m_bench_algo_value_count[BENCH_ALGO_COUNT];
+
+uint32_t m_bench_iteration_count = 10;
+char *m_bench_json_file_name;
+char *m_bench_responder_path;
+bool m_bench_spawn_responder = true;
+
+/* Options given to the requester that the responder must agree on.*/
+char *m_bench_responder_arg[BENCH_MAX_RESPONDER_ARG_COUNT];
+uint32_t m_bench_responder_arg_count;
+
+#ifdef _MSC_VER
+PROCESS_INFORMATION m_bench_responder_process;
+#else
+pid_t m_bench_responder_pid;
+#endif
+
+libspdm_transport_encode_message_func m_bench_transport_encode_message;
+libspdm_transport_decode_message_func m_bench_transport_decode_message;
+
+/* The request in flight, timed from its encoding to the decoding of its response.*/
+uint32_t m_bench_pending_class = BENCH_MESSAGE_CLASS_NONE;
+uint64_t m_bench_pending_start;
+
+spdm_emu_stats_t *m_bench_stats[BENCH_MESSAGE_CLASS_COUNT];
+uint64_t m_bench_bytes_sent;
+uint64_t m_bench_bytes_received;
+uint64_t m_bench_handshake_count;
+
+void print_bench_usage(const char *name)
+{
+    printf("\n%s [--iterations <count>]\n", name);
+    printf("   [--responder <responder_path>|NONE]\n");
+    printf("   [--json <json_file_name>]\n");
+    printf("   [--hash <hash>[,<hash>...]] [--asym <asym>[,<asym>...]]\n");
+    printf("   [--dhe <dhe>[,<dhe>...]] [--aead <aead>[,<aead>...]]\n");
+    printf("   [spdm_requester_emu options]\n");
+    printf("\n");
+    printf("NOTE:\n");
+    printf(
+        "   [--iterations] is the number of times the requester flow runs for each algorithm combination. By default, it is 10.\n");
+    printf(
+        "           Each run opens a new connection, as spdm_requester_emu does, and runs the flows selected by --exe_conn and --exe_session.\n");
+    printf(
+        "   [--responder] is the spdm_responder_emu started for each algorithm combination. By default, it is spdm_responder_emu next to spdm_bench.\n");
+    printf(
+        "           The responder gets the same --trans, --tcp_sub, --ver, --sec_ver and algorithm options as the requester.\n");
+    printf(
+        "           NONE uses a responder that is already running. It must support every algorithm of the combinations.\n");
+    printf("   [--json] is used to write the results to a JSON file. The durations are in nanoseconds.\n");
+    printf(
+        "   [--hash] [--asym] [--dhe] [--aead] take a comma separated list of algorithms, in the format of spdm_requester_emu.\n");
+    printf(
+        "           Unlike spdm_requester_emu, each value is benchmarked on its own: every combination of the given lists is run.\n");
+    printf("           For example, --hash SHA_256,SHA_384 --dhe SECP_256_R1,SECP_384_R1 runs 4 combinations.\n");
+}
+
+static bool bench_record_latency(uint32_t message_class, uint64_t latency)
+{
+    if (m_bench_stats[message_class] == NULL) {
+        m_bench_stats[message_class] = (void *)malloc(sizeof(spdm_emu_stats_t));
+        if (m_bench_stats[message_class] == NULL) {
+            return false;
+        }
+        spdm_emu_stats_init(m_bench_stats[message_class]);
+    }
+    spdm_emu_stats_record(m_bench_stats[message_class], latency);
+    return true;
+}
+
+static void bench_reset_stats(void)
+{
+    uint32_t index;
+
+    for (index = 0; index < BENCH_MESSAGE_CLASS_COUNT; index++) {
+        free(m_bench_stats[index]);
+        m_bench_stats[index] = NULL;
+    }
+    m_bench_bytes_sent = 0;
+    m_bench_bytes_received = 0;
+    m_bench_handshake_count = 0;
+    m_bench_pending_class = BENCH_MESSAGE_CLASS_NONE;
+}
+
+static const char *bench_get_message_class_name(uint32_t message_class, char *buffer,
+                                                size_t buffer_size)
+{
+    const char *name;
+
+    if (message_class == BENCH_MESSAGE_CLASS_APP) {
+        return "APP";
+    }
+    name = spdm_emu_get_request_name((uint8_t)message_class);
+    if (name == NULL) {
+        snprintf(buffer, buffer_size, "0x%02x", message_class);
+        name = buffer;
+    }
+    return name;
+}
+
+/**
+ * Start the latency measurement of a request, then encode it with the transport of the requester.
+ **/
+static libspdm_return_t bench_transport_encode_message(
+    void *spdm_context, const uint32_t *session_id, bool is_app_message,
+    bool is_request_message, size_t message_size, void *message,
+    size_t *transport_message_size, void **transport_message)
+{
+    libspdm_return_t status;
+
+    if (is_app_message || (message_size < sizeof(spdm_message_header_t))) {
+        m_bench_pending_class = BENCH_MESSAGE_CLASS_APP;
+    } else {
+        m_bench_pending_class = ((spdm_message_header_t *)message)->request_response_code;
+    }
+    /* The encryption of a secured message is part of the measured time.*/
+    m_bench_pending_start = spdm_emu_get_monotonic_ns();
+
+    status = m_bench_transport_encode_message(spdm_context, session_id, is_app_message,
+                                              is_request_message, message_size, message,
+                                              transport_message_size, transport_message);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        m_bench_pending_class = BENCH_MESSAGE_CLASS_NONE;
+        return status;
+    }
+    m_bench_bytes_sent += *transport_message_size;
+    return status;
+}
+
+/**
+ * Decode a response with the transport of the requester, then complete the latency measurement.
+ **/
+static libspdm_return_t bench_transport_decode_message(
+    void *spdm_context, uint32_t **session_id, bool *is_app_message,
+    bool is_request_message, size_t transport_message_size, void *transport_message,
+    size_t *message_size, void **message)
+{
+    libspdm_return_t status;
+    const spdm_message_header_t *header;
+
+    m_bench_bytes_received += transport_message_size;
+    status = m_bench_transport_decode_message(spdm_context, session_id, is_app_message,
+                                              is_request_message, transport_message_size,
+                                              transport_message, message_size, message);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        return status;
+    }
+
+    if (m_bench_pending_class != BENCH_MESSAGE_CLASS_NONE) {
+        bench_record_latency(m_bench_pending_class,
+                             spdm_emu_get_monotonic_ns() - m_bench_pending_start);
+        m_bench_pending_class = BENCH_MESSAGE_CLASS_NONE;
+    }
+
+    if (((is_app_message == NULL) || !*is_app_message) &&
+        (*message_size >= sizeof(spdm_message_header_t))) {
+        header = *message;
+        if ((header->request_response_code == SPDM_FINISH_RSP) ||
+            (header->request_response_code == SPDM_PSK_FINISH_RSP)) {
+            m_bench_handshake_count++;
+        }
+    }
+    return status;
+}
+
+/**
+ * Register the transport of spdm_client_init through the measurement functions above, so
+ * that every message of the requester is measured.
+ **/
+void spdm_requester_register_transport_layer_func(
+    void *spdm_context, uint32_t max_spdm_msg_size, uint32_t transport_header_size,
+    uint32_t transport_tail_size, libspdm_transport_encode_message_func transport_encode_message,
+    libspdm_transport_decode_message_func transport_decode_message)
+{
+    m_bench_transport_encode_message = transport_encode_message;
+    m_bench_transport_decode_message = transport_decode_message;
+    libspdm_register_transport_layer_func(spdm_context, max_spdm_msg_size,
+                                          transport_header_size, transport_tail_size,
+                                          bench_transport_encode_message,
+                                          bench_transport_decode_message);
+}
+
+/**
+ * Start the responder with the given arguments, its output discarded.
+ **/
+static bool bench_start_responder(char *responder_argv[])
+{
+#ifdef _MSC_VER
+    STARTUPINFOA startup_info;
+    char command_line[1024];
+    size_t length;
+    uint32_t index;
+
+    /* quote the path, the options have no space*/
+    length = (size_t)snprintf(command_line, sizeof(command_line), "\"%s\"", responder_argv[0]);
+    for (index = 1; responder_argv[index] != NULL; index++) {
+        if (length >= sizeof(command_line)) {
+            break;
+        }
+        length += (size_t)snprintf(command_line + length, sizeof(command_line) - length, " %s",
+                                   responder_argv[index]);
+    }
+    if (length >= sizeof(command_line)) {
+        printf("responder command line too long\n");
+        return false;
+    }
+
+    libspdm_zero_mem(&startup_info, sizeof(startup_info));
+    startup_info.cb = sizeof(startup_info);
+    if (!CreateProcessA(NULL, command_line, NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL,
+                        &startup_info, &m_bench_responder_process)) {
+        printf("Start %s Failed - %x\n", responder_argv[0], GetLastError());
+        return false;
+    }
+    return true;
+#else
+    int null_fd;
+
+    m_bench_responder_pid = fork();
+    if (m_bench_responder_pid < 0) {
+        printf("fork Failed - %x\n", errno);
+        return false;
+    }
+    if (m_bench_responder_pid == 0) {
+        null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            close(null_fd);
+        }
+        execv(responder_argv[0], responder_argv);
+        fprintf(stderr, "Start %s Failed - %x\n", responder_argv[0], errno);
+        _exit(127);
+    }
+    return true;
+#endif
+}
+
+/**
+ * Wait for the responder to exit, after terminating it if it is still running.
+ **/
+static void bench_stop_responder(bool terminate)
+{
+#ifdef _MSC_VER
+    if (terminate) {
+        TerminateProcess(m_bench_responder_process.hProcess, 1);
+    }
+    WaitForSingleObject(m_bench_responder_process.hProcess, INFINITE);
+    CloseHandle(m_bench_responder_process.hProcess);
+    CloseHandle(m_bench_responder_process.hThread);
+#else
+    if (terminate) {
+        kill(m_bench_responder_pid, SIGTERM);
+    }
+    while ((waitpid(m_bench_responder_pid, NULL, 0) < 0) && (errno == EINTR)) {
+    }
+#endif
+}
+
+static void bench_print_report(const char *combination_name, uint32_t flow_pass_count,
+                               uint32_t flow_fail_count, uint64_t elapsed)
+{
+    uint32_t message_class;
+    char code_name[8];
+    char value[16];
+    double seconds;
+
+    seconds = (elapsed == 0) ? 1e-9 : (double)elapsed / 1000000000;
+
+    printf("\n%s\n", combination_name);
+    printf("    flows: %u passed, %u failed in %s, %.1f flows/s\n",
+           flow_pass_count, flow_fail_count,
+           spdm_emu_format_duration(value, sizeof(value), elapsed),
+           (double)flow_pass_count / seconds);
+    printf("    handshakes: %llu, %.1f handshakes/s\n",
+           (unsigned long long)m_bench_handshake_count,
+           (double)m_bench_handshake_count / seconds);
+    printf("    bytes: %llu sent, %llu received",
+           (unsigned long long)m_bench_bytes_sent,
+           (unsigned long long)m_bench_bytes_received);
+    if (flow_pass_count + flow_fail_count != 0) {
+        printf(", %llu per flow",
+               (unsigned long long)((m_bench_bytes_sent + m_bench_bytes_received) /
+                                    (flow_pass_count + flow_fail_count)));
+    }
+    printf("\n\n");
+
+    spdm_emu_stats_print_header("request");
+    for (message_class = 0; message_class < BENCH_MESSAGE_CLASS_COUNT; message_class++) {
+        if (m_bench_stats[message_class] != NULL) {
+            spdm_emu_stats_print_row(
+                bench_get_message_class_name(message_class, code_name, sizeof(code_name)),
+                m_bench_stats[message_class]);
+        }
+    }
+}
+
+static void bench_write_json(FILE *file, bool is_first, const uint32_t *algo_index,
+                             uint32_t flow_pass_count, uint32_t flow_fail_count,
+                             uint64_t elapsed)
+{
+    uint32_t algo;
+    uint32_t message_class;
+    char code_name[8];
+    bool is_first_message;
+
+    fprintf(file, "%s\n    {", is_first ? "" : ",");
+    for (algo = 0; algo < BENCH_ALGO_COUNT; algo++) {
+        fprintf(file, "\"%s\": \"%s\", ", m_bench_algo_option[algo] + 2,
+                m_bench_algo_value_count[algo] == 0 ?
+                "default" : m_bench_algo_value[algo][algo_index[algo]]);
+    }
+    fprintf(file,
+            "\"flows_passed\": %u, \"flows_failed\": %u, \"elapsed_ns\": %llu, "
+            "\"handshakes\": %llu, \"bytes_sent\": %llu, \"bytes_received\": %llu,\n"
+            "     \"messages\": {",
+            flow_pass_count, flow_fail_count, (unsigned long long)elapsed,
+            (unsigned long long)m_bench_handshake_count,
+            (unsigned long long)m_bench_bytes_sent,
+            (unsigned long long)m_bench_bytes_received);
+    is_first_message = true;
+    for (message_class = 0; message_class < BENCH_MESSAGE_CLASS_COUNT; message_class++) {
+        if (m_bench_stats[message_class] == NULL) {
+            continue;
+        }
+        fprintf(file, "%s\n        \"%s\": ", is_first_message ? "" : ",",
+                bench_get_message_class_name(message_class, code_name, sizeof(code_name)));
+        spdm_emu_stats_write_json(file, m_bench_stats[message_class]);
+        is_first_message = false;
+    }
+    fprintf(file, "}}");
+}
+
+/**
+ * Run the requester flow m_bench_iteration_count times with the algorithms of one combination.
+ *
+ * @param  algo_index                    The index of the value of each algorithm option.
+ * @param  is_last                       This is the last combination.
+ * @param  exe_mode                      The --exe_mode given for a responder that is already running.
+ * @param  json_file                     The JSON file to complete, or NULL.
+ * @param  is_first                      This is the first combination written to json_file.
+ *
+ * @retval true  All the flows passed.
+ * @retval false A flow failed, the remaining iterations are skipped.
+ **/
+static bool bench_run_combination(const uint32_t *algo_index, bool is_last, uint32_t exe_mode,
+                                  FILE *json_file, bool is_first)
+{
+    char *algo_argv[1 + BENCH_ALGO_COUNT * 2];
+    char *responder_argv[BENCH_MAX_RESPONDER_ARG_COUNT + BENCH_ALGO_COUNT * 2 + 4];
+    int algo_argc;
+    uint32_t responder_argc;
+    uint32_t algo;
+    uint32_t index;
+    char combination_name[128];
+    size_t length;
+    uint32_t flow_pass_count;
+    uint32_t flow_fail_count;
+    uint64_t start;
+    uint64_t elapsed;
+    bool result;
+
+    algo_argc = 0;
+    algo_argv[algo_argc++] = "spdm_bench";
+    length = 0;
+    combination_name[0] = '\0';
+    for (algo = 0; algo < BENCH_ALGO_COUNT; algo++) {
+        if (m_bench_algo_value_count[algo] == 0) {
+            continue;
+        }
+        algo_argv[algo_argc++] = (char *)m_bench_algo_option[algo];
+        algo_argv[algo_argc++] = m_bench_algo_value[algo][algo_index[algo]];
+        if (length < sizeof(combination_name)) {
+            length += (size_t)snprintf(combination_name + length,
+                                       sizeof(combination_name) - length, "%s%s",
+                                       length == 0 ? "" : " / ",
+                                       m_bench_algo_value[algo][algo_index[algo]]);
+        }
+    }
+    if (length == 0) {
+        snprintf(combination_name, sizeof(combination_name), "default algorithms");
+    }
+    printf("\n--- %s ---\n", combination_name);
+    process_args("spdm_bench", algo_argc, algo_argv);
+
+    if (m_bench_spawn_responder) {
+        responder_argc = 0;
+        responder_argv[responder_argc++] = m_bench_responder_path;
+        for (index = 0; index < m_bench_responder_arg_count; index++) {
+            responder_argv[responder_argc++] = m_bench_responder_arg[index];
+        }
+        for (index = 1; index < (uint32_t)algo_argc; index++) {
+            responder_argv[responder_argc++] = algo_argv[index];
+        }
+        responder_argv[responder_argc++] = "--log_level";
+        responder_argv[responder_argc++] = "ERROR";
+        responder_argv[responder_argc] = NULL;
+        if (!bench_start_responder(responder_argv)) {
+            return false;
+        }
+    }
+
+    bench_reset_stats();
+    flow_pass_count = 0;
+    flow_fail_count = 0;
+    result = true;
+    start = spdm_emu_get_monotonic_ns();
+    for (index = 0; index < m_bench_iteration_count; index++) {
+        /* keep the responder running until the last flow it serves*/
+        if (index + 1 < m_bench_iteration_count) {
+            m_exe_mode = EXE_MODE_CONTINUE;
+        } else if (m_bench_spawn_responder) {
+            m_exe_mode = EXE_MODE_SHUTDOWN;
+        } else {
+            m_exe_mode = is_last ? exe_mode : EXE_MODE_CONTINUE;
+        }
+
+        if (!platform_client_routine(m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP ?
+                                     TCP_SPDM_PLATFORM_PORT : DEFAULT_SPDM_PLATFORM_PORT)) {
+            flow_fail_count++;
+            result = false;
+            break;
+        }
+        flow_pass_count++;
+    }
+    elapsed = spdm_emu_get_monotonic_ns() - start;
+
+    if (m_bench_spawn_responder) {
+        bench_stop_responder(!result);
+    }
+
+    bench_print_report(combination_name, flow_pass_count, flow_fail_count, elapsed);
+    if (json_file != NULL) {
+        bench_write_json(json_file, is_first, algo_index, flow_pass_count, flow_fail_count,
+                         elapsed);
+    }
+    return result;
+}
+
+/**
+ * Take the bench options out of argv. The other options are left for process_args.
+ **/
+void process_bench_args(char *program_name, int *argc, char *argv[])
+{
+    int index;
+    int common_argc;
+    uint32_t algo;
+    char *value;
+    char *next;
+
+    common_argc = 1;
+    for (index = 1; index < *argc; index++) {
+        if ((strcmp(argv[index], "-h") == 0) || (strcmp(argv[index], "--help") == 0)) {
+            print_bench_usage(program_name);
+            exit(0);
+        }
+
+        for (algo = 0; algo < BENCH_ALGO_COUNT; algo++) {
+            if (strcmp(argv[index], m_bench_algo_option[algo]) == 0) {
+                break;
+            }
+        }
+        if ((algo < BENCH_ALGO_COUNT) ||
+            (strcmp(argv[index], "--iterations") == 0) ||
+            (strcmp(argv[index], "--responder") == 0) ||
+            (strcmp(argv[index], "--json") == 0)) {
+            if (index + 1 >= *argc) {
+                printf("invalid %s\n", argv[index]);
+                print_bench_usage(program_name);
+                exit(0);
+            }
+        } else {
+            /* The responder must use the same transport and version.*/
+            if (((strcmp(argv[index], "--trans") == 0) ||
+                 (strcmp(argv[index], "--tcp_sub") == 0) ||
+                 (strcmp(argv[index], "--ver") == 0) ||
+                 (strcmp(argv[index], "--sec_ver") == 0)) &&
+                (index + 1 < *argc) &&
+                (m_bench_responder_arg_count + 2 <= BENCH_MAX_RESPONDER_ARG_COUNT)) {
+                m_bench_responder_arg[m_bench_responder_arg_count++] = argv[index];
+                m_bench_responder_arg[m_bench_responder_arg_count++] = argv[index + 1];
+            }
+            argv[common_argc++] = argv[index];
+            continue;
+        }
+
+        if (algo < BENCH_ALGO_COUNT) {
+            m_bench_algo_value_count[algo] = 0;
+            value = argv[index + 1];
+            while (value != NULL) {
+                next = strchr(value, ',');
+                if (next != NULL) {
+                    *next = '\0';
+                    next++;
+                }
+                if ((*value == '\0') ||
+                    (m_bench_algo_value_count[algo] == BENCH_MAX_ALGO_VALUE_COUNT)) {
+                    printf("invalid %s %s\n", argv[index], argv[index + 1]);
+                    print_bench_usage(program_name);
+                    exit(0);
+                }
+                m_bench_algo_value[algo][m_bench_algo_value_count[algo]++] = value;
+                value = next;
+            }
+            printf("%s - %u values\n", argv[index] + 2, m_bench_algo_value_count[algo]);
+        } else if (strcmp(argv[index], "--iterations") == 0) {
+            m_bench_iteration_count = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            if (m_bench_iteration_count == 0) {
+                printf("invalid --iterations %s\n", argv[index + 1]);
+                print_bench_usage(program_name);
+                exit(0);
+            }
+            printf("iterations - %u\n", m_bench_iteration_count);
+        } else if (strcmp(argv[index], "--responder") == 0) {
+            if (strcmp(argv[index + 1], "NONE") == 0) {
+                m_bench_spawn_responder = false;
+            } else {
+                m_bench_responder_path = argv[index + 1];
+            }
+            printf("responder - %s\n", argv[index + 1]);
+        } else {
+            m_bench_json_file_name = argv[index + 1];
+            printf("json - %s\n", m_bench_json_file_name);
+        }
+        index++;
+    }
+    *argc = common_argc;
+}
+
+/**
+ * Return spdm_responder_emu in the directory of this program.
+ **/
+static char *bench_get_default_responder_path(const char *program_path)
+{
+    const char *separator;
+    char *path;
+    size_t directory_length;
+    size_t path_size;
+
+    separator = strrchr(program_path, '/');
+#ifdef _MSC_VER
+    if ((strrchr(program_path, '\\') != NULL) &&
+        ((separator == NULL) || (strrchr(program_path, '\\') > separator))) {
+        separator = strrchr(program_path, '\\');
+    }
+#endif
+    directory_length = (separator == NULL) ? 0 : (size_t)(separator - program_path) + 1;
+
+    path_size = directory_length + sizeof("./spdm_responder_emu");
+    path = (void *)malloc(path_size);
+    if (path == NULL) {
+        return NULL;
+    }
+    if (directory_length == 0) {
+        snprintf(path, path_size, "./spdm_responder_emu");
+    } else {
+        snprintf(path, path_size, "%.*s%s", (int)directory_length, program_path,
+                 "spdm_responder_emu");
+    }
+    return path;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t algo_index[BENCH_ALGO_COUNT];
+    uint32_t algo;
+    uint32_t exe_mode;
+    uint32_t combination_count;
+    uint32_t combination;
+    uint32_t fail_count;
+    char *default_responder_path;
+    FILE *json_file;
+
+    printf("%s version 0.1\n", "spdm_bench");
+    srand((unsigned int)time(NULL));
+
+    process_bench_args("spdm_bench", &argc, argv);
+    process_args("spdm_bench", argc, argv);
+    if ((m_loop_duration != 0) || (m_loop_concurrency > 1)) {
+        printf("--duration and --concurrency are not supported by spdm_bench\n");
+        return 1;
+    }
+    /* --exe_mode applies to a responder that is already running, after the last flow.*/
+    exe_mode = m_exe_mode;
+
+    default_responder_path = NULL;
+    if (m_bench_spawn_responder) {
+        if (m_bench_responder_path == NULL) {
+            default_responder_path = bench_get_default_responder_path(argv[0]);
+            if (default_responder_path == NULL) {
+                return 1;
+            }
+            m_bench_responder_path = default_responder_path;
+        }
+        m_connect_retry_ms = BENCH_RESPONDER_START_TIMEOUT_MS;
+    }
+
+    json_file = NULL;
+    if (m_bench_json_file_name != NULL) {
+        json_file = fopen(m_bench_json_file_name, "w");
+        if (json_file == NULL) {
+            printf("!!!Unable to write file %s\n", m_bench_json_file_name);
+            free(default_responder_path);
+            return 1;
+        }
+        fprintf(json_file, "{\"iterations\": %u, \"combinations\": [", m_bench_iteration_count);
+    }
+
+    combination_count = 1;
+    for (algo = 0; algo < BENCH_ALGO_COUNT; algo++) {
+        if (m_bench_algo_value_count[algo] != 0) {
+            combination_count *= m_bench_algo_value_count[algo];
+        }
+    }
+
+    libspdm_zero_mem(algo_index, sizeof(algo_index));
+    fail_count = 0;
+    for (combination = 0; combination < combination_count; combination++) {
+        if (!bench_run_combination(algo_index, combination + 1 == combination_count, exe_mode,
+                                   json_file, combination == 0)) {
+            fail_count++;
+        }
+
+        /* next combination, the last option changes fastest*/
+        algo = BENCH_ALGO_COUNT;
+        while (algo-- > 0) {
+            if (m_bench_algo_value_count[algo] == 0) {
+                continue;
+            }
+            algo_index[algo]++;
+            if (algo_index[algo] < m_bench_algo_value_count[algo]) {
+                break;
+            }
+            algo_index[algo] = 0;
+        }
+    }
+
+    if (json_file != NULL) {
+        fprintf(json_file, "\n]}\n");
+        fclose(json_file);
+    }
+    printf("\n%u of %u combinations failed\n", fail_count, combination_count);
+    printf("Bench stopped\n");
+
+    bench_reset_stats();
+    close_pcap_packet_file();
+    free(default_responder_path);
+    return (fail_count == 0) ? 0 : 1;
+}
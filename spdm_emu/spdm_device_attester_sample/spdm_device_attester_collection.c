@@ -6,8 +6,37 @@
 
 #include "spdm_device_attester_sample.h"
 
-void
-spdm_device_evidence_collection (void *spdm_context)
+/* Keep a piece of evidence in --evidence_store, or write it to <file_prefix><file_name>.
+ * An empty slot is not kept in the store.*/
+static void evidence_collection_save(const char *device_name, const char *file_prefix,
+                                     uint64_t timestamp, uint8_t kind, uint8_t slot_id,
+                                     const char *file_name, const void *data, size_t size)
+{
+    char full_file_name[SPDM_ATTESTER_MAX_FILE_NAME_SIZE];
+
+    if (m_evidence_store_dir != NULL) {
+        if (size != 0) {
+            spdm_emu_evidence_store_add(device_name, timestamp, kind, slot_id, data, size);
+        }
+        return;
+    }
+    snprintf(full_file_name, sizeof(full_file_name), "%s%s", file_prefix, file_name);
+    LIBSPDM_DEBUG((LIBSPDM_DEBUG_INFO, "write file - %s\n", full_file_name));
+    libspdm_write_output_file (full_file_name, data, size);
+}
+
+/**
+ * Collect the certificate chains and the measurements of a device into files, or into
+ * --evidence_store.
+ *
+ * @param  spdm_context                  The SPDM context of the device, after VCA.
+ * @param  device_name                   The name of the device in --evidence_store.
+ * @param  file_prefix                   The prefix of the file names, "device_" for
+ *                                       device_cert_chain_<slot>.bin and device_measurement.bin.
+ **/
+libspdm_return_t
+spdm_device_evidence_collection (void *spdm_context, const char *device_name,
+                                 const char *file_prefix)
 {
     libspdm_return_t status;
     uint32_t measurement_record_length;
@@ -15,8 +44,10 @@ spdm_device_evidence_collection (void *spdm_context)
     spdm_attester_cert_chain_struct_t cert_chain;
     uint8_t slot_id;
     uint32_t session_id;
-    char cert_chain_name[] = "device_cert_chain_0.bin";
-    char measurement_name[] = "device_measurement.bin";
+    char cert_chain_name[SPDM_ATTESTER_MAX_FILE_NAME_SIZE];
+    uint64_t timestamp;
+
+    timestamp = (uint64_t)time(NULL);
 
     /* get cert_chain 0 */
     slot_id = 0;
@@ -27,13 +58,12 @@ spdm_device_evidence_collection (void *spdm_context)
                                       cert_chain.cert_chain);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("libspdm_get_certificate (slot=%d) - %x\n", slot_id, (uint32_t)status);
-        return;
+        return status;
     }
-    cert_chain_name[18] = slot_id + '0';
-    LIBSPDM_DEBUG((LIBSPDM_DEBUG_INFO, "write file - %s\n", cert_chain_name));
-    libspdm_write_output_file (cert_chain_name,
-                               cert_chain.cert_chain,
-                               cert_chain.cert_chain_size);
+    snprintf(cert_chain_name, sizeof(cert_chain_name), "cert_chain_%d.bin", slot_id);
+    evidence_collection_save(device_name, file_prefix, timestamp,
+                             SPDM_EMU_EVIDENCE_KIND_CERT_CHAIN, slot_id, cert_chain_name,
+                             cert_chain.cert_chain, cert_chain.cert_chain_size);
 
     /* setup session based on slot 0 */
     status = libspdm_start_session(
@@ -45,7 +75,7 @@ spdm_device_evidence_collection (void *spdm_context)
         NULL, NULL);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("libspdm_start_session - %x\n", (uint32_t)status);
-        return;
+        return status;
     }
 
     /* get measurement */
@@ -55,12 +85,11 @@ spdm_device_evidence_collection (void *spdm_context)
                                                 &measurement_record_length);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("spdm_send_receive_get_measurement - %x\n", (uint32_t)status);
-        return;
+        return status;
     }
-
-    LIBSPDM_DEBUG((LIBSPDM_DEBUG_INFO, "write file - %s\n", measurement_name));
-    libspdm_write_output_file (measurement_name,
-                               measurement_record, measurement_record_length);
+    evidence_collection_save(device_name, file_prefix, timestamp,
+                             SPDM_EMU_EVIDENCE_KIND_MEASUREMENT, 0, "measurement.bin",
+                             measurement_record, measurement_record_length);
 
     /* get cert_chain 1 ~ 7 */
     for (slot_id = 1; slot_id < SPDM_MAX_SLOT_COUNT; slot_id++) {
@@ -75,19 +104,84 @@ spdm_device_evidence_collection (void *spdm_context)
             printf("libspdm_get_certificate (slot=%d) - %x\n", slot_id, (uint32_t)status);
             cert_chain.cert_chain_size = 0;
         }
-        cert_chain_name[18] = slot_id + '0';
-        LIBSPDM_DEBUG((LIBSPDM_DEBUG_INFO, "write file - %s\n", cert_chain_name));
-        libspdm_write_output_file (cert_chain_name,
-                                   cert_chain.cert_chain,
-                                   cert_chain.cert_chain_size);
+        snprintf(cert_chain_name, sizeof(cert_chain_name), "cert_chain_%d.bin", slot_id);
+        evidence_collection_save(device_name, file_prefix, timestamp,
+                                 SPDM_EMU_EVIDENCE_KIND_CERT_CHAIN, slot_id, cert_chain_name,
+                                 cert_chain.cert_chain, cert_chain.cert_chain_size);
     }
 
     /* stop session */
     status = libspdm_stop_session(spdm_context, session_id, 0);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("libspdm_stop_session - %x\n", (uint32_t)status);
-        return;
+        return status;
     }
 
-    return;
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/**
+ * Print the evidence of the last collection of a device in --evidence_store.
+ *
+ * @param  query                         "<device>[@<time>]", the time in seconds since the epoch.
+ **/
+bool spdm_attester_evidence_query(const char *query)
+{
+    char device_name[SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE];
+    const char *separator;
+    uint64_t timestamp;
+    size_t device_name_size;
+    const spdm_emu_evidence_record_t *record;
+    size_t record_count;
+    size_t index;
+    const void *data;
+    size_t data_size;
+    uint32_t digest_index;
+
+    if (m_evidence_store_dir == NULL) {
+        printf("--evidence_query needs --evidence_store\n");
+        return false;
+    }
+    separator = strrchr(query, '@');
+    if (separator != NULL) {
+        device_name_size = (size_t)(separator - query);
+        timestamp = (uint64_t)strtoull(separator + 1, NULL, 0);
+    } else {
+        device_name_size = strlen(query);
+        timestamp = UINT64_MAX;
+    }
+    if (device_name_size >= sizeof(device_name)) {
+        printf("invalid --evidence_query %s\n", query);
+        return false;
+    }
+    libspdm_copy_mem(device_name, sizeof(device_name), query, device_name_size);
+    device_name[device_name_size] = '\0';
+
+    if (!spdm_emu_evidence_store_open(false)) {
+        return false;
+    }
+    record = spdm_emu_evidence_store_find(device_name, timestamp, &record_count);
+    if (record == NULL) {
+        printf("%s is not in %s\n", query, m_evidence_store_dir);
+        spdm_emu_evidence_store_close();
+        return false;
+    }
+    printf("%s collected at %llu\n", device_name, (unsigned long long)record->timestamp);
+    for (index = 0; index < record_count; index++, record++) {
+        if (record->kind == SPDM_EMU_EVIDENCE_KIND_MEASUREMENT) {
+            printf("    measurement       ");
+        } else {
+            printf("    cert_chain slot %d ", record->slot_id);
+        }
+        printf(" %6u bytes  sha256 ", record->size);
+        for (digest_index = 0; digest_index < SPDM_EMU_EVIDENCE_HASH_SIZE; digest_index++) {
+            printf("%02x", record->digest[digest_index]);
+        }
+        if (!spdm_emu_evidence_store_get_data(record, &data, &data_size)) {
+            printf("  (missing)");
+        }
+        printf("\n");
+    }
+    spdm_emu_evidence_store_close();
+    return true;
 }
@@ -0,0 +1,405 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_device_attester_sample.h"
+
+/* With --inventory, the attester collects the evidence of every device listed in the file.
+ * A line is "<IPv4 address>:<port> <MCTP|PCI_DOE|NONE>", '#' starts a comment.
+ * --inventory_workers threads take the devices in order, each device with its own socket,
+ * connection and SPDM context, so a rack takes about the time of its slowest device.
+ * The files of a device are prefixed with "<address>_<port>_".*/
+
+#define INVENTORY_MAX_LINE_SIZE 256
+#define INVENTORY_MAX_DEVICE_COUNT 4096
+#define INVENTORY_MAX_WORKER_COUNT 64
+
+/* The steps timed for each device.*/
+#define INVENTORY_STEP_CONNECT 0
+#define INVENTORY_STEP_VCA 1
+#define INVENTORY_STEP_EVIDENCE 2
+#define INVENTORY_STEP_TOTAL 3
+#define INVENTORY_STEP_COUNT 4
+
+const char *m_inventory_step_name[INVENTORY_STEP_COUNT] = {
+    "connect",
+    "VCA",
+    "evidence",
+    "total",
+};
+
+typedef struct {
+    spdm_emu_connection_t connection;
+    /* "<address>:<port>"*/
+    char name[32];
+    struct in_addr address;
+    uint16_t port;
+    bool result;
+    const char *failed_step;
+    uint64_t step_ns[INVENTORY_STEP_COUNT];
+} spdm_attester_device_t;
+
+spdm_attester_device_t *m_inventory_device;
+uint32_t m_inventory_device_count;
+/* The next device a worker takes.*/
+uint32_t m_inventory_next_device;
+spdm_emu_mutex_t m_inventory_lock;
+
+static const char *inventory_get_transport_name(uint32_t transport_layer)
+{
+    switch (transport_layer) {
+    case SOCKET_TRANSPORT_TYPE_MCTP:
+        return "MCTP";
+    case SOCKET_TRANSPORT_TYPE_PCI_DOE:
+        return "PCI_DOE";
+    default:
+        return "NONE";
+    }
+}
+
+static bool inventory_parse_line(const char *line, uint32_t line_number)
+{
+    spdm_attester_device_t *device;
+    uint32_t octet[4];
+    uint32_t port;
+    char transport_name[16];
+    uint8_t *address;
+    uint32_t index;
+
+    if ((sscanf(line, "%u.%u.%u.%u:%u %15s", &octet[0], &octet[1], &octet[2], &octet[3],
+                &port, transport_name) != 6) ||
+        (octet[0] > 255) || (octet[1] > 255) || (octet[2] > 255) || (octet[3] > 255) ||
+        (port == 0) || (port > 0xFFFF)) {
+        printf("Inventory fail - invalid device at line %u\n", line_number);
+        return false;
+    }
+    if (m_inventory_device_count == INVENTORY_MAX_DEVICE_COUNT) {
+        printf("Inventory fail - more than %u devices\n", INVENTORY_MAX_DEVICE_COUNT);
+        return false;
+    }
+
+    device = &m_inventory_device[m_inventory_device_count];
+    libspdm_zero_mem(device, sizeof(spdm_attester_device_t));
+    if (strcmp(transport_name, "MCTP") == 0) {
+        device->connection.transport_layer = SOCKET_TRANSPORT_TYPE_MCTP;
+    } else if (strcmp(transport_name, "PCI_DOE") == 0) {
+        device->connection.transport_layer = SOCKET_TRANSPORT_TYPE_PCI_DOE;
+    } else if (strcmp(transport_name, "NONE") == 0) {
+        device->connection.transport_layer = SOCKET_TRANSPORT_TYPE_NONE;
+    } else {
+        printf("Inventory fail - invalid transport %s at line %u\n", transport_name,
+               line_number);
+        return false;
+    }
+    address = (uint8_t *)&device->address;
+    for (index = 0; index < 4; index++) {
+        address[index] = (uint8_t)octet[index];
+    }
+    device->port = (uint16_t)port;
+    snprintf(device->name, sizeof(device->name), "%u.%u.%u.%u:%u", octet[0], octet[1],
+             octet[2], octet[3], port);
+    device->connection.socket = INVALID_SOCKET;
+    m_inventory_device_count++;
+    return true;
+}
+
+static bool inventory_load(const char *inventory_file_name)
+{
+    spdm_emu_file_view_t *view;
+    const void *data;
+    size_t size;
+    const char *text;
+    char line[INVENTORY_MAX_LINE_SIZE];
+    size_t offset;
+    size_t line_size;
+    size_t start;
+    uint32_t line_number;
+    bool result;
+
+    view = spdm_emu_map_input_file(inventory_file_name, &data, &size);
+    if (view == NULL) {
+        return false;
+    }
+    m_inventory_device =
+        (void *)malloc(sizeof(spdm_attester_device_t) * INVENTORY_MAX_DEVICE_COUNT);
+    if (m_inventory_device == NULL) {
+        spdm_emu_release_file_view(view);
+        return false;
+    }
+    text = data;
+    result = true;
+    line_number = 0;
+    for (offset = 0; result && (offset < size); offset += line_size + 1) {
+        line_number++;
+        for (line_size = 0; (offset + line_size < size) && (text[offset + line_size] != '\n');
+             line_size++) {
+        }
+        if (line_size >= sizeof(line)) {
+            printf("Inventory fail - line %u is too long\n", line_number);
+            result = false;
+            break;
+        }
+        libspdm_copy_mem(line, sizeof(line), text + offset, line_size);
+        line[line_size] = '\0';
+        for (start = 0; (line[start] == ' ') || (line[start] == '\t'); start++) {
+        }
+        if ((line[start] == '\0') || (line[start] == '\r') || (line[start] == '#')) {
+            continue;
+        }
+        result = inventory_parse_line(line + start, line_number);
+    }
+    spdm_emu_release_file_view(view);
+    if (result && (m_inventory_device_count == 0)) {
+        printf("Inventory fail - no device in %s\n", inventory_file_name);
+        result = false;
+    }
+    return result;
+}
+
+static void inventory_record_step(spdm_attester_device_t *device, uint32_t step,
+                                  uint64_t *start)
+{
+    uint64_t now;
+
+    now = spdm_emu_get_monotonic_ns();
+    device->step_ns[step] = now - *start;
+    *start = now;
+}
+
+/**
+ * Connect to one device, collect its evidence and disconnect.
+ **/
+static void inventory_collect_device(spdm_attester_device_t *device)
+{
+    spdm_emu_connection_t *connection;
+    SOCKET platform_socket;
+    uint32_t response;
+    size_t response_size;
+    libspdm_return_t status;
+    void *spdm_context;
+    char file_prefix[SPDM_ATTESTER_MAX_FILE_NAME_SIZE];
+    uint64_t device_start;
+    uint64_t start;
+
+    connection = &device->connection;
+    device_start = spdm_emu_get_monotonic_ns();
+    start = device_start;
+    device->failed_step = m_inventory_step_name[INVENTORY_STEP_CONNECT];
+    if (!init_client_address(&platform_socket, &device->address, device->port)) {
+#ifdef _MSC_VER
+        WSACleanup();
+#endif
+        device->step_ns[INVENTORY_STEP_TOTAL] = spdm_emu_get_monotonic_ns() - device_start;
+        return;
+    }
+    connection->socket = platform_socket;
+
+    if (connection->transport_layer != SOCKET_TRANSPORT_TYPE_NONE) {
+        response_size = connection->send_receive_buffer_size;
+        if (!communicate_platform_data(connection, SOCKET_SPDM_COMMAND_TEST,
+                                       (uint8_t *)"Client Hello!", sizeof("Client Hello!"),
+                                       &response, &response_size,
+                                       connection->send_receive_buffer)) {
+            goto done;
+        }
+    }
+    if (connection->transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
+        status = pci_doe_init_request (connection);
+        if (LIBSPDM_STATUS_IS_ERROR(status)) {
+            printf("%s pci_doe_init_request - %x\n", device->name, (uint32_t)status);
+            goto done;
+        }
+    }
+    inventory_record_step(device, INVENTORY_STEP_CONNECT, &start);
+
+    device->failed_step = m_inventory_step_name[INVENTORY_STEP_VCA];
+    spdm_context = spdm_client_init(connection);
+    if (spdm_context == NULL) {
+        goto done;
+    }
+    inventory_record_step(device, INVENTORY_STEP_VCA, &start);
+
+    device->failed_step = m_inventory_step_name[INVENTORY_STEP_EVIDENCE];
+    snprintf(file_prefix, sizeof(file_prefix), "%u.%u.%u.%u_%u_",
+             ((uint8_t *)&device->address)[0], ((uint8_t *)&device->address)[1],
+             ((uint8_t *)&device->address)[2], ((uint8_t *)&device->address)[3],
+             device->port);
+    status = spdm_device_evidence_collection(spdm_context, device->name, file_prefix);
+    spdm_client_deinit(connection);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        goto done;
+    }
+    inventory_record_step(device, INVENTORY_STEP_EVIDENCE, &start);
+    device->failed_step = NULL;
+    device->result = true;
+
+done:
+    response_size = 0;
+    communicate_platform_data(connection, SOCKET_SPDM_COMMAND_SHUTDOWN - m_exe_mode,
+                              NULL, 0, &response, &response_size, NULL);
+    closesocket(platform_socket);
+    connection->socket = INVALID_SOCKET;
+#ifdef _MSC_VER
+    WSACleanup();
+#endif
+    device->step_ns[INVENTORY_STEP_TOTAL] = spdm_emu_get_monotonic_ns() - device_start;
+}
+
+static void inventory_worker_routine(void *context)
+{
+    uint8_t *send_receive_buffer;
+    spdm_attester_device_t *device;
+
+    send_receive_buffer = (void *)malloc(LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE);
+    while (true) {
+        spdm_emu_mutex_lock(&m_inventory_lock);
+        if (m_inventory_next_device == m_inventory_device_count) {
+            spdm_emu_mutex_unlock(&m_inventory_lock);
+            break;
+        }
+        device = &m_inventory_device[m_inventory_next_device];
+        m_inventory_next_device++;
+        spdm_emu_mutex_unlock(&m_inventory_lock);
+
+        if (send_receive_buffer == NULL) {
+            device->failed_step = "no memory";
+            continue;
+        }
+        /* The buffer is only in use while the worker serves this device.*/
+        device->connection.send_receive_buffer = send_receive_buffer;
+        device->connection.send_receive_buffer_size = LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE;
+        inventory_collect_device(device);
+        device->connection.send_receive_buffer = NULL;
+    }
+    free(send_receive_buffer);
+}
+
+static void inventory_print_report(uint32_t worker_count, uint64_t elapsed)
+{
+    spdm_emu_stats_t *step_stats;
+    spdm_attester_device_t *device;
+    uint64_t sum;
+    uint32_t pass_count;
+    uint32_t index;
+    uint32_t step;
+    char value[INVENTORY_STEP_COUNT][16];
+
+    printf("\n%-22s %-8s %-6s %10s %10s %10s %10s\n", "device", "trans", "result",
+           m_inventory_step_name[INVENTORY_STEP_CONNECT], m_inventory_step_name[INVENTORY_STEP_VCA],
+           m_inventory_step_name[INVENTORY_STEP_EVIDENCE],
+           m_inventory_step_name[INVENTORY_STEP_TOTAL]);
+    step_stats = (void *)malloc(sizeof(spdm_emu_stats_t) * INVENTORY_STEP_COUNT);
+    if (step_stats != NULL) {
+        for (step = 0; step < INVENTORY_STEP_COUNT; step++) {
+            spdm_emu_stats_init(&step_stats[step]);
+        }
+    }
+    sum = 0;
+    pass_count = 0;
+    for (index = 0; index < m_inventory_device_count; index++) {
+        device = &m_inventory_device[index];
+        for (step = 0; step < INVENTORY_STEP_COUNT; step++) {
+            if ((device->step_ns[step] == 0) && (step != INVENTORY_STEP_TOTAL)) {
+                snprintf(value[step], sizeof(value[step]), "-");
+                continue;
+            }
+            spdm_emu_format_duration(value[step], sizeof(value[step]), device->step_ns[step]);
+            if ((step_stats != NULL) && device->result) {
+                spdm_emu_stats_record(&step_stats[step], device->step_ns[step]);
+            }
+        }
+        printf("%-22s %-8s %-6s %10s %10s %10s %10s", device->name,
+               inventory_get_transport_name(device->connection.transport_layer),
+               device->result ? "pass" : "fail", value[INVENTORY_STEP_CONNECT],
+               value[INVENTORY_STEP_VCA], value[INVENTORY_STEP_EVIDENCE],
+               value[INVENTORY_STEP_TOTAL]);
+        if (!device->result) {
+            printf("  (%s)", device->failed_step);
+        }
+        printf("\n");
+        sum += device->step_ns[INVENTORY_STEP_TOTAL];
+        if (device->result) {
+            pass_count++;
+        }
+    }
+
+    printf("\n%u devices: %u passed, %u failed with %u workers in %s",
+           m_inventory_device_count, pass_count, m_inventory_device_count - pass_count,
+           worker_count, spdm_emu_format_duration(value[0], sizeof(value[0]), elapsed));
+    printf(", %s one after another\n", spdm_emu_format_duration(value[1], sizeof(value[1]), sum));
+    if ((step_stats != NULL) && (pass_count != 0)) {
+        spdm_emu_stats_print_header("step");
+        for (step = 0; step < INVENTORY_STEP_COUNT; step++) {
+            spdm_emu_stats_print_row(m_inventory_step_name[step], &step_stats[step]);
+        }
+    }
+    free(step_stats);
+}
+
+/**
+ * Collect the evidence of the --inventory devices with --inventory_workers threads, then
+ * print the time of each device.
+ *
+ * @retval true  The evidence of all the devices is collected.
+ * @retval false The inventory is invalid, or a device failed.
+ **/
+bool spdm_attester_inventory_routine(void)
+{
+    spdm_emu_thread_t thread[INVENTORY_MAX_WORKER_COUNT];
+    uint32_t worker_count;
+    uint32_t thread_count;
+    uint32_t index;
+    uint64_t start;
+    uint64_t elapsed;
+    bool result;
+
+    if (!inventory_load(m_inventory_file_name)) {
+        free(m_inventory_device);
+        m_inventory_device = NULL;
+        m_inventory_device_count = 0;
+        return false;
+    }
+
+    worker_count = m_inventory_worker_count;
+    if ((worker_count == 0) || (worker_count > INVENTORY_MAX_WORKER_COUNT)) {
+        worker_count = INVENTORY_MAX_WORKER_COUNT;
+    }
+    if (worker_count > m_inventory_device_count) {
+        worker_count = m_inventory_device_count;
+    }
+    printf("Inventory - %u devices, %u workers\n", m_inventory_device_count, worker_count);
+
+    spdm_emu_mutex_init(&m_inventory_lock);
+    m_inventory_next_device = 0;
+    start = spdm_emu_get_monotonic_ns();
+    thread_count = 0;
+    for (index = 0; index < worker_count; index++) {
+        if (!spdm_emu_thread_create(&thread[thread_count], inventory_worker_routine, NULL)) {
+            printf("Create worker thread fail\n");
+            break;
+        }
+        thread_count++;
+    }
+    if (thread_count == 0) {
+        /* The devices are collected by this thread instead.*/
+        inventory_worker_routine(NULL);
+    }
+    for (index = 0; index < thread_count; index++) {
+        spdm_emu_thread_join(thread[index]);
+    }
+    elapsed = spdm_emu_get_monotonic_ns() - start;
+
+    inventory_print_report(thread_count == 0 ? 1 : thread_count, elapsed);
+
+    result = true;
+    for (index = 0; index < m_inventory_device_count; index++) {
+        result = result && m_inventory_device[index].result;
+    }
+    spdm_emu_mutex_destroy(&m_inventory_lock);
+    free(m_inventory_device);
+    m_inventory_device = NULL;
+    m_inventory_device_count = 0;
+    return result;
+}
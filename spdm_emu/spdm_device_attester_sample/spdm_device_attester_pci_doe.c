@@ -8,7 +8,7 @@
 
 void *m_pci_doe_context;
 
-libspdm_return_t pci_doe_init_request()
+libspdm_return_t pci_doe_init_request(spdm_emu_connection_t *connection)
 {
     pci_doe_data_object_protocol_t data_object_protocol[6];
     size_t data_object_protocol_size;
@@ -17,7 +17,7 @@ libspdm_return_t pci_doe_init_request()
 
     data_object_protocol_size = sizeof(data_object_protocol);
     status =
-        pci_doe_discovery (m_pci_doe_context, data_object_protocol, &data_object_protocol_size);
+        pci_doe_discovery (connection, data_object_protocol, &data_object_protocol_size);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         return status;
     }
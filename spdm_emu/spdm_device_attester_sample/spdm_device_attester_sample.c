@@ -8,28 +8,15 @@
 
 uint8_t m_receive_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
 
-extern SOCKET m_socket;
-
-extern void *m_spdm_context;
-extern void *m_scratch_buffer;
-
-void *spdm_client_init(void);
-
-libspdm_return_t pci_doe_init_request(void);
-
-bool communicate_platform_data(SOCKET socket, uint32_t command,
-                               const uint8_t *send_buffer, size_t bytes_to_send,
-                               uint32_t *response,
-                               size_t *bytes_to_receive,
-                               uint8_t *receive_buffer);
-
 bool platform_client_routine(uint16_t port_number)
 {
+    spdm_emu_connection_t *connection;
     SOCKET platform_socket;
     bool result;
     uint32_t response;
     size_t response_size;
     libspdm_return_t status;
+    void *spdm_context;
 
     result = init_client(&platform_socket, port_number);
     if (!result) {
@@ -39,12 +26,14 @@ bool platform_client_routine(uint16_t port_number)
         return false;
     }
 
-    m_socket = platform_socket;
+    connection = &m_default_connection;
+    connection->socket = platform_socket;
+    connection->transport_layer = m_use_transport_layer;
 
     if (m_use_transport_layer != SOCKET_TRANSPORT_TYPE_NONE) {
         response_size = sizeof(m_receive_buffer);
         result = communicate_platform_data(
-            platform_socket,
+            connection,
             SOCKET_SPDM_COMMAND_TEST,
             (uint8_t *)"Client Hello!",
             sizeof("Client Hello!"), &response,
@@ -55,7 +44,7 @@ bool platform_client_routine(uint16_t port_number)
     }
 
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
-        status = pci_doe_init_request ();
+        status = pci_doe_init_request (connection);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("pci_doe_init_request - %x\n", (uint32_t)status);
             goto done;
@@ -64,10 +53,10 @@ bool platform_client_routine(uint16_t port_number)
 
     /* Do test - begin*/
 
-    m_spdm_context = spdm_client_init ();
-    if (m_spdm_context != NULL) {
-        spdm_device_evidence_collection (m_spdm_context);
-        free(m_spdm_context);
+    spdm_context = spdm_client_init (connection);
+    if (spdm_context != NULL) {
+        spdm_device_evidence_collection (spdm_context, "device", "device_");
+        spdm_client_deinit (connection);
     }
 
     /* Do test - end*/
@@ -75,7 +64,7 @@ bool platform_client_routine(uint16_t port_number)
 done:
     response_size = 0;
     result = communicate_platform_data(
-        platform_socket, SOCKET_SPDM_COMMAND_SHUTDOWN - m_exe_mode,
+        connection, SOCKET_SPDM_COMMAND_SHUTDOWN - m_exe_mode,
         NULL, 0, &response, &response_size, NULL);
 
     closesocket(platform_socket);
@@ -94,7 +83,27 @@ int main(int argc, char *argv[])
 
     process_args("spdm_device_attester_sample", argc, argv);
 
-    platform_client_routine(DEFAULT_SPDM_PLATFORM_PORT);
+    if (m_evidence_query != NULL) {
+        spdm_attester_evidence_query(m_evidence_query);
+        return 0;
+    }
+
+    if (!spdm_emu_trust_cache_init()) {
+        return 0;
+    }
+    if (!spdm_emu_evidence_store_open(true)) {
+        spdm_emu_trust_cache_free();
+        return 0;
+    }
+
+    if (m_inventory_file_name != NULL) {
+        spdm_attester_inventory_routine();
+    } else {
+        platform_client_routine(DEFAULT_SPDM_PLATFORM_PORT);
+    }
+
+    spdm_emu_evidence_store_close();
+    spdm_emu_trust_cache_free();
     printf("Client stopped\n");
 
     close_pcap_packet_file();
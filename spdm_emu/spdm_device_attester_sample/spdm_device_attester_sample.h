@@ -31,6 +31,25 @@ libspdm_return_t spdm_send_receive_get_measurement(void *spdm_context,
                                                    uint8_t *measurement_record,
                                                    uint32_t *measurement_record_length);
 
-void spdm_device_evidence_collection (void *spdm_context);
+#define SPDM_ATTESTER_MAX_FILE_NAME_SIZE 256
+
+libspdm_return_t spdm_device_evidence_collection (void *spdm_context, const char *device_name,
+                                                   const char *file_prefix);
+
+bool communicate_platform_data(const spdm_emu_connection_t *connection, uint32_t command,
+                               const uint8_t *send_buffer, size_t bytes_to_send,
+                               uint32_t *response,
+                               size_t *bytes_to_receive,
+                               uint8_t *receive_buffer);
+
+void *spdm_client_init(spdm_emu_connection_t *connection);
+
+void spdm_client_deinit(spdm_emu_connection_t *connection);
+
+libspdm_return_t pci_doe_init_request(spdm_emu_connection_t *connection);
+
+bool spdm_attester_inventory_routine(void);
+
+bool spdm_attester_evidence_query(const char *query);
 
 #endif
@@ -6,11 +6,7 @@
 
 #include "spdm_device_attester_sample.h"
 
-void *m_spdm_context;
-void *m_scratch_buffer;
-SOCKET m_socket;
-
-bool communicate_platform_data(SOCKET socket, uint32_t command,
+bool communicate_platform_data(const spdm_emu_connection_t *connection, uint32_t command,
                                const uint8_t *send_buffer, size_t bytes_to_send,
                                uint32_t *response,
                                size_t *bytes_to_receive,
@@ -19,7 +15,8 @@ bool communicate_platform_data(SOCKET socket, uint32_t command,
     bool result;
 
     result =
-        send_platform_data(socket, command, send_buffer, bytes_to_send);
+        send_platform_data_ex(connection->socket, connection->transport_layer, command,
+                              send_buffer, bytes_to_send);
     if (!result) {
         printf("send_platform_data Error - %x\n",
 #ifdef _MSC_VER
@@ -31,8 +28,8 @@ bool communicate_platform_data(SOCKET socket, uint32_t command,
         return result;
     }
 
-    result = receive_platform_data(socket, response, receive_buffer,
-                                   bytes_to_receive);
+    result = receive_platform_data_ex(connection->socket, connection->transport_layer,
+                                      response, receive_buffer, bytes_to_receive);
     if (!result) {
         printf("receive_platform_data Error - %x\n",
 #ifdef _MSC_VER
@@ -50,10 +47,13 @@ libspdm_return_t spdm_device_send_message(void *spdm_context,
                                           size_t request_size, const void *request,
                                           uint64_t timeout)
 {
+    spdm_emu_connection_t *connection;
     bool result;
 
-    result = send_platform_data(m_socket, SOCKET_SPDM_COMMAND_NORMAL,
-                                request, (uint32_t)request_size);
+    connection = spdm_emu_get_connection(spdm_context);
+    result = send_platform_data_ex(connection->socket, connection->transport_layer,
+                                   SOCKET_SPDM_COMMAND_NORMAL,
+                                   request, (uint32_t)request_size);
     if (!result) {
         printf("send_platform_data Error - %x\n",
 #ifdef _MSC_VER
@@ -72,11 +72,13 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
                                              void **response,
                                              uint64_t timeout)
 {
+    spdm_emu_connection_t *connection;
     bool result;
     uint32_t command;
 
-    result = receive_platform_data(m_socket, &command, *response,
-                                   response_size);
+    connection = spdm_emu_get_connection(spdm_context);
+    result = receive_platform_data_ex(connection->socket, connection->transport_layer,
+                                      &command, *response, response_size);
     if (!result) {
         printf("receive_platform_data Error - %x\n",
 #ifdef _MSC_VER
@@ -93,6 +95,7 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
 /**
  * Send and receive an DOE message
  *
+ * @param pci_doe_context               the platform connection of the device.
  * @param request                       the PCI DOE request message, start from pci_doe_data_object_header_t.
  * @param request_size                  size in bytes of request.
  * @param response                      the PCI DOE response message, start from pci_doe_data_object_header_t.
@@ -109,7 +112,7 @@ libspdm_return_t pci_doe_send_receive_data(const void *pci_doe_context,
     uint32_t response_code;
 
     result = communicate_platform_data(
-        m_socket, SOCKET_SPDM_COMMAND_NORMAL,
+        pci_doe_context, SOCKET_SPDM_COMMAND_NORMAL,
         request, request_size,
         &response_code, response_size,
         response);
@@ -119,7 +122,22 @@ libspdm_return_t pci_doe_send_receive_data(const void *pci_doe_context,
     return LIBSPDM_STATUS_SUCCESS;
 }
 
-void *spdm_client_init(void)
+/**
+ * Free the SPDM context and the scratch buffer of a device connection.
+ **/
+void spdm_client_deinit(spdm_emu_connection_t *connection)
+{
+    free(connection->spdm_context);
+    connection->spdm_context = NULL;
+    free(connection->scratch_buffer);
+    connection->scratch_buffer = NULL;
+}
+
+/**
+ * Create and provision an SPDM context for a device connection, then run VCA.
+ * The context and the scratch buffer are owned by the connection, see spdm_client_deinit.
+ **/
+void *spdm_client_init(spdm_emu_connection_t *connection)
 {
     void *spdm_context;
     libspdm_return_t status;
@@ -131,17 +149,21 @@ void *spdm_client_init(void)
 
     printf("context_size - 0x%x\n", (uint32_t)libspdm_get_context_size());
 
-    m_spdm_context = (void *)malloc(libspdm_get_context_size());
-    if (m_spdm_context == NULL) {
+    spdm_context = (void *)malloc(libspdm_get_context_size());
+    if (spdm_context == NULL) {
         return NULL;
     }
-    spdm_context = m_spdm_context;
+    connection->spdm_context = spdm_context;
     libspdm_init_context(spdm_context);
+    if (!spdm_emu_attach_connection(spdm_context, connection)) {
+        spdm_client_deinit(connection);
+        return NULL;
+    }
 
     libspdm_register_device_io_func(spdm_context, spdm_device_send_message,
                                     spdm_device_receive_message);
 
-    if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
+    if (connection->transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
         libspdm_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
@@ -149,7 +171,7 @@ void *spdm_client_init(void)
             LIBSPDM_TRANSPORT_TAIL_SIZE,
             libspdm_transport_mctp_encode_message,
             libspdm_transport_mctp_decode_message);
-    } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
+    } else if (connection->transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
         libspdm_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
@@ -157,7 +179,7 @@ void *spdm_client_init(void)
             LIBSPDM_TRANSPORT_TAIL_SIZE,
             libspdm_transport_pci_doe_encode_message,
             libspdm_transport_pci_doe_decode_message);
-    } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_NONE) {
+    } else if (connection->transport_layer == SOCKET_TRANSPORT_TYPE_NONE) {
         libspdm_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
@@ -166,8 +188,7 @@ void *spdm_client_init(void)
             spdm_transport_none_encode_message,
             spdm_transport_none_decode_message);
     } else {
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+        spdm_client_deinit(connection);
         return NULL;
     }
 
@@ -179,14 +200,13 @@ void *spdm_client_init(void)
                                         spdm_device_acquire_receiver_buffer,
                                         spdm_device_release_receiver_buffer);
 
-    scratch_buffer_size = libspdm_get_sizeof_required_scratch_buffer(m_spdm_context);
-    m_scratch_buffer = (void *)malloc(scratch_buffer_size);
-    if (m_scratch_buffer == NULL) {
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+    scratch_buffer_size = libspdm_get_sizeof_required_scratch_buffer(spdm_context);
+    connection->scratch_buffer = (void *)malloc(scratch_buffer_size);
+    if (connection->scratch_buffer == NULL) {
+        spdm_client_deinit(connection);
         return NULL;
     }
-    libspdm_set_scratch_buffer (spdm_context, m_scratch_buffer, scratch_buffer_size);
+    libspdm_set_scratch_buffer (spdm_context, connection->scratch_buffer, scratch_buffer_size);
 
     libspdm_zero_mem(&parameter, sizeof(parameter));
     parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
@@ -194,7 +214,8 @@ void *spdm_client_init(void)
     data8 = 0;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_CAPABILITY_CT_EXPONENT,
                      &parameter, &data8, sizeof(data8));
-    m_use_requester_capability_flags =
+    /* A local copy, so that the --inventory workers can provision their contexts together.*/
+    data32 =
         (0 |
          SPDM_GET_CAPABILITIES_REQUEST_FLAGS_CERT_CAP |
          SPDM_GET_CAPABILITIES_REQUEST_FLAGS_CHAL_CAP |
@@ -209,7 +230,6 @@ void *spdm_client_init(void)
          /* SPDM_GET_CAPABILITIES_REQUEST_FLAGS_HANDSHAKE_IN_THE_CLEAR_CAP |
           * SPDM_GET_CAPABILITIES_REQUEST_FLAGS_PUB_KEY_ID_CAP |*/
          0);
-    data32 = m_use_requester_capability_flags;
     if (m_use_capability_flags != 0) {
         data32 = m_use_capability_flags;
     }
@@ -244,10 +264,9 @@ void *spdm_client_init(void)
     status = libspdm_init_connection(spdm_context, false);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("libspdm_init_connection - 0x%x\n", (uint32_t)status);
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+        spdm_client_deinit(connection);
         return NULL;
     }
 
-    return m_spdm_context;
+    return spdm_context;
 }
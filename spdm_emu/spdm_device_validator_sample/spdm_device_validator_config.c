@@ -176,3 +176,51 @@ common_test_suite_config_t m_spdm_responder_validator_config = {
     "spdm_responder_validator default config",
     m_spdm_test_group_configs
 };
+
+/* The --test_groups names, in the order of m_spdm_test_group_configs.*/
+const char *m_spdm_test_group_names[] = {
+    "VERSION",
+    "CAPABILITIES",
+    "ALGORITHMS",
+    "DIGESTS",
+    "CERTIFICATE",
+    "CHALLENGE_AUTH",
+    "MEASUREMENTS",
+    "KEY_EXCHANGE_RSP",
+    "FINISH_RSP",
+    "HEARTBEAT_ACK",
+    "KEY_UPDATE_ACK",
+    "END_SESSION_ACK",
+};
+
+/* The test cases of each group, for --timing to run them one by one.*/
+common_test_case_config_t *m_spdm_test_case_configs[] = {
+    m_spdm_test_group_version_configs,
+    m_spdm_test_group_capabilities_configs,
+    m_spdm_test_group_algorithms_configs,
+    m_spdm_test_group_digests_configs,
+    m_spdm_test_group_certificate_configs,
+    m_spdm_test_group_challenge_auth_configs,
+    m_spdm_test_group_measurements_configs,
+    m_spdm_test_group_key_exchange_rsp_configs,
+    m_spdm_test_group_finish_rsp_configs,
+    m_spdm_test_group_heartbeat_ack_configs,
+    m_spdm_test_group_key_update_ack_configs,
+    m_spdm_test_group_end_session_ack_configs,
+};
+
+/* without the end of the cases*/
+const uint32_t m_spdm_test_case_counts[] = {
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_version_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_capabilities_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_algorithms_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_digests_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_certificate_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_challenge_auth_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_measurements_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_key_exchange_rsp_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_finish_rsp_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_heartbeat_ack_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_key_update_ack_configs) - 1,
+    LIBSPDM_ARRAY_SIZE(m_spdm_test_group_end_session_ack_configs) - 1,
+};
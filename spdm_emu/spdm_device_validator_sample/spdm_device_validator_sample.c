@@ -8,6 +8,30 @@
 
 uint8_t m_receive_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
 
+const char *m_validator_algo_option[SPDM_VALIDATOR_ALGO_COUNT] = {
+    "--ver", "--asym", "--dhe"
+};
+
+char *m_validator_algo_value[SPDM_VALIDATOR_ALGO_COUNT][SPDM_VALIDATOR_MAX_ALGO_VALUE_COUNT];
+uint32_t m_validator_algo_value_count[SPDM_VALIDATOR_ALGO_COUNT];
+
+/* 0 runs the test groups here, one after another.*/
+uint32_t m_validator_shard_count;
+char *m_validator_responder_path;
+bool m_validator_spawn_responder = true;
+char *m_validator_report_file_name = "spdm_device_validator_report.log";
+bool m_validator_group_selected[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+
+char *m_validator_forward_arg[SPDM_VALIDATOR_MAX_FORWARD_ARG_COUNT];
+uint32_t m_validator_forward_arg_count;
+char *m_validator_job_arg[SPDM_VALIDATOR_MAX_JOB_ARG_COUNT];
+uint32_t m_validator_job_arg_count;
+
+/* The jobs would all write the same file, or --exe_mode is chosen by --responder.*/
+const char *m_validator_shard_unsupported_option[] = {
+    "--exe_mode", "--pcap", "--pcap_rotate", "--save_state", "--state_store"
+};
+
 extern SOCKET m_socket;
 
 extern void *m_spdm_context;
@@ -65,7 +89,11 @@ bool platform_client_routine(uint16_t port_number)
     /* Do test - begin*/
 
     m_spdm_context = spdm_client_init ();
-    spdm_responder_conformance_test (m_spdm_context, &m_spdm_responder_validator_config);
+    if (m_validator_timing_file_name != NULL) {
+        spdm_validator_timing_run_test_cases(m_spdm_context);
+    } else {
+        spdm_responder_conformance_test (m_spdm_context, &m_spdm_responder_validator_config);
+    }
     if (m_spdm_context != NULL) {
         free(m_spdm_context);
     }
@@ -87,16 +115,316 @@ done:
     return true;
 }
 
+void print_validator_usage(const char *name)
+{
+    printf("\n%s [--test_groups <group>[,<group>...]]\n", name);
+    printf("   [--connect_timeout <ms>]\n");
+    printf("   [--timing <json_or_csv_file_name>]\n");
+    printf("   [--timing_rtt <us>]\n");
+    printf("   [--shards <number>]\n");
+    printf("   [--responder <responder_path>|NONE]\n");
+    printf("   [--report <report_file_name>]\n");
+    printf("   [--ver <ver>[,<ver>...]] [--asym <asym>[,<asym>...]] [--dhe <dhe>[,<dhe>...]]\n");
+    printf("   [spdm_requester_emu options]\n");
+    printf("\n");
+    printf("NOTE:\n");
+    printf(
+        "   [--test_groups] selects the test groups to run. By default, all are run.\n");
+    printf(
+        "           VERSION|CAPABILITIES|ALGORITHMS|DIGESTS|CERTIFICATE|CHALLENGE_AUTH|MEASUREMENTS|KEY_EXCHANGE_RSP|FINISH_RSP|HEARTBEAT_ACK|KEY_UPDATE_ACK|END_SESSION_ACK\n");
+    printf(
+        "   [--connect_timeout] is how long to retry connecting to a responder that is not listening yet. By default, 0 is used.\n");
+    printf(
+        "   [--timing] runs the test cases one by one and times every request to the responder. The file name ending with .csv selects CSV, otherwise JSON is used.\n");
+    printf(
+        "           A round trip must take at most RTT + CT, with CT from the CT exponent of CAPABILITIES, for CHALLENGE, KEY_EXCHANGE, FINISH,\n");
+    printf(
+        "           PSK_EXCHANGE, PSK_FINISH and a signed GET_MEASUREMENTS, and RTT + ST1 (100ms) for the others. The exit code is 2 if a round trip is over.\n");
+    printf(
+        "           After a ResponseNotReady, the deferred response must come within RTT + RDT x RDTM. With --shards, the timing of every job is merged into the file.\n");
+    printf(
+        "   [--timing_rtt] is the RTT of the transport in the timing budgets, in microseconds. By default, 0 is used.\n");
+    printf(
+        "   [--shards] is the number of responder instances the test groups run on at the same time. By default, the groups run here one after another.\n");
+    printf(
+        "           Each test group of each algorithm combination is a job. A shard takes the next job, starts a responder on its own port from --port,\n");
+    printf(
+        "           and runs the job in a new spdm_device_validator_sample, with its own SPDM context. The time is about the one of the slowest shard.\n");
+    printf(
+        "   [--responder] is the spdm_responder_emu started for each job. By default, it is spdm_responder_emu next to spdm_device_validator_sample.\n");
+    printf(
+        "           The responder gets the same --trans, --tcp_sub and --sec_ver options as the validator, and the algorithms of the combination.\n");
+    printf(
+        "           NONE uses the responders that are already running on --shards ports from --port, with --exe_mode CONTINUE. The lists are not supported.\n");
+    printf(
+        "           The validator of each job gets the spdm_requester_emu options given here, but --port.\n");
+    printf(
+        "           --exe_mode, --pcap, --pcap_rotate, --save_state and --state_store are not supported with --shards. --port + --shards - 1 must be at most 65535.\n");
+    printf(
+        "   [--report] is the file the output of all the jobs is merged into. By default, spdm_device_validator_report.log is used.\n");
+    printf(
+        "   [--ver] [--asym] [--dhe] take a comma separated list with --shards. Every combination of the given lists is validated.\n");
+    printf(
+        "           For example, --ver 1.1,1.2 --asym ECDSA_P256,ECDSA_P384 runs the test groups against 4 responder configurations.\n");
+}
+
+static bool validator_select_test_groups(char *list)
+{
+    char *value;
+    char *next;
+    uint32_t index;
+
+    libspdm_zero_mem(m_validator_group_selected, sizeof(m_validator_group_selected));
+    value = list;
+    while (value != NULL) {
+        next = strchr(value, ',');
+        if (next != NULL) {
+            *next = '\0';
+            next++;
+        }
+        for (index = 0; index < SPDM_VALIDATOR_TEST_GROUP_COUNT; index++) {
+            if (strcmp(value, m_spdm_test_group_names[index]) == 0) {
+                break;
+            }
+        }
+        if (index == SPDM_VALIDATOR_TEST_GROUP_COUNT) {
+            printf("invalid --test_groups %s\n", value);
+            return false;
+        }
+        m_validator_group_selected[index] = true;
+        value = next;
+    }
+    return true;
+}
+
+/**
+ * Remove the test groups that are not selected from the suite.
+ **/
+static void validator_apply_test_groups(void)
+{
+    uint32_t index;
+    uint32_t count;
+
+    count = 0;
+    for (index = 0; index < SPDM_VALIDATOR_TEST_GROUP_COUNT; index++) {
+        if (m_validator_group_selected[index]) {
+            m_spdm_test_group_configs[count++] = m_spdm_test_group_configs[index];
+        }
+    }
+    /* the end of the groups*/
+    m_spdm_test_group_configs[count] = m_spdm_test_group_configs[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+}
+
+/* Keep a spdm_requester_emu option for the validator and the responder of each job.*/
+static void validator_add_shard_arg(char *program_name, char *option, char *value)
+{
+    uint32_t index;
+
+    for (index = 0; index < LIBSPDM_ARRAY_SIZE(m_validator_shard_unsupported_option); index++) {
+        if (strcmp(option, m_validator_shard_unsupported_option[index]) == 0) {
+            printf("%s is not supported with --shards\n", option);
+            print_validator_usage(program_name);
+            exit(0);
+        }
+    }
+    /* The responders must use the same transport.*/
+    if ((strcmp(option, "--trans") == 0) || (strcmp(option, "--tcp_sub") == 0) ||
+        (strcmp(option, "--sec_ver") == 0)) {
+        if (m_validator_forward_arg_count + 2 > SPDM_VALIDATOR_MAX_FORWARD_ARG_COUNT) {
+            printf("too many %s with --shards\n", option);
+            exit(0);
+        }
+        m_validator_forward_arg[m_validator_forward_arg_count++] = option;
+        m_validator_forward_arg[m_validator_forward_arg_count++] = value;
+    }
+    /* Each job has the port of its shard.*/
+    if (strcmp(option, "--port") == 0) {
+        return;
+    }
+    if (m_validator_job_arg_count + 2 > SPDM_VALIDATOR_MAX_JOB_ARG_COUNT) {
+        printf("too many options with --shards\n");
+        exit(0);
+    }
+    m_validator_job_arg[m_validator_job_arg_count++] = option;
+    m_validator_job_arg[m_validator_job_arg_count++] = value;
+}
+
+/**
+ * Take the validator options out of argv. The other options are left for process_args.
+ **/
+void process_validator_args(char *program_name, int *argc, char *argv[])
+{
+    int index;
+    int common_argc;
+    uint32_t algo;
+    uint32_t data32;
+    bool sharded;
+    char *value;
+    char *next;
+
+    /* The algorithm lists are only taken by --shards, the validator itself does not use them.*/
+    sharded = false;
+    for (index = 1; index < *argc; index++) {
+        if (strcmp(argv[index], "--shards") == 0) {
+            sharded = true;
+        }
+    }
+
+    for (index = 0; index < SPDM_VALIDATOR_TEST_GROUP_COUNT; index++) {
+        m_validator_group_selected[index] = true;
+    }
+
+    common_argc = 1;
+    for (index = 1; index < *argc; index++) {
+        if ((strcmp(argv[index], "-h") == 0) || (strcmp(argv[index], "--help") == 0)) {
+            print_validator_usage(program_name);
+            exit(0);
+        }
+
+        algo = SPDM_VALIDATOR_ALGO_COUNT;
+        if (sharded) {
+            for (algo = 0; algo < SPDM_VALIDATOR_ALGO_COUNT; algo++) {
+                if (strcmp(argv[index], m_validator_algo_option[algo]) == 0) {
+                    break;
+                }
+            }
+        }
+        if ((algo < SPDM_VALIDATOR_ALGO_COUNT) ||
+            (strcmp(argv[index], "--test_groups") == 0) ||
+            (strcmp(argv[index], "--connect_timeout") == 0) ||
+            (strcmp(argv[index], "--timing") == 0) ||
+            (strcmp(argv[index], "--timing_rtt") == 0) ||
+            (strcmp(argv[index], "--shards") == 0) ||
+            (strcmp(argv[index], "--responder") == 0) ||
+            (strcmp(argv[index], "--report") == 0)) {
+            if (index + 1 >= *argc) {
+                printf("invalid %s\n", argv[index]);
+                print_validator_usage(program_name);
+                exit(0);
+            }
+        } else {
+            /* Every spdm_requester_emu option takes a value.*/
+            argv[common_argc++] = argv[index];
+            if (sharded && (index + 1 < *argc)) {
+                validator_add_shard_arg(program_name, argv[index], argv[index + 1]);
+                index++;
+                argv[common_argc++] = argv[index];
+            }
+            continue;
+        }
+
+        if (algo < SPDM_VALIDATOR_ALGO_COUNT) {
+            m_validator_algo_value_count[algo] = 0;
+            value = argv[index + 1];
+            while (value != NULL) {
+                next = strchr(value, ',');
+                if (next != NULL) {
+                    *next = '\0';
+                    next++;
+                }
+                if ((*value == '\0') ||
+                    (m_validator_algo_value_count[algo] == SPDM_VALIDATOR_MAX_ALGO_VALUE_COUNT)) {
+                    printf("invalid %s %s\n", argv[index], argv[index + 1]);
+                    print_validator_usage(program_name);
+                    exit(0);
+                }
+                m_validator_algo_value[algo][m_validator_algo_value_count[algo]++] = value;
+                value = next;
+            }
+            printf("%s - %u values\n", argv[index] + 2, m_validator_algo_value_count[algo]);
+        } else if (strcmp(argv[index], "--test_groups") == 0) {
+            printf("test_groups - %s\n", argv[index + 1]);
+            if (!validator_select_test_groups(argv[index + 1])) {
+                print_validator_usage(program_name);
+                exit(0);
+            }
+        } else if (strcmp(argv[index], "--connect_timeout") == 0) {
+            m_connect_retry_ms = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            printf("connect_timeout - %u\n", m_connect_retry_ms);
+        } else if (strcmp(argv[index], "--timing") == 0) {
+            m_validator_timing_file_name = argv[index + 1];
+            printf("timing - %s\n", m_validator_timing_file_name);
+        } else if (strcmp(argv[index], "--timing_rtt") == 0) {
+            m_validator_timing_rtt_us = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            printf("timing_rtt - %u\n", m_validator_timing_rtt_us);
+        } else if (strcmp(argv[index], "--shards") == 0) {
+            data32 = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            if ((data32 == 0) || (data32 > SPDM_VALIDATOR_MAX_SHARD_COUNT)) {
+                printf("invalid --shards %s\n", argv[index + 1]);
+                print_validator_usage(program_name);
+                exit(0);
+            }
+            m_validator_shard_count = data32;
+            printf("shards - %u\n", m_validator_shard_count);
+        } else if (strcmp(argv[index], "--responder") == 0) {
+            if (strcmp(argv[index + 1], "NONE") == 0) {
+                m_validator_spawn_responder = false;
+            } else {
+                m_validator_responder_path = argv[index + 1];
+            }
+            printf("responder - %s\n", argv[index + 1]);
+        } else {
+            m_validator_report_file_name = argv[index + 1];
+            printf("report - %s\n", m_validator_report_file_name);
+        }
+        index++;
+    }
+    *argc = common_argc;
+}
+
 int main(int argc, char *argv[])
 {
+    uint32_t algo;
+    bool result;
+    bool over_budget;
+
     printf("%s version 0.1\n", "spdm_device_validator_sample");
     srand((unsigned int)time(NULL));
 
+    process_validator_args("spdm_device_validator_sample", &argc, argv);
     process_args("spdm_device_validator_sample", argc, argv);
 
-    platform_client_routine(DEFAULT_SPDM_PLATFORM_PORT);
+    if (m_validator_shard_count != 0) {
+        /* A shard listens on --port + <shard>.*/
+        if ((uint32_t)spdm_emu_get_platform_port() + m_validator_shard_count - 1 > 0xFFFF) {
+            printf("--port %u is too high for %u shards\n", spdm_emu_get_platform_port(),
+                   m_validator_shard_count);
+            return 1;
+        }
+        if (!m_validator_spawn_responder) {
+            for (algo = 0; algo < SPDM_VALIDATOR_ALGO_COUNT; algo++) {
+                if (m_validator_algo_value_count[algo] != 0) {
+                    printf("%s is not supported with --responder NONE\n",
+                           m_validator_algo_option[algo]);
+                    return 1;
+                }
+            }
+        }
+        result = spdm_validator_shard_routine(argv[0]);
+        printf("Validator stopped\n");
+        close_pcap_packet_file();
+        return result ? 0 : 1;
+    }
+
+    /* --timing runs the selected test groups itself.*/
+    if (m_validator_timing_file_name == NULL) {
+        validator_apply_test_groups();
+    }
+    result = platform_client_routine(spdm_emu_get_platform_port());
     printf("Client stopped\n");
 
     close_pcap_packet_file();
+    if (!result) {
+        return 1;
+    }
+    /* 2 is only for a round trip over its budget, a failure to report it is 1.*/
+    if (m_validator_timing_file_name != NULL) {
+        if (!spdm_validator_timing_write_report(&over_budget)) {
+            return 1;
+        }
+        if (over_budget) {
+            return 2;
+        }
+    }
     return 0;
 }
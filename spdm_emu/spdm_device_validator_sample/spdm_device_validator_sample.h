@@ -23,4 +23,58 @@
 
 extern common_test_suite_config_t m_spdm_responder_validator_config;
 
+#define SPDM_VALIDATOR_TEST_GROUP_COUNT 12
+
+extern common_test_group_config_t m_spdm_test_group_configs[];
+extern const char *m_spdm_test_group_names[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+extern common_test_case_config_t *m_spdm_test_case_configs[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+extern const uint32_t m_spdm_test_case_counts[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+
+#define SPDM_VALIDATOR_MAX_TEST_CASE_COUNT 16
+
+/* The --ver, --asym and --dhe lists of --shards.*/
+#define SPDM_VALIDATOR_ALGO_VER 0
+#define SPDM_VALIDATOR_ALGO_ASYM 1
+#define SPDM_VALIDATOR_ALGO_DHE 2
+#define SPDM_VALIDATOR_ALGO_COUNT 3
+
+#define SPDM_VALIDATOR_MAX_ALGO_VALUE_COUNT 16
+#define SPDM_VALIDATOR_MAX_FORWARD_ARG_COUNT 8
+#define SPDM_VALIDATOR_MAX_JOB_ARG_COUNT 64
+#define SPDM_VALIDATOR_MAX_SHARD_COUNT 64
+
+extern const char *m_validator_algo_option[SPDM_VALIDATOR_ALGO_COUNT];
+extern char *m_validator_algo_value[SPDM_VALIDATOR_ALGO_COUNT][SPDM_VALIDATOR_MAX_ALGO_VALUE_COUNT];
+extern uint32_t m_validator_algo_value_count[SPDM_VALIDATOR_ALGO_COUNT];
+
+extern uint32_t m_validator_shard_count;
+extern char *m_validator_responder_path;
+extern bool m_validator_spawn_responder;
+extern char *m_validator_report_file_name;
+extern bool m_validator_group_selected[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+
+/* Options given to the validator that the responders must agree on.*/
+extern char *m_validator_forward_arg[SPDM_VALIDATOR_MAX_FORWARD_ARG_COUNT];
+extern uint32_t m_validator_forward_arg_count;
+/* The spdm_requester_emu options given to the validator, but --port, for the validator of
+ * each job.*/
+extern char *m_validator_job_arg[SPDM_VALIDATOR_MAX_JOB_ARG_COUNT];
+extern uint32_t m_validator_job_arg_count;
+
+bool spdm_validator_shard_routine(const char *program_path);
+
+extern char *m_validator_timing_file_name;
+extern uint32_t m_validator_timing_rtt_us;
+
+void spdm_validator_register_transport_layer_func(
+    void *spdm_context, uint32_t max_spdm_msg_size, uint32_t transport_header_size,
+    uint32_t transport_tail_size, libspdm_transport_encode_message_func transport_encode_message,
+    libspdm_transport_decode_message_func transport_decode_message);
+
+void spdm_validator_timing_run_test_cases(void *spdm_context);
+
+bool spdm_validator_timing_write_report(bool *over_budget);
+
+bool spdm_validator_timing_is_csv(const char *file_name);
+
 #endif
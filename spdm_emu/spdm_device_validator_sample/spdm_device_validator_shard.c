@@ -0,0 +1,701 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "spdm_device_validator_sample.h"
+
+#ifndef _MSC_VER
+#include "fcntl.h"
+#include "signal.h"
+#include "sys/wait.h"
+#endif
+
+/* With --shards, each test group of each algorithm combination is a job. The shards are
+ * threads that take the jobs in order. A shard owns the port --port + <shard>: for a job it
+ * starts a responder with the algorithms of the combination on that port, then runs the
+ * job in a new validator process, so that each job has its own SPDM context and the
+ * conformance test library is not shared between threads. The output of the job goes to
+ * <report>.<job>, and is merged into the report once all the jobs are done. With --timing,
+ * the timing of the job goes to <report>.<job>.timing.<csv|json> and is merged the same way.*/
+
+#define VALIDATOR_MAX_FILE_NAME_SIZE 512
+#define VALIDATOR_MAX_LINE_SIZE 512
+#define VALIDATOR_MAX_ARG_COUNT (SPDM_VALIDATOR_MAX_JOB_ARG_COUNT + \
+                                 SPDM_VALIDATOR_ALGO_COUNT * 2 + 12)
+
+/* How long a job waits for its responder to listen, in milliseconds.*/
+#define VALIDATOR_RESPONDER_START_TIMEOUT_MS "5000"
+
+#ifdef _MSC_VER
+typedef PROCESS_INFORMATION validator_process_t;
+#else
+typedef pid_t validator_process_t;
+#endif
+
+typedef struct {
+    uint32_t algo_index[SPDM_VALIDATOR_ALGO_COUNT];
+    uint32_t group_index;
+    uint32_t shard;
+    /* The validator ran until the end of the test groups.*/
+    bool completed;
+    /* A round trip took longer than the SPDM timing, with --timing.*/
+    bool over_budget;
+    uint32_t pass_count;
+    uint32_t fail_count;
+    uint64_t elapsed;
+} validator_job_t;
+
+validator_job_t *m_validator_job;
+uint32_t m_validator_job_count;
+/* The next job a shard takes.*/
+uint32_t m_validator_next_job;
+spdm_emu_mutex_t m_validator_job_lock;
+
+const char *m_validator_program_path;
+uint16_t m_validator_base_port;
+
+/**
+ * Start a process with the given arguments, its standard output written to output_file_name.
+ * The output is discarded if output_file_name is NULL.
+ **/
+static bool validator_start_process(char *process_argv[], const char *output_file_name,
+                                    validator_process_t *process)
+{
+#ifdef _MSC_VER
+    STARTUPINFOA startup_info;
+    SECURITY_ATTRIBUTES security_attributes;
+    HANDLE output;
+    char command_line[1024];
+    size_t length;
+    uint32_t index;
+    BOOL result;
+
+    /* quote the path, the options have no space*/
+    length = (size_t)snprintf(command_line, sizeof(command_line), "\"%s\"", process_argv[0]);
+    for (index = 1; process_argv[index] != NULL; index++) {
+        if (length >= sizeof(command_line)) {
+            break;
+        }
+        length += (size_t)snprintf(command_line + length, sizeof(command_line) - length, " %s",
+                                   process_argv[index]);
+    }
+    if (length >= sizeof(command_line)) {
+        printf("command line too long\n");
+        return false;
+    }
+
+    security_attributes.nLength = sizeof(security_attributes);
+    security_attributes.lpSecurityDescriptor = NULL;
+    security_attributes.bInheritHandle = TRUE;
+    output = CreateFileA(output_file_name == NULL ? "NUL" : output_file_name, GENERIC_WRITE,
+                         FILE_SHARE_READ, &security_attributes, CREATE_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL, NULL);
+    if (output == INVALID_HANDLE_VALUE) {
+        printf("!!!Unable to write file %s\n", output_file_name);
+        return false;
+    }
+
+    libspdm_zero_mem(&startup_info, sizeof(startup_info));
+    startup_info.cb = sizeof(startup_info);
+    startup_info.dwFlags = STARTF_USESTDHANDLES;
+    startup_info.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+    startup_info.hStdOutput = output;
+    startup_info.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    result = CreateProcessA(NULL, command_line, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL,
+                            &startup_info, process);
+    CloseHandle(output);
+    if (!result) {
+        printf("Start %s Failed - %x\n", process_argv[0], GetLastError());
+        return false;
+    }
+    return true;
+#else
+    int output_fd;
+
+    output_fd = open(output_file_name == NULL ? "/dev/null" : output_file_name,
+                     O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (output_fd < 0) {
+        printf("!!!Unable to write file %s\n", output_file_name);
+        return false;
+    }
+    *process = fork();
+    if (*process < 0) {
+        printf("fork Failed - %x\n", errno);
+        close(output_fd);
+        return false;
+    }
+    if (*process == 0) {
+        /* Only async-signal-safe calls until exec, the other shards may hold locks.*/
+        dup2(output_fd, STDOUT_FILENO);
+        close(output_fd);
+        execvp(process_argv[0], process_argv);
+        _exit(127);
+    }
+    close(output_fd);
+    return true;
+#endif
+}
+
+/**
+ * Wait for a process to exit, after terminating it if it is still running.
+ *
+ * @return the exit code of the process, -1 if it did not exit normally.
+ **/
+static int validator_wait_process(validator_process_t *process, bool terminate)
+{
+#ifdef _MSC_VER
+    DWORD exit_code;
+
+    if (terminate) {
+        TerminateProcess(process->hProcess, 1);
+    }
+    WaitForSingleObject(process->hProcess, INFINITE);
+    if (!GetExitCodeProcess(process->hProcess, &exit_code)) {
+        exit_code = (DWORD)-1;
+    }
+    CloseHandle(process->hProcess);
+    CloseHandle(process->hThread);
+    return (int)exit_code;
+#else
+    int status;
+
+    if (terminate) {
+        kill(*process, SIGTERM);
+    }
+    while (waitpid(*process, &status, 0) < 0) {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+static void validator_get_combination_name(const validator_job_t *job, char *buffer,
+                                           size_t buffer_size)
+{
+    uint32_t algo;
+    size_t length;
+
+    length = 0;
+    buffer[0] = '\0';
+    for (algo = 0; algo < SPDM_VALIDATOR_ALGO_COUNT; algo++) {
+        if ((m_validator_algo_value_count[algo] == 0) || (length >= buffer_size)) {
+            continue;
+        }
+        length += (size_t)snprintf(buffer + length, buffer_size - length, "%s%s",
+                                   length == 0 ? "" : " / ",
+                                   m_validator_algo_value[algo][job->algo_index[algo]]);
+    }
+    if (length == 0) {
+        snprintf(buffer, buffer_size, "default algorithms");
+    }
+}
+
+static bool validator_get_log_file_name(uint32_t job_index, char *buffer, size_t buffer_size)
+{
+    int length;
+
+    length = snprintf(buffer, buffer_size, "%s.%u", m_validator_report_file_name, job_index);
+    return (length > 0) && ((size_t)length < buffer_size);
+}
+
+static bool validator_get_timing_file_name(uint32_t job_index, char *buffer,
+                                           size_t buffer_size)
+{
+    int length;
+
+    length = snprintf(buffer, buffer_size, "%s.%u.timing.%s", m_validator_report_file_name,
+                      job_index,
+                      spdm_validator_timing_is_csv(m_validator_timing_file_name) ? "csv" : "json");
+    return (length > 0) && ((size_t)length < buffer_size);
+}
+
+/**
+ * Count the test assertions that passed and failed in the output of a job.
+ **/
+static void validator_count_assertions(validator_job_t *job, const char *log, size_t log_size)
+{
+    char line[VALIDATOR_MAX_LINE_SIZE];
+    const char *assertion;
+    const char *pass;
+    const char *fail;
+    size_t offset;
+    size_t line_size;
+
+    for (offset = 0; offset < log_size; offset += line_size + 1) {
+        for (line_size = 0; (offset + line_size < log_size) && (log[offset + line_size] != '\n');
+             line_size++) {
+        }
+        /* the result is at the beginning of the line, a longer message is cut*/
+        libspdm_copy_mem(line, sizeof(line), log + offset,
+                         LIBSPDM_MIN(line_size, sizeof(line) - 1));
+        line[LIBSPDM_MIN(line_size, sizeof(line) - 1)] = '\0';
+        assertion = strstr(line, "test assertion");
+        if (assertion == NULL) {
+            continue;
+        }
+        pass = strstr(assertion, "PASS");
+        fail = strstr(assertion, "FAIL");
+        if ((fail != NULL) && ((pass == NULL) || (fail < pass))) {
+            job->fail_count++;
+        } else if (pass != NULL) {
+            job->pass_count++;
+        }
+    }
+}
+
+/**
+ * Start the responder of a job on the port of the shard, run the job in a new validator
+ * and count its assertions.
+ **/
+static void validator_run_job(uint32_t job_index, const char *port_string)
+{
+    validator_job_t *job;
+    char *responder_argv[VALIDATOR_MAX_ARG_COUNT];
+    char *validator_argv[VALIDATOR_MAX_ARG_COUNT];
+    uint32_t argc;
+    uint32_t algo;
+    uint32_t index;
+    validator_process_t responder;
+    validator_process_t validator;
+    char log_file_name[VALIDATOR_MAX_FILE_NAME_SIZE];
+    char timing_file_name[VALIDATOR_MAX_FILE_NAME_SIZE];
+    char rtt_string[12];
+    spdm_emu_file_view_t *view;
+    const void *log;
+    size_t log_size;
+    uint64_t start;
+    int exit_code;
+
+    job = &m_validator_job[job_index];
+    if (!validator_get_log_file_name(job_index, log_file_name, sizeof(log_file_name)) ||
+        ((m_validator_timing_file_name != NULL) &&
+         !validator_get_timing_file_name(job_index, timing_file_name,
+                                         sizeof(timing_file_name)))) {
+        printf("report file name too long\n");
+        return;
+    }
+
+    if (m_validator_spawn_responder) {
+        argc = 0;
+        responder_argv[argc++] = m_validator_responder_path;
+        for (index = 0; index < m_validator_forward_arg_count; index++) {
+            responder_argv[argc++] = m_validator_forward_arg[index];
+        }
+        for (algo = 0; algo < SPDM_VALIDATOR_ALGO_COUNT; algo++) {
+            if (m_validator_algo_value_count[algo] != 0) {
+                responder_argv[argc++] = (char *)m_validator_algo_option[algo];
+                responder_argv[argc++] = m_validator_algo_value[algo][job->algo_index[algo]];
+            }
+        }
+        responder_argv[argc++] = "--port";
+        responder_argv[argc++] = (char *)port_string;
+        responder_argv[argc++] = "--log_level";
+        responder_argv[argc++] = "ERROR";
+        responder_argv[argc] = NULL;
+        if (!validator_start_process(responder_argv, NULL, &responder)) {
+            return;
+        }
+    }
+
+    argc = 0;
+    validator_argv[argc++] = (char *)m_validator_program_path;
+    for (index = 0; index < m_validator_job_arg_count; index++) {
+        validator_argv[argc++] = m_validator_job_arg[index];
+    }
+    validator_argv[argc++] = "--port";
+    validator_argv[argc++] = (char *)port_string;
+    validator_argv[argc++] = "--test_groups";
+    validator_argv[argc++] = (char *)m_spdm_test_group_names[job->group_index];
+    if (m_validator_spawn_responder) {
+        validator_argv[argc++] = "--connect_timeout";
+        validator_argv[argc++] = VALIDATOR_RESPONDER_START_TIMEOUT_MS;
+    } else {
+        /* keep the responder for the next job of the shard*/
+        validator_argv[argc++] = "--exe_mode";
+        validator_argv[argc++] = "CONTINUE";
+    }
+    if (m_validator_timing_file_name != NULL) {
+        snprintf(rtt_string, sizeof(rtt_string), "%u", m_validator_timing_rtt_us);
+        validator_argv[argc++] = "--timing";
+        validator_argv[argc++] = timing_file_name;
+        validator_argv[argc++] = "--timing_rtt";
+        validator_argv[argc++] = rtt_string;
+    }
+    validator_argv[argc] = NULL;
+
+    start = spdm_emu_get_monotonic_ns();
+    exit_code = -1;
+    if (validator_start_process(validator_argv, log_file_name, &validator)) {
+        exit_code = validator_wait_process(&validator, false);
+    }
+    job->elapsed = spdm_emu_get_monotonic_ns() - start;
+    /* 2 is a round trip over its timing budget*/
+    job->completed = (exit_code == 0) || (exit_code == 2);
+    job->over_budget = (exit_code == 2);
+
+    /* The responder exits on the SHUTDOWN sent at the end of the job.*/
+    if (m_validator_spawn_responder) {
+        validator_wait_process(&responder, !job->completed);
+    }
+
+    view = spdm_emu_map_input_file(log_file_name, &log, &log_size);
+    if (view != NULL) {
+        validator_count_assertions(job, log, log_size);
+        spdm_emu_release_file_view(view);
+    }
+}
+
+static void validator_shard_routine(void *context)
+{
+    uint32_t shard;
+    uint32_t job_index;
+    char port_string[8];
+
+    shard = (uint32_t)(size_t)context;
+    snprintf(port_string, sizeof(port_string), "%u", (uint32_t)m_validator_base_port + shard);
+    while (true) {
+        spdm_emu_mutex_lock(&m_validator_job_lock);
+        if (m_validator_next_job == m_validator_job_count) {
+            spdm_emu_mutex_unlock(&m_validator_job_lock);
+            break;
+        }
+        job_index = m_validator_next_job;
+        m_validator_next_job++;
+        spdm_emu_mutex_unlock(&m_validator_job_lock);
+
+        m_validator_job[job_index].shard = shard;
+        validator_run_job(job_index, port_string);
+    }
+}
+
+/**
+ * Append the output of each job to the report, in the order of the jobs, and remove it.
+ **/
+static bool validator_write_report(void)
+{
+    FILE *report;
+    validator_job_t *job;
+    char log_file_name[VALIDATOR_MAX_FILE_NAME_SIZE];
+    char combination_name[128];
+    spdm_emu_file_view_t *view;
+    const void *log;
+    size_t log_size;
+    uint32_t index;
+
+    report = fopen(m_validator_report_file_name, "w");
+    if (report == NULL) {
+        printf("!!!Unable to write file %s\n", m_validator_report_file_name);
+        return false;
+    }
+    for (index = 0; index < m_validator_job_count; index++) {
+        job = &m_validator_job[index];
+        validator_get_combination_name(job, combination_name, sizeof(combination_name));
+        fprintf(report, "=== %s / %s - shard %u, %s, %u passed, %u failed%s ===\n",
+                combination_name, m_spdm_test_group_names[job->group_index], job->shard,
+                job->completed ? "completed" : "not completed", job->pass_count,
+                job->fail_count, job->over_budget ? ", over the timing budget" : "");
+        if (!validator_get_log_file_name(index, log_file_name, sizeof(log_file_name))) {
+            continue;
+        }
+        view = spdm_emu_map_input_file(log_file_name, &log, &log_size);
+        if (view != NULL) {
+            fwrite(log, 1, log_size, report);
+            spdm_emu_release_file_view(view);
+        }
+        fprintf(report, "\n");
+        remove(log_file_name);
+    }
+    fclose(report);
+    return true;
+}
+
+/**
+ * Merge the timing files of the jobs into the --timing file. A CSV row gets the combination
+ * as first column, a JSON timing is put in an object with its combination and test group.
+ **/
+static bool validator_write_timing_report(void)
+{
+    FILE *report;
+    validator_job_t *job;
+    char timing_file_name[VALIDATOR_MAX_FILE_NAME_SIZE];
+    char combination_name[128];
+    spdm_emu_file_view_t *view;
+    const char *timing;
+    const void *data;
+    size_t size;
+    size_t offset;
+    bool is_csv;
+    bool is_first;
+    uint32_t index;
+
+    report = fopen(m_validator_timing_file_name, "w");
+    if (report == NULL) {
+        printf("!!!Unable to write file %s\n", m_validator_timing_file_name);
+        return false;
+    }
+    is_csv = spdm_validator_timing_is_csv(m_validator_timing_file_name);
+    if (!is_csv) {
+        fprintf(report, "{\"jobs\": [");
+    }
+    is_first = true;
+    for (index = 0; index < m_validator_job_count; index++) {
+        job = &m_validator_job[index];
+        if (!validator_get_timing_file_name(index, timing_file_name, sizeof(timing_file_name))) {
+            continue;
+        }
+        view = spdm_emu_map_input_file(timing_file_name, &data, &size);
+        if (view == NULL) {
+            continue;
+        }
+        validator_get_combination_name(job, combination_name, sizeof(combination_name));
+        timing = data;
+        if (is_csv) {
+            /* the header of the first job only*/
+            for (offset = 0; (offset < size) && (timing[offset] != '\n'); offset++) {
+            }
+            if (is_first) {
+                fprintf(report, "combination,%.*s\n", (int)offset, timing);
+            }
+            offset++;
+            while (offset < size) {
+                fprintf(report, "%s,", combination_name);
+                while ((offset < size) && (timing[offset] != '\n')) {
+                    fputc(timing[offset++], report);
+                }
+                fputc('\n', report);
+                offset++;
+            }
+        } else {
+            fprintf(report, "%s\n{\"combination\": \"%s\", \"group\": \"%s\", \"timing\":\n",
+                    is_first ? "" : ",", combination_name,
+                    m_spdm_test_group_names[job->group_index]);
+            fwrite(data, 1, size, report);
+            fprintf(report, "}");
+        }
+        is_first = false;
+        spdm_emu_release_file_view(view);
+        remove(timing_file_name);
+    }
+    if (!is_csv) {
+        fprintf(report, "\n]}\n");
+    }
+    fclose(report);
+    return true;
+}
+
+static bool validator_print_report(uint32_t shard_count, uint64_t elapsed)
+{
+    validator_job_t *job;
+    char combination_name[128];
+    char value[2][16];
+    uint64_t sum;
+    uint32_t pass_count;
+    uint32_t fail_count;
+    uint32_t job_pass_count;
+    uint32_t index;
+
+    printf("\n%-40s %-18s %5s %-6s %6s %6s %10s\n", "combination", "test group", "shard",
+           "result", "pass", "fail", "time");
+    sum = 0;
+    pass_count = 0;
+    fail_count = 0;
+    job_pass_count = 0;
+    for (index = 0; index < m_validator_job_count; index++) {
+        job = &m_validator_job[index];
+        validator_get_combination_name(job, combination_name, sizeof(combination_name));
+        printf("%-40s %-18s %5u %-6s %6u %6u %10s\n", combination_name,
+               m_spdm_test_group_names[job->group_index], job->shard,
+               !job->completed ? "error" : (job->fail_count != 0) ? "fail" :
+               job->over_budget ? "slow" : "pass",
+               job->pass_count, job->fail_count,
+               spdm_emu_format_duration(value[0], sizeof(value[0]), job->elapsed));
+        sum += job->elapsed;
+        pass_count += job->pass_count;
+        fail_count += job->fail_count;
+        if (job->completed && (job->fail_count == 0) && !job->over_budget) {
+            job_pass_count++;
+        }
+    }
+
+    printf("\n%u jobs: %u passed, %u failed on %u shards in %s", m_validator_job_count,
+           job_pass_count, m_validator_job_count - job_pass_count, shard_count,
+           spdm_emu_format_duration(value[0], sizeof(value[0]), elapsed));
+    printf(", %s one after another\n", spdm_emu_format_duration(value[1], sizeof(value[1]), sum));
+    printf("test assertions: %u passed, %u failed\n", pass_count, fail_count);
+    return job_pass_count == m_validator_job_count;
+}
+
+/**
+ * Return spdm_responder_emu in the directory of this program.
+ **/
+static char *validator_get_default_responder_path(const char *program_path)
+{
+    const char *separator;
+    char *path;
+    size_t directory_length;
+    size_t path_size;
+
+    separator = strrchr(program_path, '/');
+#ifdef _MSC_VER
+    if ((strrchr(program_path, '\\') != NULL) &&
+        ((separator == NULL) || (strrchr(program_path, '\\') > separator))) {
+        separator = strrchr(program_path, '\\');
+    }
+#endif
+    directory_length = (separator == NULL) ? 0 : (size_t)(separator - program_path) + 1;
+
+    path_size = directory_length + sizeof("./spdm_responder_emu");
+    path = (void *)malloc(path_size);
+    if (path == NULL) {
+        return NULL;
+    }
+    if (directory_length == 0) {
+        snprintf(path, path_size, "./spdm_responder_emu");
+    } else {
+        snprintf(path, path_size, "%.*s%s", (int)directory_length, program_path,
+                 "spdm_responder_emu");
+    }
+    return path;
+}
+
+/**
+ * Run the selected test groups of every algorithm combination on --shards responders,
+ * then merge the output of the jobs into the report.
+ *
+ * @param  program_path                  The path of this program, started for each job.
+ *
+ * @retval true  All the jobs completed without a failed assertion.
+ * @retval false A job failed, or could not run.
+ **/
+bool spdm_validator_shard_routine(const char *program_path)
+{
+    spdm_emu_thread_t thread[SPDM_VALIDATOR_MAX_SHARD_COUNT];
+    uint32_t algo_index[SPDM_VALIDATOR_ALGO_COUNT];
+    uint32_t combination_count;
+    uint32_t combination;
+    uint32_t group_count;
+    uint32_t shard_count;
+    uint32_t thread_count;
+    uint32_t algo;
+    uint32_t index;
+    char *default_responder_path;
+    validator_job_t *job;
+    uint64_t start;
+    uint64_t elapsed;
+    bool result;
+
+    default_responder_path = NULL;
+    if (m_validator_spawn_responder && (m_validator_responder_path == NULL)) {
+        default_responder_path = validator_get_default_responder_path(program_path);
+        if (default_responder_path == NULL) {
+            return false;
+        }
+        m_validator_responder_path = default_responder_path;
+    }
+    m_validator_program_path = program_path;
+    m_validator_base_port = spdm_emu_get_platform_port();
+
+    combination_count = 1;
+    for (algo = 0; algo < SPDM_VALIDATOR_ALGO_COUNT; algo++) {
+        if (m_validator_algo_value_count[algo] != 0) {
+            combination_count *= m_validator_algo_value_count[algo];
+        }
+    }
+    group_count = 0;
+    for (index = 0; index < SPDM_VALIDATOR_TEST_GROUP_COUNT; index++) {
+        if (m_validator_group_selected[index]) {
+            group_count++;
+        }
+    }
+    shard_count = m_validator_shard_count;
+
+    m_validator_job_count = combination_count * group_count;
+    m_validator_job = (void *)malloc(sizeof(validator_job_t) * m_validator_job_count);
+    if (m_validator_job == NULL) {
+        free(default_responder_path);
+        return false;
+    }
+    libspdm_zero_mem(m_validator_job, sizeof(validator_job_t) * m_validator_job_count);
+    libspdm_zero_mem(algo_index, sizeof(algo_index));
+    job = m_validator_job;
+    for (combination = 0; combination < combination_count; combination++) {
+        for (index = 0; index < SPDM_VALIDATOR_TEST_GROUP_COUNT; index++) {
+            if (!m_validator_group_selected[index]) {
+                continue;
+            }
+            libspdm_copy_mem(job->algo_index, sizeof(job->algo_index),
+                             algo_index, sizeof(algo_index));
+            job->group_index = index;
+            job++;
+        }
+
+        /* next combination, the last option changes fastest*/
+        algo = SPDM_VALIDATOR_ALGO_COUNT;
+        while (algo-- > 0) {
+            if (m_validator_algo_value_count[algo] == 0) {
+                continue;
+            }
+            algo_index[algo]++;
+            if (algo_index[algo] < m_validator_algo_value_count[algo]) {
+                break;
+            }
+            algo_index[algo] = 0;
+        }
+    }
+
+    if (shard_count > m_validator_job_count) {
+        shard_count = m_validator_job_count;
+    }
+    printf("Validator - %u combinations, %u test groups, %u shards from port %u\n",
+           combination_count, group_count, shard_count, m_validator_base_port);
+
+    spdm_emu_mutex_init(&m_validator_job_lock);
+    m_validator_next_job = 0;
+    start = spdm_emu_get_monotonic_ns();
+    thread_count = 0;
+    for (index = 0; index < shard_count; index++) {
+        if (!spdm_emu_thread_create(&thread[thread_count], validator_shard_routine,
+                                    (void *)(size_t)index)) {
+            printf("Create shard thread fail\n");
+            break;
+        }
+        thread_count++;
+    }
+    if (thread_count == 0) {
+        /* The jobs run one after another on the first port instead.*/
+        validator_shard_routine((void *)(size_t)0);
+    }
+    for (index = 0; index < thread_count; index++) {
+        spdm_emu_thread_join(thread[index]);
+    }
+    elapsed = spdm_emu_get_monotonic_ns() - start;
+    spdm_emu_mutex_destroy(&m_validator_job_lock);
+
+    result = validator_print_report(thread_count == 0 ? 1 : thread_count, elapsed);
+    if (validator_write_report()) {
+        printf("report - %s\n", m_validator_report_file_name);
+    } else {
+        result = false;
+    }
+    if (m_validator_timing_file_name != NULL) {
+        if (validator_write_timing_report()) {
+            printf("timing - %s\n", m_validator_timing_file_name);
+        } else {
+            result = false;
+        }
+    }
+
+    free(m_validator_job);
+    m_validator_job = NULL;
+    m_validator_job_count = 0;
+    free(default_responder_path);
+    return result;
+}
@@ -137,7 +137,7 @@ void *spdm_client_init(void)
                                     spdm_device_receive_message);
 
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
-        libspdm_register_transport_layer_func(
+        spdm_validator_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             LIBSPDM_TRANSPORT_HEADER_SIZE,
@@ -145,7 +145,7 @@ void *spdm_client_init(void)
             libspdm_transport_mctp_encode_message,
             libspdm_transport_mctp_decode_message);
     } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
-        libspdm_register_transport_layer_func(
+        spdm_validator_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             LIBSPDM_TRANSPORT_HEADER_SIZE,
@@ -153,7 +153,7 @@ void *spdm_client_init(void)
             libspdm_transport_pci_doe_encode_message,
             libspdm_transport_pci_doe_decode_message);
     } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_NONE) {
-        libspdm_register_transport_layer_func(
+        spdm_validator_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             0,
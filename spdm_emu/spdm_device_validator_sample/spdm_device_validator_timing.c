@@ -0,0 +1,624 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_device_validator_sample.h"
+
+/* With --timing, the test cases run one by one, and every request to the responder is timed
+ * from its encoding to the decoding of its response, per test case and request code.
+ * A round trip is checked against the timing of SPDM 1.2: RTT + CT for the requests with a
+ * cryptographic processing, RTT + ST1 for the others. CT comes from the CT exponent of the
+ * CAPABILITIES response. After a ResponseNotReady, the time until the deferred response is
+ * checked against the RDT x RDTM of the error.*/
+
+#define VALIDATOR_TIMING_CLASS_SIGNED_MEASUREMENTS 256
+#define VALIDATOR_TIMING_CLASS_COUNT 257
+#define VALIDATOR_TIMING_CLASS_NONE VALIDATOR_TIMING_CLASS_COUNT
+
+#define VALIDATOR_TIMING_ST1_US 100000
+/* A larger CT exponent is taken as this one, which keeps CT in nanoseconds in a uint64_t.*/
+#define VALIDATOR_TIMING_MAX_CT_EXPONENT 40
+
+typedef struct {
+    spdm_emu_stats_t latency;
+    /* The budget of the last round trip, 0 before the CT exponent is known.*/
+    uint64_t budget_ns;
+    uint64_t over_budget_count;
+    /* The round trips that needed CT before the CT exponent was known.*/
+    uint64_t unchecked_count;
+    uint64_t not_ready_count;
+    /* The largest RDT x RDTM of a ResponseNotReady.*/
+    uint64_t not_ready_wait_us;
+    uint64_t deferred_max_ns;
+    uint64_t deferred_over_budget_count;
+} validator_timing_request_t;
+
+typedef struct {
+    uint32_t group_index;
+    uint32_t case_id;
+    validator_timing_request_t *request[VALIDATOR_TIMING_CLASS_COUNT];
+} validator_timing_case_t;
+
+char *m_validator_timing_file_name;
+uint32_t m_validator_timing_rtt_us;
+
+libspdm_transport_encode_message_func m_validator_transport_encode_message;
+libspdm_transport_decode_message_func m_validator_transport_decode_message;
+
+validator_timing_case_t *m_validator_timing_case;
+uint32_t m_validator_timing_case_count;
+/* The case the round trips are recorded in, NULL between the cases.*/
+validator_timing_case_t *m_validator_timing_current;
+
+bool m_validator_timing_has_ct;
+uint8_t m_validator_timing_ct_exponent;
+
+/* The request in flight.*/
+uint32_t m_validator_timing_pending_class = VALIDATOR_TIMING_CLASS_NONE;
+uint64_t m_validator_timing_pending_start;
+
+/* The request deferred by a ResponseNotReady, until RESPOND_IF_READY gets its response.*/
+uint32_t m_validator_timing_deferred_class = VALIDATOR_TIMING_CLASS_NONE;
+uint64_t m_validator_timing_deferred_start;
+uint64_t m_validator_timing_deferred_budget_ns;
+
+static bool validator_timing_is_ct_class(uint32_t timing_class)
+{
+    switch (timing_class) {
+    case SPDM_CHALLENGE:
+    case SPDM_KEY_EXCHANGE:
+    case SPDM_FINISH:
+    case SPDM_PSK_EXCHANGE:
+    case SPDM_PSK_FINISH:
+    case VALIDATOR_TIMING_CLASS_SIGNED_MEASUREMENTS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static const char *validator_timing_get_class_name(uint32_t timing_class, char *buffer,
+                                                   size_t buffer_size)
+{
+    const char *name;
+
+    if (timing_class == VALIDATOR_TIMING_CLASS_SIGNED_MEASUREMENTS) {
+        return "GET_MEASUREMENTS_SIGNED";
+    }
+    name = spdm_emu_get_request_name((uint8_t)timing_class);
+    if (name == NULL) {
+        snprintf(buffer, buffer_size, "0x%02x", timing_class);
+        name = buffer;
+    }
+    return name;
+}
+
+static validator_timing_request_t *validator_timing_get_request(
+    validator_timing_case_t *test_case, uint32_t timing_class)
+{
+    validator_timing_request_t *request;
+
+    if (test_case->request[timing_class] == NULL) {
+        request = (void *)malloc(sizeof(validator_timing_request_t));
+        if (request == NULL) {
+            return NULL;
+        }
+        libspdm_zero_mem(request, sizeof(validator_timing_request_t));
+        spdm_emu_stats_init(&request->latency);
+        test_case->request[timing_class] = request;
+    }
+    return test_case->request[timing_class];
+}
+
+static void validator_timing_record_round_trip(uint32_t timing_class, uint64_t latency)
+{
+    validator_timing_request_t *request;
+
+    request = validator_timing_get_request(m_validator_timing_current, timing_class);
+    if (request == NULL) {
+        return;
+    }
+    spdm_emu_stats_record(&request->latency, latency);
+    if (validator_timing_is_ct_class(timing_class) && !m_validator_timing_has_ct) {
+        request->budget_ns = 0;
+        request->unchecked_count++;
+        return;
+    }
+    request->budget_ns = (uint64_t)m_validator_timing_rtt_us * 1000;
+    if (validator_timing_is_ct_class(timing_class)) {
+        request->budget_ns += ((uint64_t)1 << m_validator_timing_ct_exponent) * 1000;
+    } else {
+        request->budget_ns += (uint64_t)VALIDATOR_TIMING_ST1_US * 1000;
+    }
+    if (latency > request->budget_ns) {
+        request->over_budget_count++;
+    }
+}
+
+static void validator_timing_record_not_ready(uint32_t timing_class,
+                                              const spdm_error_data_response_not_ready_t *data,
+                                              uint64_t now)
+{
+    validator_timing_request_t *request;
+    uint64_t wait_us;
+
+    /* a RESPOND_IF_READY that is not ready yet keeps the original request*/
+    if ((timing_class != SPDM_RESPOND_IF_READY) ||
+        (m_validator_timing_deferred_class == VALIDATOR_TIMING_CLASS_NONE)) {
+        m_validator_timing_deferred_class = timing_class;
+        m_validator_timing_deferred_start = now;
+    }
+    wait_us = (data->rd_exponent < 32) ? ((uint64_t)1 << data->rd_exponent) * data->rd_tm :
+              UINT32_MAX;
+    m_validator_timing_deferred_budget_ns = (wait_us + m_validator_timing_rtt_us) * 1000;
+
+    request = validator_timing_get_request(m_validator_timing_current,
+                                           m_validator_timing_deferred_class);
+    if (request == NULL) {
+        return;
+    }
+    request->not_ready_count++;
+    if (wait_us > request->not_ready_wait_us) {
+        request->not_ready_wait_us = wait_us;
+    }
+}
+
+static void validator_timing_record_deferred(uint64_t now)
+{
+    validator_timing_request_t *request;
+    uint64_t deferred;
+
+    request = validator_timing_get_request(m_validator_timing_current,
+                                           m_validator_timing_deferred_class);
+    m_validator_timing_deferred_class = VALIDATOR_TIMING_CLASS_NONE;
+    if (request == NULL) {
+        return;
+    }
+    deferred = now - m_validator_timing_deferred_start;
+    if (deferred > request->deferred_max_ns) {
+        request->deferred_max_ns = deferred;
+    }
+    if (deferred > m_validator_timing_deferred_budget_ns) {
+        request->deferred_over_budget_count++;
+    }
+}
+
+/**
+ * Start the timing of a request, then encode it with the transport of the validator.
+ **/
+static libspdm_return_t validator_transport_encode_message(
+    void *spdm_context, const uint32_t *session_id, bool is_app_message,
+    bool is_request_message, size_t message_size, void *message,
+    size_t *transport_message_size, void **transport_message)
+{
+    const spdm_message_header_t *header;
+
+    m_validator_timing_pending_class = VALIDATOR_TIMING_CLASS_NONE;
+    if (is_request_message && !is_app_message &&
+        (message_size >= sizeof(spdm_message_header_t))) {
+        header = message;
+        m_validator_timing_pending_class = header->request_response_code;
+        if ((header->request_response_code == SPDM_GET_MEASUREMENTS) &&
+            ((header->param1 &
+              SPDM_GET_MEASUREMENTS_REQUEST_ATTRIBUTES_GENERATE_SIGNATURE) != 0)) {
+            m_validator_timing_pending_class = VALIDATOR_TIMING_CLASS_SIGNED_MEASUREMENTS;
+        }
+    }
+    /* The encryption of a secured message is part of the round trip.*/
+    m_validator_timing_pending_start = spdm_emu_get_monotonic_ns();
+
+    return m_validator_transport_encode_message(spdm_context, session_id, is_app_message,
+                                                is_request_message, message_size, message,
+                                                transport_message_size, transport_message);
+}
+
+/**
+ * Decode a response with the transport of the validator, then complete the timing of the
+ * request.
+ **/
+static libspdm_return_t validator_transport_decode_message(
+    void *spdm_context, uint32_t **session_id, bool *is_app_message,
+    bool is_request_message, size_t transport_message_size, void *transport_message,
+    size_t *message_size, void **message)
+{
+    libspdm_return_t status;
+    const spdm_message_header_t *header;
+    const spdm_capabilities_response_t *capabilities;
+    uint32_t timing_class;
+    uint64_t now;
+
+    status = m_validator_transport_decode_message(spdm_context, session_id, is_app_message,
+                                                  is_request_message, transport_message_size,
+                                                  transport_message, message_size, message);
+    if (LIBSPDM_STATUS_IS_ERROR(status) ||
+        (m_validator_timing_pending_class == VALIDATOR_TIMING_CLASS_NONE)) {
+        return status;
+    }
+    now = spdm_emu_get_monotonic_ns();
+    timing_class = m_validator_timing_pending_class;
+    m_validator_timing_pending_class = VALIDATOR_TIMING_CLASS_NONE;
+    if ((m_validator_timing_current == NULL) ||
+        ((is_app_message != NULL) && *is_app_message) ||
+        (*message_size < sizeof(spdm_message_header_t))) {
+        return status;
+    }
+
+    validator_timing_record_round_trip(timing_class, now - m_validator_timing_pending_start);
+
+    header = *message;
+    if ((header->request_response_code == SPDM_CAPABILITIES) &&
+        (*message_size >= sizeof(spdm_capabilities_response_t) -
+         sizeof(uint32_t) * 2)) {
+        capabilities = *message;
+        m_validator_timing_ct_exponent = LIBSPDM_MIN(capabilities->ct_exponent,
+                                                     VALIDATOR_TIMING_MAX_CT_EXPONENT);
+        m_validator_timing_has_ct = true;
+    }
+    if ((header->request_response_code == SPDM_ERROR) &&
+        (header->param1 == SPDM_ERROR_CODE_RESPONSE_NOT_READY) &&
+        (*message_size >= sizeof(spdm_message_header_t) +
+         sizeof(spdm_error_data_response_not_ready_t))) {
+        validator_timing_record_not_ready(
+            timing_class, (const void *)((const uint8_t *)*message +
+                                         sizeof(spdm_message_header_t)), now);
+    } else if ((timing_class == SPDM_RESPOND_IF_READY) &&
+               (m_validator_timing_deferred_class != VALIDATOR_TIMING_CLASS_NONE)) {
+        validator_timing_record_deferred(now);
+    }
+    return status;
+}
+
+/**
+ * Register the transport layer of the validator, through the timing functions above with
+ * --timing.
+ **/
+void spdm_validator_register_transport_layer_func(
+    void *spdm_context, uint32_t max_spdm_msg_size, uint32_t transport_header_size,
+    uint32_t transport_tail_size, libspdm_transport_encode_message_func transport_encode_message,
+    libspdm_transport_decode_message_func transport_decode_message)
+{
+    if (m_validator_timing_file_name == NULL) {
+        libspdm_register_transport_layer_func(spdm_context, max_spdm_msg_size,
+                                              transport_header_size, transport_tail_size,
+                                              transport_encode_message,
+                                              transport_decode_message);
+        return;
+    }
+    m_validator_transport_encode_message = transport_encode_message;
+    m_validator_transport_decode_message = transport_decode_message;
+    libspdm_register_transport_layer_func(spdm_context, max_spdm_msg_size,
+                                          transport_header_size, transport_tail_size,
+                                          validator_transport_encode_message,
+                                          validator_transport_decode_message);
+}
+
+/**
+ * Run the selected test cases one by one, each in a suite of its own, so that the round
+ * trips are recorded per test case.
+ **/
+void spdm_validator_timing_run_test_cases(void *spdm_context)
+{
+    common_test_group_config_t saved_groups[SPDM_VALIDATOR_TEST_GROUP_COUNT + 1];
+    common_test_case_config_t saved_cases[SPDM_VALIDATOR_MAX_TEST_CASE_COUNT + 1];
+    common_test_case_config_t *case_configs;
+    uint32_t case_count;
+    uint32_t group_index;
+    uint32_t case_index;
+
+    m_validator_timing_case_count = 0;
+    for (group_index = 0; group_index < SPDM_VALIDATOR_TEST_GROUP_COUNT; group_index++) {
+        m_validator_timing_case_count += m_spdm_test_case_counts[group_index];
+    }
+    m_validator_timing_case =
+        (void *)malloc(sizeof(validator_timing_case_t) * m_validator_timing_case_count);
+    if (m_validator_timing_case == NULL) {
+        m_validator_timing_case_count = 0;
+        return;
+    }
+    libspdm_zero_mem(m_validator_timing_case,
+                     sizeof(validator_timing_case_t) * m_validator_timing_case_count);
+    m_validator_timing_case_count = 0;
+
+    libspdm_copy_mem(saved_groups, sizeof(saved_groups),
+                     m_spdm_test_group_configs, sizeof(saved_groups));
+    for (group_index = 0; group_index < SPDM_VALIDATOR_TEST_GROUP_COUNT; group_index++) {
+        case_count = m_spdm_test_case_counts[group_index];
+        if (!m_validator_group_selected[group_index] ||
+            (saved_groups[group_index].action == COMMON_TEST_ACTION_SKIP) ||
+            (case_count > SPDM_VALIDATOR_MAX_TEST_CASE_COUNT)) {
+            continue;
+        }
+        m_spdm_test_group_configs[0] = saved_groups[group_index];
+        m_spdm_test_group_configs[1] = saved_groups[SPDM_VALIDATOR_TEST_GROUP_COUNT];
+
+        case_configs = m_spdm_test_case_configs[group_index];
+        libspdm_copy_mem(saved_cases, sizeof(saved_cases), case_configs,
+                         sizeof(common_test_case_config_t) * (case_count + 1));
+        for (case_index = 0; case_index < case_count; case_index++) {
+            if (saved_cases[case_index].action == COMMON_TEST_ACTION_SKIP) {
+                continue;
+            }
+            case_configs[0] = saved_cases[case_index];
+            case_configs[1] = saved_cases[case_count];
+
+            m_validator_timing_current = &m_validator_timing_case[m_validator_timing_case_count];
+            m_validator_timing_current->group_index = group_index;
+            m_validator_timing_current->case_id = saved_cases[case_index].case_id;
+            m_validator_timing_case_count++;
+            m_validator_timing_deferred_class = VALIDATOR_TIMING_CLASS_NONE;
+            spdm_responder_conformance_test(spdm_context, &m_spdm_responder_validator_config);
+            m_validator_timing_current = NULL;
+        }
+        libspdm_copy_mem(case_configs, sizeof(common_test_case_config_t) * (case_count + 1),
+                         saved_cases, sizeof(common_test_case_config_t) * (case_count + 1));
+    }
+    libspdm_copy_mem(m_spdm_test_group_configs, sizeof(saved_groups),
+                     saved_groups, sizeof(saved_groups));
+}
+
+/**
+ * A file name ending with .csv selects CSV, otherwise JSON is used.
+ **/
+bool spdm_validator_timing_is_csv(const char *file_name)
+{
+    size_t name_size;
+
+    name_size = strlen(file_name);
+    return (name_size >= sizeof(".csv") - 1) &&
+           (strcmp(file_name + name_size - (sizeof(".csv") - 1), ".csv") == 0);
+}
+
+static void validator_timing_merge_request(validator_timing_request_t *total,
+                                           const validator_timing_request_t *request)
+{
+    spdm_emu_stats_merge(&total->latency, &request->latency);
+    if (request->budget_ns != 0) {
+        total->budget_ns = request->budget_ns;
+    }
+    total->over_budget_count += request->over_budget_count;
+    total->unchecked_count += request->unchecked_count;
+    total->not_ready_count += request->not_ready_count;
+    total->not_ready_wait_us = LIBSPDM_MAX(total->not_ready_wait_us,
+                                           request->not_ready_wait_us);
+    total->deferred_max_ns = LIBSPDM_MAX(total->deferred_max_ns, request->deferred_max_ns);
+    total->deferred_over_budget_count += request->deferred_over_budget_count;
+}
+
+static void validator_timing_write_csv_row(FILE *file, const char *group_name, uint32_t case_id,
+                                           const char *request_name,
+                                           const validator_timing_request_t *request)
+{
+    const spdm_emu_stats_t *latency;
+
+    latency = &request->latency;
+    fprintf(file, "%s,%u,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,"
+            "%llu,%llu,%llu,%llu,%llu,%llu,%llu\n",
+            group_name, case_id, request_name,
+            (unsigned long long)latency->count,
+            (unsigned long long)(latency->count == 0 ? 0 : latency->min),
+            (unsigned long long)spdm_emu_stats_get_percentile(latency, 500),
+            (unsigned long long)spdm_emu_stats_get_percentile(latency, 990),
+            (unsigned long long)spdm_emu_stats_get_percentile(latency, 999),
+            (unsigned long long)latency->max,
+            (unsigned long long)(latency->count == 0 ? 0 : latency->sum / latency->count),
+            (unsigned long long)request->budget_ns,
+            (unsigned long long)request->over_budget_count,
+            (unsigned long long)request->unchecked_count,
+            (unsigned long long)request->not_ready_count,
+            (unsigned long long)request->not_ready_wait_us,
+            (unsigned long long)request->deferred_max_ns,
+            (unsigned long long)request->deferred_over_budget_count);
+}
+
+static void validator_timing_write_json_requests(FILE *file,
+                                                 validator_timing_request_t *const *request,
+                                                 const char *indent)
+{
+    uint32_t timing_class;
+    char code_name[8];
+    bool is_first;
+
+    fprintf(file, "{");
+    is_first = true;
+    for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+        if (request[timing_class] == NULL) {
+            continue;
+        }
+        fprintf(file,
+                "%s\n%s\"%s\": {\"budget_ns\": %llu, \"over_budget\": %llu, "
+                "\"unchecked\": %llu, \"not_ready\": %llu, \"not_ready_wait_us\": %llu, "
+                "\"deferred_max_ns\": %llu, \"deferred_over_budget\": %llu,\n%s    \"latency\": ",
+                is_first ? "" : ",", indent,
+                validator_timing_get_class_name(timing_class, code_name, sizeof(code_name)),
+                (unsigned long long)request[timing_class]->budget_ns,
+                (unsigned long long)request[timing_class]->over_budget_count,
+                (unsigned long long)request[timing_class]->unchecked_count,
+                (unsigned long long)request[timing_class]->not_ready_count,
+                (unsigned long long)request[timing_class]->not_ready_wait_us,
+                (unsigned long long)request[timing_class]->deferred_max_ns,
+                (unsigned long long)request[timing_class]->deferred_over_budget_count,
+                indent);
+        spdm_emu_stats_write_json(file, &request[timing_class]->latency);
+        fprintf(file, "}");
+        is_first = false;
+    }
+    fprintf(file, "}");
+}
+
+static bool validator_timing_write_file(validator_timing_request_t *const *total, bool is_csv)
+{
+    FILE *file;
+    validator_timing_case_t *test_case;
+    uint32_t case_index;
+    uint32_t timing_class;
+    char code_name[8];
+
+    file = fopen(m_validator_timing_file_name, "w");
+    if (file == NULL) {
+        printf("!!!Unable to write file %s\n", m_validator_timing_file_name);
+        return false;
+    }
+
+    if (is_csv) {
+        fprintf(file, "group,case_id,request,count,min_ns,p50_ns,p99_ns,p999_ns,max_ns,mean_ns,"
+                "budget_ns,over_budget,unchecked,not_ready,not_ready_wait_us,deferred_max_ns,"
+                "deferred_over_budget\n");
+        /* case 0 of group ALL is the whole suite*/
+        for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+            if (total[timing_class] != NULL) {
+                validator_timing_write_csv_row(
+                    file, "ALL", 0,
+                    validator_timing_get_class_name(timing_class, code_name, sizeof(code_name)),
+                    total[timing_class]);
+            }
+        }
+        for (case_index = 0; case_index < m_validator_timing_case_count; case_index++) {
+            test_case = &m_validator_timing_case[case_index];
+            for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+                if (test_case->request[timing_class] != NULL) {
+                    validator_timing_write_csv_row(
+                        file, m_spdm_test_group_names[test_case->group_index], test_case->case_id,
+                        validator_timing_get_class_name(timing_class, code_name,
+                                                        sizeof(code_name)),
+                        test_case->request[timing_class]);
+                }
+            }
+        }
+    } else {
+        if (m_validator_timing_has_ct) {
+            fprintf(file, "{\"ct_exponent\": %u, ", m_validator_timing_ct_exponent);
+        } else {
+            fprintf(file, "{\"ct_exponent\": null, ");
+        }
+        fprintf(file, "\"st1_us\": %u, \"rtt_us\": %u,\n \"requests\": ",
+                VALIDATOR_TIMING_ST1_US, m_validator_timing_rtt_us);
+        validator_timing_write_json_requests(file, total, "    ");
+        fprintf(file, ",\n \"test_cases\": [");
+        for (case_index = 0; case_index < m_validator_timing_case_count; case_index++) {
+            test_case = &m_validator_timing_case[case_index];
+            fprintf(file, "%s\n    {\"group\": \"%s\", \"case_id\": %u, \"requests\": ",
+                    case_index == 0 ? "" : ",", m_spdm_test_group_names[test_case->group_index],
+                    test_case->case_id);
+            validator_timing_write_json_requests(file, test_case->request, "        ");
+            fprintf(file, "}");
+        }
+        fprintf(file, "\n]}\n");
+    }
+    fclose(file);
+    return true;
+}
+
+static void validator_timing_print_report(validator_timing_request_t *const *total)
+{
+    uint32_t timing_class;
+    char code_name[8];
+    char value[3][16];
+
+    printf("\ntiming of %u test cases", m_validator_timing_case_count);
+    if (m_validator_timing_has_ct) {
+        printf(", CT exponent %u (%s)\n", m_validator_timing_ct_exponent,
+               spdm_emu_format_duration(value[0], sizeof(value[0]),
+                                        ((uint64_t)1 << m_validator_timing_ct_exponent) * 1000));
+    } else {
+        printf(", no CAPABILITIES response, CT is not checked\n");
+    }
+    spdm_emu_stats_print_header("request");
+    for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+        if (total[timing_class] != NULL) {
+            spdm_emu_stats_print_row(
+                validator_timing_get_class_name(timing_class, code_name, sizeof(code_name)),
+                &total[timing_class]->latency);
+        }
+    }
+
+    printf("\n    %-30s %10s %11s %9s %9s %10s %9s\n", "request", "budget", "over_budget",
+           "unchecked", "not_ready", "RDTxRDTM", "deferred");
+    for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+        if (total[timing_class] == NULL) {
+            continue;
+        }
+        printf("    %-30s %10s %11llu %9llu %9llu %10s %9s\n",
+               validator_timing_get_class_name(timing_class, code_name, sizeof(code_name)),
+               total[timing_class]->budget_ns == 0 ? "-" :
+               spdm_emu_format_duration(value[0], sizeof(value[0]),
+                                        total[timing_class]->budget_ns),
+               (unsigned long long)total[timing_class]->over_budget_count,
+               (unsigned long long)total[timing_class]->unchecked_count,
+               (unsigned long long)total[timing_class]->not_ready_count,
+               total[timing_class]->not_ready_count == 0 ? "-" :
+               spdm_emu_format_duration(value[1], sizeof(value[1]),
+                                        total[timing_class]->not_ready_wait_us * 1000),
+               total[timing_class]->not_ready_count == 0 ? "-" :
+               spdm_emu_format_duration(value[2], sizeof(value[2]),
+                                        total[timing_class]->deferred_max_ns));
+    }
+}
+
+/**
+ * Print the timing of the requests, write the --timing file and free the timing.
+ *
+ * @param  over_budget                   Set if a round trip was over its budget.
+ *
+ * @retval true  The timing was written.
+ * @retval false The file could not be written, or there is no memory.
+ **/
+bool spdm_validator_timing_write_report(bool *over_budget)
+{
+    validator_timing_request_t *total[VALIDATOR_TIMING_CLASS_COUNT];
+    validator_timing_case_t *test_case;
+    uint32_t case_index;
+    uint32_t timing_class;
+    bool result;
+
+    libspdm_zero_mem(total, sizeof(total));
+    *over_budget = false;
+    result = true;
+    for (case_index = 0; case_index < m_validator_timing_case_count; case_index++) {
+        test_case = &m_validator_timing_case[case_index];
+        for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+            if (test_case->request[timing_class] == NULL) {
+                continue;
+            }
+            if (total[timing_class] == NULL) {
+                total[timing_class] = (void *)malloc(sizeof(validator_timing_request_t));
+                if (total[timing_class] == NULL) {
+                    result = false;
+                    goto done;
+                }
+                libspdm_zero_mem(total[timing_class], sizeof(validator_timing_request_t));
+                spdm_emu_stats_init(&total[timing_class]->latency);
+            }
+            validator_timing_merge_request(total[timing_class], test_case->request[timing_class]);
+        }
+    }
+
+    for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+        if ((total[timing_class] != NULL) &&
+            ((total[timing_class]->over_budget_count != 0) ||
+             (total[timing_class]->deferred_over_budget_count != 0))) {
+            *over_budget = true;
+        }
+    }
+    validator_timing_print_report(total);
+
+    if (!validator_timing_write_file(total,
+                                     spdm_validator_timing_is_csv(m_validator_timing_file_name))) {
+        result = false;
+    }
+
+done:
+    for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+        free(total[timing_class]);
+    }
+    for (case_index = 0; case_index < m_validator_timing_case_count; case_index++) {
+        for (timing_class = 0; timing_class < VALIDATOR_TIMING_CLASS_COUNT; timing_class++) {
+            free(m_validator_timing_case[case_index].request[timing_class]);
+        }
+    }
+    free(m_validator_timing_case);
+    m_validator_timing_case = NULL;
+    m_validator_timing_case_count = 0;
+    return result;
+}
@@ -0,0 +1,226 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_emu.h"
+
+/* The certificate chains and public keys read from files, keyed by kind and algorithm.
+ * libspdm keeps a pointer to the data given with libspdm_set_data, so an entry lives until
+ * spdm_emu_cert_cache_free and is shared read-only by all the SPDM contexts.
+ * A failed read is cached too, so that a missing file is not looked up on every connection.*/
+typedef struct spdm_emu_cert_cache_entry {
+    struct spdm_emu_cert_cache_entry *next;
+    uint8_t kind;
+    uint8_t slot_id;
+    uint32_t hash_algo;
+    uint32_t asym_algo;
+    bool result;
+    void *data;
+    size_t data_size;
+    /* For SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT, the root certificate inside data.*/
+    const uint8_t *cert;
+    size_t cert_size;
+} spdm_emu_cert_cache_entry_t;
+
+spdm_emu_cert_cache_entry_t *m_cert_cache;
+bool m_cert_cache_lock_initialized;
+spdm_emu_mutex_t m_cert_cache_lock;
+
+static bool cert_cache_read(spdm_emu_cert_cache_entry_t *entry)
+{
+    void *hash;
+    size_t hash_size;
+
+    switch (entry->kind) {
+    case SPDM_EMU_CERT_CACHE_RESPONDER_CERT_CHAIN:
+        if (entry->slot_id == 0) {
+            return libspdm_read_responder_public_certificate_chain(
+                entry->hash_algo, entry->asym_algo,
+                &entry->data, &entry->data_size, NULL, NULL);
+        }
+        return libspdm_read_responder_public_certificate_chain_per_slot(
+            entry->slot_id, entry->hash_algo, entry->asym_algo,
+            &entry->data, &entry->data_size, NULL, NULL);
+    case SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT:
+        if (!libspdm_read_requester_root_public_certificate(
+                entry->hash_algo, (uint16_t)entry->asym_algo,
+                &entry->data, &entry->data_size, &hash, &hash_size)) {
+            return false;
+        }
+        /* The file holds an spdm_cert_chain_t, the root hash, then the root certificate.*/
+        return libspdm_x509_get_cert_from_cert_chain(
+            (uint8_t *)entry->data + sizeof(spdm_cert_chain_t) + hash_size,
+            entry->data_size - sizeof(spdm_cert_chain_t) - hash_size, 0,
+            &entry->cert, &entry->cert_size);
+    case SPDM_EMU_CERT_CACHE_RESPONDER_PUBLIC_KEY:
+        return libspdm_read_responder_public_key(entry->asym_algo,
+                                                 &entry->data, &entry->data_size);
+    case SPDM_EMU_CERT_CACHE_REQUESTER_PUBLIC_KEY:
+        return libspdm_read_requester_public_key((uint16_t)entry->asym_algo,
+                                                 &entry->data, &entry->data_size);
+    default:
+        return false;
+    }
+}
+
+/**
+ * Find an entry, reading its file the first time it is requested.
+ *
+ * @param  kind                          SPDM_EMU_CERT_CACHE_*.
+ * @param  hash_algo                     The base hash algorithm, 0 for a public key.
+ * @param  asym_algo                     The base or requester asym algorithm.
+ * @param  slot_id                       The slot of a responder certificate chain, else 0.
+ *
+ * @return the entry, or NULL if it could not be allocated.
+ **/
+static const spdm_emu_cert_cache_entry_t *cert_cache_get_entry(uint8_t kind,
+                                                               uint32_t hash_algo,
+                                                               uint32_t asym_algo,
+                                                               uint8_t slot_id)
+{
+    spdm_emu_cert_cache_entry_t *entry;
+
+    spdm_emu_mutex_lock(&m_cert_cache_lock);
+    for (entry = m_cert_cache; entry != NULL; entry = entry->next) {
+        if ((entry->kind == kind) && (entry->hash_algo == hash_algo) &&
+            (entry->asym_algo == asym_algo) && (entry->slot_id == slot_id)) {
+            spdm_emu_mutex_unlock(&m_cert_cache_lock);
+            return entry;
+        }
+    }
+
+    entry = (void *)malloc(sizeof(spdm_emu_cert_cache_entry_t));
+    if (entry != NULL) {
+        libspdm_zero_mem(entry, sizeof(spdm_emu_cert_cache_entry_t));
+        entry->kind = kind;
+        entry->hash_algo = hash_algo;
+        entry->asym_algo = asym_algo;
+        entry->slot_id = slot_id;
+        entry->result = cert_cache_read(entry);
+        if (!entry->result && (entry->data != NULL)) {
+            free(entry->data);
+            entry->data = NULL;
+            entry->data_size = 0;
+        }
+        entry->next = m_cert_cache;
+        m_cert_cache = entry;
+    }
+    spdm_emu_mutex_unlock(&m_cert_cache_lock);
+    return entry;
+}
+
+/**
+ * Get a certificate chain or a public key from the cache.
+ *
+ * The data is owned by the cache. It must not be modified or freed.
+ *
+ * @param  kind                          SPDM_EMU_CERT_CACHE_*.
+ * @param  hash_algo                     The base hash algorithm, ignored for a public key.
+ * @param  asym_algo                     The base asym algorithm for the responder data,
+ *                                       the requester asym algorithm for the requester data.
+ * @param  slot_id                       The slot of a responder certificate chain, else ignored.
+ * @param  data                          The certificate chain, the root certificate for
+ *                                       SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT, or the key.
+ * @param  data_size                     The size of data.
+ *
+ * @retval true  The data is returned.
+ * @retval false The file is missing or invalid.
+ **/
+bool spdm_emu_cert_cache_get(uint8_t kind, uint32_t hash_algo, uint32_t asym_algo,
+                             uint8_t slot_id, const void **data, size_t *data_size)
+{
+    const spdm_emu_cert_cache_entry_t *entry;
+
+    if ((kind == SPDM_EMU_CERT_CACHE_RESPONDER_PUBLIC_KEY) ||
+        (kind == SPDM_EMU_CERT_CACHE_REQUESTER_PUBLIC_KEY)) {
+        hash_algo = 0;
+    }
+    if (kind != SPDM_EMU_CERT_CACHE_RESPONDER_CERT_CHAIN) {
+        slot_id = 0;
+    }
+
+    entry = cert_cache_get_entry(kind, hash_algo, asym_algo, slot_id);
+    if ((entry == NULL) || !entry->result) {
+        return false;
+    }
+    if (kind == SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT) {
+        *data = entry->cert;
+        *data_size = entry->cert_size;
+    } else {
+        *data = entry->data;
+        *data_size = entry->data_size;
+    }
+    return true;
+}
+
+/**
+ * Initialize the cache. With --cert_cache WARM, read the files for all the supported
+ * algorithms now instead of on the first connection that negotiates them.
+ **/
+void spdm_emu_cert_cache_init(void)
+{
+    uint32_t hash_algo;
+    uint32_t asym_algo;
+    uint32_t req_asym_algo;
+    uint8_t slot_id;
+
+    if (!m_cert_cache_lock_initialized) {
+        spdm_emu_mutex_init(&m_cert_cache_lock);
+        m_cert_cache_lock_initialized = true;
+    }
+    if (!m_cert_cache_warm) {
+        return;
+    }
+
+    for (asym_algo = 1; asym_algo != 0; asym_algo <<= 1) {
+        if ((m_support_asym_algo & asym_algo) == 0) {
+            continue;
+        }
+        cert_cache_get_entry(SPDM_EMU_CERT_CACHE_RESPONDER_PUBLIC_KEY, 0, asym_algo, 0);
+        for (hash_algo = 1; hash_algo != 0; hash_algo <<= 1) {
+            if ((m_support_hash_algo & hash_algo) == 0) {
+                continue;
+            }
+            /* The connection state callback provisions slot 0 and slot 1.*/
+            for (slot_id = 0; slot_id < 2; slot_id++) {
+                cert_cache_get_entry(SPDM_EMU_CERT_CACHE_RESPONDER_CERT_CHAIN,
+                                     hash_algo, asym_algo, slot_id);
+            }
+        }
+    }
+    for (req_asym_algo = 1; req_asym_algo <= 0xFFFF; req_asym_algo <<= 1) {
+        if ((m_support_req_asym_algo & req_asym_algo) == 0) {
+            continue;
+        }
+        cert_cache_get_entry(SPDM_EMU_CERT_CACHE_REQUESTER_PUBLIC_KEY, 0, req_asym_algo, 0);
+        for (hash_algo = 1; hash_algo != 0; hash_algo <<= 1) {
+            if ((m_support_hash_algo & hash_algo) == 0) {
+                continue;
+            }
+            cert_cache_get_entry(SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT,
+                                 hash_algo, req_asym_algo, 0);
+        }
+    }
+}
+
+/**
+ * Free all the entries. No SPDM context may still use them.
+ **/
+void spdm_emu_cert_cache_free(void)
+{
+    spdm_emu_cert_cache_entry_t *entry;
+
+    if (!m_cert_cache_lock_initialized) {
+        return;
+    }
+    while (m_cert_cache != NULL) {
+        entry = m_cert_cache;
+        m_cert_cache = entry->next;
+        free(entry->data);
+        free(entry);
+    }
+    spdm_emu_mutex_destroy(&m_cert_cache_lock);
+    m_cert_cache_lock_initialized = false;
+}
@@ -6,22 +6,89 @@
 
 #include "spdm_emu.h"
 
-/* hack to add MCTP header for PCAP*/
-#include "industry_standard/mctp.h"
-
 uint32_t m_use_transport_layer = SOCKET_TRANSPORT_TYPE_MCTP;
 
 uint32_t m_use_tcp_handshake = SOCKET_TCP_NO_HANDSHAKE;
 
-bool m_send_receive_buffer_acquired = false;
 uint8_t m_send_receive_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
-size_t m_send_receive_buffer_size;
+
+spdm_emu_connection_t m_default_connection = {
+    INVALID_SOCKET, 0, NULL, NULL, NULL,
+    m_send_receive_buffer, 0, false
+};
+
+/**
+ * Bind the platform connection state to an SPDM context, so that the device IO and buffer
+ * functions registered in this context use the connection socket and buffer.
+ *
+ * @param  spdm_context                  A pointer to the SPDM context.
+ * @param  connection                    The connection owned by this SPDM context.
+ **/
+bool spdm_emu_attach_connection(void *spdm_context, spdm_emu_connection_t *connection)
+{
+    libspdm_data_parameter_t parameter;
+    libspdm_return_t status;
+
+    libspdm_zero_mem(&parameter, sizeof(parameter));
+    parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
+    status = libspdm_set_data(spdm_context, LIBSPDM_DATA_APP_CONTEXT_DATA,
+                              &parameter, &connection, sizeof(connection));
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        return false;
+    }
+    connection->spdm_context = spdm_context;
+    return true;
+}
+
+/**
+ * Return the platform connection state of an SPDM context.
+ * The default connection is returned if none is attached.
+ **/
+spdm_emu_connection_t *spdm_emu_get_connection(void *spdm_context)
+{
+    libspdm_data_parameter_t parameter;
+    spdm_emu_connection_t *connection;
+    size_t data_size;
+
+    connection = NULL;
+    if (spdm_context != NULL) {
+        libspdm_zero_mem(&parameter, sizeof(parameter));
+        parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
+        data_size = sizeof(connection);
+        libspdm_get_data(spdm_context, LIBSPDM_DATA_APP_CONTEXT_DATA,
+                         &parameter, &connection, &data_size);
+    }
+    if (connection == NULL) {
+        return &m_default_connection;
+    }
+    return connection;
+}
+
+/* The platform socket frame header. All fields are big endian.*/
+typedef struct {
+    uint32_t command;
+    uint32_t transport_type;
+    uint32_t payload_size;
+} platform_frame_header_t;
+
+#ifdef _MSC_VER
+typedef WSABUF platform_io_buffer_t;
+#define SET_PLATFORM_IO_BUFFER(io_buffer, data, size) \
+    do { (io_buffer).buf = (char *)(data); (io_buffer).len = (ULONG)(size); } while (0)
+#else
+typedef struct iovec platform_io_buffer_t;
+#define SET_PLATFORM_IO_BUFFER(io_buffer, data, size) \
+    do { (io_buffer).iov_base = (void *)(data); (io_buffer).iov_len = (size_t)(size); } while (0)
+#endif
 
 /**
  * Read number of bytes data in blocking mode.
  *
  * If there is no enough data in socket, this function will wait.
  * This function will return if enough data is read, or socket error.
+ *
+ * MSG_WAITALL lets the kernel complete the whole read in one call. The loop is only
+ * taken again if the call is interrupted.
  **/
 bool read_bytes(const SOCKET socket, uint8_t *buffer,
                 uint32_t number_of_bytes)
@@ -32,8 +99,13 @@ bool read_bytes(const SOCKET socket, uint8_t *buffer,
     number_received = 0;
     while (number_received < number_of_bytes) {
         result = recv(socket, (char *)(buffer + number_received),
-                      number_of_bytes - number_received, 0);
+                      number_of_bytes - number_received, MSG_WAITALL);
         if (result == -1) {
+#ifndef _MSC_VER
+            if (errno == EINTR) {
+                continue;
+            }
+#endif
             printf("Receive error - 0x%x\n",
 #ifdef _MSC_VER
                    WSAGetLastError()
@@ -51,106 +123,59 @@ bool read_bytes(const SOCKET socket, uint8_t *buffer,
     return true;
 }
 
-bool read_data32(const SOCKET socket, uint32_t *data)
+bool receive_platform_data(const SOCKET socket, uint32_t *command,
+                           uint8_t *receive_buffer,
+                           size_t *bytes_to_receive)
 {
-    bool result;
-
-    result = read_bytes(socket, (uint8_t *)data, sizeof(uint32_t));
-    if (!result) {
-        return result;
-    }
-    *data = ntohl(*data);
-    return true;
+    return receive_platform_data_ex(socket, m_use_transport_layer, command, receive_buffer,
+                                    bytes_to_receive);
 }
 
 /**
- * Read multiple bytes in blocking mode.
- *
- * The length is presented as first 4 bytes in big endian.
- * The data follows the length.
- *
- * If there is no enough data in socket, this function will wait.
- * This function will return if enough data is read, or socket error.
+ * Receive a platform frame from a peer of the given transport, instead of --trans.
  **/
-bool read_multiple_bytes(const SOCKET socket, uint8_t *buffer,
-                         uint32_t *bytes_received,
-                         uint32_t max_buffer_length)
-{
-    uint32_t length;
-    bool result;
-
-    result = read_data32(socket, &length);
-    if (!result) {
-        return result;
-    }
-    printf("Platform port Receive size: ");
-    length = ntohl(length);
-    dump_data((uint8_t *)&length, sizeof(uint32_t));
-    printf("\n");
-    length = ntohl(length);
-
-    *bytes_received = length;
-    if (*bytes_received > max_buffer_length) {
-        printf("buffer too small (0x%x). Expected - 0x%x\n",
-               max_buffer_length, *bytes_received);
-        return false;
-    }
-    if (length == 0) {
-        return true;
-    }
-    result = read_bytes(socket, buffer, length);
-    if (!result) {
-        return result;
-    }
-    printf("Platform port Receive buffer:\n    ");
-    dump_data(buffer, length);
-    printf("\n");
-
-    return true;
-}
-
-bool receive_platform_data(const SOCKET socket, uint32_t *command,
-                           uint8_t *receive_buffer,
-                           size_t *bytes_to_receive)
+bool receive_platform_data_ex(const SOCKET socket, uint32_t transport_layer,
+                              uint32_t *command, uint8_t *receive_buffer,
+                              size_t *bytes_to_receive)
 {
     bool result;
-    uint32_t response;
+    platform_frame_header_t header;
     uint32_t transport_type;
     uint32_t bytes_received;
 
-    result = read_data32(socket, &response);
+    /* The fixed header is read in one call, the payload in a second call straight into
+     * the caller buffer.*/
+    result = read_bytes(socket, (uint8_t *)&header, sizeof(header));
     if (!result) {
         return result;
     }
-    *command = response;
-    printf("Platform port Receive command: ");
-    response = ntohl(response);
-    dump_data((uint8_t *)&response, sizeof(uint32_t));
-    printf("\n");
-
-    result = read_data32(socket, &transport_type);
-    if (!result) {
-        return result;
-    }
-    printf("Platform port Receive transport_type: ");
-    transport_type = ntohl(transport_type);
-    dump_data((uint8_t *)&transport_type, sizeof(uint32_t));
-    printf("\n");
-    transport_type = ntohl(transport_type);
-    if (transport_type != m_use_transport_layer) {
+    *command = ntohl(header.command);
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Receive command: ",
+                      &header.command, sizeof(uint32_t));
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Receive transport_type: ",
+                      &header.transport_type, sizeof(uint32_t));
+    transport_type = ntohl(header.transport_type);
+    if (transport_type != transport_layer) {
         printf("transport_type mismatch\n");
         return false;
     }
 
-    bytes_received = 0;
-    result = read_multiple_bytes(socket, receive_buffer, &bytes_received,
-                                 (uint32_t)*bytes_to_receive);
-    if (!result) {
-        return result;
-    }
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Receive size: ",
+                      &header.payload_size, sizeof(uint32_t));
+    bytes_received = ntohl(header.payload_size);
     if (bytes_received > (uint32_t)*bytes_to_receive) {
+        printf("buffer too small (0x%x). Expected - 0x%x\n",
+               (uint32_t)*bytes_to_receive, bytes_received);
         return false;
     }
+    if (bytes_received != 0) {
+        result = read_bytes(socket, receive_buffer, bytes_received);
+        if (!result) {
+            return result;
+        }
+        SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Receive buffer:\n    ",
+                          receive_buffer, bytes_received);
+    }
     *bytes_to_receive = bytes_received;
 
     switch (*command) {
@@ -158,28 +183,33 @@ bool receive_platform_data(const SOCKET socket, uint32_t *command,
         close_pcap_packet_file();
         break;
     case SOCKET_SPDM_COMMAND_NORMAL:
-        if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
-
-            /* Append mctp_header_t for PCAP*/
-
-            mctp_header_t mctp_header;
-            mctp_header.header_version = 0;
-            mctp_header.destination_id = 0;
-            mctp_header.source_id = 0;
-            mctp_header.message_tag = 0xC0;
-            append_pcap_packet_data(&mctp_header,
-                                    sizeof(mctp_header),
-                                    receive_buffer, bytes_received);
-        } else {
-            append_pcap_packet_data(NULL, 0, receive_buffer,
-                                    bytes_received);
-        }
+        append_pcap_packet_data(socket, false, receive_buffer, bytes_received);
         break;
     }
 
     return result;
 }
 
+/**
+ * Print a send error, in the same way for the scalar and the gather write.
+ **/
+static void print_send_error(void)
+{
+#ifdef _MSC_VER
+    if (WSAGetLastError() == 0x2745) {
+        printf("Client disconnected\n");
+        return;
+    }
+#endif
+    printf("Send error - 0x%x\n",
+#ifdef _MSC_VER
+           WSAGetLastError()
+#else
+           errno
+#endif
+           );
+}
+
 /**
  * Write number of bytes data in blocking mode.
  *
@@ -196,21 +226,7 @@ bool write_bytes(const SOCKET socket, const uint8_t *buffer,
         result = send(socket, (char *)(buffer + number_sent),
                       number_of_bytes - number_sent, 0);
         if (result == -1) {
-#ifdef _MSC_VER
-            if (WSAGetLastError() == 0x2745) {
-                printf("Client disconnected\n");
-            } else {
-#endif
-            printf("Send error - 0x%x\n",
-#ifdef _MSC_VER
-                   WSAGetLastError()
-#else
-                   errno
-#endif
-                   );
-#ifdef _MSC_VER
-        }
-#endif
+            print_send_error();
             return false;
         }
         number_sent += result;
@@ -218,96 +234,104 @@ bool write_bytes(const SOCKET socket, const uint8_t *buffer,
     return true;
 }
 
-bool write_data32(const SOCKET socket, uint32_t data)
-{
-    data = htonl(data);
-    return write_bytes(socket, (uint8_t *)&data, sizeof(uint32_t));
-}
-
 /**
- * Write multiple bytes.
+ * Write a header and a payload in blocking mode with one gather write.
  *
- * The length is presented as first 4 bytes in big endian.
- * The data follows the length.
+ * The payload is sent from the caller buffer without being copied behind the header.
+ * A short write resumes from the first unsent byte.
  **/
-bool write_multiple_bytes(const SOCKET socket, const uint8_t *buffer,
-                          uint32_t bytes_to_send)
+static bool write_frame(const SOCKET socket, const uint8_t *header, uint32_t header_size,
+                        const uint8_t *payload, uint32_t payload_size)
 {
-    bool result;
-
-    result = write_data32(socket, bytes_to_send);
-    if (!result) {
-        return result;
-    }
-    printf("Platform port Transmit size: ");
-    bytes_to_send = htonl(bytes_to_send);
-    dump_data((uint8_t *)&bytes_to_send, sizeof(uint32_t));
-    printf("\n");
-    bytes_to_send = htonl(bytes_to_send);
+    platform_io_buffer_t io_buffer[2];
+    uint32_t io_buffer_count;
+    uint32_t total_size;
+    uint32_t number_sent;
+#ifdef _MSC_VER
+    DWORD result;
+#else
+    ssize_t result;
+#endif
 
-    result = write_bytes(socket, buffer, bytes_to_send);
-    if (!result) {
-        return result;
+    total_size = header_size + payload_size;
+    number_sent = 0;
+    while (number_sent < total_size) {
+        io_buffer_count = 0;
+        if (number_sent < header_size) {
+            SET_PLATFORM_IO_BUFFER(io_buffer[io_buffer_count],
+                                   header + number_sent, header_size - number_sent);
+            io_buffer_count++;
+            if (payload_size != 0) {
+                SET_PLATFORM_IO_BUFFER(io_buffer[io_buffer_count], payload, payload_size);
+                io_buffer_count++;
+            }
+        } else {
+            SET_PLATFORM_IO_BUFFER(io_buffer[io_buffer_count],
+                                   payload + (number_sent - header_size),
+                                   total_size - number_sent);
+            io_buffer_count++;
+        }
+#ifdef _MSC_VER
+        if (WSASend(socket, io_buffer, io_buffer_count, &result, 0, NULL, NULL) ==
+            SOCKET_ERROR) {
+            print_send_error();
+            return false;
+        }
+#else
+        result = writev(socket, io_buffer, (int)io_buffer_count);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            print_send_error();
+            return false;
+        }
+#endif
+        number_sent += (uint32_t)result;
     }
-    printf("Platform port Transmit buffer:\n    ");
-    dump_data(buffer, bytes_to_send);
-    printf("\n");
     return true;
 }
 
 bool send_platform_data(const SOCKET socket, uint32_t command,
                         const uint8_t *send_buffer, size_t bytes_to_send)
 {
-    bool result;
-    uint32_t request;
-    uint32_t transport_type;
+    return send_platform_data_ex(socket, m_use_transport_layer, command, send_buffer,
+                                 bytes_to_send);
+}
 
-    request = command;
-    result = write_data32(socket, request);
-    if (!result) {
-        return result;
-    }
-    printf("Platform port Transmit command: ");
-    request = htonl(request);
-    dump_data((uint8_t *)&request, sizeof(uint32_t));
-    printf("\n");
+/**
+ * Send a platform frame to a peer of the given transport, instead of --trans.
+ **/
+bool send_platform_data_ex(const SOCKET socket, uint32_t transport_layer, uint32_t command,
+                           const uint8_t *send_buffer, size_t bytes_to_send)
+{
+    bool result;
+    platform_frame_header_t header;
 
-    result = write_data32(socket, m_use_transport_layer);
-    if (!result) {
-        return result;
-    }
-    printf("Platform port Transmit transport_type: ");
-    transport_type = ntohl(m_use_transport_layer);
-    dump_data((uint8_t *)&transport_type, sizeof(uint32_t));
-    printf("\n");
+    header.command = htonl(command);
+    header.transport_type = htonl(transport_layer);
+    header.payload_size = htonl((uint32_t)bytes_to_send);
 
-    result = write_multiple_bytes(socket, send_buffer,
-                                  (uint32_t)bytes_to_send);
+    result = write_frame(socket, (const uint8_t *)&header, sizeof(header),
+                         send_buffer, (uint32_t)bytes_to_send);
     if (!result) {
         return result;
     }
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Transmit command: ",
+                      &header.command, sizeof(uint32_t));
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Transmit transport_type: ",
+                      &header.transport_type, sizeof(uint32_t));
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Transmit size: ",
+                      &header.payload_size, sizeof(uint32_t));
+    SPDM_EMU_LOG_DATA(SPDM_EMU_LOG_LEVEL_DEBUG, "Platform port Transmit buffer:\n    ",
+                      send_buffer, bytes_to_send);
 
     switch (command) {
     case SOCKET_SPDM_COMMAND_SHUTDOWN:
         close_pcap_packet_file();
         break;
     case SOCKET_SPDM_COMMAND_NORMAL:
-        if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
-
-            /* Append mctp_header_t for PCAP*/
-
-            mctp_header_t mctp_header;
-            mctp_header.header_version = 0;
-            mctp_header.destination_id = 0;
-            mctp_header.source_id = 0;
-            mctp_header.message_tag = 0xC0;
-            append_pcap_packet_data(&mctp_header,
-                                    sizeof(mctp_header),
-                                    send_buffer, bytes_to_send);
-        } else {
-            append_pcap_packet_data(NULL, 0, send_buffer,
-                                    bytes_to_send);
-        }
+        append_pcap_packet_data(socket, true, send_buffer, bytes_to_send);
         break;
     }
 
@@ -317,37 +341,49 @@ bool send_platform_data(const SOCKET socket, uint32_t command,
 libspdm_return_t spdm_device_acquire_sender_buffer (
     void *context, void **msg_buf_ptr)
 {
-    LIBSPDM_ASSERT (!m_send_receive_buffer_acquired);
-    *msg_buf_ptr = m_send_receive_buffer;
-    libspdm_zero_mem (m_send_receive_buffer, sizeof(m_send_receive_buffer));
-    m_send_receive_buffer_acquired = true;
+    spdm_emu_connection_t *connection;
+
+    connection = spdm_emu_get_connection(context);
+    LIBSPDM_ASSERT (!connection->send_receive_buffer_acquired);
+    *msg_buf_ptr = connection->send_receive_buffer;
+    libspdm_zero_mem (connection->send_receive_buffer, LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE);
+    connection->send_receive_buffer_acquired = true;
     return LIBSPDM_STATUS_SUCCESS;
 }
 
 void spdm_device_release_sender_buffer (
     void *context, const void *msg_buf_ptr)
 {
-    LIBSPDM_ASSERT (m_send_receive_buffer_acquired);
-    LIBSPDM_ASSERT (msg_buf_ptr == m_send_receive_buffer);
-    m_send_receive_buffer_acquired = false;
+    spdm_emu_connection_t *connection;
+
+    connection = spdm_emu_get_connection(context);
+    LIBSPDM_ASSERT (connection->send_receive_buffer_acquired);
+    LIBSPDM_ASSERT (msg_buf_ptr == connection->send_receive_buffer);
+    connection->send_receive_buffer_acquired = false;
     return;
 }
 
 libspdm_return_t spdm_device_acquire_receiver_buffer (
     void *context, void **msg_buf_ptr)
 {
-    LIBSPDM_ASSERT (!m_send_receive_buffer_acquired);
-    *msg_buf_ptr = m_send_receive_buffer;
-    libspdm_zero_mem (m_send_receive_buffer, sizeof(m_send_receive_buffer));
-    m_send_receive_buffer_acquired = true;
+    spdm_emu_connection_t *connection;
+
+    connection = spdm_emu_get_connection(context);
+    LIBSPDM_ASSERT (!connection->send_receive_buffer_acquired);
+    *msg_buf_ptr = connection->send_receive_buffer;
+    libspdm_zero_mem (connection->send_receive_buffer, LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE);
+    connection->send_receive_buffer_acquired = true;
     return LIBSPDM_STATUS_SUCCESS;
 }
 
 void spdm_device_release_receiver_buffer (
     void *context, const void *msg_buf_ptr)
 {
-    LIBSPDM_ASSERT (m_send_receive_buffer_acquired);
-    LIBSPDM_ASSERT (msg_buf_ptr == m_send_receive_buffer);
-    m_send_receive_buffer_acquired = false;
+    spdm_emu_connection_t *connection;
+
+    connection = spdm_emu_get_connection(context);
+    LIBSPDM_ASSERT (connection->send_receive_buffer_acquired);
+    LIBSPDM_ASSERT (msg_buf_ptr == connection->send_receive_buffer);
+    connection->send_receive_buffer_acquired = false;
     return;
 }
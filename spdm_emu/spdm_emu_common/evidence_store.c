@@ -0,0 +1,706 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+/* 64 bit off_t for fseeko on 32 bit hosts*/
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "spdm_emu.h"
+
+/* With --evidence_store <dir>, the attester keeps the evidence of every collection in <dir>:
+ *
+ *   chunks.bin  - the certificate chains and measurement records, each one stored once,
+ *                 as a chunk header (magic, size, SHA-256) followed by the data, 8-byte aligned.
+ *                 Only appended to.
+ *   journal.bin - the records of the collections since index.bin was written, in the order
+ *                 they were collected. Only appended to.
+ *   index.bin   - an index header followed by the records, sorted by device, timestamp, kind
+ *                 and slot.
+ *
+ * A record is (device, timestamp, kind, slot) -> (SHA-256, size, chunk offset). Devices sharing
+ * their certificate chains or firmware share the chunks, so the store grows with the unique
+ * content. When the store is closed, the journal is merged into a new index.bin, which is then
+ * mapped and binary searched by --evidence_query. A journal left by a crash is merged the next
+ * time the store is opened for writing.*/
+
+#define EVIDENCE_STORE_MAX_FILE_NAME_SIZE 1024
+#define EVIDENCE_STORE_BUCKET_COUNT 4096
+#define EVIDENCE_STORE_CHUNK_MAGIC 0x4B484345 /* "ECHK"*/
+#define EVIDENCE_STORE_INDEX_VERSION 1
+#define EVIDENCE_STORE_ALIGNMENT 8
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;
+    uint8_t digest[SPDM_EMU_EVIDENCE_HASH_SIZE];
+} evidence_store_chunk_header_t;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t record_count;
+} evidence_store_index_header_t;
+
+typedef struct evidence_store_chunk {
+    struct evidence_store_chunk *next;
+    uint8_t digest[SPDM_EMU_EVIDENCE_HASH_SIZE];
+    uint32_t size;
+    uint64_t offset;
+} evidence_store_chunk_t;
+
+const char m_evidence_store_index_magic[8] = {'S', 'P', 'D', 'M', 'E', 'V', 'I', 'X'};
+
+bool m_evidence_store_opened;
+bool m_evidence_store_writable;
+spdm_emu_mutex_t m_evidence_store_lock;
+
+/* index.bin*/
+spdm_emu_file_view_t *m_evidence_store_index_view;
+const spdm_emu_evidence_record_t *m_evidence_store_index;
+size_t m_evidence_store_index_count;
+
+/* chunks.bin, mapped when the store is read, appended to when it is written*/
+spdm_emu_file_view_t *m_evidence_store_chunk_view;
+const uint8_t *m_evidence_store_chunk_data;
+size_t m_evidence_store_chunk_data_size;
+FILE *m_evidence_store_chunk_file;
+uint64_t m_evidence_store_chunk_offset;
+
+/* journal.bin, and the records it holds*/
+FILE *m_evidence_store_journal_file;
+spdm_emu_evidence_record_t *m_evidence_store_journal;
+size_t m_evidence_store_journal_count;
+size_t m_evidence_store_journal_capacity;
+
+/* The chunks in the store, indexed by the first 12 bits of their digest.*/
+evidence_store_chunk_t *m_evidence_store_bucket[EVIDENCE_STORE_BUCKET_COUNT];
+uint32_t m_evidence_store_new_chunk_count;
+uint32_t m_evidence_store_shared_chunk_count;
+
+static void evidence_store_get_file_name(const char *name, char *file_name,
+                                         size_t file_name_size)
+{
+    snprintf(file_name, file_name_size, "%s/%s", m_evidence_store_dir, name);
+}
+
+static bool evidence_store_file_exists(const char *file_name)
+{
+    FILE *fp_in;
+
+    if ((fp_in = fopen(file_name, "rb")) == NULL) {
+        return false;
+    }
+    fclose(fp_in);
+    return true;
+}
+
+/* The end of chunks.bin, past 2 GiB too.*/
+static bool evidence_store_get_end(FILE *file, uint64_t *offset)
+{
+#ifdef _MSC_VER
+    __int64 position;
+
+    if (_fseeki64(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    position = _ftelli64(file);
+#else
+    off_t position;
+
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return false;
+    }
+    position = ftello(file);
+#endif
+    if (position < 0) {
+        return false;
+    }
+    *offset = (uint64_t)position;
+    return true;
+}
+
+static uint32_t evidence_store_get_bucket(const uint8_t *digest)
+{
+    return ((uint32_t)digest[0] << 4) | (digest[1] >> 4);
+}
+
+static const evidence_store_chunk_t *evidence_store_find_chunk(const uint8_t *digest,
+                                                               uint32_t size)
+{
+    const evidence_store_chunk_t *chunk;
+
+    for (chunk = m_evidence_store_bucket[evidence_store_get_bucket(digest)]; chunk != NULL;
+         chunk = chunk->next) {
+        if ((chunk->size == size) &&
+            (libspdm_const_compare_mem(chunk->digest, digest,
+                                       SPDM_EMU_EVIDENCE_HASH_SIZE) == 0)) {
+            return chunk;
+        }
+    }
+    return NULL;
+}
+
+static bool evidence_store_add_chunk(const uint8_t *digest, uint32_t size, uint64_t offset)
+{
+    evidence_store_chunk_t *chunk;
+    uint32_t bucket;
+
+    if (evidence_store_find_chunk(digest, size) != NULL) {
+        return true;
+    }
+    chunk = (void *)malloc(sizeof(evidence_store_chunk_t));
+    if (chunk == NULL) {
+        return false;
+    }
+    libspdm_copy_mem(chunk->digest, sizeof(chunk->digest), digest, SPDM_EMU_EVIDENCE_HASH_SIZE);
+    chunk->size = size;
+    chunk->offset = offset;
+    bucket = evidence_store_get_bucket(digest);
+    chunk->next = m_evidence_store_bucket[bucket];
+    m_evidence_store_bucket[bucket] = chunk;
+    return true;
+}
+
+static void evidence_store_free_chunks(void)
+{
+    evidence_store_chunk_t *chunk;
+    uint32_t bucket;
+
+    for (bucket = 0; bucket < EVIDENCE_STORE_BUCKET_COUNT; bucket++) {
+        while (m_evidence_store_bucket[bucket] != NULL) {
+            chunk = m_evidence_store_bucket[bucket];
+            m_evidence_store_bucket[bucket] = chunk->next;
+            free(chunk);
+        }
+    }
+}
+
+static bool evidence_store_append_journal(const spdm_emu_evidence_record_t *record)
+{
+    spdm_emu_evidence_record_t *journal;
+    size_t capacity;
+
+    if (m_evidence_store_journal_count == m_evidence_store_journal_capacity) {
+        capacity = (m_evidence_store_journal_capacity == 0) ?
+                   256 : m_evidence_store_journal_capacity * 2;
+        journal = (void *)realloc(m_evidence_store_journal,
+                                  capacity * sizeof(spdm_emu_evidence_record_t));
+        if (journal == NULL) {
+            return false;
+        }
+        m_evidence_store_journal = journal;
+        m_evidence_store_journal_capacity = capacity;
+    }
+    m_evidence_store_journal[m_evidence_store_journal_count++] = *record;
+    return true;
+}
+
+static int evidence_store_compare_key(const spdm_emu_evidence_record_t *record,
+                                      const char *device, uint64_t timestamp)
+{
+    int result;
+
+    result = strncmp(record->device, device, SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE);
+    if (result != 0) {
+        return result;
+    }
+    if (record->timestamp != timestamp) {
+        return (record->timestamp < timestamp) ? -1 : 1;
+    }
+    return 0;
+}
+
+static int evidence_store_compare_record(const void *left, const void *right)
+{
+    const spdm_emu_evidence_record_t *record1;
+    const spdm_emu_evidence_record_t *record2;
+    int result;
+
+    record1 = left;
+    record2 = right;
+    result = evidence_store_compare_key(record1, record2->device, record2->timestamp);
+    if (result != 0) {
+        return result;
+    }
+    if (record1->kind != record2->kind) {
+        return (record1->kind < record2->kind) ? -1 : 1;
+    }
+    if (record1->slot_id != record2->slot_id) {
+        return (record1->slot_id < record2->slot_id) ? -1 : 1;
+    }
+    /* The rest only tells the same record, merged twice after a crash, from another one.*/
+    return memcmp(record1, record2, sizeof(spdm_emu_evidence_record_t));
+}
+
+static bool evidence_store_map_index(void)
+{
+    char file_name[EVIDENCE_STORE_MAX_FILE_NAME_SIZE];
+    const evidence_store_index_header_t *header;
+    const void *data;
+    size_t size;
+
+    evidence_store_get_file_name("index.bin", file_name, sizeof(file_name));
+    if ((m_evidence_store_index_view != NULL) || !evidence_store_file_exists(file_name)) {
+        return true;
+    }
+    m_evidence_store_index_view = spdm_emu_map_input_file(file_name, &data, &size);
+    if (m_evidence_store_index_view == NULL) {
+        return false;
+    }
+    header = data;
+    if ((size < sizeof(evidence_store_index_header_t)) ||
+        (memcmp(header->magic, m_evidence_store_index_magic, sizeof(header->magic)) != 0) ||
+        (header->version != EVIDENCE_STORE_INDEX_VERSION) ||
+        (header->record_size != sizeof(spdm_emu_evidence_record_t)) ||
+        (header->record_count != (size - sizeof(evidence_store_index_header_t)) /
+         sizeof(spdm_emu_evidence_record_t)) ||
+        ((size - sizeof(evidence_store_index_header_t)) %
+         sizeof(spdm_emu_evidence_record_t) != 0)) {
+        printf("EvidenceStore fail - %s is not an evidence index\n", file_name);
+        spdm_emu_release_file_view(m_evidence_store_index_view);
+        m_evidence_store_index_view = NULL;
+        return false;
+    }
+    m_evidence_store_index = (const void *)(header + 1);
+    m_evidence_store_index_count = (size_t)header->record_count;
+    return true;
+}
+
+/* Read the journal left by a crash, its last record may be cut short.*/
+static bool evidence_store_read_journal(const char *file_name)
+{
+    FILE *fp_in;
+    spdm_emu_evidence_record_t record;
+
+    if ((fp_in = fopen(file_name, "rb")) == NULL) {
+        printf("EvidenceStore fail - unable to read %s\n", file_name);
+        return false;
+    }
+    while (fread(&record, sizeof(record), 1, fp_in) == 1) {
+        if (!evidence_store_append_journal(&record)) {
+            fclose(fp_in);
+            return false;
+        }
+    }
+    fclose(fp_in);
+    if (m_evidence_store_journal_count != 0) {
+        printf("EvidenceStore - %u records recovered from %s\n",
+               (uint32_t)m_evidence_store_journal_count, file_name);
+    }
+    return true;
+}
+
+/* Write index.bin with the records of the old one and of the journal, then drop the journal.*/
+static bool evidence_store_merge_journal(void)
+{
+    char file_name[EVIDENCE_STORE_MAX_FILE_NAME_SIZE];
+    evidence_store_index_header_t *header;
+    spdm_emu_evidence_record_t *record;
+    size_t record_count;
+    size_t old_index;
+    size_t new_index;
+    size_t index_size;
+    int result;
+    bool status;
+
+    if (m_evidence_store_journal_count == 0) {
+        return true;
+    }
+    qsort(m_evidence_store_journal, m_evidence_store_journal_count,
+          sizeof(spdm_emu_evidence_record_t), evidence_store_compare_record);
+
+    index_size = sizeof(evidence_store_index_header_t) +
+                 (m_evidence_store_index_count + m_evidence_store_journal_count) *
+                 sizeof(spdm_emu_evidence_record_t);
+    header = (void *)malloc(index_size);
+    if (header == NULL) {
+        printf("EvidenceStore fail - no sufficient memory to merge the journal\n");
+        return false;
+    }
+    record = (void *)(header + 1);
+    record_count = 0;
+    old_index = 0;
+    new_index = 0;
+    while ((old_index < m_evidence_store_index_count) ||
+           (new_index < m_evidence_store_journal_count)) {
+        if (old_index == m_evidence_store_index_count) {
+            result = 1;
+        } else if (new_index == m_evidence_store_journal_count) {
+            result = -1;
+        } else {
+            result = evidence_store_compare_record(&m_evidence_store_index[old_index],
+                                                   &m_evidence_store_journal[new_index]);
+        }
+        if (result <= 0) {
+            record[record_count] = m_evidence_store_index[old_index++];
+        } else {
+            record[record_count] = m_evidence_store_journal[new_index++];
+        }
+        if (result == 0) {
+            new_index++;
+        }
+        if ((record_count == 0) ||
+            (evidence_store_compare_record(&record[record_count - 1],
+                                           &record[record_count]) != 0)) {
+            record_count++;
+        }
+    }
+    libspdm_copy_mem(header->magic, sizeof(header->magic), m_evidence_store_index_magic,
+                     sizeof(m_evidence_store_index_magic));
+    header->version = EVIDENCE_STORE_INDEX_VERSION;
+    header->record_size = sizeof(spdm_emu_evidence_record_t);
+    header->record_count = record_count;
+    index_size = sizeof(evidence_store_index_header_t) +
+                 record_count * sizeof(spdm_emu_evidence_record_t);
+
+    /* index.bin is replaced, the old one is not read any more.*/
+    if (m_evidence_store_index_view != NULL) {
+        spdm_emu_release_file_view(m_evidence_store_index_view);
+        m_evidence_store_index_view = NULL;
+    }
+    m_evidence_store_index = NULL;
+    m_evidence_store_index_count = 0;
+    m_evidence_store_journal_count = 0;
+
+    evidence_store_get_file_name("index.bin", file_name, sizeof(file_name));
+    status = libspdm_write_output_file(file_name, header, index_size);
+    free(header);
+    if (!status) {
+        return false;
+    }
+    if (m_evidence_store_journal_file != NULL) {
+        fclose(m_evidence_store_journal_file);
+        m_evidence_store_journal_file = NULL;
+    }
+    evidence_store_get_file_name("journal.bin", file_name, sizeof(file_name));
+    remove(file_name);
+    return true;
+}
+
+static bool evidence_store_open_for_writing(void)
+{
+    char file_name[EVIDENCE_STORE_MAX_FILE_NAME_SIZE];
+    size_t index;
+
+    evidence_store_get_file_name("journal.bin", file_name, sizeof(file_name));
+    if (evidence_store_file_exists(file_name)) {
+        /* Merge the journal of a crashed run first, so that new records are not appended
+         * after a record cut short.*/
+        if (!evidence_store_read_journal(file_name) || !evidence_store_merge_journal() ||
+            !evidence_store_map_index()) {
+            return false;
+        }
+        remove(file_name);
+    }
+    m_evidence_store_journal_file = fopen(file_name, "ab");
+    if (m_evidence_store_journal_file == NULL) {
+        printf("EvidenceStore fail - unable to open %s\n", file_name);
+        return false;
+    }
+
+    evidence_store_get_file_name("chunks.bin", file_name, sizeof(file_name));
+    m_evidence_store_chunk_file = fopen(file_name, "ab");
+    if ((m_evidence_store_chunk_file == NULL) ||
+        !evidence_store_get_end(m_evidence_store_chunk_file, &m_evidence_store_chunk_offset)) {
+        printf("EvidenceStore fail - unable to open %s\n", file_name);
+        return false;
+    }
+    /* A chunk cut short by a crash is left behind, no record points to it.*/
+    m_evidence_store_chunk_offset = (m_evidence_store_chunk_offset +
+                                     EVIDENCE_STORE_ALIGNMENT - 1) &
+                                    ~(uint64_t)(EVIDENCE_STORE_ALIGNMENT - 1);
+
+    /* The records know every chunk, chunks.bin is not read.*/
+    for (index = 0; index < m_evidence_store_index_count; index++) {
+        if (!evidence_store_add_chunk(m_evidence_store_index[index].digest,
+                                      m_evidence_store_index[index].size,
+                                      m_evidence_store_index[index].chunk_offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool evidence_store_open_for_reading(void)
+{
+    char file_name[EVIDENCE_STORE_MAX_FILE_NAME_SIZE];
+    const void *data;
+
+    evidence_store_get_file_name("journal.bin", file_name, sizeof(file_name));
+    if (evidence_store_file_exists(file_name)) {
+        printf("EvidenceStore - %s is not merged yet, its records are not searched\n",
+               file_name);
+    }
+    if (m_evidence_store_index_count == 0) {
+        return true;
+    }
+    evidence_store_get_file_name("chunks.bin", file_name, sizeof(file_name));
+    m_evidence_store_chunk_view = spdm_emu_map_input_file(file_name, &data,
+                                                          &m_evidence_store_chunk_data_size);
+    if (m_evidence_store_chunk_view == NULL) {
+        return false;
+    }
+    m_evidence_store_chunk_data = data;
+    return true;
+}
+
+/**
+ * Open the store in --evidence_store.
+ *
+ * @param  writable  true to add the evidence of new collections, false to query the store.
+ *
+ * @retval true  The store is open, or there is no --evidence_store.
+ * @retval false The store cannot be opened.
+ **/
+bool spdm_emu_evidence_store_open(bool writable)
+{
+    bool result;
+
+    if ((m_evidence_store_dir == NULL) || m_evidence_store_opened) {
+        return true;
+    }
+    spdm_emu_mutex_init(&m_evidence_store_lock);
+    m_evidence_store_opened = true;
+    m_evidence_store_writable = writable;
+
+    result = evidence_store_map_index();
+    if (result) {
+        result = writable ? evidence_store_open_for_writing() :
+                 evidence_store_open_for_reading();
+    }
+    if (!result) {
+        spdm_emu_evidence_store_close();
+    }
+    return result;
+}
+
+/**
+ * Merge the journal of the collections into the index, and close the store.
+ **/
+void spdm_emu_evidence_store_close(void)
+{
+    if (!m_evidence_store_opened) {
+        return;
+    }
+    if (m_evidence_store_writable && (m_evidence_store_chunk_file != NULL)) {
+        if (!evidence_store_merge_journal()) {
+            printf("EvidenceStore fail - the journal is not merged\n");
+        }
+        printf("EvidenceStore - new chunk %u, shared chunk %u\n",
+               m_evidence_store_new_chunk_count, m_evidence_store_shared_chunk_count);
+    }
+    if (m_evidence_store_journal_file != NULL) {
+        fclose(m_evidence_store_journal_file);
+        m_evidence_store_journal_file = NULL;
+    }
+    if (m_evidence_store_chunk_file != NULL) {
+        fclose(m_evidence_store_chunk_file);
+        m_evidence_store_chunk_file = NULL;
+    }
+    if (m_evidence_store_chunk_view != NULL) {
+        spdm_emu_release_file_view(m_evidence_store_chunk_view);
+        m_evidence_store_chunk_view = NULL;
+    }
+    m_evidence_store_chunk_data = NULL;
+    m_evidence_store_chunk_data_size = 0;
+    if (m_evidence_store_index_view != NULL) {
+        spdm_emu_release_file_view(m_evidence_store_index_view);
+        m_evidence_store_index_view = NULL;
+    }
+    m_evidence_store_index = NULL;
+    m_evidence_store_index_count = 0;
+    free(m_evidence_store_journal);
+    m_evidence_store_journal = NULL;
+    m_evidence_store_journal_count = 0;
+    m_evidence_store_journal_capacity = 0;
+    evidence_store_free_chunks();
+    spdm_emu_mutex_destroy(&m_evidence_store_lock);
+    m_evidence_store_opened = false;
+}
+
+/* Called with the lock held. Append the data to chunks.bin, unless the store has it already.*/
+static bool evidence_store_put_chunk(const uint8_t *digest, const void *data, uint32_t size,
+                                     uint64_t *offset)
+{
+    const evidence_store_chunk_t *chunk;
+    evidence_store_chunk_header_t header;
+    uint8_t padding[EVIDENCE_STORE_ALIGNMENT];
+    size_t padding_size;
+    uint64_t position;
+
+    chunk = evidence_store_find_chunk(digest, size);
+    if (chunk != NULL) {
+        *offset = chunk->offset;
+        m_evidence_store_shared_chunk_count++;
+        return true;
+    }
+
+    header.magic = EVIDENCE_STORE_CHUNK_MAGIC;
+    header.size = size;
+    libspdm_copy_mem(header.digest, sizeof(header.digest), digest, SPDM_EMU_EVIDENCE_HASH_SIZE);
+    /* The chunk starts at the aligned offset, a few bytes past the end of chunks.bin. If it
+     * does not, chunks.bin changed under the store.*/
+    if (!evidence_store_get_end(m_evidence_store_chunk_file, &position) ||
+        (position > m_evidence_store_chunk_offset) ||
+        (m_evidence_store_chunk_offset - position > sizeof(padding))) {
+        return false;
+    }
+    padding_size = (size_t)(m_evidence_store_chunk_offset - position);
+    libspdm_zero_mem(padding, sizeof(padding));
+    if ((fwrite(padding, 1, padding_size, m_evidence_store_chunk_file) != padding_size) ||
+        (fwrite(&header, 1, sizeof(header), m_evidence_store_chunk_file) != sizeof(header)) ||
+        (fwrite(data, 1, size, m_evidence_store_chunk_file) != size) ||
+        !spdm_emu_sync_file(m_evidence_store_chunk_file)) {
+        return false;
+    }
+    if (!evidence_store_add_chunk(digest, size, m_evidence_store_chunk_offset)) {
+        return false;
+    }
+    *offset = m_evidence_store_chunk_offset;
+    m_evidence_store_chunk_offset = (m_evidence_store_chunk_offset + sizeof(header) + size +
+                                     EVIDENCE_STORE_ALIGNMENT - 1) &
+                                    ~(uint64_t)(EVIDENCE_STORE_ALIGNMENT - 1);
+    m_evidence_store_new_chunk_count++;
+    return true;
+}
+
+/**
+ * Add a piece of evidence of a device to the store. It is safe to call from several threads.
+ *
+ * @param  device     The name of the device, shorter than SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE.
+ * @param  timestamp  The time of the collection, in seconds since the epoch. The evidence of a
+ *                    collection share it.
+ * @param  kind       SPDM_EMU_EVIDENCE_KIND_*.
+ * @param  slot_id    The slot of a certificate chain, 0 for a measurement record.
+ **/
+bool spdm_emu_evidence_store_add(const char *device, uint64_t timestamp, uint8_t kind,
+                                 uint8_t slot_id, const void *data, size_t size)
+{
+    spdm_emu_evidence_record_t record;
+    bool result;
+
+    if (!m_evidence_store_opened || !m_evidence_store_writable ||
+        (strlen(device) >= SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE) || (size > UINT32_MAX)) {
+        return false;
+    }
+    libspdm_zero_mem(&record, sizeof(record));
+    libspdm_copy_mem(record.device, sizeof(record.device), device, strlen(device));
+    record.timestamp = timestamp;
+    record.kind = kind;
+    record.slot_id = slot_id;
+    record.size = (uint32_t)size;
+    if (!libspdm_hash_all(SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_256, data, size,
+                          record.digest)) {
+        return false;
+    }
+
+    spdm_emu_mutex_lock(&m_evidence_store_lock);
+    result = evidence_store_put_chunk(record.digest, data, record.size, &record.chunk_offset);
+    /* The record is journaled after its chunk, so that a crash never leaves it dangling.*/
+    if (result) {
+        result = (fwrite(&record, 1, sizeof(record), m_evidence_store_journal_file) ==
+                  sizeof(record)) &&
+                 spdm_emu_sync_file(m_evidence_store_journal_file) &&
+                 evidence_store_append_journal(&record);
+    }
+    spdm_emu_mutex_unlock(&m_evidence_store_lock);
+    if (!result) {
+        printf("EvidenceStore fail - unable to add the evidence of %s\n", device);
+    }
+    return result;
+}
+
+/**
+ * Get all the records of index.bin, sorted by device, timestamp, kind and slot.
+ **/
+const spdm_emu_evidence_record_t *spdm_emu_evidence_store_get_records(size_t *record_count)
+{
+    *record_count = m_evidence_store_index_count;
+    return m_evidence_store_index;
+}
+
+/**
+ * Find the records of the last collection of a device, at or before a time.
+ *
+ * @param  device        The name of the device.
+ * @param  timestamp     The time, UINT64_MAX for the last collection.
+ * @param  record_count  The number of records of the collection.
+ *
+ * @return the records, sorted by kind and slot, or NULL if the device was not collected then.
+ **/
+const spdm_emu_evidence_record_t *spdm_emu_evidence_store_find(const char *device,
+                                                               uint64_t timestamp,
+                                                               size_t *record_count)
+{
+    size_t low;
+    size_t high;
+    size_t middle;
+    size_t last;
+    const spdm_emu_evidence_record_t *record;
+
+    *record_count = 0;
+    /* The first record after (device, timestamp).*/
+    low = 0;
+    high = m_evidence_store_index_count;
+    while (low < high) {
+        middle = low + (high - low) / 2;
+        if (evidence_store_compare_key(&m_evidence_store_index[middle], device,
+                                       timestamp) <= 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        return NULL;
+    }
+    last = low - 1;
+    record = &m_evidence_store_index[last];
+    if (strncmp(record->device, device, SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE) != 0) {
+        return NULL;
+    }
+    /* A collection holds at most a measurement record and SPDM_MAX_SLOT_COUNT chains.*/
+    while ((record != m_evidence_store_index) &&
+           (evidence_store_compare_key(record - 1, device, m_evidence_store_index[last].timestamp)
+            == 0)) {
+        record--;
+    }
+    *record_count = (size_t)(&m_evidence_store_index[last] - record) + 1;
+    return record;
+}
+
+/**
+ * Get the data of a record found with spdm_emu_evidence_store_find. The data stays valid until
+ * the store is closed.
+ **/
+bool spdm_emu_evidence_store_get_data(const spdm_emu_evidence_record_t *record,
+                                      const void **data, size_t *size)
+{
+    const evidence_store_chunk_header_t *header;
+
+    if ((m_evidence_store_chunk_data == NULL) ||
+        (record->chunk_offset > m_evidence_store_chunk_data_size) ||
+        (m_evidence_store_chunk_data_size - record->chunk_offset <
+         sizeof(evidence_store_chunk_header_t))) {
+        return false;
+    }
+    header = (const void *)(m_evidence_store_chunk_data + record->chunk_offset);
+    if ((header->magic != EVIDENCE_STORE_CHUNK_MAGIC) || (header->size != record->size) ||
+        (m_evidence_store_chunk_data_size - record->chunk_offset -
+         sizeof(evidence_store_chunk_header_t) < header->size) ||
+        (libspdm_const_compare_mem(header->digest, record->digest,
+                                   SPDM_EMU_EVIDENCE_HASH_SIZE) != 0)) {
+        printf("EvidenceStore fail - bad chunk at offset 0x%llx\n",
+               (unsigned long long)record->chunk_offset);
+        return false;
+    }
+    *data = header + 1;
+    *size = header->size;
+    return true;
+}
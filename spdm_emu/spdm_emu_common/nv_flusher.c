@@ -0,0 +1,234 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_emu.h"
+
+/* The negotiated state is saved from the connection state callback, in the middle of
+ * libspdm_responder_dispatch_message. Once the flusher is started, the save only queues the
+ * write, and a background thread does the file I/O.
+ * A write replaces a queued write of the same file or state store key, so a state saved and
+ * cleared again before the flusher runs costs one write.*/
+
+typedef struct spdm_nv_write {
+    struct spdm_nv_write *next;
+    /* true for a state store key, false for a file*/
+    bool is_state;
+    char *name;
+    /* NULL with a state store key deletes the key.*/
+    void *data;
+    size_t data_size;
+} spdm_nv_write_t;
+
+bool m_nv_flusher_running;
+bool m_nv_flusher_stopping;
+spdm_emu_thread_t m_nv_flusher_thread;
+spdm_emu_mutex_t m_nv_flusher_lock;
+spdm_emu_cond_t m_nv_flusher_cond;
+spdm_nv_write_t *m_nv_flusher_queue;
+/* The write the thread is doing, still visible to spdm_nv_get_state.*/
+spdm_nv_write_t *m_nv_flusher_current;
+
+static void nv_flusher_free_write(spdm_nv_write_t *write)
+{
+    free(write->name);
+    free(write->data);
+    free(write);
+}
+
+static void nv_flusher_do_write(const spdm_nv_write_t *write)
+{
+    bool result;
+
+    if (!write->is_state) {
+        result = libspdm_write_output_file(write->name, write->data, write->data_size);
+    } else if (write->data == NULL) {
+        result = spdm_state_store_delete(write->name);
+    } else {
+        result = spdm_state_store_put(write->name, write->data, write->data_size);
+    }
+    if (!result) {
+        printf("NvFlusher fail - write %s error\n", write->name);
+    }
+}
+
+static void nv_flusher_routine(void *context)
+{
+    spdm_emu_mutex_lock(&m_nv_flusher_lock);
+    while (true) {
+        while ((m_nv_flusher_queue == NULL) && !m_nv_flusher_stopping) {
+            spdm_emu_cond_wait(&m_nv_flusher_cond, &m_nv_flusher_lock);
+        }
+        if (m_nv_flusher_queue == NULL) {
+            break;
+        }
+        m_nv_flusher_current = m_nv_flusher_queue;
+        m_nv_flusher_queue = m_nv_flusher_current->next;
+        spdm_emu_mutex_unlock(&m_nv_flusher_lock);
+
+        nv_flusher_do_write(m_nv_flusher_current);
+
+        spdm_emu_mutex_lock(&m_nv_flusher_lock);
+        nv_flusher_free_write(m_nv_flusher_current);
+        m_nv_flusher_current = NULL;
+    }
+    spdm_emu_mutex_unlock(&m_nv_flusher_lock);
+}
+
+/**
+ * Queue a write, or do it now if the flusher is not running.
+ *
+ * @param  is_state                      true for a state store key, false for a file.
+ * @param  name                          The file name or the state store key.
+ * @param  data                          The data, NULL to delete a state store key.
+ * @param  data_size                     The size of data.
+ *
+ * @retval true  The write is done or queued.
+ * @retval false The write failed, or there is no memory to queue it.
+ **/
+static bool nv_flusher_write(bool is_state, const char *name, const void *data,
+                             size_t data_size)
+{
+    spdm_nv_write_t *write;
+    spdm_nv_write_t **link;
+    size_t name_size;
+
+    write = (void *)malloc(sizeof(spdm_nv_write_t));
+    if (write == NULL) {
+        return false;
+    }
+    libspdm_zero_mem(write, sizeof(spdm_nv_write_t));
+    write->is_state = is_state;
+    name_size = strlen(name) + 1;
+    write->name = (void *)malloc(name_size);
+    if (data != NULL) {
+        /* malloc(0) may return NULL, keep one byte for an empty file.*/
+        write->data = (void *)malloc(data_size == 0 ? 1 : data_size);
+    }
+    if ((write->name == NULL) || ((data != NULL) && (write->data == NULL))) {
+        nv_flusher_free_write(write);
+        return false;
+    }
+    libspdm_copy_mem(write->name, name_size, name, name_size);
+    if (data_size != 0) {
+        libspdm_copy_mem(write->data, data_size, data, data_size);
+    }
+    write->data_size = data_size;
+
+    if (!m_nv_flusher_running) {
+        nv_flusher_do_write(write);
+        nv_flusher_free_write(write);
+        return true;
+    }
+
+    spdm_emu_mutex_lock(&m_nv_flusher_lock);
+    for (link = &m_nv_flusher_queue; *link != NULL; link = &(*link)->next) {
+        if (((*link)->is_state == is_state) && (strcmp((*link)->name, name) == 0)) {
+            /* Coalesce, the queued write keeps its place.*/
+            write->next = (*link)->next;
+            nv_flusher_free_write(*link);
+            break;
+        }
+    }
+    *link = write;
+    spdm_emu_cond_signal(&m_nv_flusher_cond);
+    spdm_emu_mutex_unlock(&m_nv_flusher_lock);
+    return true;
+}
+
+/**
+ * Start the background thread that does the writes of spdm_nv_write_file and spdm_nv_*_state.
+ **/
+bool spdm_nv_flusher_start(void)
+{
+    if (m_nv_flusher_running) {
+        return true;
+    }
+    spdm_emu_mutex_init(&m_nv_flusher_lock);
+    spdm_emu_cond_init(&m_nv_flusher_cond);
+    m_nv_flusher_stopping = false;
+    if (!spdm_emu_thread_create(&m_nv_flusher_thread, nv_flusher_routine, NULL)) {
+        printf("NvFlusher fail - thread create error\n");
+        spdm_emu_cond_destroy(&m_nv_flusher_cond);
+        spdm_emu_mutex_destroy(&m_nv_flusher_lock);
+        return false;
+    }
+    m_nv_flusher_running = true;
+    return true;
+}
+
+/**
+ * Do the queued writes, then stop the background thread. Later writes are done synchronously.
+ **/
+void spdm_nv_flusher_stop(void)
+{
+    if (!m_nv_flusher_running) {
+        return;
+    }
+    spdm_emu_mutex_lock(&m_nv_flusher_lock);
+    m_nv_flusher_stopping = true;
+    spdm_emu_cond_signal(&m_nv_flusher_cond);
+    spdm_emu_mutex_unlock(&m_nv_flusher_lock);
+    spdm_emu_thread_join(m_nv_flusher_thread);
+
+    m_nv_flusher_running = false;
+    spdm_emu_cond_destroy(&m_nv_flusher_cond);
+    spdm_emu_mutex_destroy(&m_nv_flusher_lock);
+}
+
+bool spdm_nv_write_file(const char *file_name, const void *data, size_t data_size)
+{
+    return nv_flusher_write(false, file_name, data, data_size);
+}
+
+bool spdm_nv_put_state(const char *key, const void *value, size_t value_size)
+{
+    return nv_flusher_write(true, key, value, value_size);
+}
+
+bool spdm_nv_delete_state(const char *key)
+{
+    return nv_flusher_write(true, key, NULL, 0);
+}
+
+/**
+ * Read the value of a state store key, including a value not written yet.
+ *
+ * @retval true  The key has a value of value_size bytes.
+ * @retval false The key is unknown or deleted, or its value has another size.
+ **/
+bool spdm_nv_get_state(const char *key, void *value, size_t value_size)
+{
+    spdm_nv_write_t *write;
+    spdm_nv_write_t *found;
+    bool result;
+
+    if (m_nv_flusher_running) {
+        spdm_emu_mutex_lock(&m_nv_flusher_lock);
+        /* A queued write is newer than the one being done.*/
+        found = NULL;
+        for (write = m_nv_flusher_queue; write != NULL; write = write->next) {
+            if (write->is_state && (strcmp(write->name, key) == 0)) {
+                found = write;
+                break;
+            }
+        }
+        if ((found == NULL) && (m_nv_flusher_current != NULL) &&
+            m_nv_flusher_current->is_state &&
+            (strcmp(m_nv_flusher_current->name, key) == 0)) {
+            found = m_nv_flusher_current;
+        }
+        if (found != NULL) {
+            result = (found->data != NULL) && (found->data_size == value_size);
+            if (result) {
+                libspdm_copy_mem(value, value_size, found->data, value_size);
+            }
+            spdm_emu_mutex_unlock(&m_nv_flusher_lock);
+            return result;
+        }
+        spdm_emu_mutex_unlock(&m_nv_flusher_lock);
+    }
+    return spdm_state_store_get(key, value, value_size);
+}
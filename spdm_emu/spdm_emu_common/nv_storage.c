@@ -8,6 +8,7 @@
 
 char *m_load_state_file_name;
 char *m_save_state_file_name;
+char *m_peer_id;
 
 libspdm_return_t spdm_provision_psk_version_only(void *spdm_context,
                                                  bool is_requester)
@@ -168,68 +169,17 @@ libspdm_return_t spdm_provision_psk_version_only(void *spdm_context,
 }
 
 /**
- * Load the negotiated_state from NV storage to an SPDM context.
+ * Provision a negotiated_state to an SPDM context, without changing the local settings.
  */
-libspdm_return_t spdm_load_negotiated_state(void *spdm_context,
-                                            bool is_requester)
+static void spdm_apply_negotiated_state(void *spdm_context, bool is_requester,
+                                        const spdm_negotiated_state_struct_t *negotiated_state)
 {
-    bool ret;
-    void *file_data;
-    size_t file_size;
-    spdm_negotiated_state_struct_t negotiated_state;
     libspdm_data_parameter_t parameter;
     uint8_t data8;
     uint16_t data16;
     uint32_t data32;
     spdm_version_number_t spdm_version;
 
-    if (m_load_state_file_name == NULL) {
-        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
-    }
-    ret = libspdm_read_input_file(m_load_state_file_name, &file_data, &file_size);
-    if (!ret) {
-        printf("LoadState fail - read file error\n");
-        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
-    }
-
-    if (file_size != sizeof(negotiated_state)) {
-        printf("LoadState fail - size mismatch\n");
-        free(file_data);
-        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
-    }
-
-    libspdm_copy_mem(&negotiated_state, file_size, file_data, file_size);
-    free(file_data);
-
-    if (negotiated_state.version != SPDM_NEGOTIATED_STATE_STRUCT_VERSION) {
-        printf("LoadState fail - version mismatch\n");
-        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
-    }
-
-    printf("LoadState from %s\n", m_load_state_file_name);
-
-
-    /* Override local setting*/
-
-    m_use_version = negotiated_state.spdm_version;
-    m_use_requester_capability_flags = negotiated_state.requester_cap_flags;
-    m_use_responder_capability_flags = negotiated_state.responder_cap_flags;
-    if (is_requester) {
-        m_use_capability_flags = negotiated_state.requester_cap_flags;
-    } else {
-        m_use_capability_flags = negotiated_state.responder_cap_flags;
-    }
-    m_support_measurement_spec = negotiated_state.measurement_spec;
-    m_support_measurement_hash_algo =
-        negotiated_state.measurement_hash_algo;
-    m_support_asym_algo = negotiated_state.base_asym_algo;
-    m_support_hash_algo = negotiated_state.base_hash_algo;
-    m_support_dhe_algo = negotiated_state.dhe_named_group;
-    m_support_aead_algo = negotiated_state.aead_cipher_suite;
-    m_support_req_asym_algo = negotiated_state.req_base_asym_alg;
-    m_support_key_schedule_algo = negotiated_state.key_schedule;
-    m_support_other_params_support = negotiated_state.other_params_support;
-
     /* Set connection info*/
 
     libspdm_zero_mem(&parameter, sizeof(parameter));
@@ -238,7 +188,7 @@ libspdm_return_t spdm_load_negotiated_state(void *spdm_context,
     libspdm_set_data(spdm_context, LIBSPDM_DATA_IS_REQUESTER, &parameter,
                      &is_requester, sizeof(is_requester));
 
-    spdm_version = m_use_version << SPDM_VERSION_NUMBER_SHIFT_BIT;
+    spdm_version = negotiated_state->spdm_version << SPDM_VERSION_NUMBER_SHIFT_BIT;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_SPDM_VERSION, &parameter,
                      &spdm_version, sizeof(spdm_version));
 
@@ -246,45 +196,46 @@ libspdm_return_t spdm_load_negotiated_state(void *spdm_context,
     libspdm_set_data(spdm_context, LIBSPDM_DATA_CAPABILITY_CT_EXPONENT,
                      &parameter, &data8, sizeof(data8));
     if (is_requester) {
-        data32 = negotiated_state.responder_cap_flags;
+        data32 = negotiated_state->responder_cap_flags;
     } else {
-        data32 = negotiated_state.requester_cap_flags;
+        data32 = negotiated_state->requester_cap_flags;
     }
     libspdm_set_data(spdm_context, LIBSPDM_DATA_CAPABILITY_FLAGS, &parameter,
                      &data32, sizeof(data32));
 
-    data8 = m_support_measurement_spec;
+    data8 = negotiated_state->measurement_spec;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_MEASUREMENT_SPEC, &parameter,
                      &data8, sizeof(data8));
-    data32 = m_support_measurement_hash_algo;
+    data32 = negotiated_state->measurement_hash_algo;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_MEASUREMENT_HASH_ALGO, &parameter,
                      &data32, sizeof(data32));
-    data32 = m_support_asym_algo;
+    data32 = negotiated_state->base_asym_algo;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_BASE_ASYM_ALGO, &parameter,
                      &data32, sizeof(data32));
-    data32 = m_support_hash_algo;
+    data32 = negotiated_state->base_hash_algo;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_BASE_HASH_ALGO, &parameter,
                      &data32, sizeof(data32));
-    if (m_use_version >= SPDM_MESSAGE_VERSION_11) {
-        data16 = m_support_dhe_algo;
+    if (negotiated_state->spdm_version >= SPDM_MESSAGE_VERSION_11) {
+        data16 = negotiated_state->dhe_named_group;
         libspdm_set_data(spdm_context, LIBSPDM_DATA_DHE_NAME_GROUP,
                          &parameter, &data16, sizeof(data16));
-        data16 = m_support_aead_algo;
+        data16 = negotiated_state->aead_cipher_suite;
         libspdm_set_data(spdm_context, LIBSPDM_DATA_AEAD_CIPHER_SUITE,
                          &parameter, &data16, sizeof(data16));
-        data16 = m_support_req_asym_algo;
+        data16 = negotiated_state->req_base_asym_alg;
         libspdm_set_data(spdm_context, LIBSPDM_DATA_REQ_BASE_ASYM_ALG,
                          &parameter, &data16, sizeof(data16));
-        data16 = m_support_key_schedule_algo;
+        data16 = negotiated_state->key_schedule;
         libspdm_set_data(spdm_context, LIBSPDM_DATA_KEY_SCHEDULE, &parameter,
                          &data16, sizeof(data16));
-        if (m_use_version >= SPDM_MESSAGE_VERSION_12) {
-            data8 = m_support_other_params_support;
+        if (negotiated_state->spdm_version >= SPDM_MESSAGE_VERSION_12) {
+            data8 = negotiated_state->other_params_support;
             libspdm_set_data(spdm_context, LIBSPDM_DATA_OTHER_PARAMS_SUPPORT, &parameter,
                              &data8, sizeof(data8));
         }
         libspdm_set_data(spdm_context, LIBSPDM_DATA_VCA_CACHE, &parameter,
-                         negotiated_state.vca_buffer, negotiated_state.vca_buffer_size);
+                         (void *)negotiated_state->vca_buffer,
+                         negotiated_state->vca_buffer_size);
     } else {
         data16 = 0;
         libspdm_set_data(spdm_context, LIBSPDM_DATA_DHE_NAME_GROUP,
@@ -306,10 +257,112 @@ libspdm_return_t spdm_load_negotiated_state(void *spdm_context,
     data32 = LIBSPDM_CONNECTION_STATE_NEGOTIATED;
     libspdm_set_data(spdm_context, LIBSPDM_DATA_CONNECTION_STATE, &parameter,
                      &data32, sizeof(data32));
+}
+
+/**
+ * Load the negotiated_state from NV storage to an SPDM context.
+ */
+libspdm_return_t spdm_load_negotiated_state(void *spdm_context,
+                                            bool is_requester)
+{
+    spdm_emu_file_view_t *file_view;
+    const void *file_data;
+    size_t file_size;
+    spdm_negotiated_state_struct_t negotiated_state;
+
+    if (m_load_state_file_name == NULL) {
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+    file_view = spdm_emu_map_input_file(m_load_state_file_name, &file_data, &file_size);
+    if (file_view == NULL) {
+        printf("LoadState fail - read file error\n");
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+
+    if (file_size != sizeof(negotiated_state)) {
+        printf("LoadState fail - size mismatch\n");
+        spdm_emu_release_file_view(file_view);
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+
+    libspdm_copy_mem(&negotiated_state, file_size, file_data, file_size);
+    spdm_emu_release_file_view(file_view);
+
+    if (negotiated_state.version != SPDM_NEGOTIATED_STATE_STRUCT_VERSION) {
+        printf("LoadState fail - version mismatch\n");
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+
+    printf("LoadState from %s\n", m_load_state_file_name);
+
+
+    /* Override local setting*/
+
+    m_use_version = negotiated_state.spdm_version;
+    m_use_requester_capability_flags = negotiated_state.requester_cap_flags;
+    m_use_responder_capability_flags = negotiated_state.responder_cap_flags;
+    if (is_requester) {
+        m_use_capability_flags = negotiated_state.requester_cap_flags;
+    } else {
+        m_use_capability_flags = negotiated_state.responder_cap_flags;
+    }
+    m_support_measurement_spec = negotiated_state.measurement_spec;
+    m_support_measurement_hash_algo =
+        negotiated_state.measurement_hash_algo;
+    m_support_asym_algo = negotiated_state.base_asym_algo;
+    m_support_hash_algo = negotiated_state.base_hash_algo;
+    m_support_dhe_algo = negotiated_state.dhe_named_group;
+    m_support_aead_algo = negotiated_state.aead_cipher_suite;
+    m_support_req_asym_algo = negotiated_state.req_base_asym_alg;
+    m_support_key_schedule_algo = negotiated_state.key_schedule;
+    m_support_other_params_support = negotiated_state.other_params_support;
+
+    spdm_apply_negotiated_state(spdm_context, is_requester, &negotiated_state);
+
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/**
+ * Load the negotiated_state saved for a peer in the state store to an SPDM context.
+ * Unlike spdm_load_negotiated_state, the local settings are kept for the other connections.
+ */
+libspdm_return_t spdm_load_peer_negotiated_state(void *spdm_context,
+                                                 bool is_requester, const char *peer_id)
+{
+    spdm_negotiated_state_struct_t negotiated_state;
+
+    if (!spdm_nv_get_state(peer_id, &negotiated_state, sizeof(negotiated_state))) {
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+    if (negotiated_state.version != SPDM_NEGOTIATED_STATE_STRUCT_VERSION) {
+        printf("LoadState fail - version mismatch\n");
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+
+    printf("LoadState for %s\n", peer_id);
+
+    spdm_apply_negotiated_state(spdm_context, is_requester, &negotiated_state);
 
     return LIBSPDM_STATUS_SUCCESS;
 }
 
+/**
+ * Return the state store key of the peer of an SPDM context, or NULL if it is not in the store.
+ */
+static const char *spdm_get_peer_state_key(void *spdm_context)
+{
+    spdm_emu_connection_t *connection;
+
+    if (m_state_store_file_name == NULL) {
+        return NULL;
+    }
+    connection = spdm_emu_get_connection(spdm_context);
+    if (connection->peer_id[0] == '\0') {
+        return NULL;
+    }
+    return connection->peer_id;
+}
+
 /**
  * Save the negotiated_state to NV storage from an SPDM context.
  */
@@ -317,6 +370,7 @@ libspdm_return_t spdm_save_negotiated_state(void *spdm_context,
                                             bool is_requester)
 {
     bool ret;
+    const char *peer_key;
     spdm_negotiated_state_struct_t negotiated_state;
     size_t data_size;
     libspdm_data_parameter_t parameter;
@@ -327,13 +381,18 @@ libspdm_return_t spdm_save_negotiated_state(void *spdm_context,
     size_t index;
     uint8_t vca_buffer[LIBSPDM_MAX_MESSAGE_VCA_BUFFER_SIZE];
 
-    if (m_save_state_file_name == NULL) {
+    peer_key = spdm_get_peer_state_key(spdm_context);
+    if ((m_save_state_file_name == NULL) && (peer_key == NULL)) {
         return LIBSPDM_STATUS_UNSUPPORTED_CAP;
     }
 
     m_end_session_attributes = 0;
 
-    printf("SaveState to %s\n", m_save_state_file_name);
+    if (peer_key != NULL) {
+        printf("SaveState for %s\n", peer_key);
+    } else {
+        printf("SaveState to %s\n", m_save_state_file_name);
+    }
 
     libspdm_zero_mem(&negotiated_state, sizeof(negotiated_state));
     negotiated_state.version = SPDM_NEGOTIATED_STATE_STRUCT_VERSION;
@@ -455,8 +514,12 @@ libspdm_return_t spdm_save_negotiated_state(void *spdm_context,
                      &data_size);
     negotiated_state.other_params_support = data8;
 
-    ret = libspdm_write_output_file(m_save_state_file_name, &negotiated_state,
-                                    sizeof(negotiated_state));
+    if (peer_key != NULL) {
+        ret = spdm_nv_put_state(peer_key, &negotiated_state, sizeof(negotiated_state));
+    } else {
+        ret = spdm_nv_write_file(m_save_state_file_name, &negotiated_state,
+                                 sizeof(negotiated_state));
+    }
     if (!ret) {
         printf("SaveState fail - write file error\n");
         return LIBSPDM_STATUS_UNSUPPORTED_CAP;
@@ -470,14 +533,21 @@ libspdm_return_t spdm_save_negotiated_state(void *spdm_context,
 libspdm_return_t spdm_clear_negotiated_state(void *spdm_context)
 {
     bool ret;
+    const char *peer_key;
 
-    if (m_save_state_file_name == NULL) {
-        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
-    }
+    peer_key = spdm_get_peer_state_key(spdm_context);
+    if (peer_key != NULL) {
+        printf("ClearState for %s\n", peer_key);
+        ret = spdm_nv_delete_state(peer_key);
+    } else {
+        if (m_save_state_file_name == NULL) {
+            return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+        }
 
-    printf("ClearState in %s\n", m_save_state_file_name);
+        printf("ClearState in %s\n", m_save_state_file_name);
 
-    ret = libspdm_write_output_file(m_save_state_file_name, NULL, 0);
+        ret = spdm_nv_write_file(m_save_state_file_name, NULL, 0);
+    }
     if (!ret) {
         printf("ClearState fail - write file error\n");
         return LIBSPDM_STATUS_UNSUPPORTED_CAP;
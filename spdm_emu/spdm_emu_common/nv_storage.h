@@ -34,6 +34,36 @@ typedef struct {
 } spdm_negotiated_state_struct_t;
 #pragma pack()
 
+/* Longest state store key, which is also the longest --peer_id.*/
+#define SPDM_STATE_STORE_MAX_KEY_SIZE 64
+
+extern char *m_state_store_file_name;
+extern char *m_peer_id;
+
+bool spdm_state_store_open(void);
+
+void spdm_state_store_close(void);
+
+bool spdm_state_store_get(const char *key, void *value, size_t value_size);
+
+bool spdm_state_store_put(const char *key, const void *value, size_t value_size);
+
+bool spdm_state_store_delete(const char *key);
+
+/* Writes of the negotiated state, deferred to a background thread once it is started.
+ * See nv_flusher.c.*/
+bool spdm_nv_flusher_start(void);
+
+void spdm_nv_flusher_stop(void);
+
+bool spdm_nv_write_file(const char *file_name, const void *data, size_t data_size);
+
+bool spdm_nv_put_state(const char *key, const void *value, size_t value_size);
+
+bool spdm_nv_delete_state(const char *key);
+
+bool spdm_nv_get_state(const char *key, void *value, size_t value_size);
+
 /**
  * privision the capability and algorithm for PKS version only case.
  */
@@ -46,6 +76,12 @@ libspdm_return_t spdm_provision_psk_version_only(void *spdm_context,
 libspdm_return_t spdm_load_negotiated_state(void *spdm_context,
                                             bool is_requester);
 
+/**
+ * Load the negotiated_state saved for a peer in the state store to an SPDM context.
+ */
+libspdm_return_t spdm_load_peer_negotiated_state(void *spdm_context,
+                                                 bool is_requester, const char *peer_id);
+
 /**
  * Save the negotiated_state to NV storage from an SPDM context.
  */
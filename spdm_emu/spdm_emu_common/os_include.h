@@ -32,6 +32,10 @@
 #pragma warning(default : 4115)
 #pragma warning(default : 4201)
 
+typedef HANDLE spdm_emu_thread_t;
+typedef CRITICAL_SECTION spdm_emu_mutex_t;
+typedef CONDITION_VARIABLE spdm_emu_cond_t;
+
 #else
 /* GCC*/
 #include "stdio.h"
@@ -39,11 +43,18 @@
 #include "unistd.h"
 #include "errno.h"
 #include "sys/socket.h"
+#include "sys/select.h"
+#include "sys/uio.h"
 #include "arpa/inet.h"
+#include "pthread.h"
 typedef int SOCKET;
 #define closesocket(x) close(x)
 #define INVALID_SOCKET (-1)
 #define SOCKET_ERROR (-1)
+
+typedef pthread_t spdm_emu_thread_t;
+typedef pthread_mutex_t spdm_emu_mutex_t;
+typedef pthread_cond_t spdm_emu_cond_t;
 #endif
 
 #endif
@@ -7,101 +7,1062 @@
 #include "spdm_emu.h"
 #include "industry_standard/pcap.h"
 #include "industry_standard/link_type_ex.h"
+#include "industry_standard/mctp.h"
 
 #define PCAP_PACKET_MAX_SIZE 0x00010000
 
+/* Packet records are copied into the ring on the request path and written to the file
+ * by the writer thread, either once half of the ring is used or every flush interval.*/
+#define PCAP_RING_SIZE 0x00400000
+#define PCAP_RING_FLUSH_THRESHOLD (PCAP_RING_SIZE / 2)
+#define PCAP_WRITER_FLUSH_INTERVAL_MS 100
+
+#ifndef LINKTYPE_RAW
+#define LINKTYPE_RAW 101
+#endif
+#ifndef LINKTYPE_USER0
+#define LINKTYPE_USER0 147
+#endif
+
+/* pcap-ng, see https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html */
+#define PCAPNG_BLOCK_TYPE_SHB 0x0A0D0D0A
+#define PCAPNG_BLOCK_TYPE_IDB 0x00000001
+#define PCAPNG_BLOCK_TYPE_EPB 0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPTION_END 0
+#define PCAPNG_OPTION_IF_NAME 2
+#define PCAPNG_OPTION_IF_TSRESOL 9
+#define PCAPNG_OPTION_EPB_FLAGS 2
+#define PCAPNG_EPB_FLAGS_INBOUND 0x1
+#define PCAPNG_EPB_FLAGS_OUTBOUND 0x2
+
+#pragma pack(1)
+typedef struct {
+    uint32_t block_type;
+    uint32_t block_total_length;
+    uint32_t byte_order_magic;
+    uint16_t major_version;
+    uint16_t minor_version;
+    int64_t section_length;
+} pcapng_section_header_block_t;
+
+typedef struct {
+    uint32_t block_type;
+    uint32_t block_total_length;
+    uint16_t link_type;
+    uint16_t reserved;
+    uint32_t snap_len;
+} pcapng_interface_description_block_t;
+
+typedef struct {
+    uint32_t block_type;
+    uint32_t block_total_length;
+    uint32_t interface_id;
+    uint32_t timestamp_high;
+    uint32_t timestamp_low;
+    uint32_t captured_length;
+    uint32_t original_length;
+} pcapng_enhanced_packet_block_t;
+
+typedef struct {
+    uint16_t code;
+    uint16_t length;
+} pcapng_option_header_t;
+
+/* Synthetic IPv4 + TCP header in front of the SPDM over TCP binding messages.*/
+typedef struct {
+    uint8_t version_ihl;
+    uint8_t tos;
+    uint16_t total_length;
+    uint16_t identification;
+    uint16_t flags_fragment_offset;
+    uint8_t ttl;
+    uint8_t protocol;
+    uint16_t checksum;
+    uint32_t source_address;
+    uint32_t destination_address;
+    uint16_t source_port;
+    uint16_t destination_port;
+    uint32_t sequence_number;
+    uint32_t acknowledgment_number;
+    uint8_t data_offset;
+    uint8_t tcp_flags;
+    uint16_t window;
+    uint16_t tcp_checksum;
+    uint16_t urgent_pointer;
+} pcap_ipv4_tcp_header_t;
+#pragma pack()
+
+#define PCAP_TCP_REQUESTER_PORT 0xC000
+#define PCAP_MCTP_REQUESTER_EID 0x08
+#define PCAP_MCTP_RESPONDER_EID 0x09
+
+/* The two interfaces of a pcap-ng file. The direction is relative to the SPDM roles.*/
+#define PCAP_INTERFACE_REQUESTER_TO_RESPONDER 0
+#define PCAP_INTERFACE_RESPONDER_TO_REQUESTER 1
+
+#define PCAP_LOCAL_ROLE_UNKNOWN 0
+#define PCAP_LOCAL_ROLE_REQUESTER 1
+#define PCAP_LOCAL_ROLE_RESPONDER 2
+
+/* Record prefix, written before the packet data: block header and transport header.*/
+#define PCAP_RECORD_PREFIX_MAX_SIZE \
+    (sizeof(pcapng_enhanced_packet_block_t) + sizeof(pcap_ipv4_tcp_header_t))
+/* Record suffix, written after the packet data: padding, options and block length.*/
+#define PCAP_RECORD_SUFFIX_MAX_SIZE \
+    (3 + sizeof(pcapng_option_header_t) + sizeof(uint32_t) + \
+     sizeof(pcapng_option_header_t) + sizeof(uint32_t))
+
+/* Start a new file once the current one reaches this size in bytes. 0 means never.*/
+uint64_t m_pcap_rotate_size;
+
 FILE *m_pcap_file;
+char *m_pcap_file_name;
+bool m_pcap_is_pcapng;
+uint32_t m_pcap_link_type;
+/* Number of the file being written, 0 is the file given by the user.*/
+uint32_t m_pcap_file_index;
+uint64_t m_pcap_file_header_size;
 
-bool open_pcap_packet_file(const char *pcap_file_name)
+/* Ring positions where the writer starts the next file. The producer decides them, as it
+ * is the one that knows where a record ends.*/
+#define PCAP_ROTATE_POINT_MAX 64
+uint64_t m_pcap_rotate_point[PCAP_ROTATE_POINT_MAX];
+uint32_t m_pcap_rotate_point_head;
+uint32_t m_pcap_rotate_point_tail;
+/* Size of the file the next record goes to, as seen by the producer.*/
+uint64_t m_pcap_producer_file_size;
+
+/* Synthesized state of one platform port connection. A concurrent server captures several
+ * connections in the same file, each one found by its socket.*/
+#define PCAP_STREAM_MAX 64
+typedef struct {
+    SOCKET socket;
+    bool in_use;
+    /* Set by the first packet, which is always a request.*/
+    uint8_t local_role;
+    uint32_t tcp_sequence[2];
+    /* m_pcap_stream_use_count at the last packet, the oldest stream is reused when all are.*/
+    uint64_t last_use;
+} pcap_stream_t;
+
+pcap_stream_t m_pcap_stream[PCAP_STREAM_MAX];
+uint64_t m_pcap_stream_use_count;
+
+bool m_pcap_lock_initialized;
+bool m_pcap_atexit_registered;
+spdm_emu_mutex_t m_pcap_lock;
+spdm_emu_cond_t m_pcap_writer_cond;
+spdm_emu_cond_t m_pcap_space_cond;
+spdm_emu_thread_t m_pcap_writer_thread;
+/* The writer thread exists and must be joined.*/
+bool m_pcap_writer_started;
+/* Packets are accepted.*/
+bool m_pcap_writer_running;
+bool m_pcap_writer_stop;
+
+uint8_t *m_pcap_ring;
+/* Total bytes copied into and written out of the ring. The used size is head - tail.*/
+uint64_t m_pcap_ring_head;
+uint64_t m_pcap_ring_tail;
+
+static size_t pcapng_append_option(uint8_t *buffer, uint16_t code,
+                                   const void *value, uint16_t length)
+{
+    pcapng_option_header_t option;
+    size_t size;
+
+    option.code = code;
+    option.length = length;
+    libspdm_copy_mem(buffer, sizeof(option), &option, sizeof(option));
+    size = sizeof(option);
+    if (length != 0) {
+        libspdm_copy_mem(buffer + size, length, value, length);
+        size += length;
+        while ((size % 4) != 0) {
+            buffer[size++] = 0;
+        }
+    }
+    return size;
+}
+
+static bool pcap_write_interface(FILE *file, const char *name)
+{
+    uint8_t block[128];
+    pcapng_interface_description_block_t idb;
+    uint8_t ts_resolution;
+    size_t size;
+    uint32_t total_length;
+
+    size = sizeof(idb);
+    size += pcapng_append_option(block + size, PCAPNG_OPTION_IF_NAME, name,
+                                 (uint16_t)strlen(name));
+    /* 10^-9, nanosecond timestamps*/
+    ts_resolution = 9;
+    size += pcapng_append_option(block + size, PCAPNG_OPTION_IF_TSRESOL, &ts_resolution,
+                                 sizeof(ts_resolution));
+    size += pcapng_append_option(block + size, PCAPNG_OPTION_END, NULL, 0);
+    total_length = (uint32_t)(size + sizeof(total_length));
+    libspdm_copy_mem(block + size, sizeof(block) - size, &total_length, sizeof(total_length));
+
+    idb.block_type = PCAPNG_BLOCK_TYPE_IDB;
+    idb.block_total_length = total_length;
+    idb.link_type = (uint16_t)m_pcap_link_type;
+    idb.reserved = 0;
+    idb.snap_len = PCAP_PACKET_MAX_SIZE;
+    libspdm_copy_mem(block, sizeof(block), &idb, sizeof(idb));
+
+    return fwrite(block, 1, total_length, file) == total_length;
+}
+
+/**
+ * Write the file header: the global header of a classic pcap file, or the section header
+ * and the two interface descriptions of a pcap-ng file.
+ **/
+static bool pcap_write_file_header(FILE *file)
 {
     pcap_global_header_t pcap_global_header;
+    pcapng_section_header_block_t shb;
+    uint32_t total_length;
 
-    if (pcap_file_name == NULL) {
+    if (!m_pcap_is_pcapng) {
+        pcap_global_header.magic_number = PCAP_GLOBAL_HEADER_MAGIC_NANO;
+        pcap_global_header.version_major = PCAP_GLOBAL_HEADER_VERSION_MAJOR;
+        pcap_global_header.version_minor = PCAP_GLOBAL_HEADER_VERSION_MINOR;
+        pcap_global_header.this_zone = 0;
+        pcap_global_header.sig_figs = 0;
+        pcap_global_header.snap_len = PCAP_PACKET_MAX_SIZE;
+        pcap_global_header.network = m_pcap_link_type;
+        return fwrite(&pcap_global_header, 1, sizeof(pcap_global_header), file) ==
+               sizeof(pcap_global_header);
+    }
+
+    total_length = sizeof(shb) + sizeof(total_length);
+    shb.block_type = PCAPNG_BLOCK_TYPE_SHB;
+    shb.block_total_length = total_length;
+    shb.byte_order_magic = PCAPNG_BYTE_ORDER_MAGIC;
+    shb.major_version = 1;
+    shb.minor_version = 0;
+    /* unknown, the section ends with the file*/
+    shb.section_length = -1;
+    if ((fwrite(&shb, 1, sizeof(shb), file) != sizeof(shb)) ||
+        (fwrite(&total_length, 1, sizeof(total_length), file) != sizeof(total_length))) {
         return false;
     }
 
-    pcap_global_header.magic_number = PCAP_GLOBAL_HEADER_MAGIC;
-    pcap_global_header.version_major = PCAP_GLOBAL_HEADER_VERSION_MAJOR;
-    pcap_global_header.version_minor = PCAP_GLOBAL_HEADER_VERSION_MINOR;
-    pcap_global_header.this_zone = 0;
-    pcap_global_header.sig_figs = 0;
-    pcap_global_header.snap_len = PCAP_PACKET_MAX_SIZE;
-    if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
-        pcap_global_header.network = LINKTYPE_MCTP;
-    } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
-        pcap_global_header.network = LINKTYPE_PCI_DOE;
+    /* Same order as PCAP_INTERFACE_REQUESTER_TO_RESPONDER and _RESPONDER_TO_REQUESTER*/
+    return pcap_write_interface(file, "requester-to-responder") &&
+           pcap_write_interface(file, "responder-to-requester");
+}
+
+/**
+ * Open the file with the given index. The index is inserted before the extension, so that
+ * "spdm.pcapng" is followed by "spdm.1.pcapng", "spdm.2.pcapng", ...
+ **/
+static FILE *pcap_open_file(uint32_t file_index)
+{
+    char file_name[512];
+    const char *extension;
+    size_t base_size;
+    FILE *file;
+
+    if (file_index == 0) {
+        snprintf(file_name, sizeof(file_name), "%s", m_pcap_file_name);
     } else {
+        extension = strrchr(m_pcap_file_name, '.');
+        if ((extension == NULL) || (strpbrk(extension, "/\\") != NULL)) {
+            extension = m_pcap_file_name + strlen(m_pcap_file_name);
+        }
+        base_size = (size_t)(extension - m_pcap_file_name);
+        snprintf(file_name, sizeof(file_name), "%.*s.%u%s", (int)base_size,
+                 m_pcap_file_name, file_index, extension);
+    }
+
+    if ((file = fopen(file_name, "wb")) == NULL) {
+        printf("!!!Unable to open pcap file %s!!!\n", file_name);
+        return NULL;
+    }
+    if (!pcap_write_file_header(file)) {
+        printf("!!!Write pcap file error!!!\n");
+        fclose(file);
+        return NULL;
+    }
+    m_pcap_file_header_size = (uint64_t)ftell(file);
+    return file;
+}
+
+static void pcap_ring_copy(const void *data, size_t size)
+{
+    size_t offset;
+    size_t first_size;
+
+    offset = (size_t)(m_pcap_ring_head % PCAP_RING_SIZE);
+    first_size = LIBSPDM_MIN(size, PCAP_RING_SIZE - offset);
+    libspdm_copy_mem(m_pcap_ring + offset, PCAP_RING_SIZE - offset, data, first_size);
+    if (first_size < size) {
+        libspdm_copy_mem(m_pcap_ring, PCAP_RING_SIZE,
+                         (const uint8_t *)data + first_size, size - first_size);
+    }
+    m_pcap_ring_head += size;
+}
+
+/**
+ * Drain the ring to the file, without holding the lock during the file IO.
+ **/
+static void pcap_writer_thread(void *context)
+{
+    uint64_t rotate_point[PCAP_ROTATE_POINT_MAX];
+    uint32_t rotate_point_count;
+    uint32_t rotate_point_index;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t end;
+    size_t offset;
+    size_t size;
+    bool stop;
+    bool result;
+    FILE *next_file;
+
+    spdm_emu_mutex_lock(&m_pcap_lock);
+    while (true) {
+        if ((m_pcap_ring_head - m_pcap_ring_tail < PCAP_RING_FLUSH_THRESHOLD) &&
+            !m_pcap_writer_stop) {
+            spdm_emu_cond_timed_wait(&m_pcap_writer_cond, &m_pcap_lock,
+                                     PCAP_WRITER_FLUSH_INTERVAL_MS);
+        }
+        head = m_pcap_ring_head;
+        tail = m_pcap_ring_tail;
+        stop = m_pcap_writer_stop;
+        rotate_point_count = m_pcap_rotate_point_head - m_pcap_rotate_point_tail;
+        for (rotate_point_index = 0; rotate_point_index < rotate_point_count;
+             rotate_point_index++) {
+            rotate_point[rotate_point_index] =
+                m_pcap_rotate_point[(m_pcap_rotate_point_tail + rotate_point_index) %
+                                    PCAP_ROTATE_POINT_MAX];
+        }
+        spdm_emu_mutex_unlock(&m_pcap_lock);
+
+        result = true;
+        rotate_point_index = 0;
+        while (result && (tail != head)) {
+            if ((rotate_point_index < rotate_point_count) &&
+                (rotate_point[rotate_point_index] == tail)) {
+                next_file = pcap_open_file(m_pcap_file_index + 1);
+                if (next_file == NULL) {
+                    result = false;
+                    break;
+                }
+                fclose(m_pcap_file);
+                m_pcap_file = next_file;
+                m_pcap_file_index++;
+                rotate_point_index++;
+            }
+            end = head;
+            if (rotate_point_index < rotate_point_count) {
+                end = rotate_point[rotate_point_index];
+            }
+            offset = (size_t)(tail % PCAP_RING_SIZE);
+            size = (size_t)LIBSPDM_MIN(end - tail, (uint64_t)(PCAP_RING_SIZE - offset));
+            if (fwrite(m_pcap_ring + offset, 1, size, m_pcap_file) != size) {
+                result = false;
+            }
+            tail += size;
+        }
+        if (result && (fflush(m_pcap_file) != 0)) {
+            result = false;
+        }
+
+        spdm_emu_mutex_lock(&m_pcap_lock);
+        m_pcap_ring_tail = head;
+        m_pcap_rotate_point_tail += rotate_point_count;
+        spdm_emu_cond_broadcast(&m_pcap_space_cond);
+        if (!result) {
+            printf("!!!Write pcap file error!!!\n");
+            m_pcap_writer_running = false;
+            break;
+        }
+        if (stop && (m_pcap_ring_head == m_pcap_ring_tail)) {
+            break;
+        }
+    }
+    spdm_emu_mutex_unlock(&m_pcap_lock);
+}
+
+/**
+ * Open the capture file. A file name ending with ".pcapng" selects the pcap-ng format,
+ * any other name the classic pcap format with nanosecond timestamps.
+ **/
+bool open_pcap_packet_file(const char *pcap_file_name)
+{
+    size_t name_size;
+
+    if (pcap_file_name == NULL) {
         return false;
     }
 
-    if ((m_pcap_file = fopen(pcap_file_name, "wb")) == NULL) {
-        printf("!!!Unable to open pcap file %s!!!\n", pcap_file_name);
+    switch (m_use_transport_layer) {
+    case SOCKET_TRANSPORT_TYPE_MCTP:
+        m_pcap_link_type = LINKTYPE_MCTP;
+        break;
+    case SOCKET_TRANSPORT_TYPE_PCI_DOE:
+        m_pcap_link_type = LINKTYPE_PCI_DOE;
+        break;
+    case SOCKET_TRANSPORT_TYPE_TCP:
+        m_pcap_link_type = LINKTYPE_RAW;
+        break;
+    case SOCKET_TRANSPORT_TYPE_NONE:
+        m_pcap_link_type = LINKTYPE_USER0;
+        break;
+    default:
         return false;
     }
 
-    if ((fwrite(&pcap_global_header, 1, sizeof(pcap_global_header),
-                m_pcap_file)) != sizeof(pcap_global_header)) {
-        printf("!!!Write pcap file error!!!\n");
-        close_pcap_packet_file();
+    name_size = strlen(pcap_file_name);
+    m_pcap_is_pcapng = (name_size >= sizeof(".pcapng") - 1) &&
+                       (strcmp(pcap_file_name + name_size - (sizeof(".pcapng") - 1),
+                               ".pcapng") == 0);
+    m_pcap_file_name = (char *)pcap_file_name;
+    m_pcap_file_index = 0;
+    libspdm_zero_mem(m_pcap_stream, sizeof(m_pcap_stream));
+
+    if (!m_pcap_lock_initialized) {
+        spdm_emu_mutex_init(&m_pcap_lock);
+        spdm_emu_cond_init(&m_pcap_writer_cond);
+        spdm_emu_cond_init(&m_pcap_space_cond);
+        m_pcap_lock_initialized = true;
+    }
+
+    m_pcap_file = pcap_open_file(m_pcap_file_index);
+    if (m_pcap_file == NULL) {
+        return false;
+    }
+
+    m_pcap_ring = (void *)malloc(PCAP_RING_SIZE);
+    if (m_pcap_ring == NULL) {
+        fclose(m_pcap_file);
+        m_pcap_file = NULL;
+        return false;
+    }
+    m_pcap_ring_head = 0;
+    m_pcap_ring_tail = 0;
+    m_pcap_rotate_point_head = 0;
+    m_pcap_rotate_point_tail = 0;
+    m_pcap_producer_file_size = m_pcap_file_header_size;
+    m_pcap_writer_stop = false;
+    m_pcap_writer_running = true;
+    if (!spdm_emu_thread_create(&m_pcap_writer_thread, pcap_writer_thread, NULL)) {
+        printf("!!!Unable to start pcap writer!!!\n");
+        m_pcap_writer_running = false;
+        free(m_pcap_ring);
+        m_pcap_ring = NULL;
+        fclose(m_pcap_file);
+        m_pcap_file = NULL;
         return false;
     }
+    m_pcap_writer_started = true;
+
+    /* Do not lose the buffered packets on an early exit path. Once is enough, as the handler
+     * closes whatever file is open at exit.*/
+    if (!m_pcap_atexit_registered) {
+        atexit(close_pcap_packet_file);
+        m_pcap_atexit_registered = true;
+    }
 
     return true;
 }
 
 void close_pcap_packet_file(void)
 {
-    if (m_pcap_file != NULL) {
-        fclose(m_pcap_file);
-        m_pcap_file = NULL;
+    if (!m_pcap_lock_initialized) {
+        return;
+    }
+    spdm_emu_mutex_lock(&m_pcap_lock);
+    if (!m_pcap_writer_started) {
+        spdm_emu_mutex_unlock(&m_pcap_lock);
+        return;
+    }
+    m_pcap_writer_started = false;
+    m_pcap_writer_running = false;
+    m_pcap_writer_stop = true;
+    spdm_emu_cond_signal(&m_pcap_writer_cond);
+    spdm_emu_cond_broadcast(&m_pcap_space_cond);
+    spdm_emu_mutex_unlock(&m_pcap_lock);
+
+    spdm_emu_thread_join(m_pcap_writer_thread);
+
+    fclose(m_pcap_file);
+    m_pcap_file = NULL;
+    free(m_pcap_ring);
+    m_pcap_ring = NULL;
+}
+
+/**
+ * Find the stream of a socket, or start a new one. Called with m_pcap_lock held.
+ **/
+static pcap_stream_t *pcap_get_stream(SOCKET socket)
+{
+    pcap_stream_t *stream;
+    uint32_t index;
+
+    stream = NULL;
+    for (index = 0; index < PCAP_STREAM_MAX; index++) {
+        if (m_pcap_stream[index].in_use && (m_pcap_stream[index].socket == socket)) {
+            stream = &m_pcap_stream[index];
+            break;
+        }
+        if ((stream == NULL) || (stream->in_use &&
+                                 (!m_pcap_stream[index].in_use ||
+                                  (m_pcap_stream[index].last_use < stream->last_use)))) {
+            stream = &m_pcap_stream[index];
+        }
+    }
+    if (!stream->in_use || (stream->socket != socket)) {
+        libspdm_zero_mem(stream, sizeof(*stream));
+        stream->socket = socket;
+        stream->in_use = true;
+        stream->local_role = PCAP_LOCAL_ROLE_UNKNOWN;
     }
+    stream->last_use = ++m_pcap_stream_use_count;
+    return stream;
 }
 
-void append_pcap_packet_data(const void *header, size_t header_size,
-                             const void *data, size_t size)
+/**
+ * Forget the synthesized state of a connection, before its socket is closed and reused.
+ **/
+void release_pcap_packet_stream(SOCKET socket)
+{
+    uint32_t index;
+
+    if (!m_pcap_lock_initialized) {
+        return;
+    }
+    spdm_emu_mutex_lock(&m_pcap_lock);
+    for (index = 0; index < PCAP_STREAM_MAX; index++) {
+        if (m_pcap_stream[index].in_use && (m_pcap_stream[index].socket == socket)) {
+            m_pcap_stream[index].in_use = false;
+        }
+    }
+    spdm_emu_mutex_unlock(&m_pcap_lock);
+}
+
+/**
+ * Build the transport header that the platform port does not carry.
+ * Each stream gets its own requester TCP port, so that the connections can be told apart.
+ *
+ * @return the size of the header in buffer.
+ **/
+static size_t pcap_build_transport_header(uint8_t *buffer, pcap_stream_t *stream,
+                                          uint32_t interface_id, size_t size)
+{
+    mctp_header_t mctp_header;
+    pcap_ipv4_tcp_header_t tcp_header;
+    uint16_t requester_port;
+    bool is_request;
+    uint32_t checksum;
+    const uint16_t *word;
+    size_t index;
+
+    is_request = (interface_id == PCAP_INTERFACE_REQUESTER_TO_RESPONDER);
+
+    switch (m_use_transport_layer) {
+    case SOCKET_TRANSPORT_TYPE_MCTP:
+        mctp_header.header_version = 1;
+        mctp_header.destination_id =
+            is_request ? PCAP_MCTP_RESPONDER_EID : PCAP_MCTP_REQUESTER_EID;
+        mctp_header.source_id = is_request ? PCAP_MCTP_REQUESTER_EID : PCAP_MCTP_RESPONDER_EID;
+        /* SOM | EOM, with tag owner set in the request*/
+        mctp_header.message_tag = is_request ? 0xC8 : 0xC0;
+        libspdm_copy_mem(buffer, sizeof(mctp_header), &mctp_header, sizeof(mctp_header));
+        return sizeof(mctp_header);
+
+    case SOCKET_TRANSPORT_TYPE_TCP:
+        requester_port = (uint16_t)(PCAP_TCP_REQUESTER_PORT + (stream - m_pcap_stream));
+        libspdm_zero_mem(&tcp_header, sizeof(tcp_header));
+        tcp_header.version_ihl = 0x45;
+        tcp_header.total_length = htons((uint16_t)(sizeof(tcp_header) + size));
+        tcp_header.flags_fragment_offset = htons(0x4000);
+        tcp_header.ttl = 64;
+        tcp_header.protocol = 6;
+        tcp_header.source_address = htonl(0x7F000001);
+        tcp_header.destination_address = htonl(0x7F000001);
+        tcp_header.source_port = htons(is_request ? requester_port : TCP_SPDM_PLATFORM_PORT);
+        tcp_header.destination_port = htons(is_request ? TCP_SPDM_PLATFORM_PORT : requester_port);
+        tcp_header.sequence_number = htonl(stream->tcp_sequence[interface_id]);
+        tcp_header.acknowledgment_number = htonl(stream->tcp_sequence[1 - interface_id]);
+        stream->tcp_sequence[interface_id] += (uint32_t)size;
+        tcp_header.data_offset = 0x50;
+        /* PSH | ACK*/
+        tcp_header.tcp_flags = 0x18;
+        tcp_header.window = htons(0xFFFF);
+        /* The TCP checksum stays 0, it would need a pass over the whole payload.*/
+        checksum = 0;
+        word = (const uint16_t *)&tcp_header;
+        for (index = 0; index < 10; index++) {
+            checksum += word[index];
+        }
+        checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        checksum = (checksum & 0xFFFF) + (checksum >> 16);
+        tcp_header.checksum = (uint16_t)~checksum;
+        libspdm_copy_mem(buffer, sizeof(tcp_header), &tcp_header, sizeof(tcp_header));
+        return sizeof(tcp_header);
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Capture one platform port message.
+ *
+ * @param  socket                        The platform port connection of the message.
+ * @param  is_send                       true if this side sends the message, false if it receives it.
+ * @param  data                          The message as carried by the platform port.
+ * @param  size                          The size of the message.
+ **/
+void append_pcap_packet_data(SOCKET socket, bool is_send, const void *data, size_t size)
 {
+    pcap_stream_t *stream;
+    uint8_t prefix[PCAP_RECORD_PREFIX_MAX_SIZE];
+    uint8_t suffix[PCAP_RECORD_SUFFIX_MAX_SIZE];
     pcap_packet_header_t pcap_packet_header;
+    pcapng_enhanced_packet_block_t epb;
+    uint64_t timestamp;
+    uint32_t interface_id;
+    uint32_t epb_flags;
+    size_t prefix_size;
+    size_t suffix_size;
+    size_t header_size;
     size_t total_size;
+    size_t captured_size;
+    size_t record_size;
+    uint32_t block_total_length;
+    bool rotate;
 
-    total_size = header_size + size;
+    if (!m_pcap_lock_initialized) {
+        return;
+    }
 
-    if (m_pcap_file != NULL) {
-        time_t rawtime;
-        time(&rawtime);
+    timestamp = spdm_emu_get_wall_clock_ns();
 
-        pcap_packet_header.ts_sec = (uint32_t)rawtime;
-        pcap_packet_header.ts_usec = 0;
+    spdm_emu_mutex_lock(&m_pcap_lock);
+    if (!m_pcap_writer_running) {
+        spdm_emu_mutex_unlock(&m_pcap_lock);
+        return;
+    }
 
-        pcap_packet_header.incl_len =
-            (uint32_t)((total_size > PCAP_PACKET_MAX_SIZE) ?
-                       PCAP_PACKET_MAX_SIZE :
-                       total_size);
+    stream = pcap_get_stream(socket);
+    if (stream->local_role == PCAP_LOCAL_ROLE_UNKNOWN) {
+        stream->local_role = is_send ? PCAP_LOCAL_ROLE_REQUESTER : PCAP_LOCAL_ROLE_RESPONDER;
+    }
+    if (is_send == (stream->local_role == PCAP_LOCAL_ROLE_REQUESTER)) {
+        interface_id = PCAP_INTERFACE_REQUESTER_TO_RESPONDER;
+    } else {
+        interface_id = PCAP_INTERFACE_RESPONDER_TO_REQUESTER;
+    }
+
+    prefix_size = m_pcap_is_pcapng ? sizeof(epb) : sizeof(pcap_packet_header);
+    header_size = pcap_build_transport_header(prefix + prefix_size, stream, interface_id,
+                                              size);
+    prefix_size += header_size;
+    total_size = header_size + size;
+    captured_size = LIBSPDM_MIN(total_size, PCAP_PACKET_MAX_SIZE);
+    size = captured_size - header_size;
+
+    suffix_size = 0;
+    if (m_pcap_is_pcapng) {
+        while (((captured_size + suffix_size) % 4) != 0) {
+            suffix[suffix_size++] = 0;
+        }
+        epb_flags = is_send ? PCAPNG_EPB_FLAGS_OUTBOUND : PCAPNG_EPB_FLAGS_INBOUND;
+        suffix_size += pcapng_append_option(suffix + suffix_size, PCAPNG_OPTION_EPB_FLAGS,
+                                            &epb_flags, sizeof(epb_flags));
+        suffix_size += pcapng_append_option(suffix + suffix_size, PCAPNG_OPTION_END, NULL, 0);
+        block_total_length =
+            (uint32_t)(sizeof(epb) + captured_size + suffix_size + sizeof(block_total_length));
+        libspdm_copy_mem(suffix + suffix_size, sizeof(suffix) - suffix_size,
+                         &block_total_length, sizeof(block_total_length));
+        suffix_size += sizeof(block_total_length);
+
+        epb.block_type = PCAPNG_BLOCK_TYPE_EPB;
+        epb.block_total_length = block_total_length;
+        epb.interface_id = interface_id;
+        epb.timestamp_high = (uint32_t)(timestamp >> 32);
+        epb.timestamp_low = (uint32_t)timestamp;
+        epb.captured_length = (uint32_t)captured_size;
+        epb.original_length = (uint32_t)total_size;
+        libspdm_copy_mem(prefix, sizeof(prefix), &epb, sizeof(epb));
+    } else {
+        pcap_packet_header.ts_sec = (uint32_t)(timestamp / 1000000000);
+        /* nanoseconds, as announced by PCAP_GLOBAL_HEADER_MAGIC_NANO*/
+        pcap_packet_header.ts_usec = (uint32_t)(timestamp % 1000000000);
+        pcap_packet_header.incl_len = (uint32_t)captured_size;
         pcap_packet_header.orig_len = (uint32_t)total_size;
+        libspdm_copy_mem(prefix, sizeof(prefix), &pcap_packet_header,
+                         sizeof(pcap_packet_header));
+    }
 
-        if ((fwrite(&pcap_packet_header, 1, sizeof(pcap_packet_header),
-                    m_pcap_file)) != sizeof(pcap_packet_header)) {
-            printf("!!!Write pcap file error!!!\n");
-            close_pcap_packet_file();
+    /* Only wait if the writer fell behind by a whole ring, or by so many small files that
+     * no rotate point is left.*/
+    record_size = prefix_size + size + suffix_size;
+    while (true) {
+        rotate = (m_pcap_rotate_size != 0) &&
+                 (m_pcap_producer_file_size > m_pcap_file_header_size) &&
+                 (m_pcap_producer_file_size + record_size > m_pcap_rotate_size);
+        if (!m_pcap_writer_running ||
+            ((PCAP_RING_SIZE - (m_pcap_ring_head - m_pcap_ring_tail) >= record_size) &&
+             (!rotate ||
+              (m_pcap_rotate_point_head - m_pcap_rotate_point_tail < PCAP_ROTATE_POINT_MAX)))) {
+            break;
+        }
+        spdm_emu_cond_signal(&m_pcap_writer_cond);
+        spdm_emu_cond_wait(&m_pcap_space_cond, &m_pcap_lock);
+    }
+    if (!m_pcap_writer_running) {
+        spdm_emu_mutex_unlock(&m_pcap_lock);
+        return;
+    }
+
+    if (rotate) {
+        m_pcap_rotate_point[m_pcap_rotate_point_head % PCAP_ROTATE_POINT_MAX] =
+            m_pcap_ring_head;
+        m_pcap_rotate_point_head++;
+        m_pcap_producer_file_size = m_pcap_file_header_size;
+    }
+    m_pcap_producer_file_size += record_size;
+
+    pcap_ring_copy(prefix, prefix_size);
+    if (size != 0) {
+        pcap_ring_copy(data, size);
+    }
+    if (suffix_size != 0) {
+        pcap_ring_copy(suffix, suffix_size);
+    }
+
+    if (m_pcap_ring_head - m_pcap_ring_tail >= PCAP_RING_FLUSH_THRESHOLD) {
+        spdm_emu_cond_signal(&m_pcap_writer_cond);
+    }
+    spdm_emu_mutex_unlock(&m_pcap_lock);
+}
+
+static uint16_t pcap_read_uint16(const uint8_t *buffer, bool swap)
+{
+    uint16_t value;
+
+    libspdm_copy_mem(&value, sizeof(value), buffer, sizeof(value));
+    return swap ? (uint16_t)((value >> 8) | (value << 8)) : value;
+}
+
+static uint32_t pcap_read_uint32(const uint8_t *buffer, bool swap)
+{
+    uint32_t value;
+
+    libspdm_copy_mem(&value, sizeof(value), buffer, sizeof(value));
+    if (swap) {
+        value = (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) |
+                (value << 24);
+    }
+    return value;
+}
+
+static bool pcap_get_transport_from_link_type(uint32_t link_type, uint32_t *transport_layer)
+{
+    switch (link_type) {
+    case LINKTYPE_MCTP:
+        *transport_layer = SOCKET_TRANSPORT_TYPE_MCTP;
+        return true;
+    case LINKTYPE_PCI_DOE:
+        *transport_layer = SOCKET_TRANSPORT_TYPE_PCI_DOE;
+        return true;
+    case LINKTYPE_RAW:
+        *transport_layer = SOCKET_TRANSPORT_TYPE_TCP;
+        return true;
+    case LINKTYPE_USER0:
+        *transport_layer = SOCKET_TRANSPORT_TYPE_NONE;
+        return true;
+    default:
+        printf("!!!Unsupported pcap link type %u!!!\n", link_type);
+        return false;
+    }
+}
+
+/**
+ * Remove the transport header added by pcap_build_transport_header and tell the direction.
+ * The direction comes from the interface in pcap-ng. In classic pcap it comes from the
+ * addresses of the transport header if they differ, or else from the request/response order.
+ **/
+static void pcap_strip_transport_header(uint32_t transport_layer,
+                                        pcap_packet_record_t *record,
+                                        bool *direction_known)
+{
+    mctp_header_t mctp_header;
+    size_t header_size;
+    uint16_t source_port;
+
+    switch (transport_layer) {
+    case SOCKET_TRANSPORT_TYPE_MCTP:
+        if (record->size < sizeof(mctp_header)) {
             return;
         }
+        libspdm_copy_mem(&mctp_header, sizeof(mctp_header), record->data, sizeof(mctp_header));
+        if (!*direction_known && (mctp_header.source_id != mctp_header.destination_id)) {
+            record->is_request = (mctp_header.source_id == PCAP_MCTP_REQUESTER_EID);
+            *direction_known = true;
+        }
+        header_size = sizeof(mctp_header);
+        break;
 
-        if (total_size > PCAP_PACKET_MAX_SIZE) {
-            total_size = PCAP_PACKET_MAX_SIZE;
+    case SOCKET_TRANSPORT_TYPE_TCP:
+        /* IPv4 header length, then TCP data offset, both in 32 bit words*/
+        if ((record->size < sizeof(pcap_ipv4_tcp_header_t)) || ((record->data[0] >> 4) != 4)) {
+            return;
+        }
+        header_size = (size_t)(record->data[0] & 0xF) * 4;
+        if (record->size < header_size + 20) {
+            return;
+        }
+        source_port = pcap_read_uint16(record->data + header_size, false);
+        if (!*direction_known) {
+            record->is_request = (ntohs(source_port) != TCP_SPDM_PLATFORM_PORT);
+            *direction_known = true;
+        }
+        header_size += (size_t)(record->data[header_size + 12] >> 4) * 4;
+        if (record->size < header_size) {
+            return;
         }
+        break;
+
+    default:
+        return;
+    }
+
+    record->data += header_size;
+    record->size -= header_size;
+}
 
-        if (header_size != 0) {
-            if ((fwrite(header, 1, header_size, m_pcap_file)) !=
-                header_size) {
-                printf("!!!Write pcap file error!!!\n");
-                close_pcap_packet_file();
-                return;
+/**
+ * Read a capture file and report each packet as carried by the platform port.
+ * Both the classic pcap format, with micro or nanosecond timestamps, and pcap-ng are read.
+ *
+ * @param  pcap_file_name                The capture file.
+ * @param  transport_layer               Return the transport of the capture, one of SOCKET_TRANSPORT_TYPE_*.
+ * @param  record_func                   Called for each packet, in file order. The record is only
+ *                                       valid during the call. Returning false stops the reading
+ *                                       and fails it.
+ * @param  context                       Passed to record_func.
+ *
+ * @retval true  The file is read.
+ * @retval false The file cannot be read, is not a supported capture or record_func failed.
+ **/
+bool read_pcap_packet_file(const char *pcap_file_name, uint32_t *transport_layer,
+                           pcap_packet_record_func_t record_func, void *context)
+{
+    spdm_emu_file_view_t *file_view;
+    const uint8_t *file_data;
+    size_t file_size;
+    size_t offset;
+    uint32_t magic_number;
+    bool swap;
+    bool nano;
+    bool result;
+    bool transport_known;
+    bool direction_known;
+    bool next_is_request;
+    uint32_t block_type;
+    uint32_t block_total_length;
+    uint32_t interface_id;
+    uint32_t interface_count;
+    uint64_t interface_ts_unit_ns[2];
+    size_t option_offset;
+    uint16_t option_code;
+    uint16_t option_length;
+    uint8_t ts_resolution;
+    uint64_t timestamp;
+    uint32_t captured_length;
+    uint32_t original_length;
+    pcap_packet_record_t record;
+
+    /* A capture can be large, parse it in place.*/
+    file_view = spdm_emu_map_input_file(pcap_file_name, (const void **)&file_data, &file_size);
+    if (file_view == NULL) {
+        return false;
+    }
+
+    result = false;
+    transport_known = false;
+    next_is_request = true;
+    interface_count = 0;
+    if (file_size < sizeof(pcap_global_header_t)) {
+        printf("!!!%s is not a pcap file!!!\n", pcap_file_name);
+        goto done;
+    }
+
+    magic_number = pcap_read_uint32(file_data, false);
+    if (magic_number != PCAPNG_BLOCK_TYPE_SHB) {
+        switch (magic_number) {
+        case PCAP_GLOBAL_HEADER_MAGIC:
+        case PCAP_GLOBAL_HEADER_MAGIC_NANO:
+            swap = false;
+            break;
+        case PCAP_GLOBAL_HEADER_MAGIC_SWAPPED:
+        case PCAP_GLOBAL_HEADER_MAGIC_NANO_SWAPPED:
+            swap = true;
+            break;
+        default:
+            printf("!!!%s is not a pcap file!!!\n", pcap_file_name);
+            goto done;
+        }
+        nano = (magic_number == PCAP_GLOBAL_HEADER_MAGIC_NANO) ||
+               (magic_number == PCAP_GLOBAL_HEADER_MAGIC_NANO_SWAPPED);
+        if (!pcap_get_transport_from_link_type(
+                pcap_read_uint32(file_data + OFFSET_OF(pcap_global_header_t, network), swap),
+                transport_layer)) {
+            goto done;
+        }
+        transport_known = true;
+
+        offset = sizeof(pcap_global_header_t);
+        while (offset + sizeof(pcap_packet_header_t) <= file_size) {
+            captured_length = pcap_read_uint32(
+                file_data + offset + OFFSET_OF(pcap_packet_header_t, incl_len), swap);
+            original_length = pcap_read_uint32(
+                file_data + offset + OFFSET_OF(pcap_packet_header_t, orig_len), swap);
+            if (captured_length > file_size - offset - sizeof(pcap_packet_header_t)) {
+                printf("!!!%s is truncated!!!\n", pcap_file_name);
+                break;
+            }
+            timestamp = (uint64_t)pcap_read_uint32(
+                file_data + offset + OFFSET_OF(pcap_packet_header_t, ts_sec), swap) * 1000000000;
+            timestamp += (uint64_t)pcap_read_uint32(
+                file_data + offset + OFFSET_OF(pcap_packet_header_t, ts_usec), swap) *
+                         (nano ? 1 : 1000);
+
+            record.timestamp = timestamp;
+            record.is_request = next_is_request;
+            record.is_truncated = (captured_length < original_length);
+            record.data = file_data + offset + sizeof(pcap_packet_header_t);
+            record.size = captured_length;
+            direction_known = false;
+            pcap_strip_transport_header(*transport_layer, &record, &direction_known);
+            next_is_request = !record.is_request;
+
+            offset += sizeof(pcap_packet_header_t) + captured_length;
+            if (!record_func(context, &record)) {
+                goto done;
             }
         }
+        result = true;
+        goto done;
+    }
 
-        if ((fwrite(data, 1, size, m_pcap_file)) != size) {
-            printf("!!!Write pcap file error!!!\n");
-            close_pcap_packet_file();
-            return;
+    swap = false;
+    offset = 0;
+    while (offset + 3 * sizeof(uint32_t) <= file_size) {
+        block_type = pcap_read_uint32(file_data + offset, swap);
+        if (block_type == PCAPNG_BLOCK_TYPE_SHB) {
+            /* Each section may use its own byte order and interfaces.*/
+            swap = (pcap_read_uint32(file_data + offset + 8, false) != PCAPNG_BYTE_ORDER_MAGIC);
+            interface_count = 0;
+        }
+        block_total_length = pcap_read_uint32(file_data + offset + 4, swap);
+        if ((block_total_length < 3 * sizeof(uint32_t)) || ((block_total_length % 4) != 0) ||
+            (block_total_length > file_size - offset)) {
+            printf("!!!%s is truncated!!!\n", pcap_file_name);
+            break;
         }
+
+        switch (block_type) {
+        case PCAPNG_BLOCK_TYPE_IDB:
+            if (block_total_length < sizeof(pcapng_interface_description_block_t) +
+                sizeof(uint32_t)) {
+                break;
+            }
+            if (!pcap_get_transport_from_link_type(
+                    pcap_read_uint16(file_data + offset +
+                                     OFFSET_OF(pcapng_interface_description_block_t,
+                                               link_type), swap),
+                    transport_layer)) {
+                goto done;
+            }
+            transport_known = true;
+            if (interface_count >= LIBSPDM_ARRAY_SIZE(interface_ts_unit_ns)) {
+                break;
+            }
+            /* microseconds, unless if_tsresol says otherwise*/
+            interface_ts_unit_ns[interface_count] = 1000;
+            option_offset = offset + sizeof(pcapng_interface_description_block_t);
+            while (option_offset + sizeof(pcapng_option_header_t) <=
+                   offset + block_total_length - sizeof(uint32_t)) {
+                option_code = pcap_read_uint16(file_data + option_offset, swap);
+                option_length = pcap_read_uint16(file_data + option_offset + 2, swap);
+                if (option_code == PCAPNG_OPTION_END) {
+                    break;
+                }
+                if ((option_code == PCAPNG_OPTION_IF_TSRESOL) && (option_length == 1)) {
+                    ts_resolution = file_data[option_offset + sizeof(pcapng_option_header_t)];
+                    /* Only decimal resolutions down to 1ns are expected here.*/
+                    if ((ts_resolution & 0x80) == 0 && ts_resolution <= 9) {
+                        interface_ts_unit_ns[interface_count] = 1;
+                        while (ts_resolution++ < 9) {
+                            interface_ts_unit_ns[interface_count] *= 10;
+                        }
+                    }
+                }
+                option_offset += sizeof(pcapng_option_header_t) + ((option_length + 3) & ~3);
+            }
+            interface_count++;
+            break;
+
+        case PCAPNG_BLOCK_TYPE_EPB:
+            if (block_total_length < sizeof(pcapng_enhanced_packet_block_t) +
+                sizeof(uint32_t)) {
+                break;
+            }
+            interface_id = pcap_read_uint32(
+                file_data + offset + OFFSET_OF(pcapng_enhanced_packet_block_t, interface_id),
+                swap);
+            captured_length = pcap_read_uint32(
+                file_data + offset +
+                OFFSET_OF(pcapng_enhanced_packet_block_t, captured_length), swap);
+            original_length = pcap_read_uint32(
+                file_data + offset +
+                OFFSET_OF(pcapng_enhanced_packet_block_t, original_length), swap);
+            if ((interface_id >= interface_count) ||
+                (captured_length > block_total_length -
+                 sizeof(pcapng_enhanced_packet_block_t) - sizeof(uint32_t))) {
+                printf("!!!%s has an invalid packet block!!!\n", pcap_file_name);
+                goto done;
+            }
+            timestamp = ((uint64_t)pcap_read_uint32(
+                             file_data + offset +
+                             OFFSET_OF(pcapng_enhanced_packet_block_t, timestamp_high),
+                             swap) << 32) |
+                        pcap_read_uint32(
+                file_data + offset + OFFSET_OF(pcapng_enhanced_packet_block_t, timestamp_low),
+                swap);
+
+            record.timestamp = timestamp * interface_ts_unit_ns[interface_id];
+            record.is_request = (interface_id == PCAP_INTERFACE_REQUESTER_TO_RESPONDER);
+            record.is_truncated = (captured_length < original_length);
+            record.data = file_data + offset + sizeof(pcapng_enhanced_packet_block_t);
+            record.size = captured_length;
+            direction_known = true;
+            pcap_strip_transport_header(*transport_layer, &record, &direction_known);
+            if (!record_func(context, &record)) {
+                goto done;
+            }
+            break;
+
+        default:
+            break;
+        }
+        offset += block_total_length;
+    }
+    result = transport_known;
+    if (!transport_known) {
+        printf("!!!%s has no interface description!!!\n", pcap_file_name);
     }
+
+done:
+    spdm_emu_release_file_view(file_view);
+    return result;
 }
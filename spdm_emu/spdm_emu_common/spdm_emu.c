@@ -12,6 +12,39 @@
  */
 uint32_t m_exe_mode = EXE_MODE_SHUTDOWN;
 
+uint32_t m_max_connection_count = 1;
+
+uint32_t m_dhe_pool_depth = 0;
+uint32_t m_dhe_pool_thread_count = 1;
+
+char *m_meas_manifest_file_name = NULL;
+uint32_t m_meas_hash_thread_count = 0;
+
+char *m_peer_cert_cache_dir = NULL;
+uint32_t m_trust_cache_ttl = 0;
+char *m_trust_revoke_file_name = NULL;
+char *m_inventory_file_name = NULL;
+uint32_t m_inventory_worker_count = 0;
+char *m_evidence_store_dir = NULL;
+char *m_evidence_query = NULL;
+
+/* Requester loop mode. The flows run m_loop_iteration_count times or for m_loop_duration
+ * seconds on each of m_loop_concurrency connections. 0 means no limit of this kind.*/
+uint32_t m_loop_iteration_count = 0;
+uint32_t m_loop_duration = 0;
+uint32_t m_loop_concurrency = 1;
+
+/* Read the certificate chains and keys at startup instead of on first use.*/
+bool m_cert_cache_warm = false;
+
+uint32_t m_fsync_policy = SPDM_EMU_FSYNC_NONE;
+
+/* How long init_client keeps retrying a refused connection, in milliseconds. 0 means one attempt.*/
+uint32_t m_connect_retry_ms = 0;
+/* 0 selects the default port of the transport.*/
+uint16_t m_platform_port = 0;
+#define CONNECT_RETRY_INTERVAL_US 20000
+
 uint32_t m_exe_connection = (0 |
                              /* EXE_CONNECTION_VERSION_ONLY |*/
                              EXE_CONNECTION_DIGEST | EXE_CONNECTION_CERT |
@@ -37,6 +70,7 @@ void print_usage(const char *name)
 {
     printf("\n%s [--trans MCTP|PCI_DOE|TCP|NONE]\n", name);
     printf("   [--tcp_sub HS|NO_HS]\n");
+    printf("   [--port <number>]\n");
     printf("   [--ver 1.0|1.1|1.2]\n");
     printf("   [--sec_ver 1.0|1.1]\n");
     printf(
@@ -65,16 +99,39 @@ void print_usage(const char *name)
     printf("   [--slot_count <1~8>]\n");
     printf("   [--save_state <NegotiateStateFileName>]\n");
     printf("   [--load_state <NegotiateStateFileName>]\n");
+    printf("   [--state_store <StateStoreFileName>]\n");
+    printf("   [--peer_id <name>]\n");
+    printf("   [--fsync NONE|DATA|FULL]\n");
     printf("   [--exe_mode SHUTDOWN|CONTINUE]\n");
     printf("   [--exe_conn VER_ONLY|DIGEST|CERT|CHAL|MEAS|GET_CSR|SET_CERT]\n");
     printf("   [--exe_session KEY_EX|PSK|NO_END|KEY_UPDATE|HEARTBEAT|MEAS|DIGEST|CERT|GET_CSR|SET_CERT|APP]\n");
     printf("   [--pcap <pcap_file_name>]\n");
+    printf("   [--pcap_rotate <size_in_MB>]\n");
     printf("   [--priv_key_mode PEM|RAW]\n");
+    printf("   [--max_conn <number>]\n");
+    printf("   [--dhe_pool <depth>]\n");
+    printf("   [--dhe_pool_threads <number>]\n");
+    printf("   [--meas_manifest <MEASUREMENT_MANIFEST_FILE>]\n");
+    printf("   [--meas_threads <number>]\n");
+    printf("   [--peer_cert_cache <DIR>]\n");
+    printf("   [--trust_cache_ttl <seconds>]\n");
+    printf("   [--trust_revoke <FILE>]\n");
+    printf("   [--inventory <FILE>]\n");
+    printf("   [--inventory_workers <number>]\n");
+    printf("   [--evidence_store <DIR>]\n");
+    printf("   [--evidence_query <DEVICE>[@<time>]]\n");
+    printf("   [--iterations <number>]\n");
+    printf("   [--duration <seconds>]\n");
+    printf("   [--concurrency <number>]\n");
+    printf("   [--cert_cache LAZY|WARM]\n");
+    printf("   [--log_level ERROR|INFO|DEBUG|VERBOSE]\n");
     printf("\n");
     printf("NOTE:\n");
     printf("   [--trans] is used to select transport layer message. By default, MCTP is used.\n");
     printf(
         "   [--tcp_sub] is sub-option when transport layer is TCP. By default, NO-HANDSHAKE is used.\n");
+    printf(
+        "   [--port] is the platform port the responder listens on and the requester connects to. By default, 4194 is used for TCP and 2323 for the others.\n");
     printf("   [--ver] is version. By default, all are used.\n");
     printf(
         "   [--sec_ver] is secured message version. By default, all are used.\n");
@@ -141,6 +198,24 @@ void print_usage(const char *name)
         "           The command line input - ver|cap|hash|meas_spec|meas_hash|asym|req_asym|dhe|aead|key_schedule|other_param are ignored.\n");
     printf(
         "           The requester will skip GET_VERSION/GET_CAPABILLITIES/NEGOTIATE_ALGORITHMS.\n");
+    printf(
+        "   [--state_store] is the responder store of the negotiated state of each requester, keyed by the requester --peer_id.\n");
+    printf(
+        "           The state is saved and cleared as with --save_state. It is loaded when the requester connects,\n");
+    printf(
+        "           so that a requester using --load_state with its own state can skip GET_VERSION/GET_CAPABILLITIES/NEGOTIATE_ALGORITHMS.\n");
+    printf(
+        "           The file is an append-only log, compacted when more than half of it is stale.\n");
+    printf(
+        "   [--peer_id] is the requester identifier sent to the responder when connecting, up to 64 characters. By default, there is none.\n");
+    printf(
+        "   [--fsync] is when the saved state reaches the disk. By default, NONE is used.\n");
+    printf(
+        "           A state file is written to a temporary file that replaces it, so a crash never leaves a truncated file.\n");
+    printf(
+        "           NONE leaves the data to the OS cache. DATA syncs each state file and state store record when it is written,\n");
+    printf(
+        "           FULL also syncs the directory after a file is replaced. The responder saves the state in a background thread.\n");
     printf("   [--exe_mode] is used to control the execution mode. By default, it is SHUTDOWN.\n");
     printf("           SHUTDOWN means the requester asks the responder to stop.\n");
     printf(
@@ -173,8 +248,91 @@ void print_usage(const char *name)
     printf("           SET_CERT means send SET_CERTIFICATE command in session.\n");
     printf("           APP means send vendor defined message or application message in session.\n");
     printf("   [--pcap] is used to generate PCAP dump file for offline analysis.\n");
+    printf(
+        "           A file name ending with .pcapng selects pcap-ng, with one interface per direction. Otherwise pcap is used.\n");
+    printf(
+        "           All transports are captured. TCP is wrapped in IPv4/TCP on port 4194, NONE uses link type USER0 (147).\n");
+    printf(
+        "   [--pcap_rotate] is used to start a new PCAP file when the current one reaches the size. By default, there is no limit.\n");
+    printf(
+        "           The files are named <name>.1.<ext>, <name>.2.<ext>, ...\n");
     printf(
         "   [--priv_key_mode] is uesed to confirm private key mode with LIBSPDM_PRIVATE_KEY_USE_PEM.\n");
+    printf(
+        "   [--max_conn] is the maximum number of requester connections served at the same time by the responder. By default, 1 is used.\n");
+    printf(
+        "           A value larger than 1 serves each accepted connection in its own thread with its own SPDM context.\n");
+    printf(
+        "           SHUTDOWN from any requester stops accepting new connections and the responder exits when the active ones are done.\n");
+    printf(
+        "           Use --exe_mode CONTINUE in the requesters to keep the responder running.\n");
+    printf(
+        "   [--dhe_pool] is the number of DHE key pairs the responder generates ahead of KEY_EXCHANGE for each --dhe group. By default, 0 is used.\n");
+    printf(
+        "           --dhe_pool_threads threads, 1 by default, refill the pools in the background. SM2_P256 is not pooled.\n");
+    printf(
+        "           When a pool is empty, the key pair is generated inline. The hits and misses of each pool are printed when the responder stops.\n");
+    printf(
+        "   [--meas_manifest] is a file of \"<index> <type> <LINEAR|TREE> <file>\" lines. The responder measurements are the digests of these files.\n");
+    printf(
+        "           type is IMMUTABLE_ROM, MUTABLE_FIRMWARE, HARDWARE_CONFIG or FIRMWARE_CONFIG. index is 1 to 252.\n");
+    printf(
+        "           A LINEAR file is hashed as a whole. A TREE file is hashed in 1MiB chunks by --meas_threads threads, and its digest is the hash of the chunk digests.\n");
+    printf(
+        "           --meas_threads is the CPU count by default. A digest is computed again when the file changes.\n");
+    printf(
+        "           The measurements are digests only, --meas_hash RAW_BIT is not supported with --meas_manifest.\n");
+    printf(
+        "           The manifest is rejected if the measurement blocks of all its images do not fit in one measurement record.\n");
+    printf(
+        "   [--peer_cert_cache] is the requester directory of the responder certificate chains, one file per slot, hash algorithm, root certificates and chain digest.\n");
+    printf(
+        "           When GET_DIGESTS returns the digest of a cached chain, the chain is provisioned and GET_CERTIFICATE is skipped.\n");
+    printf(
+        "           A cached chain is verified against the root certificates first. Without a root certificate, the cache is not used.\n");
+    printf(
+        "   [--trust_cache_ttl] is how long, in seconds, the requester remembers a verified link of a peer certificate chain. By default 0, no cache.\n");
+    printf(
+        "           A link is a certificate and its issuer, so the root and intermediate certificates shared by the peers are verified once.\n");
+    printf(
+        "   [--trust_revoke] is a file of revoked certificates, one hex SHA-256 of the DER certificate per line. A peer certificate chain holding one fails.\n");
+    printf(
+        "   [--inventory] is the attester file of the devices to collect the evidence of, one \"<IPv4 address>:<port> <MCTP|PCI_DOE|NONE>\" per line.\n");
+    printf(
+        "           Each device has its own connection and SPDM context. --inventory_workers devices are collected at the same time, by default all of them up to 64.\n");
+    printf(
+        "           The files of a device are prefixed with <address>_<port>_, and the time of each device is printed at the end.\n");
+    printf(
+        "   [--evidence_store] is the attester directory that keeps the evidence of every collection, instead of the .bin files.\n");
+    printf(
+        "           A certificate chain or measurement record is stored once, however many devices and collections share it.\n");
+    printf(
+        "   [--evidence_query] prints the evidence of the last collection of a device in --evidence_store, instead of collecting it.\n");
+    printf(
+        "           The device is \"device\" without --inventory, \"<IPv4 address>:<port>\" with it. @<time>, in seconds since the epoch, selects the last collection at or before it.\n");
+    printf(
+        "   [--iterations] [--duration] [--concurrency] select the loop mode of the requester, to generate a sustained load.\n");
+    printf(
+        "           --concurrency connections are opened, 1 by default, each one in its own thread with its own SPDM context.\n");
+    printf(
+        "           After VCA, each connection repeats the authentication, measurement and session flows of --exe_conn and --exe_session\n");
+    printf(
+        "           --iterations times, or until --duration seconds have passed. If only --concurrency is given, the flows run once.\n");
+    printf(
+        "           At the end, the requester prints the flows per second and the latency of each flow. Use --max_conn in the responder.\n");
+    printf(
+        "   [--cert_cache] is when the certificate chains and keys are read. By default, LAZY is used.\n");
+    printf(
+        "           They are read once per algorithm and shared by all the connections.\n");
+    printf(
+        "           LAZY reads them on the first connection that negotiates the algorithm, WARM reads them at startup for all the algorithms given.\n");
+    printf(
+        "   [--log_level] is the emulator log level. By default, VERBOSE is used.\n");
+    printf(
+        "           DEBUG prints each platform port frame, with the data cut after %d bytes. VERBOSE prints the whole data.\n",
+        SPDM_EMU_LOG_DUMP_SIZE_DEBUG);
+    printf(
+        "           Release build only supports up to INFO. Use INFO or ERROR for load test.\n");
 }
 
 typedef struct {
@@ -375,6 +533,19 @@ value_string_entry_t m_exe_mode_string_table[] = {
     { EXE_MODE_CONTINUE, "CONTINUE" },
 };
 
+value_string_entry_t m_fsync_policy_string_table[] = {
+    { SPDM_EMU_FSYNC_NONE, "NONE" },
+    { SPDM_EMU_FSYNC_DATA, "DATA" },
+    { SPDM_EMU_FSYNC_FULL, "FULL" },
+};
+
+value_string_entry_t m_log_level_string_table[] = {
+    { SPDM_EMU_LOG_LEVEL_ERROR, "ERROR" },
+    { SPDM_EMU_LOG_LEVEL_INFO, "INFO" },
+    { SPDM_EMU_LOG_LEVEL_DEBUG, "DEBUG" },
+    { SPDM_EMU_LOG_LEVEL_VERBOSE, "VERBOSE" },
+};
+
 value_string_entry_t m_exe_connection_string_table[] = {
     { EXE_CONNECTION_VERSION_ONLY, "VER_ONLY" },
     { EXE_CONNECTION_DIGEST, "DIGEST" },
@@ -518,6 +689,26 @@ void process_args(char *program_name, int argc, char *argv[])
             }
         }
 
+        if (strcmp(argv[0], "--port") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if ((data32 == 0) || (data32 > 0xFFFF)) {
+                    printf("invalid --port %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_platform_port = (uint16_t)data32;
+                printf("port - %d\n", m_platform_port);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --port\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
         if (strcmp(argv[0], "--ver") == 0) {
             if (argc >= 2) {
                 if (!get_value_from_name(
@@ -1088,6 +1279,59 @@ void process_args(char *program_name, int argc, char *argv[])
             }
         }
 
+        if (strcmp(argv[0], "--state_store") == 0) {
+            if (argc >= 2) {
+                m_state_store_file_name = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --state_store\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--peer_id") == 0) {
+            if (argc >= 2) {
+                if ((argv[1][0] == '\0') || (strlen(argv[1]) > SPDM_STATE_STORE_MAX_KEY_SIZE)) {
+                    printf("invalid --peer_id %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_peer_id = argv[1];
+                printf("peer_id - %s\n", m_peer_id);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --peer_id\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--fsync") == 0) {
+            if (argc >= 2) {
+                if (!get_value_from_name(
+                        m_fsync_policy_string_table,
+                        LIBSPDM_ARRAY_SIZE(m_fsync_policy_string_table),
+                        argv[1], &m_fsync_policy)) {
+                    printf("invalid --fsync %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                printf("fsync - %s\n", argv[1]);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --fsync\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
         if (strcmp(argv[0], "--exe_mode") == 0) {
             if (argc >= 2) {
                 if (!get_value_from_name(
@@ -1169,6 +1413,26 @@ void process_args(char *program_name, int argc, char *argv[])
             }
         }
 
+        if (strcmp(argv[0], "--pcap_rotate") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if (data32 == 0) {
+                    printf("invalid --pcap_rotate %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_pcap_rotate_size = (uint64_t)data32 * 1024 * 1024;
+                printf("pcap_rotate - %d MB\n", data32);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --pcap_rotate\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
         if (strcmp(argv[0], "--priv_key_mode") == 0) {
             if (argc >= 2) {
                 if ((strcmp(argv[1], "PEM") != 0) && (strcmp(argv[1], "RAW") != 0)) {
@@ -1195,12 +1459,310 @@ void process_args(char *program_name, int argc, char *argv[])
             }
         }
 
+        if (strcmp(argv[0], "--max_conn") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if (data32 == 0) {
+                    printf("invalid --max_conn %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_max_connection_count = data32;
+                printf("max_conn - %d\n", m_max_connection_count);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --max_conn\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--dhe_pool") == 0) {
+            if (argc >= 2) {
+                m_dhe_pool_depth = (uint32_t)strtoul(argv[1], NULL, 0);
+                printf("dhe_pool - %d\n", m_dhe_pool_depth);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --dhe_pool\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--dhe_pool_threads") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if ((data32 == 0) || (data32 > 64)) {
+                    printf("invalid --dhe_pool_threads %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_dhe_pool_thread_count = data32;
+                printf("dhe_pool_threads - %d\n", m_dhe_pool_thread_count);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --dhe_pool_threads\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--meas_manifest") == 0) {
+            if (argc >= 2) {
+                m_meas_manifest_file_name = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --meas_manifest\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--peer_cert_cache") == 0) {
+            if (argc >= 2) {
+                m_peer_cert_cache_dir = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --peer_cert_cache\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--trust_cache_ttl") == 0) {
+            if (argc >= 2) {
+                m_trust_cache_ttl = (uint32_t)strtoul(argv[1], NULL, 0);
+                printf("trust_cache_ttl - %d\n", m_trust_cache_ttl);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --trust_cache_ttl\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--trust_revoke") == 0) {
+            if (argc >= 2) {
+                m_trust_revoke_file_name = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --trust_revoke\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--inventory") == 0) {
+            if (argc >= 2) {
+                m_inventory_file_name = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --inventory\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--inventory_workers") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if ((data32 == 0) || (data32 > 64)) {
+                    printf("invalid --inventory_workers %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_inventory_worker_count = data32;
+                printf("inventory_workers - %d\n", m_inventory_worker_count);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --inventory_workers\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--evidence_store") == 0) {
+            if (argc >= 2) {
+                m_evidence_store_dir = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --evidence_store\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--evidence_query") == 0) {
+            if (argc >= 2) {
+                m_evidence_query = argv[1];
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --evidence_query\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--meas_threads") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if ((data32 == 0) || (data32 > 64)) {
+                    printf("invalid --meas_threads %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_meas_hash_thread_count = data32;
+                printf("meas_threads - %d\n", m_meas_hash_thread_count);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --meas_threads\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--iterations") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if (data32 == 0) {
+                    printf("invalid --iterations %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_loop_iteration_count = data32;
+                printf("iterations - %d\n", m_loop_iteration_count);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --iterations\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--duration") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if (data32 == 0) {
+                    printf("invalid --duration %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_loop_duration = data32;
+                printf("duration - %d\n", m_loop_duration);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --duration\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--concurrency") == 0) {
+            if (argc >= 2) {
+                data32 = (uint32_t)strtoul(argv[1], NULL, 0);
+                if (data32 == 0) {
+                    printf("invalid --concurrency %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_loop_concurrency = data32;
+                printf("concurrency - %d\n", m_loop_concurrency);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --concurrency\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--cert_cache") == 0) {
+            if (argc >= 2) {
+                if ((strcmp(argv[1], "LAZY") != 0) && (strcmp(argv[1], "WARM") != 0)) {
+                    printf("invalid --cert_cache %s\n", argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                m_cert_cache_warm = (strcmp(argv[1], "WARM") == 0);
+                printf("cert_cache - %s\n", argv[1]);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --cert_cache\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
+        if (strcmp(argv[0], "--log_level") == 0) {
+            if (argc >= 2) {
+                if (!get_value_from_name(
+                        m_log_level_string_table,
+                        LIBSPDM_ARRAY_SIZE(m_log_level_string_table),
+                        argv[1], &m_log_level)) {
+                    printf("invalid --log_level %s\n",
+                           argv[1]);
+                    print_usage(program_name);
+                    exit(0);
+                }
+                if (m_log_level > SPDM_EMU_LOG_MAX_LEVEL) {
+                    printf("log_level %s is not built in\n", argv[1]);
+                    m_log_level = SPDM_EMU_LOG_MAX_LEVEL;
+                }
+                printf("log_level - 0x%08x\n", m_log_level);
+                argc -= 2;
+                argv += 2;
+                continue;
+            } else {
+                printf("invalid --log_level\n");
+                print_usage(program_name);
+                exit(0);
+            }
+        }
+
         printf("invalid %s\n", argv[0]);
         print_usage(program_name);
         exit(0);
     }
 
 
+    if (m_state_store_file_name != NULL) {
+        if (!spdm_state_store_open()) {
+            print_usage(program_name);
+            exit(0);
+        }
+    }
+
     /* Open PCAP file as last option, after the user indicates transport type.*/
 
     if (pcap_file_name != NULL) {
@@ -1213,11 +1775,33 @@ void process_args(char *program_name, int argc, char *argv[])
     return;
 }
 
+/**
+ * Return the --port value, or the default platform port of the transport.
+ **/
+uint16_t spdm_emu_get_platform_port(void)
+{
+    if (m_platform_port != 0) {
+        return m_platform_port;
+    }
+    /* The IANA has assigned port number 4194 for SPDM */
+    return (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP) ?
+           TCP_SPDM_PLATFORM_PORT : DEFAULT_SPDM_PLATFORM_PORT;
+}
+
 bool init_client(SOCKET *sock, uint16_t port)
+{
+    return init_client_address(sock, &m_ip_address, port);
+}
+
+/**
+ * Connect to a responder at another address than the default one.
+ **/
+bool init_client_address(SOCKET *sock, const struct in_addr *address, uint16_t port)
 {
     SOCKET client_socket;
     struct sockaddr_in server_addr;
     int32_t ret_val;
+    uint64_t start;
 
 #ifdef _MSC_VER
     WSADATA ws;
@@ -1227,26 +1811,36 @@ bool init_client(SOCKET *sock, uint16_t port)
     }
 #endif
 
-    client_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (client_socket == INVALID_SOCKET) {
-        printf("Create socket Failed - %x\n",
-#ifdef _MSC_VER
-               WSAGetLastError()
-#else
-               errno
-#endif
-               );
-        return false;
-    }
-
     server_addr.sin_family = AF_INET;
-    libspdm_copy_mem(&server_addr.sin_addr.s_addr, sizeof(struct in_addr), &m_ip_address,
+    libspdm_copy_mem(&server_addr.sin_addr.s_addr, sizeof(struct in_addr), address,
                      sizeof(struct in_addr));
     server_addr.sin_port = htons(port);
     libspdm_zero_mem(server_addr.sin_zero, sizeof(server_addr.sin_zero));
 
-    ret_val = connect(client_socket, (struct sockaddr *)&server_addr,
-                      sizeof(server_addr));
+    start = spdm_emu_get_monotonic_ns();
+    while (true) {
+        client_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (client_socket == INVALID_SOCKET) {
+            printf("Create socket Failed - %x\n",
+#ifdef _MSC_VER
+                   WSAGetLastError()
+#else
+                   errno
+#endif
+                   );
+            return false;
+        }
+
+        ret_val = connect(client_socket, (struct sockaddr *)&server_addr,
+                          sizeof(server_addr));
+        if ((ret_val != SOCKET_ERROR) ||
+            (spdm_emu_get_monotonic_ns() - start >= (uint64_t)m_connect_retry_ms * 1000000)) {
+            break;
+        }
+        /* The responder may still be starting up.*/
+        closesocket(client_socket);
+        spdm_emu_sleep_us(CONNECT_RETRY_INTERVAL_US);
+    }
     if (ret_val == SOCKET_ERROR) {
         printf("Connect Error - %x\n",
 #ifdef _MSC_VER
@@ -1328,7 +1922,8 @@ bool create_socket(uint16_t port_number, SOCKET *listen_socket)
         return false;
     }
 
-    res = listen(*listen_socket, 3);
+    /* The concurrent server may see hundreds of requesters connecting at once.*/
+    res = listen(*listen_socket, (m_max_connection_count > 1) ? SOMAXCONN : 3);
     if (res == SOCKET_ERROR) {
         printf("Listen error.  Error is 0x%x\n",
 #ifdef _MSC_VER
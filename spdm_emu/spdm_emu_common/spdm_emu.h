@@ -67,6 +67,140 @@ extern char *m_save_state_file_name;
 #define EXE_MODE_CONTINUE 1
 extern uint32_t m_exe_mode;
 
+/* Maximum number of requester connections the responder serves at the same time.
+ * 1 keeps the original serial server. */
+extern uint32_t m_max_connection_count;
+
+/* Depth of the responder pool of pre-generated DHE key pairs per group, 0 for none.
+ * See spdm_responder_dhe_pool.c.*/
+extern uint32_t m_dhe_pool_depth;
+extern uint32_t m_dhe_pool_thread_count;
+
+/* Manifest of the image files the responder measures, NULL for the built-in measurements.
+ * See spdm_responder_measurement.c.*/
+extern char *m_meas_manifest_file_name;
+extern uint32_t m_meas_hash_thread_count;
+
+/* Requester directory of the cached responder certificate chains, NULL for none.
+ * See spdm_requester_cert_cache.c.*/
+extern char *m_peer_cert_cache_dir;
+
+/* Requester and attester cache of the verified peer certificate chain links, see
+ * trust_cache.c. The TTL is in seconds, 0 for no cache.*/
+#define SPDM_EMU_TRUST_CACHE_HASH_SIZE 32
+extern uint32_t m_trust_cache_ttl;
+extern char *m_trust_revoke_file_name;
+
+bool spdm_emu_trust_cache_init(void);
+
+void spdm_emu_trust_cache_free(void);
+
+bool spdm_emu_trust_cache_revoke(const uint8_t *cert_hash);
+
+void spdm_emu_trust_cache_flush(void);
+
+/* Attester file of the devices to collect the evidence of, NULL for the --trans device.
+ * See spdm_device_attester_inventory.c.*/
+extern char *m_inventory_file_name;
+extern uint32_t m_inventory_worker_count;
+
+/* Attester store of the collected evidence, NULL to write the .bin files. See evidence_store.c.*/
+#define SPDM_EMU_EVIDENCE_HASH_SIZE 32
+#define SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE 32
+#define SPDM_EMU_EVIDENCE_KIND_MEASUREMENT 0
+#define SPDM_EMU_EVIDENCE_KIND_CERT_CHAIN 1
+extern char *m_evidence_store_dir;
+extern char *m_evidence_query;
+
+/* A record of index.bin and journal.bin, 88 bytes.*/
+typedef struct {
+    char device[SPDM_EMU_EVIDENCE_MAX_DEVICE_NAME_SIZE];
+    uint64_t timestamp;
+    uint64_t chunk_offset;
+    uint32_t size;
+    uint8_t kind;
+    uint8_t slot_id;
+    uint8_t reserved[2];
+    uint8_t digest[SPDM_EMU_EVIDENCE_HASH_SIZE];
+} spdm_emu_evidence_record_t;
+
+bool spdm_emu_evidence_store_open(bool writable);
+
+void spdm_emu_evidence_store_close(void);
+
+bool spdm_emu_evidence_store_add(const char *device, uint64_t timestamp, uint8_t kind,
+                                 uint8_t slot_id, const void *data, size_t size);
+
+const spdm_emu_evidence_record_t *spdm_emu_evidence_store_get_records(size_t *record_count);
+
+const spdm_emu_evidence_record_t *spdm_emu_evidence_store_find(const char *device,
+                                                               uint64_t timestamp,
+                                                               size_t *record_count);
+
+bool spdm_emu_evidence_store_get_data(const spdm_emu_evidence_record_t *record,
+                                      const void **data, size_t *size);
+
+extern uint32_t m_connect_retry_ms;
+extern uint16_t m_platform_port;
+
+uint16_t spdm_emu_get_platform_port(void);
+
+extern uint32_t m_loop_iteration_count;
+extern uint32_t m_loop_duration;
+extern uint32_t m_loop_concurrency;
+
+/* Certificate chains and keys read from files, shared by all the connections. See cert_cache.c.*/
+#define SPDM_EMU_CERT_CACHE_RESPONDER_CERT_CHAIN 0
+#define SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT 1
+#define SPDM_EMU_CERT_CACHE_RESPONDER_PUBLIC_KEY 2
+#define SPDM_EMU_CERT_CACHE_REQUESTER_PUBLIC_KEY 3
+extern bool m_cert_cache_warm;
+
+void spdm_emu_cert_cache_init(void);
+
+void spdm_emu_cert_cache_free(void);
+
+bool spdm_emu_cert_cache_get(uint8_t kind, uint32_t hash_algo, uint32_t asym_algo,
+                             uint8_t slot_id, const void **data, size_t *data_size);
+
+/* How the files written by the emulator reach the disk, see --fsync.*/
+#define SPDM_EMU_FSYNC_NONE 0
+#define SPDM_EMU_FSYNC_DATA 1
+#define SPDM_EMU_FSYNC_FULL 2
+extern uint32_t m_fsync_policy;
+
+#define SPDM_EMU_LOG_LEVEL_ERROR 0
+#define SPDM_EMU_LOG_LEVEL_INFO 1
+#define SPDM_EMU_LOG_LEVEL_DEBUG 2
+#define SPDM_EMU_LOG_LEVEL_VERBOSE 3
+extern uint32_t m_log_level;
+
+/* Highest log level compiled in. Messages above it cost nothing at run time.
+ * Release builds set it to INFO, so that the platform port dumps are compiled out. */
+#ifndef SPDM_EMU_LOG_MAX_LEVEL
+#define SPDM_EMU_LOG_MAX_LEVEL SPDM_EMU_LOG_LEVEL_VERBOSE
+#endif
+
+#define SPDM_EMU_LOG_ENABLED(level) \
+    (((level) <= SPDM_EMU_LOG_MAX_LEVEL) && ((level) <= m_log_level))
+
+#define SPDM_EMU_LOG(level, ...) \
+    do { \
+        if (SPDM_EMU_LOG_ENABLED(level)) { \
+            printf(__VA_ARGS__); \
+        } \
+    } while (0)
+
+/* Print title followed by the hex bytes of buffer and a new line. At DEBUG level only the
+ * first SPDM_EMU_LOG_DUMP_SIZE_DEBUG bytes are printed, VERBOSE prints all of them. */
+#define SPDM_EMU_LOG_DUMP_SIZE_DEBUG 32
+#define SPDM_EMU_LOG_DATA(level, title, buffer, buffer_size) \
+    do { \
+        if (SPDM_EMU_LOG_ENABLED(level)) { \
+            log_data(title, buffer, buffer_size); \
+        } \
+    } while (0)
+
 #define EXE_CONNECTION_VERSION_ONLY 0x1
 #define EXE_CONNECTION_DIGEST 0x2
 #define EXE_CONNECTION_CERT 0x4
@@ -93,6 +227,8 @@ void libspdm_dump_hex_str(const uint8_t *buffer, size_t buffer_size);
 
 void dump_data(const uint8_t *buffer, size_t buffer_size);
 
+void log_data(const char *title, const void *buffer, size_t buffer_size);
+
 void dump_hex(const uint8_t *buffer, size_t buffer_size);
 
 bool send_platform_data(SOCKET socket, uint32_t command,
@@ -102,6 +238,12 @@ bool receive_platform_data(SOCKET socket, uint32_t *command,
                            uint8_t *receive_buffer,
                            size_t *bytes_to_receive);
 
+bool send_platform_data_ex(SOCKET socket, uint32_t transport_layer, uint32_t command,
+                           const uint8_t *send_buffer, size_t bytes_to_send);
+
+bool receive_platform_data_ex(SOCKET socket, uint32_t transport_layer, uint32_t *command,
+                              uint8_t *receive_buffer, size_t *bytes_to_receive);
+
 
 libspdm_return_t spdm_device_acquire_sender_buffer (
     void *context, void **msg_buf_ptr);
@@ -118,15 +260,46 @@ void spdm_device_release_receiver_buffer (
 bool libspdm_read_input_file(const char *file_name, void **file_data,
                              size_t *file_size);
 
+typedef struct spdm_emu_file_view spdm_emu_file_view_t;
+
+spdm_emu_file_view_t *spdm_emu_map_input_file(const char *file_name, const void **file_data,
+                                              size_t *file_size);
+
+void spdm_emu_release_file_view(spdm_emu_file_view_t *view);
+
 bool libspdm_write_output_file(const char *file_name, const void *file_data,
                                size_t file_size);
 
+bool spdm_emu_sync_file(FILE *file);
+
+bool spdm_emu_replace_file(const char *temp_file_name, const char *file_name);
+
+extern uint64_t m_pcap_rotate_size;
+
 bool open_pcap_packet_file(const char *pcap_file_name);
 
 void close_pcap_packet_file(void);
 
-void append_pcap_packet_data(const void *header, size_t header_size,
-                             const void *data, size_t size);
+void append_pcap_packet_data(SOCKET socket, bool is_send, const void *data, size_t size);
+
+void release_pcap_packet_stream(SOCKET socket);
+
+/* One packet of a capture, as carried by the platform port.*/
+typedef struct {
+    /* nanoseconds since the Unix epoch*/
+    uint64_t timestamp;
+    /* true if sent by the requester*/
+    bool is_request;
+    /* true if the capture holds only the beginning of the packet*/
+    bool is_truncated;
+    const uint8_t *data;
+    size_t size;
+} pcap_packet_record_t;
+
+typedef bool (*pcap_packet_record_func_t)(void *context, const pcap_packet_record_t *record);
+
+bool read_pcap_packet_file(const char *pcap_file_name, uint32_t *transport_layer,
+                           pcap_packet_record_func_t record_func, void *context);
 
 void process_args(char *program_name, int argc, char *argv[]);
 
@@ -134,6 +307,8 @@ bool create_socket(uint16_t port_number, SOCKET *listen_socket);
 
 bool init_client(SOCKET *sock, uint16_t port);
 
+bool init_client_address(SOCKET *sock, const struct in_addr *address, uint16_t port);
+
 bool read_bytes(const SOCKET socket, uint8_t *buffer,
                 uint32_t number_of_bytes);
 
@@ -193,7 +368,101 @@ bool write_bytes(const SOCKET socket, const uint8_t *buffer,
 
 /* expose it because the responder/requester may use it to send/receive other message such as DOE discovery */
 extern uint8_t m_send_receive_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
-extern size_t m_send_receive_buffer_size;
+
+/* Platform state owned by one SPDM context: the socket it talks on, the last platform command
+ * and the sender/receiver buffer handed to libspdm.
+ * The single connection tools implicitly use the default connection backed by m_send_receive_buffer.
+ * A concurrent server allocates one per accepted socket and attaches it to its own SPDM context. */
+typedef struct {
+    SOCKET socket;
+    uint32_t command;
+    void *spdm_context;
+    void *scratch_buffer;
+    void *cert_chain_buffer;
+    uint8_t *send_receive_buffer;
+    size_t send_receive_buffer_size;
+    bool send_receive_buffer_acquired;
+    /* --peer_id of the requester, empty if it sent none*/
+    char peer_id[SPDM_STATE_STORE_MAX_KEY_SIZE + 1];
+    /* SOCKET_TRANSPORT_TYPE_* of the peer, set by the attester for each --inventory device*/
+    uint32_t transport_layer;
+} spdm_emu_connection_t;
+
+extern spdm_emu_connection_t m_default_connection;
+
+bool spdm_emu_attach_connection(void *spdm_context, spdm_emu_connection_t *connection);
+
+spdm_emu_connection_t *spdm_emu_get_connection(void *spdm_context);
+
+typedef void (*spdm_emu_thread_func_t)(void *context);
+
+bool spdm_emu_thread_create(spdm_emu_thread_t *thread,
+                            spdm_emu_thread_func_t func, void *context);
+
+void spdm_emu_thread_join(spdm_emu_thread_t thread);
+
+void spdm_emu_mutex_init(spdm_emu_mutex_t *mutex);
+
+void spdm_emu_mutex_destroy(spdm_emu_mutex_t *mutex);
+
+void spdm_emu_mutex_lock(spdm_emu_mutex_t *mutex);
+
+void spdm_emu_mutex_unlock(spdm_emu_mutex_t *mutex);
+
+void spdm_emu_cond_init(spdm_emu_cond_t *cond);
+
+void spdm_emu_cond_destroy(spdm_emu_cond_t *cond);
+
+void spdm_emu_cond_wait(spdm_emu_cond_t *cond, spdm_emu_mutex_t *mutex);
+
+void spdm_emu_cond_timed_wait(spdm_emu_cond_t *cond, spdm_emu_mutex_t *mutex,
+                              uint32_t timeout_ms);
+
+void spdm_emu_cond_signal(spdm_emu_cond_t *cond);
+
+void spdm_emu_cond_broadcast(spdm_emu_cond_t *cond);
+
+uint32_t spdm_emu_get_cpu_count(void);
+
+uint64_t spdm_emu_get_wall_clock_ns(void);
+
+uint64_t spdm_emu_get_monotonic_ns(void);
+
+void spdm_emu_sleep_us(uint64_t microseconds);
+
+/* Latency histogram, see stats.c. Values are normally nanoseconds.*/
+#define SPDM_EMU_STATS_SUB_BUCKET_BITS 4
+#define SPDM_EMU_STATS_SUB_BUCKET_COUNT (1 << SPDM_EMU_STATS_SUB_BUCKET_BITS)
+#define SPDM_EMU_STATS_BUCKET_COUNT \
+    ((64 - SPDM_EMU_STATS_SUB_BUCKET_BITS + 1) * SPDM_EMU_STATS_SUB_BUCKET_COUNT)
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t bucket[SPDM_EMU_STATS_BUCKET_COUNT];
+} spdm_emu_stats_t;
+
+void spdm_emu_stats_init(spdm_emu_stats_t *stats);
+
+void spdm_emu_stats_record(spdm_emu_stats_t *stats, uint64_t value);
+
+void spdm_emu_stats_merge(spdm_emu_stats_t *stats, const spdm_emu_stats_t *other);
+
+uint64_t spdm_emu_stats_get_percentile(const spdm_emu_stats_t *stats, uint32_t per_mille);
+
+void spdm_emu_stats_print_header(const char *name_title);
+
+void spdm_emu_stats_print_row(const char *name, const spdm_emu_stats_t *stats);
+
+void spdm_emu_stats_print_histogram(const spdm_emu_stats_t *stats);
+
+void spdm_emu_stats_write_json(FILE *file, const spdm_emu_stats_t *stats);
+
+const char *spdm_emu_format_duration(char *buffer, size_t buffer_size, uint64_t ns);
+
+const char *spdm_emu_get_request_name(uint8_t request_code);
 
 #ifndef LIBSPDM_MAX_CSR_SIZE
 #define LIBSPDM_MAX_CSR_SIZE 0xffff
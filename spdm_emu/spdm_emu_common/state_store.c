@@ -0,0 +1,469 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+/* 64 bit off_t for fseeko on 32 bit hosts*/
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "spdm_emu.h"
+
+/* The store is an append-only log of records. A put appends the new value of a key and a delete
+ * appends a record without value, the last record of a key wins. An in-memory hash index gives
+ * the offset of the live value of each key.
+ * Each record carries a CRC32, so a record torn by a crash is detected when the log is opened,
+ * and dropped together with everything after it.
+ * When the log holds more dead records than live ones, the live ones are copied to a new log
+ * that replaces the old one with a rename.*/
+
+#define STATE_STORE_RECORD_MAGIC 0x53544553 /* "SETS" */
+#define STATE_STORE_BUCKET_COUNT 256
+/* Do not compact logs smaller than this.*/
+#define STATE_STORE_COMPACT_MIN_SIZE 0x10000
+
+#pragma pack(1)
+typedef struct {
+    uint32_t magic;
+    uint16_t key_size;
+    uint16_t reserved;
+    uint32_t value_size;
+    /* CRC32 of the header with this field 0, then the key and the value*/
+    uint32_t checksum;
+} state_store_record_header_t;
+#pragma pack()
+
+typedef struct state_store_entry {
+    struct state_store_entry *next;
+    char *key;
+    /* offset of the value in the log*/
+    uint64_t value_offset;
+    uint32_t value_size;
+} state_store_entry_t;
+
+char *m_state_store_file_name;
+FILE *m_state_store_file;
+spdm_emu_mutex_t m_state_store_lock;
+state_store_entry_t *m_state_store_bucket[STATE_STORE_BUCKET_COUNT];
+uint64_t m_state_store_file_size;
+/* total size of the records of the live values*/
+uint64_t m_state_store_live_size;
+
+static uint32_t state_store_crc32(uint32_t crc, const void *data, size_t size)
+{
+    const uint8_t *buffer;
+    size_t index;
+    uint32_t bit;
+
+    buffer = data;
+    crc = ~crc;
+    for (index = 0; index < size; index++) {
+        crc ^= buffer[index];
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t state_store_get_checksum(const state_store_record_header_t *header,
+                                         const void *key, const void *value)
+{
+    state_store_record_header_t header_copy;
+    uint32_t crc;
+
+    header_copy = *header;
+    header_copy.checksum = 0;
+    crc = state_store_crc32(0, &header_copy, sizeof(header_copy));
+    crc = state_store_crc32(crc, key, header->key_size);
+    return state_store_crc32(crc, value, header->value_size);
+}
+
+/* FNV-1a*/
+static uint32_t state_store_get_bucket(const char *key)
+{
+    uint32_t hash;
+
+    hash = 2166136261u;
+    while (*key != '\0') {
+        hash = (hash ^ (uint8_t)*key) * 16777619u;
+        key++;
+    }
+    return hash % STATE_STORE_BUCKET_COUNT;
+}
+
+static state_store_entry_t **state_store_find(const char *key)
+{
+    state_store_entry_t **link;
+
+    link = &m_state_store_bucket[state_store_get_bucket(key)];
+    while ((*link != NULL) && (strcmp((*link)->key, key) != 0)) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static uint64_t state_store_get_record_size(size_t key_size, size_t value_size)
+{
+    return sizeof(state_store_record_header_t) + key_size + value_size;
+}
+
+/**
+ * Make a record the live value of its key, or remove the key if value_size is 0.
+ **/
+static bool state_store_index(const char *key, uint64_t value_offset, uint32_t value_size)
+{
+    state_store_entry_t **link;
+    state_store_entry_t *entry;
+    size_t key_size;
+
+    key_size = strlen(key);
+    link = state_store_find(key);
+    entry = *link;
+    if (entry != NULL) {
+        m_state_store_live_size -= state_store_get_record_size(key_size, entry->value_size);
+        if (value_size == 0) {
+            *link = entry->next;
+            free(entry->key);
+            free(entry);
+            return true;
+        }
+    } else {
+        if (value_size == 0) {
+            return true;
+        }
+        entry = (void *)malloc(sizeof(state_store_entry_t));
+        if (entry == NULL) {
+            return false;
+        }
+        entry->key = (void *)malloc(key_size + 1);
+        if (entry->key == NULL) {
+            free(entry);
+            return false;
+        }
+        libspdm_copy_mem(entry->key, key_size + 1, key, key_size + 1);
+        entry->next = NULL;
+        *link = entry;
+    }
+    entry->value_offset = value_offset;
+    entry->value_size = value_size;
+    m_state_store_live_size += state_store_get_record_size(key_size, value_size);
+    return true;
+}
+
+static void state_store_free_index(void)
+{
+    state_store_entry_t *entry;
+    uint32_t index;
+
+    for (index = 0; index < STATE_STORE_BUCKET_COUNT; index++) {
+        while (m_state_store_bucket[index] != NULL) {
+            entry = m_state_store_bucket[index];
+            m_state_store_bucket[index] = entry->next;
+            free(entry->key);
+            free(entry);
+        }
+    }
+    m_state_store_live_size = 0;
+}
+
+static bool state_store_write_record(FILE *file, const char *key, const void *value,
+                                     uint32_t value_size)
+{
+    state_store_record_header_t header;
+
+    header.magic = STATE_STORE_RECORD_MAGIC;
+    header.key_size = (uint16_t)strlen(key);
+    header.reserved = 0;
+    header.value_size = value_size;
+    header.checksum = state_store_get_checksum(&header, key, value);
+    if ((fwrite(&header, 1, sizeof(header), file) != sizeof(header)) ||
+        (fwrite(key, 1, header.key_size, file) != header.key_size) ||
+        ((value_size != 0) && (fwrite(value, 1, value_size, file) != value_size))) {
+        return false;
+    }
+    return true;
+}
+
+static bool state_store_seek(FILE *file, uint64_t offset)
+{
+#ifdef _MSC_VER
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static bool state_store_read_value(FILE *file, const state_store_entry_t *entry, void *value)
+{
+    if (!state_store_seek(file, entry->value_offset)) {
+        return false;
+    }
+    return fread(value, 1, entry->value_size, file) == entry->value_size;
+}
+
+/**
+ * Rewrite the log with the live values only, then replace the old log.
+ **/
+static bool state_store_compact(void)
+{
+    char *temp_file_name;
+    size_t temp_file_name_size;
+    FILE *temp_file;
+    state_store_entry_t *entry;
+    uint64_t offset;
+    uint32_t index;
+    void *value;
+    bool result;
+
+    temp_file_name_size = strlen(m_state_store_file_name) + sizeof(".tmp");
+    temp_file_name = (void *)malloc(temp_file_name_size);
+    if (temp_file_name == NULL) {
+        return false;
+    }
+    snprintf(temp_file_name, temp_file_name_size, "%s.tmp", m_state_store_file_name);
+    temp_file = fopen(temp_file_name, "w+b");
+    if (temp_file == NULL) {
+        printf("Unable to open file %s\n", temp_file_name);
+        free(temp_file_name);
+        return false;
+    }
+
+    /* Copy the values first. The index is only updated once the new log replaced the old one.*/
+    result = true;
+    for (index = 0; (index < STATE_STORE_BUCKET_COUNT) && result; index++) {
+        for (entry = m_state_store_bucket[index]; (entry != NULL) && result;
+             entry = entry->next) {
+            value = (void *)malloc(entry->value_size);
+            result = (value != NULL) &&
+                     state_store_read_value(m_state_store_file, entry, value) &&
+                     state_store_write_record(temp_file, entry->key, value, entry->value_size);
+            free(value);
+        }
+    }
+    if (result) {
+        result = spdm_emu_sync_file(temp_file);
+    }
+    fclose(temp_file);
+    if (!result) {
+        printf("StateStore compaction fail - write file error\n");
+        remove(temp_file_name);
+        free(temp_file_name);
+        return false;
+    }
+
+    fclose(m_state_store_file);
+    result = spdm_emu_replace_file(temp_file_name, m_state_store_file_name);
+    free(temp_file_name);
+    m_state_store_file = fopen(m_state_store_file_name, "r+b");
+    if (m_state_store_file == NULL) {
+        printf("Unable to open file %s\n", m_state_store_file_name);
+        return false;
+    }
+    if (!result) {
+        printf("StateStore compaction fail - rename error\n");
+        return false;
+    }
+
+    /* The records were written in index order.*/
+    offset = 0;
+    for (index = 0; index < STATE_STORE_BUCKET_COUNT; index++) {
+        for (entry = m_state_store_bucket[index]; entry != NULL; entry = entry->next) {
+            entry->value_offset = offset + sizeof(state_store_record_header_t) +
+                                  strlen(entry->key);
+            offset += state_store_get_record_size(strlen(entry->key), entry->value_size);
+        }
+    }
+    m_state_store_file_size = offset;
+    return true;
+}
+
+static bool state_store_append(const char *key, const void *value, uint32_t value_size)
+{
+    if (!state_store_seek(m_state_store_file, m_state_store_file_size) ||
+        !state_store_write_record(m_state_store_file, key, value, value_size) ||
+        !spdm_emu_sync_file(m_state_store_file)) {
+        printf("StateStore fail - write file error\n");
+        return false;
+    }
+    if (!state_store_index(key, m_state_store_file_size + sizeof(state_store_record_header_t) +
+                           strlen(key), value_size)) {
+        return false;
+    }
+    m_state_store_file_size += state_store_get_record_size(strlen(key), value_size);
+
+    if ((m_state_store_file_size > STATE_STORE_COMPACT_MIN_SIZE) &&
+        (m_state_store_file_size > 2 * m_state_store_live_size)) {
+        state_store_compact();
+    }
+    return true;
+}
+
+/**
+ * Open the state store in m_state_store_file_name, creating it if needed, and index it.
+ *
+ * @retval true  The store is ready.
+ * @retval false The file cannot be read or written.
+ **/
+bool spdm_state_store_open(void)
+{
+    spdm_emu_file_view_t *file_view;
+    const uint8_t *file_data;
+    size_t file_size;
+    size_t offset;
+    state_store_record_header_t header;
+    char key[SPDM_STATE_STORE_MAX_KEY_SIZE + 1];
+    bool torn;
+
+    m_state_store_file = fopen(m_state_store_file_name, "r+b");
+    if (m_state_store_file == NULL) {
+        m_state_store_file = fopen(m_state_store_file_name, "w+b");
+        if (m_state_store_file == NULL) {
+            printf("Unable to open file %s\n", m_state_store_file_name);
+            return false;
+        }
+    }
+
+    file_view = spdm_emu_map_input_file(m_state_store_file_name, (const void **)&file_data,
+                                        &file_size);
+    if (file_view == NULL) {
+        fclose(m_state_store_file);
+        m_state_store_file = NULL;
+        return false;
+    }
+    offset = 0;
+    torn = false;
+    while (offset < file_size) {
+        if (file_size - offset < sizeof(header)) {
+            torn = true;
+            break;
+        }
+        libspdm_copy_mem(&header, sizeof(header), file_data + offset, sizeof(header));
+        if ((header.magic != STATE_STORE_RECORD_MAGIC) ||
+            (header.key_size == 0) || (header.key_size > SPDM_STATE_STORE_MAX_KEY_SIZE) ||
+            (file_size - offset - sizeof(header) < (uint64_t)header.key_size + header.value_size) ||
+            (header.checksum != state_store_get_checksum(
+                 &header, file_data + offset + sizeof(header),
+                 file_data + offset + sizeof(header) + header.key_size))) {
+            torn = true;
+            break;
+        }
+        libspdm_copy_mem(key, sizeof(key), file_data + offset + sizeof(header), header.key_size);
+        key[header.key_size] = '\0';
+        if (!state_store_index(key, offset + sizeof(header) + header.key_size,
+                               header.value_size)) {
+            /* The records after this one are valid, so they cannot be dropped as torn.*/
+            printf("No sufficient memory to index %s\n", m_state_store_file_name);
+            spdm_emu_release_file_view(file_view);
+            state_store_free_index();
+            fclose(m_state_store_file);
+            m_state_store_file = NULL;
+            return false;
+        }
+        offset += (size_t)state_store_get_record_size(header.key_size, header.value_size);
+    }
+    spdm_emu_release_file_view(file_view);
+    m_state_store_file_size = offset;
+
+    spdm_emu_mutex_init(&m_state_store_lock);
+    printf("StateStore %s - %u bytes\n", m_state_store_file_name, (uint32_t)offset);
+    if (torn) {
+        /* Drop the torn tail now, so that new records are not written after it.*/
+        printf("StateStore drops %u bytes of incomplete records\n",
+               (uint32_t)(file_size - offset));
+        if (!state_store_compact()) {
+            spdm_state_store_close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void spdm_state_store_close(void)
+{
+    if (m_state_store_file == NULL) {
+        return;
+    }
+    fclose(m_state_store_file);
+    m_state_store_file = NULL;
+    state_store_free_index();
+    spdm_emu_mutex_destroy(&m_state_store_lock);
+}
+
+/**
+ * Read the value of a key.
+ *
+ * @param  key                           The key, up to SPDM_STATE_STORE_MAX_KEY_SIZE characters.
+ * @param  value                         The value.
+ * @param  value_size                    The expected size of the value.
+ *
+ * @retval true  The key has a value of value_size bytes.
+ * @retval false The key is unknown, or its value has another size.
+ **/
+bool spdm_state_store_get(const char *key, void *value, size_t value_size)
+{
+    state_store_entry_t *entry;
+    bool result;
+
+    if (m_state_store_file == NULL) {
+        return false;
+    }
+    spdm_emu_mutex_lock(&m_state_store_lock);
+    entry = *state_store_find(key);
+    result = (entry != NULL) && (entry->value_size == value_size) &&
+             state_store_read_value(m_state_store_file, entry, value);
+    spdm_emu_mutex_unlock(&m_state_store_lock);
+    return result;
+}
+
+/**
+ * Set the value of a key. An unchanged value is not written again.
+ **/
+bool spdm_state_store_put(const char *key, const void *value, size_t value_size)
+{
+    state_store_entry_t *entry;
+    void *old_value;
+    bool result;
+
+    if ((m_state_store_file == NULL) || (key[0] == '\0') ||
+        (strlen(key) > SPDM_STATE_STORE_MAX_KEY_SIZE) ||
+        (value_size == 0) || (value_size > UINT32_MAX)) {
+        return false;
+    }
+    spdm_emu_mutex_lock(&m_state_store_lock);
+    entry = *state_store_find(key);
+    if ((entry != NULL) && (entry->value_size == value_size)) {
+        old_value = (void *)malloc(value_size);
+        if ((old_value != NULL) &&
+            state_store_read_value(m_state_store_file, entry, old_value) &&
+            (memcmp(old_value, value, value_size) == 0)) {
+            free(old_value);
+            spdm_emu_mutex_unlock(&m_state_store_lock);
+            return true;
+        }
+        free(old_value);
+    }
+    result = state_store_append(key, value, (uint32_t)value_size);
+    spdm_emu_mutex_unlock(&m_state_store_lock);
+    return result;
+}
+
+bool spdm_state_store_delete(const char *key)
+{
+    bool result;
+
+    if ((m_state_store_file == NULL) || (key[0] == '\0') ||
+        (strlen(key) > SPDM_STATE_STORE_MAX_KEY_SIZE)) {
+        return false;
+    }
+    spdm_emu_mutex_lock(&m_state_store_lock);
+    result = true;
+    if (*state_store_find(key) != NULL) {
+        result = state_store_append(key, NULL, 0);
+    }
+    spdm_emu_mutex_unlock(&m_state_store_lock);
+    return result;
+}
@@ -0,0 +1,304 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_emu.h"
+
+/* Width of the bar drawn for the largest histogram row.*/
+#define STATS_HISTOGRAM_BAR_WIDTH 40
+
+/**
+ * Return the name of an SPDM request code, or NULL if it is not a known request.
+ **/
+const char *spdm_emu_get_request_name(uint8_t request_code)
+{
+    switch (request_code) {
+    case SPDM_GET_DIGESTS:
+        return "GET_DIGESTS";
+    case SPDM_GET_CERTIFICATE:
+        return "GET_CERTIFICATE";
+    case SPDM_CHALLENGE:
+        return "CHALLENGE";
+    case SPDM_GET_VERSION:
+        return "GET_VERSION";
+    case SPDM_CHUNK_SEND:
+        return "CHUNK_SEND";
+    case SPDM_CHUNK_GET:
+        return "CHUNK_GET";
+    case SPDM_GET_MEASUREMENTS:
+        return "GET_MEASUREMENTS";
+    case SPDM_GET_CAPABILITIES:
+        return "GET_CAPABILITIES";
+    case SPDM_NEGOTIATE_ALGORITHMS:
+        return "NEGOTIATE_ALGORITHMS";
+    case SPDM_KEY_EXCHANGE:
+        return "KEY_EXCHANGE";
+    case SPDM_FINISH:
+        return "FINISH";
+    case SPDM_PSK_EXCHANGE:
+        return "PSK_EXCHANGE";
+    case SPDM_PSK_FINISH:
+        return "PSK_FINISH";
+    case SPDM_HEARTBEAT:
+        return "HEARTBEAT";
+    case SPDM_KEY_UPDATE:
+        return "KEY_UPDATE";
+    case SPDM_GET_ENCAPSULATED_REQUEST:
+        return "GET_ENCAPSULATED_REQUEST";
+    case SPDM_DELIVER_ENCAPSULATED_RESPONSE:
+        return "DELIVER_ENCAPSULATED_RESPONSE";
+    case SPDM_END_SESSION:
+        return "END_SESSION";
+    case SPDM_GET_CSR:
+        return "GET_CSR";
+    case SPDM_SET_CERTIFICATE:
+        return "SET_CERTIFICATE";
+    case SPDM_VENDOR_DEFINED_REQUEST:
+        return "VENDOR_DEFINED_REQUEST";
+    case SPDM_RESPOND_IF_READY:
+        return "RESPOND_IF_READY";
+    default:
+        return NULL;
+    }
+}
+
+/* The histogram is log-linear: values below SPDM_EMU_STATS_SUB_BUCKET_COUNT have a bucket
+ * each, then every power of two is split in SPDM_EMU_STATS_SUB_BUCKET_COUNT buckets.
+ * The relative error of a bucket is below 1 / SPDM_EMU_STATS_SUB_BUCKET_COUNT.*/
+static uint32_t stats_get_bucket_index(uint64_t value)
+{
+    uint32_t msb;
+    uint32_t shift;
+
+    if (value < SPDM_EMU_STATS_SUB_BUCKET_COUNT) {
+        return (uint32_t)value;
+    }
+    msb = 63;
+    while ((value >> msb) == 0) {
+        msb--;
+    }
+    shift = msb - SPDM_EMU_STATS_SUB_BUCKET_BITS;
+    return (shift + 1) * SPDM_EMU_STATS_SUB_BUCKET_COUNT +
+           (uint32_t)((value >> shift) & (SPDM_EMU_STATS_SUB_BUCKET_COUNT - 1));
+}
+
+static uint64_t stats_get_bucket_lower_bound(uint32_t index)
+{
+    uint32_t shift;
+
+    if (index < SPDM_EMU_STATS_SUB_BUCKET_COUNT) {
+        return index;
+    }
+    shift = index / SPDM_EMU_STATS_SUB_BUCKET_COUNT - 1;
+    return (uint64_t)(SPDM_EMU_STATS_SUB_BUCKET_COUNT +
+                      index % SPDM_EMU_STATS_SUB_BUCKET_COUNT) << shift;
+}
+
+static uint64_t stats_get_bucket_upper_bound(uint32_t index)
+{
+    if (index < SPDM_EMU_STATS_SUB_BUCKET_COUNT) {
+        return index;
+    }
+    return stats_get_bucket_lower_bound(index) +
+           (((uint64_t)1 << (index / SPDM_EMU_STATS_SUB_BUCKET_COUNT - 1)) - 1);
+}
+
+void spdm_emu_stats_init(spdm_emu_stats_t *stats)
+{
+    libspdm_zero_mem(stats, sizeof(*stats));
+    stats->min = UINT64_MAX;
+}
+
+void spdm_emu_stats_record(spdm_emu_stats_t *stats, uint64_t value)
+{
+    stats->count++;
+    stats->sum += value;
+    if (value < stats->min) {
+        stats->min = value;
+    }
+    if (value > stats->max) {
+        stats->max = value;
+    }
+    stats->bucket[stats_get_bucket_index(value)]++;
+}
+
+/**
+ * Add the samples of other to stats.
+ **/
+void spdm_emu_stats_merge(spdm_emu_stats_t *stats, const spdm_emu_stats_t *other)
+{
+    uint32_t index;
+
+    stats->count += other->count;
+    stats->sum += other->sum;
+    stats->min = LIBSPDM_MIN(stats->min, other->min);
+    if (other->max > stats->max) {
+        stats->max = other->max;
+    }
+    for (index = 0; index < SPDM_EMU_STATS_BUCKET_COUNT; index++) {
+        stats->bucket[index] += other->bucket[index];
+    }
+}
+
+/**
+ * Return the value below which the given share of the samples falls.
+ *
+ * @param  stats                         The samples.
+ * @param  per_mille                     The share in 1/1000, for example 500 for the median or 999 for p99.9.
+ *
+ * @return the upper bound of the bucket holding the percentile, capped to the largest sample,
+ *         or 0 if there is no sample.
+ **/
+uint64_t spdm_emu_stats_get_percentile(const spdm_emu_stats_t *stats, uint32_t per_mille)
+{
+    uint64_t rank;
+    uint64_t seen;
+    uint32_t index;
+
+    if (stats->count == 0) {
+        return 0;
+    }
+    /* rank of the sample, counted from 1, rounded up*/
+    rank = (stats->count * per_mille + 999) / 1000;
+    if (rank == 0) {
+        rank = 1;
+    }
+    seen = 0;
+    for (index = 0; index < SPDM_EMU_STATS_BUCKET_COUNT; index++) {
+        seen += stats->bucket[index];
+        if (seen >= rank) {
+            return LIBSPDM_MIN(stats_get_bucket_upper_bound(index), stats->max);
+        }
+    }
+    return stats->max;
+}
+
+/**
+ * Format a duration in nanoseconds with a unit that keeps 3 or 4 significant digits.
+ **/
+const char *spdm_emu_format_duration(char *buffer, size_t buffer_size, uint64_t ns)
+{
+    if (ns < 10000) {
+        snprintf(buffer, buffer_size, "%uns", (uint32_t)ns);
+    } else if (ns < 10000000) {
+        snprintf(buffer, buffer_size, "%.1fus", (double)ns / 1000);
+    } else if (ns < 10000000000ULL) {
+        snprintf(buffer, buffer_size, "%.1fms", (double)ns / 1000000);
+    } else {
+        snprintf(buffer, buffer_size, "%.1fs", (double)ns / 1000000000);
+    }
+    return buffer;
+}
+
+/**
+ * Print the column titles for spdm_emu_stats_print_row.
+ **/
+void spdm_emu_stats_print_header(const char *name_title)
+{
+    printf("    %-30s %10s %9s %9s %9s %9s %9s %9s\n",
+           name_title, "count", "min", "p50", "p99", "p99.9", "max", "mean");
+}
+
+/**
+ * Print one table row with the count and the min, p50, p99, p99.9, max and mean durations.
+ **/
+void spdm_emu_stats_print_row(const char *name, const spdm_emu_stats_t *stats)
+{
+    char value[6][16];
+
+    if (stats->count == 0) {
+        printf("    %-30s %10u\n", name, 0);
+        return;
+    }
+    printf("    %-30s %10llu %9s %9s %9s %9s %9s %9s\n", name,
+           (unsigned long long)stats->count,
+           spdm_emu_format_duration(value[0], sizeof(value[0]), stats->min),
+           spdm_emu_format_duration(value[1], sizeof(value[1]),
+                                    spdm_emu_stats_get_percentile(stats, 500)),
+           spdm_emu_format_duration(value[2], sizeof(value[2]),
+                                    spdm_emu_stats_get_percentile(stats, 990)),
+           spdm_emu_format_duration(value[3], sizeof(value[3]),
+                                    spdm_emu_stats_get_percentile(stats, 999)),
+           spdm_emu_format_duration(value[4], sizeof(value[4]), stats->max),
+           spdm_emu_format_duration(value[5], sizeof(value[5]), stats->sum / stats->count));
+}
+
+/**
+ * Print the histogram of durations in nanoseconds, one row per power of two.
+ **/
+void spdm_emu_stats_print_histogram(const spdm_emu_stats_t *stats)
+{
+    uint64_t row_count[64];
+    uint64_t largest_row;
+    uint32_t first_row;
+    uint32_t last_row;
+    uint32_t row;
+    uint32_t index;
+    uint32_t bar;
+    char low[16];
+    char high[16];
+
+    if (stats->count == 0) {
+        return;
+    }
+
+    libspdm_zero_mem(row_count, sizeof(row_count));
+    for (index = 0; index < SPDM_EMU_STATS_BUCKET_COUNT; index++) {
+        if (stats->bucket[index] != 0) {
+            /* row r holds [2^r, 2^(r+1)), row 0 also holds 0*/
+            row = 0;
+            while ((row < 63) &&
+                   ((stats_get_bucket_lower_bound(index) >> (row + 1)) != 0)) {
+                row++;
+            }
+            row_count[row] += stats->bucket[index];
+        }
+    }
+
+    first_row = 0;
+    while (row_count[first_row] == 0) {
+        first_row++;
+    }
+    last_row = 63;
+    while (row_count[last_row] == 0) {
+        last_row--;
+    }
+    largest_row = 0;
+    for (row = first_row; row <= last_row; row++) {
+        if (row_count[row] > largest_row) {
+            largest_row = row_count[row];
+        }
+    }
+
+    for (row = first_row; row <= last_row; row++) {
+        printf("    [%8s, %8s) %10llu |",
+               spdm_emu_format_duration(low, sizeof(low), row == 0 ? 0 : (uint64_t)1 << row),
+               spdm_emu_format_duration(high, sizeof(high), (uint64_t)1 << (row + 1)),
+               (unsigned long long)row_count[row]);
+        bar = (uint32_t)((row_count[row] * STATS_HISTOGRAM_BAR_WIDTH + largest_row - 1) /
+                         largest_row);
+        while (bar-- > 0) {
+            printf("#");
+        }
+        printf("\n");
+    }
+}
+
+/**
+ * Write the summary of stats as one JSON object, with the values in nanoseconds.
+ **/
+void spdm_emu_stats_write_json(FILE *file, const spdm_emu_stats_t *stats)
+{
+    fprintf(file,
+            "{\"count\": %llu, \"min\": %llu, \"p50\": %llu, \"p99\": %llu, \"p999\": %llu, "
+            "\"max\": %llu, \"mean\": %llu}",
+            (unsigned long long)stats->count,
+            (unsigned long long)(stats->count == 0 ? 0 : stats->min),
+            (unsigned long long)spdm_emu_stats_get_percentile(stats, 500),
+            (unsigned long long)spdm_emu_stats_get_percentile(stats, 990),
+            (unsigned long long)spdm_emu_stats_get_percentile(stats, 999),
+            (unsigned long long)stats->max,
+            (unsigned long long)(stats->count == 0 ? 0 : stats->sum / stats->count));
+}
@@ -4,8 +4,24 @@
  *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
  **/
 
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include "spdm_emu.h"
 
+#ifdef _MSC_VER
+#include <io.h>
+#include <fcntl.h>
+#include <process.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 void libspdm_dump_hex_str(const uint8_t *buffer, size_t buffer_size)
 {
     size_t index;
@@ -15,15 +31,92 @@ void libspdm_dump_hex_str(const uint8_t *buffer, size_t buffer_size)
     }
 }
 
-void dump_data(const uint8_t *buffer, size_t buffer_size)
+uint32_t m_log_level = SPDM_EMU_LOG_LEVEL_VERBOSE;
+
+static const char m_hex_digit[] = "0123456789abcdef";
+
+/* Room for the title, about 330 bytes of hex and the truncation note.*/
+#define LOG_LINE_BUFFER_SIZE 1024
+#define LOG_LINE_TAIL_SIZE 32
+
+/**
+ * Format each byte as two hex digits and a space.
+ *
+ * @return the number of characters written to line, 3 * buffer_size.
+ **/
+static size_t format_hex(char *line, const uint8_t *buffer, size_t buffer_size)
 {
     size_t index;
+    char *p;
 
+    p = line;
     for (index = 0; index < buffer_size; index++) {
-        printf("%02x ", buffer[index]);
+        *p++ = m_hex_digit[buffer[index] >> 4];
+        *p++ = m_hex_digit[buffer[index] & 0xF];
+        *p++ = ' ';
+    }
+    return (size_t)(p - line);
+}
+
+void dump_data(const uint8_t *buffer, size_t buffer_size)
+{
+    char line[LOG_LINE_BUFFER_SIZE];
+    size_t chunk_size;
+
+    while (buffer_size != 0) {
+        chunk_size = LIBSPDM_MIN(buffer_size, sizeof(line) / 3);
+        fwrite(line, 1, format_hex(line, buffer, chunk_size), stdout);
+        buffer += chunk_size;
+        buffer_size -= chunk_size;
     }
 }
 
+/**
+ * Print title, the hex dump of buffer and a new line, with one fwrite per line buffer.
+ * Unless VERBOSE logging is enabled the dump is cut after SPDM_EMU_LOG_DUMP_SIZE_DEBUG bytes.
+ **/
+void log_data(const char *title, const void *buffer, size_t buffer_size)
+{
+    char line[LOG_LINE_BUFFER_SIZE];
+    const uint8_t *data;
+    size_t dump_size;
+    size_t chunk_size;
+    size_t line_size;
+    size_t title_size;
+
+    data = buffer;
+    dump_size = buffer_size;
+    if (!SPDM_EMU_LOG_ENABLED(SPDM_EMU_LOG_LEVEL_VERBOSE)) {
+        dump_size = LIBSPDM_MIN(dump_size, SPDM_EMU_LOG_DUMP_SIZE_DEBUG);
+    }
+
+    line_size = 0;
+    title_size = strlen(title);
+    if (title_size > sizeof(line) / 2) {
+        fwrite(title, 1, title_size, stdout);
+    } else {
+        libspdm_copy_mem(line, sizeof(line), title, title_size);
+        line_size = title_size;
+    }
+
+    do {
+        chunk_size = LIBSPDM_MIN(dump_size,
+                                 (sizeof(line) - line_size - LOG_LINE_TAIL_SIZE) / 3);
+        line_size += format_hex(line + line_size, data, chunk_size);
+        data += chunk_size;
+        dump_size -= chunk_size;
+        if (dump_size == 0) {
+            if (data != (const uint8_t *)buffer + buffer_size) {
+                line_size += snprintf(line + line_size, sizeof(line) - line_size,
+                                      "... (%u bytes)", (uint32_t)buffer_size);
+            }
+            line[line_size++] = '\n';
+        }
+        fwrite(line, 1, line_size, stdout);
+        line_size = 0;
+    } while (dump_size != 0);
+}
+
 void dump_hex(const uint8_t *data, size_t size)
 {
     size_t index;
@@ -47,10 +140,132 @@ void dump_hex(const uint8_t *data, size_t size)
     }
 }
 
+/* A read-only mapping of a whole file, owned by the caller that mapped it.*/
+struct spdm_emu_file_view {
+    void *data;
+    size_t size;
+};
+
+/**
+ * Map a whole file read-only.
+ *
+ * The data is backed by the page cache and is not copied. It stays valid until the view is
+ * released. The mapping is private: the emulator replaces its files by rename, so a later
+ * writer never changes or truncates the pages under a view.
+ *
+ * @param  file_name                     The file to map.
+ * @param  file_data                     The file content, NULL for an empty file.
+ * @param  file_size                     The file size.
+ *
+ * @return the view, or NULL on failure.
+ **/
+spdm_emu_file_view_t *spdm_emu_map_input_file(const char *file_name, const void **file_data,
+                                              size_t *file_size)
+{
+    spdm_emu_file_view_t *view;
+#ifdef _MSC_VER
+    HANDLE file;
+    HANDLE mapping;
+    LARGE_INTEGER size;
+#else
+    int fd;
+    struct stat file_stat;
+#endif
+
+    view = (void *)malloc(sizeof(spdm_emu_file_view_t));
+    if (view == NULL) {
+        printf("No sufficient memory to map %s\n", file_name);
+        return NULL;
+    }
+    view->data = NULL;
+    view->size = 0;
+
+#ifdef _MSC_VER
+    file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("Unable to open file %s\n", file_name);
+        free(view);
+        return NULL;
+    }
+    if (!GetFileSizeEx(file, &size)) {
+        printf("Unable to get the file size %s\n", file_name);
+        CloseHandle(file);
+        free(view);
+        return NULL;
+    }
+    view->size = (size_t)size.QuadPart;
+    if (view->size != 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            view->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            /* The view keeps the mapping alive.*/
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    fd = open(file_name, O_RDONLY);
+    if (fd < 0) {
+        printf("Unable to open file %s\n", file_name);
+        free(view);
+        return NULL;
+    }
+    if (fstat(fd, &file_stat) != 0) {
+        printf("Unable to get the file size %s\n", file_name);
+        close(fd);
+        free(view);
+        return NULL;
+    }
+    view->size = (size_t)file_stat.st_size;
+    if (view->size != 0) {
+        view->data = mmap(NULL, view->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view->data == MAP_FAILED) {
+            view->data = NULL;
+        }
+    }
+    close(fd);
+#endif
+    if ((view->size != 0) && (view->data == NULL)) {
+        printf("Unable to map file %s\n", file_name);
+        free(view);
+        return NULL;
+    }
+
+    *file_data = view->data;
+    *file_size = view->size;
+    return view;
+}
+
+/**
+ * Unmap a view. The data returned with it must not be used afterwards.
+ **/
+void spdm_emu_release_file_view(spdm_emu_file_view_t *view)
+{
+    if (view == NULL) {
+        return;
+    }
+    if (view->data != NULL) {
+#ifdef _MSC_VER
+        UnmapViewOfFile(view->data);
+#else
+        munmap(view->data, view->size);
+#endif
+    }
+    free(view);
+}
+
+/* The caller owns and frees the returned buffer, as libspdm expects for the certificates and
+ * keys. Callers that only read the content use spdm_emu_map_input_file instead.*/
 bool libspdm_read_input_file(const char *file_name, void **file_data,
                              size_t *file_size)
 {
     FILE *fp_in;
+#ifdef _MSC_VER
+    __int64 size;
+#else
+    off_t size;
+#endif
     size_t temp_result;
 
     if ((fp_in = fopen(file_name, "rb")) == NULL) {
@@ -59,27 +274,35 @@ bool libspdm_read_input_file(const char *file_name, void **file_data,
         return false;
     }
 
-    fseek(fp_in, 0, SEEK_END);
-    *file_size = ftell(fp_in);
-    if (*file_size == -1) {
+#ifdef _MSC_VER
+    _fseeki64(fp_in, 0, SEEK_END);
+    size = _ftelli64(fp_in);
+#else
+    fseeko(fp_in, 0, SEEK_END);
+    size = ftello(fp_in);
+#endif
+    if ((size < 0) || ((uint64_t)size > SIZE_MAX)) {
         printf("Unable to get the file size %s\n", file_name);
         *file_data = NULL;
         fclose(fp_in);
         return false;
     }
+    *file_size = (size_t)size;
 
-    *file_data = (void *)malloc(*file_size);
+    /* malloc(0) may return NULL, keep one byte for an empty file.*/
+    *file_data = (void *)malloc(*file_size == 0 ? 1 : *file_size);
     if (NULL == *file_data) {
         printf("No sufficient memory to allocate %s\n", file_name);
         fclose(fp_in);
         return false;
     }
 
-    fseek(fp_in, 0, SEEK_SET);
+    rewind(fp_in);
     temp_result = fread(*file_data, 1, *file_size, fp_in);
     if (temp_result != *file_size) {
-        printf("Read input file error %s", file_name);
+        printf("Read input file error %s\n", file_name);
         free((void *)*file_data);
+        *file_data = NULL;
         fclose(fp_in);
         return false;
     }
@@ -89,25 +312,177 @@ bool libspdm_read_input_file(const char *file_name, void **file_data,
     return true;
 }
 
+/**
+ * Flush a file written with stdio, then sync it to the disk unless --fsync is NONE.
+ **/
+bool spdm_emu_sync_file(FILE *file)
+{
+    if (fflush(file) != 0) {
+        return false;
+    }
+    if (m_fsync_policy == SPDM_EMU_FSYNC_NONE) {
+        return true;
+    }
+#ifdef _MSC_VER
+    return _commit(_fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+#ifndef _MSC_VER
+/* The new name of a renamed file is only durable once its directory is synced.*/
+static bool sync_parent_directory(const char *file_name)
+{
+    char *directory_name;
+    const char *separator;
+    size_t directory_name_size;
+    int fd;
+    bool result;
+
+    separator = strrchr(file_name, '/');
+    if (separator == NULL) {
+        return sync_parent_directory("./");
+    }
+    directory_name_size = (size_t)(separator - file_name) + 1;
+    directory_name = (void *)malloc(directory_name_size + 1);
+    if (directory_name == NULL) {
+        return false;
+    }
+    libspdm_copy_mem(directory_name, directory_name_size + 1, file_name, directory_name_size);
+    directory_name[directory_name_size] = '\0';
+    fd = open(directory_name, O_RDONLY);
+    free(directory_name);
+    if (fd < 0) {
+        return false;
+    }
+    result = (fsync(fd) == 0);
+    close(fd);
+    return result;
+}
+#endif
+
+/**
+ * Atomically replace a file with a temporary file written next to it.
+ * With --fsync FULL, the rename itself is synced too.
+ *
+ * @param  temp_file_name                The temporary file, already synced and closed.
+ * @param  file_name                     The file to replace.
+ *
+ * @retval true  file_name has the content of temp_file_name, which is gone.
+ * @retval false file_name is unchanged.
+ **/
+bool spdm_emu_replace_file(const char *temp_file_name, const char *file_name)
+{
+#ifdef _MSC_VER
+    return MoveFileExA(temp_file_name, file_name,
+                       MOVEFILE_REPLACE_EXISTING |
+                       ((m_fsync_policy == SPDM_EMU_FSYNC_FULL) ? MOVEFILE_WRITE_THROUGH : 0));
+#else
+    if (rename(temp_file_name, file_name) != 0) {
+        return false;
+    }
+    if (m_fsync_policy == SPDM_EMU_FSYNC_FULL) {
+        /* The file is replaced, a failure only means the rename may be lost on a crash.*/
+        if (!sync_parent_directory(file_name)) {
+            printf("Unable to sync the directory of %s\n", file_name);
+        }
+    }
+    return true;
+#endif
+}
+
+#define SPDM_EMU_TEMP_FILE_MAX_ATTEMPT 100
+
+/* Create <file>.<pid>.<n>.tmp for writing. The file is created exclusively, so two writers of
+ * the same file, in one process or in several, never share a temporary file.*/
+static FILE *spdm_emu_create_temp_file(const char *file_name, char *temp_file_name,
+                                       size_t temp_file_name_size)
+{
+    uint32_t attempt;
+    int fd;
+    FILE *file;
+
+    for (attempt = 0; attempt < SPDM_EMU_TEMP_FILE_MAX_ATTEMPT; attempt++) {
+#ifdef _MSC_VER
+        snprintf(temp_file_name, temp_file_name_size, "%s.%u.%u.tmp", file_name,
+                 (uint32_t)_getpid(), attempt);
+        fd = _open(temp_file_name, _O_WRONLY | _O_CREAT | _O_EXCL | _O_BINARY,
+                   _S_IREAD | _S_IWRITE);
+        if (fd >= 0) {
+            file = _fdopen(fd, "wb");
+            if (file == NULL) {
+                _close(fd);
+                remove(temp_file_name);
+            }
+            return file;
+        }
+#else
+        snprintf(temp_file_name, temp_file_name_size, "%s.%u.%u.tmp", file_name,
+                 (uint32_t)getpid(), attempt);
+        fd = open(temp_file_name, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd >= 0) {
+            file = fdopen(fd, "wb");
+            if (file == NULL) {
+                close(fd);
+                remove(temp_file_name);
+            }
+            return file;
+        }
+#endif
+        if (errno != EEXIST) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* The file is written to a temporary file next to it, then renamed, so that a crash leaves
+ * either the old or the new content, never a truncated file.*/
 bool libspdm_write_output_file(const char *file_name, const void *file_data,
                                size_t file_size)
 {
     FILE *fp_out;
+    char *temp_file_name;
+    size_t temp_file_name_size;
+    bool result;
 
-    if ((fp_out = fopen(file_name, "w+b")) == NULL) {
-        printf("Unable to open file %s\n", file_name);
+    /* room for ".<pid>.<n>.tmp"*/
+    temp_file_name_size = strlen(file_name) + 32;
+    temp_file_name = (void *)malloc(temp_file_name_size);
+    if (temp_file_name == NULL) {
+        printf("No sufficient memory to allocate %s\n", file_name);
+        return false;
+    }
+
+    if ((fp_out = spdm_emu_create_temp_file(file_name, temp_file_name,
+                                            temp_file_name_size)) == NULL) {
+        printf("Unable to open file %s\n", temp_file_name);
+        free(temp_file_name);
         return false;
     }
 
+    result = true;
     if (file_size != 0) {
         if ((fwrite(file_data, 1, file_size, fp_out)) != file_size) {
             printf("Write output file error %s\n", file_name);
-            fclose(fp_out);
-            return false;
+            result = false;
         }
     }
-
+    if (result && !spdm_emu_sync_file(fp_out)) {
+        printf("Sync output file error %s\n", file_name);
+        result = false;
+    }
     fclose(fp_out);
 
-    return true;
+    if (result && !spdm_emu_replace_file(temp_file_name, file_name)) {
+        printf("Unable to replace file %s\n", file_name);
+        result = false;
+    }
+    if (!result) {
+        remove(temp_file_name);
+    }
+    free(temp_file_name);
+
+    return result;
 }
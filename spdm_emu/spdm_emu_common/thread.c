@@ -0,0 +1,268 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "spdm_emu.h"
+
+typedef struct {
+    spdm_emu_thread_func_t func;
+    void *context;
+} spdm_emu_thread_start_t;
+
+#ifdef _MSC_VER
+static DWORD WINAPI spdm_emu_thread_entry(LPVOID parameter)
+#else
+static void *spdm_emu_thread_entry(void *parameter)
+#endif
+{
+    spdm_emu_thread_start_t start;
+
+    start = *(spdm_emu_thread_start_t *)parameter;
+    free(parameter);
+
+    start.func(start.context);
+#ifdef _MSC_VER
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * Start a new thread running func(context).
+ *
+ * @param  thread                        The created thread handle, to be passed to spdm_emu_thread_join.
+ * @param  func                          The thread routine.
+ * @param  context                       The context passed to the thread routine.
+ *
+ * @retval true  The thread is started.
+ * @retval false The thread cannot be started.
+ **/
+bool spdm_emu_thread_create(spdm_emu_thread_t *thread,
+                            spdm_emu_thread_func_t func, void *context)
+{
+    spdm_emu_thread_start_t *start;
+
+    start = (void *)malloc(sizeof(spdm_emu_thread_start_t));
+    if (start == NULL) {
+        return false;
+    }
+    start->func = func;
+    start->context = context;
+
+#ifdef _MSC_VER
+    *thread = CreateThread(NULL, 0, spdm_emu_thread_entry, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return false;
+    }
+#else
+    if (pthread_create(thread, NULL, spdm_emu_thread_entry, start) != 0) {
+        free(start);
+        return false;
+    }
+#endif
+    return true;
+}
+
+void spdm_emu_thread_join(spdm_emu_thread_t thread)
+{
+#ifdef _MSC_VER
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+void spdm_emu_mutex_init(spdm_emu_mutex_t *mutex)
+{
+#ifdef _MSC_VER
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void spdm_emu_mutex_destroy(spdm_emu_mutex_t *mutex)
+{
+#ifdef _MSC_VER
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+void spdm_emu_mutex_lock(spdm_emu_mutex_t *mutex)
+{
+#ifdef _MSC_VER
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void spdm_emu_mutex_unlock(spdm_emu_mutex_t *mutex)
+{
+#ifdef _MSC_VER
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void spdm_emu_cond_init(spdm_emu_cond_t *cond)
+{
+#ifdef _MSC_VER
+    InitializeConditionVariable(cond);
+#else
+    pthread_cond_init(cond, NULL);
+#endif
+}
+
+void spdm_emu_cond_destroy(spdm_emu_cond_t *cond)
+{
+#ifdef _MSC_VER
+    /* nothing to release for a Win32 condition variable */
+#else
+    pthread_cond_destroy(cond);
+#endif
+}
+
+/**
+ * Atomically release the mutex and wait for the condition to be signaled.
+ * The mutex is held again when the function returns.
+ **/
+void spdm_emu_cond_wait(spdm_emu_cond_t *cond, spdm_emu_mutex_t *mutex)
+{
+#ifdef _MSC_VER
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+    pthread_cond_wait(cond, mutex);
+#endif
+}
+
+/**
+ * Same as spdm_emu_cond_wait, but return after timeout_ms milliseconds at the latest.
+ **/
+void spdm_emu_cond_timed_wait(spdm_emu_cond_t *cond, spdm_emu_mutex_t *mutex,
+                              uint32_t timeout_ms)
+{
+#ifdef _MSC_VER
+    SleepConditionVariableCS(cond, mutex, timeout_ms);
+#else
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(cond, mutex, &deadline);
+#endif
+}
+
+void spdm_emu_cond_signal(spdm_emu_cond_t *cond)
+{
+#ifdef _MSC_VER
+    WakeConditionVariable(cond);
+#else
+    pthread_cond_signal(cond);
+#endif
+}
+
+void spdm_emu_cond_broadcast(spdm_emu_cond_t *cond)
+{
+#ifdef _MSC_VER
+    WakeAllConditionVariable(cond);
+#else
+    pthread_cond_broadcast(cond);
+#endif
+}
+
+/**
+ * Return the number of online logical processors, at least 1.
+ **/
+uint32_t spdm_emu_get_cpu_count(void)
+{
+#ifdef _MSC_VER
+    SYSTEM_INFO system_info;
+
+    GetSystemInfo(&system_info);
+    return system_info.dwNumberOfProcessors == 0 ? 1 : system_info.dwNumberOfProcessors;
+#else
+    long count;
+
+    count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count <= 0 ? 1 : (uint32_t)count;
+#endif
+}
+
+/**
+ * Return the wall clock time in nanoseconds since the Unix epoch.
+ **/
+uint64_t spdm_emu_get_wall_clock_ns(void)
+{
+#ifdef _MSC_VER
+    FILETIME file_time;
+    ULARGE_INTEGER time_100ns;
+
+    GetSystemTimePreciseAsFileTime(&file_time);
+    time_100ns.LowPart = file_time.dwLowDateTime;
+    time_100ns.HighPart = file_time.dwHighDateTime;
+    /* FILETIME counts 100ns intervals since 1601-01-01.*/
+    return (time_100ns.QuadPart - 116444736000000000ULL) * 100;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+ * Return a monotonic time stamp in nanoseconds, suitable for measuring intervals.
+ **/
+uint64_t spdm_emu_get_monotonic_ns(void)
+{
+#ifdef _MSC_VER
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000 +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000 /
+           (uint64_t)frequency.QuadPart;
+#else
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#endif
+}
+
+/**
+ * Suspend the calling thread for at least the given number of microseconds.
+ **/
+void spdm_emu_sleep_us(uint64_t microseconds)
+{
+#ifdef _MSC_VER
+    Sleep((DWORD)((microseconds + 999) / 1000));
+#else
+    struct timespec duration;
+
+    duration.tv_sec = (time_t)(microseconds / 1000000);
+    duration.tv_nsec = (long)(microseconds % 1000000) * 1000;
+    while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {
+    }
+#endif
+}
@@ -0,0 +1,456 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_emu.h"
+
+/* libspdm validates the peer certificate chain against LIBSPDM_DATA_PEER_PUBLIC_ROOT_CERT
+ * with libspdm_x509_verify_cert_chain, which checks each certificate with the one before it,
+ * the first one with the root certificate. The requester and the attester are linked with
+ * --wrap for that function (see CMakeLists.txt) and set SPDM_EMU_TRUST_CACHE.
+ *
+ * With --trust_cache_ttl, a link that verified is remembered for that many seconds, keyed by
+ * the SHA-256 of the issuer certificate and of the certificate. The devices of a fleet share
+ * their root and intermediate certificates, so only their leaf certificate is verified.
+ * With --trust_revoke, a chain holding a revoked certificate fails, cached or not.*/
+
+#ifndef SPDM_EMU_TRUST_CACHE
+#define SPDM_EMU_TRUST_CACHE 0
+#endif
+
+#if SPDM_EMU_TRUST_CACHE
+
+#define TRUST_CACHE_BUCKET_COUNT 256
+#define TRUST_CACHE_MAX_LINK_COUNT 4096
+#define TRUST_REVOKE_MAX_LINE_SIZE 256
+
+typedef struct trust_cache_link {
+    struct trust_cache_link *next;
+    uint8_t issuer_hash[SPDM_EMU_TRUST_CACHE_HASH_SIZE];
+    uint8_t subject_hash[SPDM_EMU_TRUST_CACHE_HASH_SIZE];
+    uint64_t expire_ns;
+} trust_cache_link_t;
+
+typedef struct trust_cache_revoked {
+    struct trust_cache_revoked *next;
+    uint8_t cert_hash[SPDM_EMU_TRUST_CACHE_HASH_SIZE];
+} trust_cache_revoked_t;
+
+bool __real_libspdm_x509_verify_cert_chain(const uint8_t *root_cert, size_t root_cert_length,
+                                           const uint8_t *cert_chain,
+                                           size_t cert_chain_length);
+
+bool m_trust_cache_running;
+spdm_emu_mutex_t m_trust_cache_lock;
+/* Indexed by the first byte of the certificate hash.*/
+trust_cache_link_t *m_trust_cache_bucket[TRUST_CACHE_BUCKET_COUNT];
+uint32_t m_trust_cache_link_count;
+trust_cache_revoked_t *m_trust_cache_revoked;
+uint32_t m_trust_cache_hit_count;
+uint32_t m_trust_cache_miss_count;
+uint32_t m_trust_cache_revoked_count;
+
+static bool trust_cache_hash(const uint8_t *cert, size_t cert_size, uint8_t *cert_hash)
+{
+    return libspdm_hash_all(SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_256, cert, cert_size,
+                            cert_hash);
+}
+
+/* Called with the lock held.*/
+static bool trust_cache_is_revoked(const uint8_t *cert_hash)
+{
+    const trust_cache_revoked_t *revoked;
+
+    for (revoked = m_trust_cache_revoked; revoked != NULL; revoked = revoked->next) {
+        if (libspdm_const_compare_mem(revoked->cert_hash, cert_hash,
+                                      SPDM_EMU_TRUST_CACHE_HASH_SIZE) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Called with the lock held. Expired links are dropped on the way.*/
+static bool trust_cache_find_link(const uint8_t *issuer_hash, const uint8_t *subject_hash,
+                                  uint64_t now)
+{
+    trust_cache_link_t **link;
+    trust_cache_link_t *entry;
+
+    link = &m_trust_cache_bucket[subject_hash[0]];
+    while (*link != NULL) {
+        entry = *link;
+        if (entry->expire_ns <= now) {
+            *link = entry->next;
+            free(entry);
+            m_trust_cache_link_count--;
+            continue;
+        }
+        if ((libspdm_const_compare_mem(entry->subject_hash, subject_hash,
+                                       SPDM_EMU_TRUST_CACHE_HASH_SIZE) == 0) &&
+            (libspdm_const_compare_mem(entry->issuer_hash, issuer_hash,
+                                       SPDM_EMU_TRUST_CACHE_HASH_SIZE) == 0)) {
+            return true;
+        }
+        link = &entry->next;
+    }
+    return false;
+}
+
+static void trust_cache_add_link(const uint8_t *issuer_hash, const uint8_t *subject_hash)
+{
+    trust_cache_link_t *entry;
+    uint64_t now;
+
+    if (m_trust_cache_ttl == 0) {
+        return;
+    }
+    now = spdm_emu_get_monotonic_ns();
+    spdm_emu_mutex_lock(&m_trust_cache_lock);
+    /* Another connection may have verified the same link meanwhile, or revoked it.*/
+    if (trust_cache_find_link(issuer_hash, subject_hash, now) ||
+        trust_cache_is_revoked(issuer_hash) || trust_cache_is_revoked(subject_hash) ||
+        (m_trust_cache_link_count >= TRUST_CACHE_MAX_LINK_COUNT)) {
+        spdm_emu_mutex_unlock(&m_trust_cache_lock);
+        return;
+    }
+    entry = (void *)malloc(sizeof(trust_cache_link_t));
+    if (entry != NULL) {
+        libspdm_copy_mem(entry->issuer_hash, sizeof(entry->issuer_hash),
+                         issuer_hash, SPDM_EMU_TRUST_CACHE_HASH_SIZE);
+        libspdm_copy_mem(entry->subject_hash, sizeof(entry->subject_hash),
+                         subject_hash, SPDM_EMU_TRUST_CACHE_HASH_SIZE);
+        entry->expire_ns = now + (uint64_t)m_trust_cache_ttl * 1000000000;
+        entry->next = m_trust_cache_bucket[subject_hash[0]];
+        m_trust_cache_bucket[subject_hash[0]] = entry;
+        m_trust_cache_link_count++;
+    }
+    spdm_emu_mutex_unlock(&m_trust_cache_lock);
+}
+
+/**
+ * Check one link of a chain.
+ *
+ * @retval true  The certificate is issued by the issuer, and neither is revoked.
+ * @retval false The link does not verify, or a certificate is revoked.
+ **/
+static bool trust_cache_verify_link(const uint8_t *issuer, size_t issuer_size,
+                                    const uint8_t *issuer_hash, const uint8_t *cert,
+                                    size_t cert_size, const uint8_t *cert_hash)
+{
+    bool revoked;
+    bool found;
+
+    spdm_emu_mutex_lock(&m_trust_cache_lock);
+    revoked = trust_cache_is_revoked(issuer_hash) || trust_cache_is_revoked(cert_hash);
+    found = !revoked && trust_cache_find_link(issuer_hash, cert_hash,
+                                              spdm_emu_get_monotonic_ns());
+    if (revoked) {
+        m_trust_cache_revoked_count++;
+    } else if (found) {
+        m_trust_cache_hit_count++;
+    } else {
+        m_trust_cache_miss_count++;
+    }
+    spdm_emu_mutex_unlock(&m_trust_cache_lock);
+
+    if (revoked) {
+        printf("TrustCache - revoked certificate in the peer certificate chain\n");
+        return false;
+    }
+    if (found) {
+        return true;
+    }
+    if (!libspdm_x509_verify_cert(cert, cert_size, issuer, issuer_size)) {
+        return false;
+    }
+    trust_cache_add_link(issuer_hash, cert_hash);
+    return true;
+}
+
+bool __wrap_libspdm_x509_verify_cert_chain(const uint8_t *root_cert, size_t root_cert_length,
+                                           const uint8_t *cert_chain,
+                                           size_t cert_chain_length)
+{
+    uint8_t issuer_hash[SPDM_EMU_TRUST_CACHE_HASH_SIZE];
+    uint8_t cert_hash[SPDM_EMU_TRUST_CACHE_HASH_SIZE];
+    const uint8_t *issuer;
+    size_t issuer_size;
+    const uint8_t *cert;
+    size_t cert_size;
+    size_t offset;
+    int32_t index;
+
+    if (!m_trust_cache_running) {
+        return __real_libspdm_x509_verify_cert_chain(root_cert, root_cert_length, cert_chain,
+                                                     cert_chain_length);
+    }
+
+    /* Walk the chain the way libspdm does. Anything unexpected is left to libspdm.*/
+    offset = 0;
+    for (index = 0; offset < cert_chain_length; index++) {
+        if ((cert_chain[offset] != 0x30) ||
+            !libspdm_x509_get_cert_from_cert_chain(cert_chain, cert_chain_length, index,
+                                                   &cert, &cert_size) ||
+            (cert != cert_chain + offset)) {
+            break;
+        }
+        offset += cert_size;
+    }
+    if ((offset != cert_chain_length) || (index == 0) ||
+        !trust_cache_hash(root_cert, root_cert_length, issuer_hash)) {
+        return __real_libspdm_x509_verify_cert_chain(root_cert, root_cert_length, cert_chain,
+                                                     cert_chain_length);
+    }
+
+    issuer = root_cert;
+    issuer_size = root_cert_length;
+    offset = 0;
+    while (offset < cert_chain_length) {
+        libspdm_x509_get_cert_from_cert_chain(cert_chain + offset, cert_chain_length - offset,
+                                              0, &cert, &cert_size);
+        if (!trust_cache_hash(cert, cert_size, cert_hash) ||
+            !trust_cache_verify_link(issuer, issuer_size, issuer_hash, cert, cert_size,
+                                     cert_hash)) {
+            return false;
+        }
+        libspdm_copy_mem(issuer_hash, sizeof(issuer_hash), cert_hash, sizeof(cert_hash));
+        issuer = cert;
+        issuer_size = cert_size;
+        offset += cert_size;
+    }
+    return true;
+}
+
+/**
+ * Revoke a certificate. A chain that holds it fails from now on, and the cached links to and
+ * from it are dropped.
+ *
+ * @param  cert_hash                     The SHA-256 of the DER certificate.
+ *
+ * @retval true  The certificate is revoked.
+ * @retval false The cache is not running, or there is no memory.
+ **/
+bool spdm_emu_trust_cache_revoke(const uint8_t *cert_hash)
+{
+    trust_cache_revoked_t *revoked;
+    trust_cache_link_t **link;
+    trust_cache_link_t *entry;
+    uint32_t bucket;
+
+    if (!m_trust_cache_running) {
+        return false;
+    }
+    spdm_emu_mutex_lock(&m_trust_cache_lock);
+    if (!trust_cache_is_revoked(cert_hash)) {
+        revoked = (void *)malloc(sizeof(trust_cache_revoked_t));
+        if (revoked == NULL) {
+            spdm_emu_mutex_unlock(&m_trust_cache_lock);
+            return false;
+        }
+        libspdm_copy_mem(revoked->cert_hash, sizeof(revoked->cert_hash),
+                         cert_hash, SPDM_EMU_TRUST_CACHE_HASH_SIZE);
+        revoked->next = m_trust_cache_revoked;
+        m_trust_cache_revoked = revoked;
+    }
+    for (bucket = 0; bucket < TRUST_CACHE_BUCKET_COUNT; bucket++) {
+        link = &m_trust_cache_bucket[bucket];
+        while (*link != NULL) {
+            entry = *link;
+            if ((libspdm_const_compare_mem(entry->subject_hash, cert_hash,
+                                           SPDM_EMU_TRUST_CACHE_HASH_SIZE) == 0) ||
+                (libspdm_const_compare_mem(entry->issuer_hash, cert_hash,
+                                           SPDM_EMU_TRUST_CACHE_HASH_SIZE) == 0)) {
+                *link = entry->next;
+                free(entry);
+                m_trust_cache_link_count--;
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+    spdm_emu_mutex_unlock(&m_trust_cache_lock);
+    return true;
+}
+
+/**
+ * Forget all the verified links, for instance after the trusted root certificates change.
+ * The revoked certificates stay revoked.
+ **/
+void spdm_emu_trust_cache_flush(void)
+{
+    trust_cache_link_t *entry;
+    uint32_t bucket;
+
+    if (!m_trust_cache_running) {
+        return;
+    }
+    spdm_emu_mutex_lock(&m_trust_cache_lock);
+    for (bucket = 0; bucket < TRUST_CACHE_BUCKET_COUNT; bucket++) {
+        while (m_trust_cache_bucket[bucket] != NULL) {
+            entry = m_trust_cache_bucket[bucket];
+            m_trust_cache_bucket[bucket] = entry->next;
+            free(entry);
+        }
+    }
+    m_trust_cache_link_count = 0;
+    spdm_emu_mutex_unlock(&m_trust_cache_lock);
+}
+
+/* A line is the hex SHA-256 of a certificate, ':' and blanks between the digits are ignored.*/
+static bool trust_revoke_parse_line(const char *line, uint8_t *cert_hash)
+{
+    uint32_t digit_count;
+    uint8_t digit;
+    char c;
+
+    digit_count = 0;
+    for (; *line != '\0'; line++) {
+        c = *line;
+        if ((c == ':') || (c == ' ') || (c == '\t') || (c == '\r')) {
+            continue;
+        }
+        if ((c >= '0') && (c <= '9')) {
+            digit = (uint8_t)(c - '0');
+        } else if ((c >= 'a') && (c <= 'f')) {
+            digit = (uint8_t)(c - 'a' + 10);
+        } else if ((c >= 'A') && (c <= 'F')) {
+            digit = (uint8_t)(c - 'A' + 10);
+        } else {
+            return false;
+        }
+        if (digit_count == SPDM_EMU_TRUST_CACHE_HASH_SIZE * 2) {
+            return false;
+        }
+        if ((digit_count % 2) == 0) {
+            cert_hash[digit_count / 2] = (uint8_t)(digit << 4);
+        } else {
+            cert_hash[digit_count / 2] |= digit;
+        }
+        digit_count++;
+    }
+    return digit_count == SPDM_EMU_TRUST_CACHE_HASH_SIZE * 2;
+}
+
+static bool trust_revoke_load(const char *file_name)
+{
+    spdm_emu_file_view_t *view;
+    const void *data;
+    size_t size;
+    const char *text;
+    char line[TRUST_REVOKE_MAX_LINE_SIZE];
+    uint8_t cert_hash[SPDM_EMU_TRUST_CACHE_HASH_SIZE];
+    size_t offset;
+    size_t line_size;
+    size_t start;
+    uint32_t line_number;
+    uint32_t count;
+    bool result;
+
+    view = spdm_emu_map_input_file(file_name, &data, &size);
+    if (view == NULL) {
+        return false;
+    }
+    text = data;
+    result = true;
+    line_number = 0;
+    count = 0;
+    for (offset = 0; result && (offset < size); offset += line_size + 1) {
+        line_number++;
+        for (line_size = 0; (offset + line_size < size) && (text[offset + line_size] != '\n');
+             line_size++) {
+        }
+        if (line_size >= sizeof(line)) {
+            printf("TrustCache fail - line %u is too long\n", line_number);
+            result = false;
+            break;
+        }
+        libspdm_copy_mem(line, sizeof(line), text + offset, line_size);
+        line[line_size] = '\0';
+        for (start = 0; (line[start] == ' ') || (line[start] == '\t'); start++) {
+        }
+        if ((line[start] == '\0') || (line[start] == '\r') || (line[start] == '#')) {
+            continue;
+        }
+        if (!trust_revoke_parse_line(line + start, cert_hash)) {
+            printf("TrustCache fail - invalid hash at line %u\n", line_number);
+            result = false;
+            break;
+        }
+        result = spdm_emu_trust_cache_revoke(cert_hash);
+        count++;
+    }
+    spdm_emu_release_file_view(view);
+    if (result) {
+        printf("TrustCache - %u revoked certificates\n", count);
+    }
+    return result;
+}
+
+/**
+ * Start the cache of --trust_cache_ttl and load --trust_revoke.
+ **/
+bool spdm_emu_trust_cache_init(void)
+{
+    if (((m_trust_cache_ttl == 0) && (m_trust_revoke_file_name == NULL)) ||
+        m_trust_cache_running) {
+        return true;
+    }
+    spdm_emu_mutex_init(&m_trust_cache_lock);
+    m_trust_cache_running = true;
+    if ((m_trust_revoke_file_name != NULL) && !trust_revoke_load(m_trust_revoke_file_name)) {
+        spdm_emu_trust_cache_free();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Print the hits and misses, and free the cache. No SPDM context may be verifying a chain.
+ **/
+void spdm_emu_trust_cache_free(void)
+{
+    trust_cache_revoked_t *revoked;
+
+    if (!m_trust_cache_running) {
+        return;
+    }
+    printf("TrustCache - hit %u, miss %u, revoked %u\n", m_trust_cache_hit_count,
+           m_trust_cache_miss_count, m_trust_cache_revoked_count);
+    spdm_emu_trust_cache_flush();
+    while (m_trust_cache_revoked != NULL) {
+        revoked = m_trust_cache_revoked;
+        m_trust_cache_revoked = revoked->next;
+        free(revoked);
+    }
+    spdm_emu_mutex_destroy(&m_trust_cache_lock);
+    m_trust_cache_running = false;
+}
+
+#else
+
+bool spdm_emu_trust_cache_init(void)
+{
+    if ((m_trust_cache_ttl != 0) || (m_trust_revoke_file_name != NULL)) {
+        printf("TrustCache - --trust_cache_ttl and --trust_revoke are not supported by this build\n");
+        return false;
+    }
+    return true;
+}
+
+void spdm_emu_trust_cache_free(void)
+{
+}
+
+bool spdm_emu_trust_cache_revoke(const uint8_t *cert_hash)
+{
+    return false;
+}
+
+void spdm_emu_trust_cache_flush(void)
+{
+}
+
+#endif /* SPDM_EMU_TRUST_CACHE*/
@@ -0,0 +1,603 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_replay.h"
+
+#define REPLAY_PACE_MAX 0
+#define REPLAY_PACE_RECORDED 1
+
+#define REPLAY_SECURED_SKIP 0
+#define REPLAY_SECURED_SEND 1
+
+/* Statistics are kept per SPDM request code, plus one class for secured messages and one
+ * for the other messages of the transport, such as the DOE discovery.*/
+#define REPLAY_MESSAGE_CLASS_SECURED 256
+#define REPLAY_MESSAGE_CLASS_OTHER 257
+#define REPLAY_MESSAGE_CLASS_COUNT 258
+
+/* command, transport type and payload size in front of each platform port message*/
+#define REPLAY_PLATFORM_HEADER_SIZE (3 * sizeof(uint32_t))
+
+typedef struct {
+    /* capture time, in nanoseconds*/
+    uint64_t timestamp;
+    uint32_t message_class;
+    uint8_t *data;
+    size_t size;
+} replay_request_t;
+
+char *m_replay_capture_file_name;
+uint32_t m_replay_pace = REPLAY_PACE_MAX;
+uint32_t m_replay_secured = REPLAY_SECURED_SKIP;
+uint32_t m_replay_loop_count = 1;
+uint32_t m_replay_timeout_ms = 5000;
+
+replay_request_t *m_replay_request;
+size_t m_replay_request_count;
+size_t m_replay_request_capacity;
+size_t m_replay_skipped_secured_count;
+size_t m_replay_skipped_truncated_count;
+
+uint8_t m_replay_receive_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
+
+spdm_emu_stats_t *m_replay_stats[REPLAY_MESSAGE_CLASS_COUNT];
+spdm_emu_stats_t m_replay_total_stats;
+uint64_t m_replay_bytes_sent;
+uint64_t m_replay_bytes_received;
+uint64_t m_replay_error_response_count;
+uint64_t m_replay_timeout_count;
+/* responses that came after their timeout, dropped by replay_sync*/
+uint64_t m_replay_late_response_count;
+
+void print_replay_usage(const char *name)
+{
+    printf("\n%s --capture <pcap_file_name>\n", name);
+    printf("   [--pace MAX|RECORDED]\n");
+    printf("   [--loop <count>]\n");
+    printf("   [--secured SKIP|SEND]\n");
+    printf("   [--timeout <ms>]\n");
+    printf("   [--trans MCTP|PCI_DOE|TCP|NONE] [--exe_mode SHUTDOWN|CONTINUE] [--pcap <pcap_file_name>] [--log_level ERROR|INFO|DEBUG|VERBOSE]\n");
+    printf("\n");
+    printf("NOTE:\n");
+    printf(
+        "   [--capture] is the pcap or pcap-ng file recorded with --pcap by spdm_requester_emu or spdm_responder_emu.\n");
+    printf(
+        "           The requester to responder messages are sent to spdm_responder_emu, each one after the response to the previous one.\n");
+    printf(
+        "           The transport is taken from the capture. --trans is only accepted if it matches.\n");
+    printf(
+        "   [--pace] is used to select the send time. By default, it is MAX.\n");
+    printf(
+        "           MAX sends the next request as soon as the response is received. RECORDED keeps the time offsets of the capture.\n");
+    printf("   [--loop] is used to replay the capture several times on the same connection. By default, it is 1.\n");
+    printf(
+        "   [--secured] is used to select what to do with the messages of an SPDM session. By default, it is SKIP.\n");
+    printf(
+        "           The session keys of the replay differ from the recorded ones, so the responder cannot decrypt them and does not answer.\n");
+    printf(
+        "           SEND still sends them, to measure the cost of a failed decryption, and counts each one as a timeout.\n");
+    printf(
+        "   [--timeout] is the time to wait for a response, in milliseconds. By default, it is 5000.\n");
+    printf(
+        "           After a timeout, a TEST command is sent and the frames up to its answer are dropped, so that a late response is not taken for the next one.\n");
+}
+
+/**
+ * Locate the SPDM message in a platform port message.
+ *
+ * @return the message class, the SPDM request code or one of REPLAY_MESSAGE_CLASS_*.
+ **/
+static uint32_t replay_get_message_class(const uint8_t *data, size_t size,
+                                         const uint8_t **spdm_message)
+{
+    pci_doe_data_object_header_t doe_header;
+    tcp_spdm_binding_header_t tcp_header;
+    size_t header_size;
+
+    *spdm_message = NULL;
+    switch (m_use_transport_layer) {
+    case SOCKET_TRANSPORT_TYPE_MCTP:
+        if (size < sizeof(mctp_message_header_t)) {
+            return REPLAY_MESSAGE_CLASS_OTHER;
+        }
+        if (data[0] == MCTP_MESSAGE_TYPE_SECURED_MCTP) {
+            return REPLAY_MESSAGE_CLASS_SECURED;
+        }
+        if (data[0] != MCTP_MESSAGE_TYPE_SPDM) {
+            return REPLAY_MESSAGE_CLASS_OTHER;
+        }
+        header_size = sizeof(mctp_message_header_t);
+        break;
+
+    case SOCKET_TRANSPORT_TYPE_PCI_DOE:
+        if (size < sizeof(doe_header)) {
+            return REPLAY_MESSAGE_CLASS_OTHER;
+        }
+        libspdm_copy_mem(&doe_header, sizeof(doe_header), data, sizeof(doe_header));
+        if (doe_header.data_object_type == PCI_DOE_DATA_OBJECT_TYPE_SECURED_SPDM) {
+            return REPLAY_MESSAGE_CLASS_SECURED;
+        }
+        if (doe_header.data_object_type != PCI_DOE_DATA_OBJECT_TYPE_SPDM) {
+            return REPLAY_MESSAGE_CLASS_OTHER;
+        }
+        header_size = sizeof(doe_header);
+        break;
+
+    case SOCKET_TRANSPORT_TYPE_TCP:
+        if (size < sizeof(tcp_header)) {
+            return REPLAY_MESSAGE_CLASS_OTHER;
+        }
+        libspdm_copy_mem(&tcp_header, sizeof(tcp_header), data, sizeof(tcp_header));
+        if (tcp_header.message_type == TCP_MESSAGE_TYPE_IN_SESSION) {
+            return REPLAY_MESSAGE_CLASS_SECURED;
+        }
+        if (tcp_header.message_type != TCP_MESSAGE_TYPE_OUT_OF_SESSION) {
+            return REPLAY_MESSAGE_CLASS_OTHER;
+        }
+        header_size = sizeof(tcp_header);
+        break;
+
+    default:
+        header_size = 0;
+        break;
+    }
+
+    if (size < header_size + sizeof(spdm_message_header_t)) {
+        return REPLAY_MESSAGE_CLASS_OTHER;
+    }
+    *spdm_message = data + header_size;
+    return ((const spdm_message_header_t *)*spdm_message)->request_response_code;
+}
+
+static bool replay_add_record(void *context, const pcap_packet_record_t *record)
+{
+    replay_request_t *request;
+    const uint8_t *spdm_message;
+    uint32_t message_class;
+
+    if (!record->is_request) {
+        return true;
+    }
+    if (record->is_truncated) {
+        m_replay_skipped_truncated_count++;
+        return true;
+    }
+    message_class = replay_get_message_class(record->data, record->size, &spdm_message);
+    if ((message_class == REPLAY_MESSAGE_CLASS_SECURED) &&
+        (m_replay_secured == REPLAY_SECURED_SKIP)) {
+        m_replay_skipped_secured_count++;
+        return true;
+    }
+
+    if (m_replay_request_count == m_replay_request_capacity) {
+        m_replay_request_capacity =
+            (m_replay_request_capacity == 0) ? 256 : m_replay_request_capacity * 2;
+        request = (void *)realloc(m_replay_request,
+                                  m_replay_request_capacity * sizeof(replay_request_t));
+        if (request == NULL) {
+            printf("No sufficient memory to load %s\n", m_replay_capture_file_name);
+            return false;
+        }
+        m_replay_request = request;
+    }
+
+    request = &m_replay_request[m_replay_request_count];
+    request->data = (void *)malloc(record->size == 0 ? 1 : record->size);
+    if (request->data == NULL) {
+        printf("No sufficient memory to load %s\n", m_replay_capture_file_name);
+        return false;
+    }
+    libspdm_copy_mem(request->data, record->size, record->data, record->size);
+    request->size = record->size;
+    request->timestamp = record->timestamp;
+    request->message_class = message_class;
+    m_replay_request_count++;
+    return true;
+}
+
+static void replay_free_requests(void)
+{
+    size_t index;
+
+    for (index = 0; index < m_replay_request_count; index++) {
+        free(m_replay_request[index].data);
+    }
+    free(m_replay_request);
+    m_replay_request = NULL;
+    m_replay_request_count = 0;
+    m_replay_request_capacity = 0;
+
+    for (index = 0; index < REPLAY_MESSAGE_CLASS_COUNT; index++) {
+        free(m_replay_stats[index]);
+        m_replay_stats[index] = NULL;
+    }
+}
+
+static bool replay_record_latency(uint32_t message_class, uint64_t latency)
+{
+    if (m_replay_stats[message_class] == NULL) {
+        m_replay_stats[message_class] = (void *)malloc(sizeof(spdm_emu_stats_t));
+        if (m_replay_stats[message_class] == NULL) {
+            return false;
+        }
+        spdm_emu_stats_init(m_replay_stats[message_class]);
+    }
+    spdm_emu_stats_record(m_replay_stats[message_class], latency);
+    spdm_emu_stats_record(&m_replay_total_stats, latency);
+    return true;
+}
+
+/**
+ * Wait until a response can be read.
+ *
+ * @retval  1 A response is pending.
+ * @retval  0 The timeout expired.
+ * @retval -1 The socket failed.
+ **/
+static int replay_wait_response(SOCKET socket)
+{
+    fd_set read_fds;
+    struct timeval timeout;
+    int ret;
+
+    do {
+        FD_ZERO(&read_fds);
+        FD_SET(socket, &read_fds);
+        timeout.tv_sec = m_replay_timeout_ms / 1000;
+        timeout.tv_usec = (m_replay_timeout_ms % 1000) * 1000;
+        ret = select((int)(socket + 1), &read_fds, NULL, NULL, &timeout);
+#ifndef _MSC_VER
+    } while ((ret < 0) && (errno == EINTR));
+#else
+    } while (false);
+#endif
+    if (ret < 0) {
+        printf("Select error.  Error is 0x%x\n",
+#ifdef _MSC_VER
+               WSAGetLastError()
+#else
+               errno
+#endif
+               );
+        return -1;
+    }
+    return ret == 0 ? 0 : 1;
+}
+
+/**
+ * After a timeout, the response may still come and would be taken for the response to the
+ * next request. Send a TEST command behind it and drop every frame up to its answer, as the
+ * responder handles the frames of a connection in order.
+ **/
+static bool replay_sync(SOCKET socket)
+{
+    uint32_t command;
+    size_t response_size;
+    int ret;
+
+    if (!send_platform_data(socket, SOCKET_SPDM_COMMAND_TEST, (uint8_t *)"Replay Sync!",
+                            sizeof("Replay Sync!"))) {
+        return false;
+    }
+    while (true) {
+        ret = replay_wait_response(socket);
+        if (ret <= 0) {
+            if (ret == 0) {
+                printf("No answer to TEST after a timeout\n");
+            }
+            return false;
+        }
+        response_size = sizeof(m_replay_receive_buffer);
+        if (!receive_platform_data(socket, &command, m_replay_receive_buffer, &response_size)) {
+            return false;
+        }
+        if (command == SOCKET_SPDM_COMMAND_TEST) {
+            return true;
+        }
+        m_replay_late_response_count++;
+    }
+}
+
+/**
+ * Send one recorded request and wait for its response.
+ **/
+static bool replay_send_request(SOCKET socket, const replay_request_t *request)
+{
+    uint64_t start;
+    uint64_t latency;
+    uint32_t command;
+    size_t response_size;
+    const uint8_t *spdm_message;
+    int ret;
+
+    start = spdm_emu_get_monotonic_ns();
+    if (!send_platform_data(socket, SOCKET_SPDM_COMMAND_NORMAL, request->data,
+                            request->size)) {
+        return false;
+    }
+    m_replay_bytes_sent += REPLAY_PLATFORM_HEADER_SIZE + request->size;
+
+    ret = replay_wait_response(socket);
+    if (ret < 0) {
+        return false;
+    }
+    if (ret == 0) {
+        m_replay_timeout_count++;
+        return replay_sync(socket);
+    }
+
+    response_size = sizeof(m_replay_receive_buffer);
+    if (!receive_platform_data(socket, &command, m_replay_receive_buffer, &response_size)) {
+        return false;
+    }
+    latency = spdm_emu_get_monotonic_ns() - start;
+    m_replay_bytes_received += REPLAY_PLATFORM_HEADER_SIZE + response_size;
+
+    if (!replay_record_latency(request->message_class, latency)) {
+        return false;
+    }
+    if ((replay_get_message_class(m_replay_receive_buffer, response_size,
+                                  &spdm_message) == SPDM_ERROR) ||
+        (command != SOCKET_SPDM_COMMAND_NORMAL)) {
+        m_replay_error_response_count++;
+    }
+    return true;
+}
+
+static void replay_print_report(uint64_t elapsed)
+{
+    spdm_emu_stats_t *stats;
+    uint32_t message_class;
+    const char *name;
+    char code_name[8];
+    char value[16];
+    double seconds;
+
+    seconds = (double)elapsed / 1000000000;
+    if (seconds <= 0) {
+        seconds = 1e-9;
+    }
+
+    printf("\nReplayed %llu requests in %s: %.1f requests/s, sent %.1f KB/s, received %.1f KB/s\n",
+           (unsigned long long)m_replay_total_stats.count,
+           spdm_emu_format_duration(value, sizeof(value), elapsed),
+           (double)m_replay_total_stats.count / seconds,
+           (double)m_replay_bytes_sent / 1024 / seconds,
+           (double)m_replay_bytes_received / 1024 / seconds);
+    printf("ERROR responses: %llu, timeouts: %llu, late responses dropped: %llu\n",
+           (unsigned long long)m_replay_error_response_count,
+           (unsigned long long)m_replay_timeout_count,
+           (unsigned long long)m_replay_late_response_count);
+    printf("Skipped from the capture: %u secured, %u truncated\n",
+           (uint32_t)m_replay_skipped_secured_count,
+           (uint32_t)m_replay_skipped_truncated_count);
+
+    if (m_replay_total_stats.count == 0) {
+        return;
+    }
+
+    printf("\n");
+    spdm_emu_stats_print_header("request");
+    for (message_class = 0; message_class < REPLAY_MESSAGE_CLASS_COUNT; message_class++) {
+        stats = m_replay_stats[message_class];
+        if (stats == NULL) {
+            continue;
+        }
+        if (message_class == REPLAY_MESSAGE_CLASS_SECURED) {
+            name = "SECURED";
+        } else if (message_class == REPLAY_MESSAGE_CLASS_OTHER) {
+            name = "OTHER";
+        } else {
+            name = spdm_emu_get_request_name((uint8_t)message_class);
+            if (name == NULL) {
+                snprintf(code_name, sizeof(code_name), "0x%02x", message_class);
+                name = code_name;
+            }
+        }
+        spdm_emu_stats_print_row(name, stats);
+    }
+
+    printf("\nLatency histogram of all requests:\n");
+    spdm_emu_stats_print_histogram(&m_replay_total_stats);
+}
+
+bool replay_routine(uint16_t port_number)
+{
+    SOCKET platform_socket;
+    bool result;
+    uint32_t response;
+    size_t response_size;
+    uint32_t loop;
+    size_t index;
+    uint64_t start;
+    uint64_t loop_start;
+    uint64_t target;
+    uint64_t now;
+
+    result = init_client(&platform_socket, port_number);
+    if (!result) {
+#ifdef _MSC_VER
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    if (m_use_transport_layer != SOCKET_TRANSPORT_TYPE_NONE) {
+        response_size = sizeof(m_replay_receive_buffer);
+        if (!send_platform_data(platform_socket, SOCKET_SPDM_COMMAND_TEST,
+                                (uint8_t *)"Client Hello!", sizeof("Client Hello!")) ||
+            !receive_platform_data(platform_socket, &response, m_replay_receive_buffer,
+                                   &response_size)) {
+            result = false;
+            goto done;
+        }
+    }
+
+    spdm_emu_stats_init(&m_replay_total_stats);
+    start = spdm_emu_get_monotonic_ns();
+    for (loop = 0; loop < m_replay_loop_count; loop++) {
+        loop_start = spdm_emu_get_monotonic_ns();
+        for (index = 0; index < m_replay_request_count; index++) {
+            if (m_replay_pace == REPLAY_PACE_RECORDED) {
+                /* If the replay is behind the capture, send at once.*/
+                target = loop_start +
+                         (m_replay_request[index].timestamp - m_replay_request[0].timestamp);
+                now = spdm_emu_get_monotonic_ns();
+                if (target > now) {
+                    spdm_emu_sleep_us((target - now) / 1000);
+                }
+            }
+            result = replay_send_request(platform_socket, &m_replay_request[index]);
+            if (!result) {
+                printf("Replay stopped at request %u of loop %u\n", (uint32_t)index, loop);
+                goto done;
+            }
+        }
+    }
+    replay_print_report(spdm_emu_get_monotonic_ns() - start);
+
+done:
+    response_size = sizeof(m_replay_receive_buffer);
+    if (send_platform_data(platform_socket, SOCKET_SPDM_COMMAND_SHUTDOWN - m_exe_mode,
+                           NULL, 0)) {
+        receive_platform_data(platform_socket, &response, m_replay_receive_buffer,
+                              &response_size);
+    }
+
+    closesocket(platform_socket);
+
+#ifdef _MSC_VER
+    WSACleanup();
+#endif
+
+    return result;
+}
+
+/**
+ * Take the replay options out of argv. The other options are left for process_args.
+ **/
+void process_replay_args(char *program_name, int *argc, char *argv[])
+{
+    int index;
+    int common_argc;
+
+    common_argc = 1;
+    for (index = 1; index < *argc; index++) {
+        if ((strcmp(argv[index], "-h") == 0) || (strcmp(argv[index], "--help") == 0)) {
+            print_replay_usage(program_name);
+            exit(0);
+        }
+
+        if ((strcmp(argv[index], "--capture") == 0) ||
+            (strcmp(argv[index], "--pace") == 0) ||
+            (strcmp(argv[index], "--loop") == 0) ||
+            (strcmp(argv[index], "--secured") == 0) ||
+            (strcmp(argv[index], "--timeout") == 0)) {
+            if (index + 1 >= *argc) {
+                printf("invalid %s\n", argv[index]);
+                print_replay_usage(program_name);
+                exit(0);
+            }
+        } else {
+            argv[common_argc++] = argv[index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--capture") == 0) {
+            m_replay_capture_file_name = argv[index + 1];
+            printf("capture - %s\n", m_replay_capture_file_name);
+        } else if (strcmp(argv[index], "--pace") == 0) {
+            if (strcmp(argv[index + 1], "MAX") == 0) {
+                m_replay_pace = REPLAY_PACE_MAX;
+            } else if (strcmp(argv[index + 1], "RECORDED") == 0) {
+                m_replay_pace = REPLAY_PACE_RECORDED;
+            } else {
+                printf("invalid --pace %s\n", argv[index + 1]);
+                print_replay_usage(program_name);
+                exit(0);
+            }
+            printf("pace - %s\n", argv[index + 1]);
+        } else if (strcmp(argv[index], "--loop") == 0) {
+            m_replay_loop_count = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            if (m_replay_loop_count == 0) {
+                printf("invalid --loop %s\n", argv[index + 1]);
+                print_replay_usage(program_name);
+                exit(0);
+            }
+            printf("loop - %d\n", m_replay_loop_count);
+        } else if (strcmp(argv[index], "--secured") == 0) {
+            if (strcmp(argv[index + 1], "SKIP") == 0) {
+                m_replay_secured = REPLAY_SECURED_SKIP;
+            } else if (strcmp(argv[index + 1], "SEND") == 0) {
+                m_replay_secured = REPLAY_SECURED_SEND;
+            } else {
+                printf("invalid --secured %s\n", argv[index + 1]);
+                print_replay_usage(program_name);
+                exit(0);
+            }
+            printf("secured - %s\n", argv[index + 1]);
+        } else {
+            m_replay_timeout_ms = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            if (m_replay_timeout_ms == 0) {
+                printf("invalid --timeout %s\n", argv[index + 1]);
+                print_replay_usage(program_name);
+                exit(0);
+            }
+            printf("timeout - %d\n", m_replay_timeout_ms);
+        }
+        index++;
+    }
+    *argc = common_argc;
+
+    if (m_replay_capture_file_name == NULL) {
+        printf("--capture is required\n");
+        print_replay_usage(program_name);
+        exit(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t capture_transport_layer;
+    bool result;
+
+    printf("%s version 0.1\n", "spdm_replay");
+
+    process_replay_args("spdm_replay", &argc, argv);
+
+    /* The records are classified with the transport of the capture.*/
+    if (!read_pcap_packet_file(m_replay_capture_file_name, &m_use_transport_layer,
+                               replay_add_record, NULL)) {
+        replay_free_requests();
+        return 1;
+    }
+    capture_transport_layer = m_use_transport_layer;
+    printf("%u requests loaded from %s\n", (uint32_t)m_replay_request_count,
+           m_replay_capture_file_name);
+
+    /* Parse the common options last, so that --pcap opens its file with the final transport.*/
+    process_args("spdm_replay", argc, argv);
+    if (m_use_transport_layer != capture_transport_layer) {
+        printf("The capture uses trans 0x%x, not 0x%x\n", capture_transport_layer,
+               m_use_transport_layer);
+        replay_free_requests();
+        return 1;
+    }
+    if ((m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP) &&
+        (m_use_tcp_handshake == SOCKET_TCP_HANDSHAKE)) {
+        printf("--tcp_sub HS is not supported by the replay\n");
+        replay_free_requests();
+        return 1;
+    }
+
+    result = replay_routine(m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP ?
+                            TCP_SPDM_PLATFORM_PORT : DEFAULT_SPDM_PLATFORM_PORT);
+    printf("Replay stopped\n");
+
+    close_pcap_packet_file();
+    replay_free_requests();
+    return result ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef __SPDM_REPLAY_H__
+#define __SPDM_REPLAY_H__
+
+#include "hal/base.h"
+#include "hal/library/memlib.h"
+#include "library/spdm_transport_none_lib.h"
+#include "library/spdm_transport_mctp_lib.h"
+#include "library/spdm_transport_pcidoe_lib.h"
+#include "library/spdm_transport_tcp_lib.h"
+#include "industry_standard/mctp.h"
+#include "industry_standard/pcidoe.h"
+
+#include "os_include.h"
+#include "stdio.h"
+#include "spdm_emu.h"
+
+#endif
@@ -8,8 +8,6 @@
 
 #if (LIBSPDM_ENABLE_CAPABILITY_CERT_CAP && LIBSPDM_ENABLE_CAPABILITY_CHAL_CAP)
 
-extern void *m_spdm_context;
-
 /**
  * This function sends GET_DIGEST, GET_CERTIFICATE, CHALLENGE
  * to authenticate the device.
@@ -58,7 +56,7 @@ spdm_authentication(void *context, uint8_t *slot_mask,
     if ((m_exe_connection & EXE_CONNECTION_CERT) != 0) {
         if (slot_id != 0xFF) {
             if (slot_id == 0) {
-                status = libspdm_get_certificate(
+                status = spdm_requester_get_certificate(
                     context, NULL, 0, cert_chain_size, cert_chain);
                 if (LIBSPDM_STATUS_IS_ERROR(status)) {
                     return status;
@@ -66,14 +64,14 @@ spdm_authentication(void *context, uint8_t *slot_mask,
                 if (m_other_slot_id != 0) {
                     *cert_chain_size = cert_chain_buffer_size;
                     libspdm_zero_mem(cert_chain, cert_chain_buffer_size);
-                    status = libspdm_get_certificate(
+                    status = spdm_requester_get_certificate(
                         context, NULL, m_other_slot_id, cert_chain_size, cert_chain);
                     if (LIBSPDM_STATUS_IS_ERROR(status)) {
                         return status;
                     }
                 }
             } else {
-                status = libspdm_get_certificate(
+                status = spdm_requester_get_certificate(
                     context, NULL, slot_id, cert_chain_size, cert_chain);
                 if (LIBSPDM_STATUS_IS_ERROR(status)) {
                     return status;
@@ -101,7 +99,7 @@ spdm_authentication(void *context, uint8_t *slot_mask,
     if ((m_exe_connection & EXE_CONNECTION_CERT) != 0) {
         if (slot_id != 0xFF) {
             *cert_chain_size = cert_chain_buffer_size;
-            status = libspdm_get_certificate(
+            status = spdm_requester_get_certificate(
                 context, NULL, slot_id, cert_chain_size, cert_chain);
             if (LIBSPDM_STATUS_IS_ERROR(status)) {
                 return status;
@@ -125,18 +123,15 @@ spdm_authentication(void *context, uint8_t *slot_mask,
  *
  * @param[in]  spdm_context            The SPDM context for the device.
  **/
-libspdm_return_t do_authentication_via_spdm(void)
+libspdm_return_t do_authentication_via_spdm(void *spdm_context)
 {
     libspdm_return_t status;
-    void *spdm_context;
     uint8_t slot_mask;
     uint8_t total_digest_buffer[LIBSPDM_MAX_HASH_SIZE * SPDM_MAX_SLOT_COUNT];
     uint8_t measurement_hash[LIBSPDM_MAX_HASH_SIZE];
     size_t cert_chain_size;
     uint8_t cert_chain[LIBSPDM_MAX_CERT_CHAIN_SIZE];
 
-    spdm_context = m_spdm_context;
-
     libspdm_zero_mem(total_digest_buffer, sizeof(total_digest_buffer));
     cert_chain_size = sizeof(cert_chain);
     libspdm_zero_mem(cert_chain, sizeof(cert_chain));
@@ -0,0 +1,357 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_requester_emu.h"
+
+#if LIBSPDM_ENABLE_CAPABILITY_CERT_CAP
+
+/* With --peer_cert_cache <dir>, the certificate chains received from the responders are kept in
+ * <dir>, one file per slot, hash algorithm, trust anchor and chain digest. When GET_DIGESTS
+ * returns the digest of a cached chain, the chain is provisioned into the SPDM context and
+ * GET_CERTIFICATE is skipped. The digest is the hash of the whole chain, so it identifies the
+ * responder identity.
+ * A cached file is hashed again, and verified against the provisioned root certificates with
+ * libspdm_x509_verify_cert_chain (so --trust_revoke applies), before it is used. The trust
+ * anchor in the file name is the SHA-256 of the root certificates, so changing the roots does
+ * not pick up the chains cached under the old ones. Without a root certificate, as with
+ * PUB_KEY_ID, the cache is not used.*/
+
+#define PEER_CERT_CACHE_MAX_FILE_NAME_SIZE 1024
+#define PEER_CERT_CACHE_MAX_ROOT_COUNT 8
+#define PEER_CERT_CACHE_ROOT_HASH_SIZE 32
+
+typedef struct {
+    uint8_t *cert;
+    size_t cert_size;
+    uint8_t cert_hash[PEER_CERT_CACHE_ROOT_HASH_SIZE];
+} peer_cert_cache_root_t;
+
+bool m_peer_cert_cache_initialized;
+spdm_emu_mutex_t m_peer_cert_cache_lock;
+uint32_t m_peer_cert_cache_hit_count;
+uint32_t m_peer_cert_cache_miss_count;
+/* An entry is not changed once it is counted, so it is read without the lock.*/
+peer_cert_cache_root_t m_peer_cert_cache_root[PEER_CERT_CACHE_MAX_ROOT_COUNT];
+uint32_t m_peer_cert_cache_root_count;
+/* SHA-256 of the root certificate hashes, in the order they were added*/
+uint8_t m_peer_cert_cache_root_id[PEER_CERT_CACHE_ROOT_HASH_SIZE];
+
+void spdm_requester_cert_cache_init(void)
+{
+    if ((m_peer_cert_cache_dir == NULL) || m_peer_cert_cache_initialized) {
+        return;
+    }
+    spdm_emu_mutex_init(&m_peer_cert_cache_lock);
+    m_peer_cert_cache_initialized = true;
+}
+
+/**
+ * Print the hits and misses of --peer_cert_cache.
+ **/
+void spdm_requester_cert_cache_free(void)
+{
+    uint32_t index;
+
+    if (!m_peer_cert_cache_initialized) {
+        return;
+    }
+    printf("PeerCertCache - hit %u, miss %u\n", m_peer_cert_cache_hit_count,
+           m_peer_cert_cache_miss_count);
+    for (index = 0; index < m_peer_cert_cache_root_count; index++) {
+        free(m_peer_cert_cache_root[index].cert);
+    }
+    m_peer_cert_cache_root_count = 0;
+    spdm_emu_mutex_destroy(&m_peer_cert_cache_lock);
+    m_peer_cert_cache_initialized = false;
+}
+
+/**
+ * Add a root certificate that the chains are verified against. Called by spdm_client_init with
+ * each LIBSPDM_DATA_PEER_PUBLIC_ROOT_CERT it provisions, a root added before is ignored.
+ **/
+void spdm_requester_cert_cache_add_root(const void *root_cert, size_t root_cert_size)
+{
+    peer_cert_cache_root_t *root;
+    uint8_t cert_hash[PEER_CERT_CACHE_ROOT_HASH_SIZE];
+    uint8_t id_data[PEER_CERT_CACHE_ROOT_HASH_SIZE * 2];
+    uint32_t index;
+
+    if (!m_peer_cert_cache_initialized ||
+        !libspdm_hash_all(SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_256, root_cert,
+                          root_cert_size, cert_hash)) {
+        return;
+    }
+    spdm_emu_mutex_lock(&m_peer_cert_cache_lock);
+    for (index = 0; index < m_peer_cert_cache_root_count; index++) {
+        if (libspdm_const_compare_mem(m_peer_cert_cache_root[index].cert_hash, cert_hash,
+                                      sizeof(cert_hash)) == 0) {
+            spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+            return;
+        }
+    }
+    if (m_peer_cert_cache_root_count == PEER_CERT_CACHE_MAX_ROOT_COUNT) {
+        printf("PeerCertCache - too many root certificates\n");
+        spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+        return;
+    }
+    root = &m_peer_cert_cache_root[m_peer_cert_cache_root_count];
+    root->cert = (void *)malloc(root_cert_size);
+    if (root->cert == NULL) {
+        spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+        return;
+    }
+    libspdm_copy_mem(root->cert, root_cert_size, root_cert, root_cert_size);
+    root->cert_size = root_cert_size;
+    libspdm_copy_mem(root->cert_hash, sizeof(root->cert_hash), cert_hash, sizeof(cert_hash));
+
+    libspdm_copy_mem(id_data, sizeof(id_data), m_peer_cert_cache_root_id,
+                     sizeof(m_peer_cert_cache_root_id));
+    libspdm_copy_mem(id_data + sizeof(m_peer_cert_cache_root_id),
+                     sizeof(id_data) - sizeof(m_peer_cert_cache_root_id),
+                     cert_hash, sizeof(cert_hash));
+    if (libspdm_hash_all(SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_256, id_data,
+                         sizeof(id_data), m_peer_cert_cache_root_id)) {
+        m_peer_cert_cache_root_count++;
+    } else {
+        free(root->cert);
+    }
+    spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+}
+
+static void peer_cert_cache_count(bool hit)
+{
+    spdm_emu_mutex_lock(&m_peer_cert_cache_lock);
+    if (hit) {
+        m_peer_cert_cache_hit_count++;
+    } else {
+        m_peer_cert_cache_miss_count++;
+    }
+    spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+}
+
+/**
+ * Get the digest that the last GET_DIGESTS returned for a slot, and the cache file name of the
+ * chain with that digest.
+ *
+ * @retval true  The slot has a digest.
+ * @retval false The digest of the slot is unknown, GET_DIGESTS was not sent.
+ **/
+static bool peer_cert_cache_get_file_name(void *spdm_context, uint8_t slot_id,
+                                          uint32_t *base_hash_algo, uint8_t *digest,
+                                          uint32_t *digest_size, char *file_name,
+                                          size_t file_name_size)
+{
+    uint8_t root_id[PEER_CERT_CACHE_ROOT_HASH_SIZE];
+    libspdm_data_parameter_t parameter;
+    uint8_t slot_mask;
+    uint8_t total_digest_buffer[LIBSPDM_MAX_HASH_SIZE * SPDM_MAX_SLOT_COUNT];
+    size_t data_size;
+    uint32_t hash_size;
+    uint8_t index;
+    uint8_t digest_index;
+    size_t offset;
+    int length;
+
+    spdm_emu_mutex_lock(&m_peer_cert_cache_lock);
+    index = (uint8_t)m_peer_cert_cache_root_count;
+    libspdm_copy_mem(root_id, sizeof(root_id), m_peer_cert_cache_root_id,
+                     sizeof(m_peer_cert_cache_root_id));
+    spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+    if (index == 0) {
+        return false;
+    }
+
+    libspdm_zero_mem(&parameter, sizeof(parameter));
+    parameter.location = LIBSPDM_DATA_LOCATION_CONNECTION;
+    data_size = sizeof(*base_hash_algo);
+    if (LIBSPDM_STATUS_IS_ERROR(libspdm_get_data(spdm_context, LIBSPDM_DATA_BASE_HASH_ALGO,
+                                                 &parameter, base_hash_algo, &data_size))) {
+        return false;
+    }
+    hash_size = libspdm_get_hash_size(*base_hash_algo);
+    data_size = sizeof(slot_mask);
+    if ((hash_size == 0) ||
+        LIBSPDM_STATUS_IS_ERROR(libspdm_get_data(spdm_context, LIBSPDM_DATA_PEER_SLOT_MASK,
+                                                 &parameter, &slot_mask, &data_size)) ||
+        ((slot_mask & (1 << slot_id)) == 0)) {
+        return false;
+    }
+    data_size = sizeof(total_digest_buffer);
+    if (LIBSPDM_STATUS_IS_ERROR(libspdm_get_data(spdm_context,
+                                                 LIBSPDM_DATA_PEER_TOTAL_DIGEST_BUFFER,
+                                                 &parameter, total_digest_buffer,
+                                                 &data_size))) {
+        return false;
+    }
+    /* The digests are in slot order, for the slots in the mask.*/
+    digest_index = 0;
+    for (index = 0; index < slot_id; index++) {
+        if ((slot_mask & (1 << index)) != 0) {
+            digest_index++;
+        }
+    }
+    if ((size_t)(digest_index + 1) * hash_size > data_size) {
+        return false;
+    }
+    libspdm_copy_mem(digest, LIBSPDM_MAX_HASH_SIZE,
+                     total_digest_buffer + digest_index * hash_size, hash_size);
+    *digest_size = hash_size;
+
+    length = snprintf(file_name, file_name_size, "%s/slot%u_%08x_", m_peer_cert_cache_dir,
+                      slot_id, *base_hash_algo);
+    if ((length < 0) ||
+        ((size_t)length + sizeof(root_id) * 2 + 1 + hash_size * 2 + sizeof(".bin") >
+         file_name_size)) {
+        return false;
+    }
+    offset = (size_t)length;
+    for (index = 0; index < sizeof(root_id); index++) {
+        snprintf(file_name + offset, file_name_size - offset, "%02x", root_id[index]);
+        offset += 2;
+    }
+    file_name[offset++] = '_';
+    for (index = 0; index < hash_size; index++) {
+        snprintf(file_name + offset, file_name_size - offset, "%02x", digest[index]);
+        offset += 2;
+    }
+    snprintf(file_name + offset, file_name_size - offset, ".bin");
+    return true;
+}
+
+static bool peer_cert_cache_matches(uint32_t base_hash_algo, const uint8_t *digest,
+                                    uint32_t digest_size, const void *cert_chain,
+                                    size_t cert_chain_size)
+{
+    uint8_t hash[LIBSPDM_MAX_HASH_SIZE];
+
+    return libspdm_hash_all(base_hash_algo, cert_chain, cert_chain_size, hash) &&
+           (libspdm_const_compare_mem(hash, digest, digest_size) == 0);
+}
+
+/* Verify a cached chain against the root certificate whose hash is in the chain header.*/
+static bool peer_cert_cache_verify(uint32_t base_hash_algo, const uint8_t *cert_chain,
+                                   size_t cert_chain_size)
+{
+    uint8_t root_hash[LIBSPDM_MAX_HASH_SIZE];
+    const peer_cert_cache_root_t *root;
+    const uint8_t *cert_chain_data;
+    size_t cert_chain_data_size;
+    uint32_t hash_size;
+    uint32_t root_count;
+    uint32_t index;
+
+    hash_size = libspdm_get_hash_size(base_hash_algo);
+    if ((cert_chain_size <= sizeof(spdm_cert_chain_t) + hash_size) ||
+        (((const spdm_cert_chain_t *)cert_chain)->length != cert_chain_size)) {
+        return false;
+    }
+    cert_chain_data = cert_chain + sizeof(spdm_cert_chain_t) + hash_size;
+    cert_chain_data_size = cert_chain_size - sizeof(spdm_cert_chain_t) - hash_size;
+
+    spdm_emu_mutex_lock(&m_peer_cert_cache_lock);
+    root_count = m_peer_cert_cache_root_count;
+    spdm_emu_mutex_unlock(&m_peer_cert_cache_lock);
+    for (index = 0; index < root_count; index++) {
+        root = &m_peer_cert_cache_root[index];
+        if (libspdm_hash_all(base_hash_algo, root->cert, root->cert_size, root_hash) &&
+            (libspdm_const_compare_mem(root_hash, cert_chain + sizeof(spdm_cert_chain_t),
+                                       hash_size) == 0)) {
+            return libspdm_x509_verify_cert_chain(root->cert, root->cert_size,
+                                                  cert_chain_data, cert_chain_data_size);
+        }
+    }
+    return false;
+}
+
+/* Read a cached chain, if it is there, still has the digest and comes from a trusted root.*/
+static bool peer_cert_cache_read(const char *file_name, uint32_t base_hash_algo,
+                                 const uint8_t *digest, uint32_t digest_size,
+                                 void *cert_chain, size_t *cert_chain_size)
+{
+    FILE *fp_in;
+    size_t size;
+
+    /* A missing file is the usual miss, do not report it.*/
+    if ((fp_in = fopen(file_name, "rb")) == NULL) {
+        return false;
+    }
+    size = fread(cert_chain, 1, *cert_chain_size, fp_in);
+    if ((size == 0) || (size == *cert_chain_size) || ferror(fp_in)) {
+        /* empty, unreadable, or larger than the buffer*/
+        fclose(fp_in);
+        return false;
+    }
+    fclose(fp_in);
+
+    if (!peer_cert_cache_matches(base_hash_algo, digest, digest_size, cert_chain, size)) {
+        printf("PeerCertCache - %s does not match its digest\n", file_name);
+        return false;
+    }
+    if (!peer_cert_cache_verify(base_hash_algo, cert_chain, size)) {
+        printf("PeerCertCache - %s does not verify with the root certificates\n", file_name);
+        return false;
+    }
+    *cert_chain_size = size;
+    return true;
+}
+
+/**
+ * Get the certificate chain of a slot, from --peer_cert_cache when GET_DIGESTS returned the
+ * digest of a cached chain, or with GET_CERTIFICATE otherwise.
+ * The parameters are the ones of libspdm_get_certificate_ex.
+ **/
+libspdm_return_t spdm_requester_get_certificate(void *spdm_context, const uint32_t *session_id,
+                                                uint8_t slot_id, size_t *cert_chain_size,
+                                                void *cert_chain)
+{
+    libspdm_return_t status;
+    libspdm_data_parameter_t parameter;
+    char file_name[PEER_CERT_CACHE_MAX_FILE_NAME_SIZE];
+    uint8_t digest[LIBSPDM_MAX_HASH_SIZE];
+    uint32_t digest_size;
+    uint32_t base_hash_algo;
+    size_t cert_chain_buffer_size;
+    bool has_digest;
+
+    if (!m_peer_cert_cache_initialized) {
+        return libspdm_get_certificate_ex(spdm_context, session_id, slot_id, cert_chain_size,
+                                          cert_chain, NULL, 0);
+    }
+
+    cert_chain_buffer_size = *cert_chain_size;
+    has_digest = peer_cert_cache_get_file_name(spdm_context, slot_id, &base_hash_algo, digest,
+                                               &digest_size, file_name, sizeof(file_name));
+    if (has_digest &&
+        peer_cert_cache_read(file_name, base_hash_algo, digest, digest_size, cert_chain,
+                             cert_chain_size)) {
+        libspdm_zero_mem(&parameter, sizeof(parameter));
+        parameter.location = LIBSPDM_DATA_LOCATION_CONNECTION;
+        parameter.additional_data[0] = slot_id;
+        status = libspdm_set_data(spdm_context, LIBSPDM_DATA_PEER_USED_CERT_CHAIN_BUFFER,
+                                  &parameter, cert_chain, *cert_chain_size);
+        if (!LIBSPDM_STATUS_IS_ERROR(status)) {
+            peer_cert_cache_count(true);
+            return LIBSPDM_STATUS_SUCCESS;
+        }
+        *cert_chain_size = cert_chain_buffer_size;
+    }
+    peer_cert_cache_count(false);
+
+    status = libspdm_get_certificate_ex(spdm_context, session_id, slot_id, cert_chain_size,
+                                        cert_chain, NULL, 0);
+    if (LIBSPDM_STATUS_IS_ERROR(status) || !has_digest) {
+        return status;
+    }
+    /* Only keep a chain that has the digest GET_DIGESTS returned.*/
+    if (peer_cert_cache_matches(base_hash_algo, digest, digest_size, cert_chain,
+                                *cert_chain_size) &&
+        !libspdm_write_output_file(file_name, cert_chain, *cert_chain_size)) {
+        printf("PeerCertCache - write %s error\n", file_name);
+    }
+    return status;
+}
+
+#endif /*LIBSPDM_ENABLE_CAPABILITY_CERT_CAP*/
@@ -6,21 +6,9 @@
 
 #include "spdm_requester_emu.h"
 
-uint8_t m_receive_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
-
-extern SOCKET m_socket;
-
-extern void *m_spdm_context;
-#if LIBSPDM_FIPS_MODE
-extern void *m_fips_selftest_context;
-#endif /*LIBSPDM_FIPS_MODE*/
-extern void *m_scratch_buffer;
-
 uint8_t m_other_slot_id = 0;
 
-void *spdm_client_init(void);
-
-libspdm_return_t pci_doe_init_requester(void);
+libspdm_return_t pci_doe_init_requester(spdm_emu_connection_t *connection);
 
 SOCKET CreateSocketAndHandShake(SOCKET *sock, uint16_t port_number);
 
@@ -31,28 +19,65 @@ bool communicate_platform_data(SOCKET socket, uint32_t command,
                                uint8_t *receive_buffer);
 
 #if LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP
-libspdm_return_t do_measurement_via_spdm(const uint32_t *session_id);
+libspdm_return_t do_measurement_via_spdm(void *spdm_context, const uint32_t *session_id,
+                                         uint8_t slot_id);
 #endif /*LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP*/
 
 #if (LIBSPDM_ENABLE_CAPABILITY_CERT_CAP && LIBSPDM_ENABLE_CAPABILITY_CHAL_CAP)
-libspdm_return_t do_authentication_via_spdm(void);
+libspdm_return_t do_authentication_via_spdm(void *spdm_context);
 #endif /*(LIBSPDM_ENABLE_CAPABILITY_CERT_CAP && LIBSPDM_ENABLE_CAPABILITY_CHAL_CAP)*/
 
-libspdm_return_t do_session_via_spdm(bool use_psk);
-libspdm_return_t do_certificate_provising_via_spdm(uint32_t* session_id);
+libspdm_return_t do_session_via_spdm(void *spdm_context, bool use_psk, uint8_t slot_id);
+libspdm_return_t do_certificate_provising_via_spdm(void *spdm_context, uint32_t* session_id);
+
+/* The flows timed in loop mode.*/
+#define CLIENT_FLOW_AUTHENTICATION 0
+#define CLIENT_FLOW_MEASUREMENT 1
+#define CLIENT_FLOW_CERTIFICATE_PROVISIONING 2
+#define CLIENT_FLOW_KEY_EX_SESSION 3
+#define CLIENT_FLOW_PSK_SESSION 4
+#define CLIENT_FLOW_COUNT 5
+
+const char *m_client_flow_name[CLIENT_FLOW_COUNT] = {
+    "authentication",
+    "measurement",
+    "certificate provisioning",
+    "KEY_EXCHANGE session",
+    "PSK_EXCHANGE session",
+};
+
+/* One connection of the loop mode, served by its own thread.*/
+typedef struct {
+    spdm_emu_connection_t connection;
+    uint16_t port_number;
+    uint32_t iteration_count;
+    /* monotonic time at which to stop, 0 for none*/
+    uint64_t deadline;
+    uint32_t flow_pass_count;
+    uint32_t flow_fail_count;
+    spdm_emu_stats_t flow_stats[CLIENT_FLOW_COUNT];
+} client_worker_t;
+
+/* spdm_client_init and spdm_client_deinit update shared options such as m_exe_session from the
+ * negotiated capabilities, so the loop mode workers run them one at a time.*/
+spdm_emu_mutex_t m_client_init_mutex;
 
-bool platform_client_routine(uint16_t port_number)
+/**
+ * Open the platform socket of a connection.
+ *
+ * @param  connection                    The connection, its socket is set on success.
+ * @param  platform_socket               The socket to close at the end. It differs from the
+ *                                       connection socket with --tcp_sub HS.
+ **/
+static bool platform_client_connect(spdm_emu_connection_t *connection,
+                                    SOCKET *platform_socket, uint16_t port_number)
 {
-    SOCKET platform_socket;
     bool result;
-    uint32_t response;
-    size_t response_size;
-    libspdm_return_t status;
 
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP &&
         m_use_tcp_handshake == SOCKET_TCP_HANDSHAKE) {
-        m_socket = CreateSocketAndHandShake(&platform_socket, port_number);
-        if (m_socket == INVALID_SOCKET) {
+        connection->socket = CreateSocketAndHandShake(platform_socket, port_number);
+        if (connection->socket == INVALID_SOCKET) {
             printf("Create platform service socket fail\n");
 #ifdef _MSC_VER
             WSACleanup();
@@ -63,7 +88,7 @@ bool platform_client_routine(uint16_t port_number)
         printf("Continuing with SPDM flow...\n");
     }
     else {
-        result = init_client(&platform_socket, port_number);
+        result = init_client(platform_socket, port_number);
         if (!result) {
 #ifdef _MSC_VER
             WSACleanup();
@@ -71,63 +96,136 @@ bool platform_client_routine(uint16_t port_number)
             return false;
         }
 
-        m_socket = platform_socket;
+        connection->socket = *platform_socket;
     }
+    return true;
+}
+
+/**
+ * Exchange the platform hello and run the DOE discovery on a new connection.
+ **/
+static bool platform_client_hello(spdm_emu_connection_t *connection)
+{
+    bool result;
+    uint32_t response;
+    size_t response_size;
+    libspdm_return_t status;
+    uint8_t hello[sizeof("Client Hello!") + SPDM_STATE_STORE_MAX_KEY_SIZE + 1];
+    size_t hello_size;
 
     if (m_use_transport_layer != SOCKET_TRANSPORT_TYPE_NONE) {
-        response_size = sizeof(m_receive_buffer);
+        /* The --peer_id follows the hello, for a responder with --state_store.*/
+        hello_size = sizeof("Client Hello!");
+        libspdm_copy_mem(hello, sizeof(hello), "Client Hello!", hello_size);
+        if (m_peer_id != NULL) {
+            libspdm_copy_mem(hello + hello_size, sizeof(hello) - hello_size,
+                             m_peer_id, strlen(m_peer_id) + 1);
+            hello_size += strlen(m_peer_id) + 1;
+        }
+        response_size = LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE;
         result = communicate_platform_data(
-            m_socket,
+            connection->socket,
             SOCKET_SPDM_COMMAND_TEST,
-            (uint8_t *)"Client Hello!",
-            sizeof("Client Hello!"), &response,
-            &response_size, m_receive_buffer);
+            hello, hello_size, &response,
+            &response_size, connection->send_receive_buffer);
         if (!result) {
-            goto done;
+            return false;
         }
     }
 
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
-        status = pci_doe_init_requester ();
+        status = pci_doe_init_requester (connection);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("pci_doe_init_requester - %x\n", (uint32_t)status);
-            goto done;
+            return false;
         }
     }
+    return true;
+}
 
-    m_spdm_context = spdm_client_init();
-    if (m_spdm_context == NULL) {
-        goto done;
+/**
+ * Send SHUTDOWN or CONTINUE, according to --exe_mode, and close the platform sockets.
+ **/
+static void platform_client_disconnect(spdm_emu_connection_t *connection,
+                                       SOCKET platform_socket)
+{
+    uint32_t response;
+    size_t response_size;
+
+    response_size = 0;
+    communicate_platform_data(
+        connection->socket, SOCKET_SPDM_COMMAND_SHUTDOWN - m_exe_mode,
+        NULL, 0, &response, &response_size, NULL);
+
+    closesocket(platform_socket);
+    if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP &&
+        m_use_tcp_handshake == SOCKET_TCP_HANDSHAKE) {
+        closesocket(connection->socket);
     }
+    connection->socket = INVALID_SOCKET;
+
+#ifdef _MSC_VER
+    WSACleanup();
+#endif
+}
+
+static void platform_client_record_flow(spdm_emu_stats_t *flow_stats, uint32_t flow,
+                                        uint64_t start)
+{
+    if (flow_stats != NULL) {
+        spdm_emu_stats_record(&flow_stats[flow], spdm_emu_get_monotonic_ns() - start);
+    }
+}
+
+/**
+ * Run the SPDM flows selected by --exe_conn and --exe_session once, after VCA.
+ *
+ * @param  spdm_context                  The SPDM context of the connection.
+ * @param  flow_stats                    If not NULL, the duration of each flow is recorded in
+ *                                       flow_stats[CLIENT_FLOW_*].
+ **/
+static libspdm_return_t platform_client_run_flows(void *spdm_context,
+                                                  spdm_emu_stats_t *flow_stats)
+{
+    libspdm_return_t status;
+    uint64_t start;
+
+    status = LIBSPDM_STATUS_SUCCESS;
 
-    /* Do test - begin*/
 #if (LIBSPDM_ENABLE_CAPABILITY_CERT_CAP && LIBSPDM_ENABLE_CAPABILITY_CHAL_CAP)
-    status = do_authentication_via_spdm();
+    start = spdm_emu_get_monotonic_ns();
+    status = do_authentication_via_spdm(spdm_context);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("do_authentication_via_spdm - %x\n", (uint32_t)status);
-        goto done;
+        return status;
     }
+    platform_client_record_flow(flow_stats, CLIENT_FLOW_AUTHENTICATION, start);
 #endif /*(LIBSPDM_ENABLE_CAPABILITY_CERT_CAP && LIBSPDM_ENABLE_CAPABILITY_CHAL_CAP)*/
 
 #if LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP
     if ((m_exe_connection & EXE_CONNECTION_MEAS) != 0) {
-        status = do_measurement_via_spdm(NULL);
+        start = spdm_emu_get_monotonic_ns();
+        status = do_measurement_via_spdm(spdm_context, NULL, m_use_slot_id);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("do_measurement_via_spdm - %x\n",
                    (uint32_t)status);
-            goto done;
+            return status;
         }
+        platform_client_record_flow(flow_stats, CLIENT_FLOW_MEASUREMENT, start);
     }
 #endif /*LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP*/
     /* when use --trans NONE, skip secure session  */
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_NONE) {
         if (m_use_version >= SPDM_MESSAGE_VERSION_12) {
-            status = do_certificate_provising_via_spdm(NULL);
+            start = spdm_emu_get_monotonic_ns();
+            status = do_certificate_provising_via_spdm(spdm_context, NULL);
             if (LIBSPDM_STATUS_IS_ERROR(status)) {
                 printf("do_certificate_provising_via_spdm - %x\n",
                        (uint32_t)status);
-                goto done;
+                return status;
             }
+            platform_client_record_flow(flow_stats, CLIENT_FLOW_CERTIFICATE_PROVISIONING,
+                                        start);
         }
     }
     else
@@ -135,87 +233,244 @@ bool platform_client_routine(uint16_t port_number)
 #if (LIBSPDM_ENABLE_CAPABILITY_KEY_EX_CAP || LIBSPDM_ENABLE_CAPABILITY_PSK_EX_CAP)
         if (m_use_version >= SPDM_MESSAGE_VERSION_11) {
             if ((m_exe_session & EXE_SESSION_KEY_EX) != 0) {
-                status = do_session_via_spdm(false);
+                start = spdm_emu_get_monotonic_ns();
+                status = do_session_via_spdm(spdm_context, false, m_use_slot_id);
                 if (LIBSPDM_STATUS_IS_ERROR(status)) {
                     printf("do_session_via_spdm - %x\n",
                            (uint32_t)status);
-                    goto done;
+                    return status;
                 }
+                platform_client_record_flow(flow_stats, CLIENT_FLOW_KEY_EX_SESSION, start);
             }
 
             if ((m_exe_session & EXE_SESSION_PSK) != 0) {
-                status = do_session_via_spdm(true);
+                start = spdm_emu_get_monotonic_ns();
+                status = do_session_via_spdm(spdm_context, true, m_use_slot_id);
                 if (LIBSPDM_STATUS_IS_ERROR(status)) {
                     printf("do_session_via_spdm - %x\n",
                            (uint32_t)status);
-                    goto done;
+                    return status;
                 }
+                platform_client_record_flow(flow_stats, CLIENT_FLOW_PSK_SESSION, start);
             }
             if ((m_exe_session & EXE_SESSION_KEY_EX) != 0) {
                 if (m_other_slot_id != 0) {
-                    m_use_slot_id = m_other_slot_id;
-                    status = do_session_via_spdm(false);
+                    start = spdm_emu_get_monotonic_ns();
+                    status = do_session_via_spdm(spdm_context, false, m_other_slot_id);
                     if (LIBSPDM_STATUS_IS_ERROR(status)) {
                         printf("do_session_via_spdm - %x\n",
                                (uint32_t)status);
-                        goto done;
+                        return status;
                     }
+                    platform_client_record_flow(flow_stats, CLIENT_FLOW_KEY_EX_SESSION, start);
                 }
             }
         }
 #endif /*(LIBSPDM_ENABLE_CAPABILITY_KEY_EX_CAP || LIBSPDM_ENABLE_CAPABILITY_PSK_EX_CAP)*/
     }
+    return status;
+}
+
+/**
+ * Connect to the responder and run the SPDM flows selected by the options.
+ *
+ * @retval true  All the flows passed.
+ * @retval false The connection failed or a flow failed.
+ **/
+bool platform_client_routine(uint16_t port_number)
+{
+    spdm_emu_connection_t *connection;
+    SOCKET platform_socket;
+    bool flow_result;
+    void *spdm_context;
+    libspdm_return_t status;
+
+    connection = &m_default_connection;
+    if (!platform_client_connect(connection, &platform_socket, port_number)) {
+        return false;
+    }
+
+    flow_result = false;
+    if (!platform_client_hello(connection)) {
+        goto done;
+    }
+
+    spdm_context = spdm_client_init(connection);
+    if (spdm_context == NULL) {
+        goto done;
+    }
+
+    /* Do test - begin*/
+    status = platform_client_run_flows(spdm_context, NULL);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        goto done;
+    }
     /* Do test - end*/
+    flow_result = true;
 
 done:
-    response_size = 0;
-    result = communicate_platform_data(
-        m_socket, SOCKET_SPDM_COMMAND_SHUTDOWN - m_exe_mode,
-        NULL, 0, &response, &response_size, NULL);
+    platform_client_disconnect(connection, platform_socket);
+    /* The routine may run again, as in spdm_bench.*/
+    spdm_client_deinit(connection);
 
-    if (m_spdm_context != NULL) {
-#if LIBSPDM_FIPS_MODE
-        if (!libspdm_export_fips_selftest_context_from_spdm_context(
-                m_spdm_context, m_fips_selftest_context,
-                libspdm_get_fips_selftest_context_size())) {
-            return false;
-        }
-#endif /*LIBSPDM_FIPS_MODE*/
-        libspdm_deinit_context(m_spdm_context);
-        free(m_spdm_context);
-        free(m_scratch_buffer);
+    return flow_result;
+}
+
+/**
+ * Loop mode worker: open one connection, repeat the flows on it, then close it.
+ **/
+static void client_worker_routine(void *context)
+{
+    client_worker_t *worker;
+    SOCKET platform_socket;
+    void *spdm_context;
+    uint32_t iteration;
+    libspdm_return_t status;
+
+    worker = context;
+    if (!platform_client_connect(&worker->connection, &platform_socket, worker->port_number)) {
+        worker->flow_fail_count++;
+        return;
     }
 
-    closesocket(platform_socket);
-    if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP &&
-        m_use_tcp_handshake == SOCKET_TCP_HANDSHAKE) {
-        closesocket(m_socket);
+    spdm_context = NULL;
+    if (platform_client_hello(&worker->connection)) {
+        spdm_emu_mutex_lock(&m_client_init_mutex);
+        spdm_context = spdm_client_init(&worker->connection);
+        spdm_emu_mutex_unlock(&m_client_init_mutex);
+    }
+    if (spdm_context == NULL) {
+        worker->flow_fail_count++;
     }
 
-#ifdef _MSC_VER
-    WSACleanup();
-#endif
+    for (iteration = 0; spdm_context != NULL; iteration++) {
+        if ((worker->iteration_count != 0) && (iteration >= worker->iteration_count)) {
+            break;
+        }
+        if ((worker->deadline != 0) && (spdm_emu_get_monotonic_ns() >= worker->deadline)) {
+            break;
+        }
+        status = platform_client_run_flows(spdm_context, worker->flow_stats);
+        if (LIBSPDM_STATUS_IS_ERROR(status)) {
+            /* The connection state is unknown after a failure.*/
+            worker->flow_fail_count++;
+            break;
+        }
+        worker->flow_pass_count++;
+    }
 
-    return true;
+    platform_client_disconnect(&worker->connection, platform_socket);
+    spdm_emu_mutex_lock(&m_client_init_mutex);
+    spdm_client_deinit(&worker->connection);
+    spdm_emu_mutex_unlock(&m_client_init_mutex);
 }
 
-int main(int argc, char *argv[])
+/**
+ * Run the flows on m_loop_concurrency connections in parallel, m_loop_iteration_count times
+ * or for m_loop_duration seconds each, then print the aggregated results.
+ *
+ * @retval true  All the flows passed.
+ * @retval false A connection or a flow failed.
+ **/
+bool platform_client_loop_routine(uint16_t port_number)
 {
-    printf("%s version 0.1\n", "spdm_requester_emu");
-    srand((unsigned int)time(NULL));
+    client_worker_t *worker;
+    spdm_emu_thread_t *thread;
+    spdm_emu_stats_t *flow_stats;
+    uint32_t thread_count;
+    uint32_t index;
+    uint32_t flow;
+    uint32_t flow_pass_count;
+    uint32_t flow_fail_count;
+    uint64_t start;
+    uint64_t elapsed;
+    double seconds;
+    char value[16];
+
+    if ((m_loop_concurrency > 1) && (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP) &&
+        (m_use_tcp_handshake == SOCKET_TCP_HANDSHAKE)) {
+        printf("--tcp_sub HS accepts one connection, --concurrency must be 1\n");
+        return false;
+    }
 
-    process_args("spdm_requester_emu", argc, argv);
+    worker = (void *)malloc(sizeof(client_worker_t) * m_loop_concurrency);
+    thread = (void *)malloc(sizeof(spdm_emu_thread_t) * m_loop_concurrency);
+    flow_stats = (void *)malloc(sizeof(spdm_emu_stats_t) * CLIENT_FLOW_COUNT);
+    if ((worker == NULL) || (thread == NULL) || (flow_stats == NULL)) {
+        free(worker);
+        free(thread);
+        free(flow_stats);
+        return false;
+    }
+    libspdm_zero_mem(worker, sizeof(client_worker_t) * m_loop_concurrency);
+    spdm_emu_mutex_init(&m_client_init_mutex);
+
+    start = spdm_emu_get_monotonic_ns();
+    for (index = 0; index < m_loop_concurrency; index++) {
+        worker[index].connection = m_default_connection;
+        worker[index].connection.send_receive_buffer =
+            (void *)malloc(LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE);
+        worker[index].port_number = port_number;
+        worker[index].iteration_count = m_loop_iteration_count;
+        if ((m_loop_iteration_count == 0) && (m_loop_duration == 0)) {
+            worker[index].iteration_count = 1;
+        }
+        if (m_loop_duration != 0) {
+            worker[index].deadline = start + (uint64_t)m_loop_duration * 1000000000;
+        }
+        for (flow = 0; flow < CLIENT_FLOW_COUNT; flow++) {
+            spdm_emu_stats_init(&worker[index].flow_stats[flow]);
+        }
+    }
+
+    thread_count = 0;
+    for (index = 0; index < m_loop_concurrency; index++) {
+        if (worker[index].connection.send_receive_buffer == NULL) {
+            worker[index].flow_fail_count++;
+            continue;
+        }
+        if (!spdm_emu_thread_create(&thread[thread_count], client_worker_routine,
+                                    &worker[index])) {
+            printf("Create worker thread fail\n");
+            worker[index].flow_fail_count++;
+            continue;
+        }
+        thread_count++;
+    }
+    for (index = 0; index < thread_count; index++) {
+        spdm_emu_thread_join(thread[index]);
+    }
+    elapsed = spdm_emu_get_monotonic_ns() - start;
 
-    if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP) {
-        /* Port number 4194 for SPDM */
-        platform_client_routine(TCP_SPDM_PLATFORM_PORT);
+    flow_pass_count = 0;
+    flow_fail_count = 0;
+    for (flow = 0; flow < CLIENT_FLOW_COUNT; flow++) {
+        spdm_emu_stats_init(&flow_stats[flow]);
     }
-    else {
-        platform_client_routine(DEFAULT_SPDM_PLATFORM_PORT);
+    for (index = 0; index < m_loop_concurrency; index++) {
+        flow_pass_count += worker[index].flow_pass_count;
+        flow_fail_count += worker[index].flow_fail_count;
+        for (flow = 0; flow < CLIENT_FLOW_COUNT; flow++) {
+            spdm_emu_stats_merge(&flow_stats[flow], &worker[index].flow_stats[flow]);
+        }
+        free(worker[index].connection.send_receive_buffer);
     }
 
-    printf("Client stopped\n");
+    seconds = (elapsed == 0) ? 1e-9 : (double)elapsed / 1000000000;
+    printf("\n%u connections: %u flows passed, %u failed in %s, %.1f flows/s\n",
+           m_loop_concurrency, flow_pass_count, flow_fail_count,
+           spdm_emu_format_duration(value, sizeof(value), elapsed),
+           (double)flow_pass_count / seconds);
+    spdm_emu_stats_print_header("flow");
+    for (flow = 0; flow < CLIENT_FLOW_COUNT; flow++) {
+        if (flow_stats[flow].count != 0) {
+            spdm_emu_stats_print_row(m_client_flow_name[flow], &flow_stats[flow]);
+        }
+    }
 
-    close_pcap_packet_file();
-    return 0;
+    spdm_emu_mutex_destroy(&m_client_init_mutex);
+    free(worker);
+    free(thread);
+    free(flow_stats);
+    return flow_fail_count == 0;
 }
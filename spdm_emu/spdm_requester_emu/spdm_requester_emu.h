@@ -26,4 +26,29 @@
 
 extern uint8_t m_other_slot_id;
 
+void *spdm_client_init(spdm_emu_connection_t *connection);
+
+void spdm_client_deinit(spdm_emu_connection_t *connection);
+
+bool platform_client_routine(uint16_t port_number);
+
+bool platform_client_loop_routine(uint16_t port_number);
+
+/* Called by spdm_client_init. spdm_requester_emu registers the transport as is, spdm_bench
+ * registers it through functions that time each message.*/
+void spdm_requester_register_transport_layer_func(
+    void *spdm_context, uint32_t max_spdm_msg_size, uint32_t transport_header_size,
+    uint32_t transport_tail_size, libspdm_transport_encode_message_func transport_encode_message,
+    libspdm_transport_decode_message_func transport_decode_message);
+
+void spdm_requester_cert_cache_init(void);
+
+void spdm_requester_cert_cache_free(void);
+
+void spdm_requester_cert_cache_add_root(const void *root_cert, size_t root_cert_size);
+
+libspdm_return_t spdm_requester_get_certificate(void *spdm_context, const uint32_t *session_id,
+                                                uint8_t slot_id, size_t *cert_chain_size,
+                                                void *cert_chain);
+
 #endif
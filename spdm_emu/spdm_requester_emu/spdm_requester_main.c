@@ -0,0 +1,48 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2021-2022 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_requester_emu.h"
+
+void spdm_requester_register_transport_layer_func(
+    void *spdm_context, uint32_t max_spdm_msg_size, uint32_t transport_header_size,
+    uint32_t transport_tail_size, libspdm_transport_encode_message_func transport_encode_message,
+    libspdm_transport_decode_message_func transport_decode_message)
+{
+    libspdm_register_transport_layer_func(spdm_context, max_spdm_msg_size,
+                                          transport_header_size, transport_tail_size,
+                                          transport_encode_message, transport_decode_message);
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t port_number;
+
+    printf("%s version 0.1\n", "spdm_requester_emu");
+    srand((unsigned int)time(NULL));
+
+    process_args("spdm_requester_emu", argc, argv);
+
+    port_number = spdm_emu_get_platform_port();
+
+    spdm_requester_cert_cache_init();
+    if (!spdm_emu_trust_cache_init()) {
+        return 0;
+    }
+
+    if ((m_loop_iteration_count != 0) || (m_loop_duration != 0) || (m_loop_concurrency > 1)) {
+        platform_client_loop_routine(port_number);
+    } else {
+        platform_client_routine(port_number);
+    }
+
+    spdm_requester_cert_cache_free();
+    spdm_emu_trust_cache_free();
+
+    printf("Client stopped\n");
+
+    close_pcap_packet_file();
+    return 0;
+}
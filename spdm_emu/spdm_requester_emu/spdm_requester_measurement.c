@@ -8,15 +8,16 @@
 
 #if LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP
 
-extern void *m_spdm_context;
-
 /**
  * This function executes SPDM measurement and extend to TPM.
  *
  * @param[in]  spdm_context            The SPDM context for the device.
+ * @param[in]  session_id              The session to use, or NULL outside a session.
+ * @param[in]  slot_id                 The slot of the certificate chain signing the measurements.
  **/
 libspdm_return_t spdm_send_receive_get_measurement(void *spdm_context,
-                                                   const uint32_t *session_id)
+                                                   const uint32_t *session_id,
+                                                   uint8_t slot_id)
 {
     libspdm_return_t status;
     uint8_t number_of_blocks;
@@ -38,7 +39,7 @@ libspdm_return_t spdm_send_receive_get_measurement(void *spdm_context,
         status = libspdm_get_measurement(
             spdm_context, session_id, request_attribute,
             SPDM_GET_MEASUREMENTS_REQUEST_MEASUREMENT_OPERATION_ALL_MEASUREMENTS,
-            m_use_slot_id & 0xF, NULL, &number_of_block,
+            slot_id & 0xF, NULL, &number_of_block,
             &measurement_record_length, measurement_record);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             return status;
@@ -51,7 +52,7 @@ libspdm_return_t spdm_send_receive_get_measurement(void *spdm_context,
         status = libspdm_get_measurement(
             spdm_context, session_id, request_attribute,
             SPDM_GET_MEASUREMENTS_REQUEST_MEASUREMENT_OPERATION_TOTAL_NUMBER_OF_MEASUREMENTS,
-            m_use_slot_id & 0xF, NULL, &number_of_blocks, NULL, NULL);
+            slot_id & 0xF, NULL, &number_of_blocks, NULL, NULL);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             return status;
         }
@@ -74,7 +75,7 @@ libspdm_return_t spdm_send_receive_get_measurement(void *spdm_context,
             measurement_record_length = sizeof(measurement_record);
             status = libspdm_get_measurement(
                 spdm_context, session_id, request_attribute,
-                index, m_use_slot_id & 0xF, NULL, &number_of_block,
+                index, slot_id & 0xF, NULL, &number_of_block,
                 &measurement_record_length, measurement_record);
             if (LIBSPDM_STATUS_IS_ERROR(status)) {
                 continue;
@@ -93,15 +94,15 @@ libspdm_return_t spdm_send_receive_get_measurement(void *spdm_context,
  * This function executes SPDM measurement and extend to TPM.
  *
  * @param[in]  spdm_context            The SPDM context for the device.
+ * @param[in]  session_id              The session to use, or NULL outside a session.
+ * @param[in]  slot_id                 The slot of the certificate chain signing the measurements.
  **/
-libspdm_return_t do_measurement_via_spdm(const uint32_t *session_id)
+libspdm_return_t do_measurement_via_spdm(void *spdm_context, const uint32_t *session_id,
+                                         uint8_t slot_id)
 {
     libspdm_return_t status;
-    void *spdm_context;
-
-    spdm_context = m_spdm_context;
 
-    status = spdm_send_receive_get_measurement(spdm_context, session_id);
+    status = spdm_send_receive_get_measurement(spdm_context, session_id, slot_id);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         return status;
     }
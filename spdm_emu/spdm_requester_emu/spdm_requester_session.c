@@ -8,10 +8,6 @@
 
 #if (LIBSPDM_ENABLE_CAPABILITY_KEY_EX_CAP || LIBSPDM_ENABLE_CAPABILITY_PSK_EX_CAP)
 
-extern SOCKET m_socket;
-
-extern void *m_spdm_context;
-
 bool communicate_platform_data(SOCKET socket, uint32_t command,
                                const uint8_t *send_buffer, size_t bytes_to_send,
                                uint32_t *response,
@@ -19,38 +15,38 @@ bool communicate_platform_data(SOCKET socket, uint32_t command,
                                uint8_t *receive_buffer);
 
 #if LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP
-libspdm_return_t do_measurement_via_spdm(const uint32_t *session_id);
+libspdm_return_t do_measurement_via_spdm(void *spdm_context, const uint32_t *session_id,
+                                         uint8_t slot_id);
 #endif /*LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP*/
 
 libspdm_return_t pci_doe_process_session_message(void *spdm_context, uint32_t session_id);
 libspdm_return_t mctp_process_session_message(void *spdm_context, uint32_t session_id);
-libspdm_return_t do_certificate_provising_via_spdm(uint32_t* session_id);
+libspdm_return_t do_certificate_provising_via_spdm(void *spdm_context, uint32_t* session_id);
 
-libspdm_return_t do_app_session_via_spdm(uint32_t session_id)
+libspdm_return_t do_app_session_via_spdm(void *spdm_context, uint32_t session_id)
 {
     libspdm_return_t status = LIBSPDM_STATUS_SUCCESS;
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
-        status = pci_doe_process_session_message (m_spdm_context, session_id);
+        status = pci_doe_process_session_message (spdm_context, session_id);
     }
 
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
-        status = mctp_process_session_message (m_spdm_context, session_id);
+        status = mctp_process_session_message (spdm_context, session_id);
     }
 
     return status;
 }
 
-libspdm_return_t get_digest_cert_in_session(const uint32_t *session_id)
+libspdm_return_t get_digest_cert_in_session(void *spdm_context, const uint32_t *session_id,
+                                            uint8_t slot_id)
 {
     libspdm_return_t status;
-    void *spdm_context;
     uint8_t slot_mask;
     uint8_t total_digest_buffer[LIBSPDM_MAX_HASH_SIZE * SPDM_MAX_SLOT_COUNT];
     uint8_t measurement_hash[LIBSPDM_MAX_HASH_SIZE];
     size_t cert_chain_size;
     uint8_t cert_chain[LIBSPDM_MAX_CERT_CHAIN_SIZE];
 
-    spdm_context = m_spdm_context;
     libspdm_zero_mem(total_digest_buffer, sizeof(total_digest_buffer));
     cert_chain_size = sizeof(cert_chain);
     libspdm_zero_mem(cert_chain, sizeof(cert_chain));
@@ -63,9 +59,9 @@ libspdm_return_t get_digest_cert_in_session(const uint32_t *session_id)
         }
     }
     if ((m_exe_session & EXE_SESSION_CERT) != 0) {
-        if (m_use_slot_id != 0xFF) {
-            status = libspdm_get_certificate_ex(
-                spdm_context, session_id, m_use_slot_id, &cert_chain_size, cert_chain, NULL, 0);
+        if (slot_id != 0xFF) {
+            status = spdm_requester_get_certificate(
+                spdm_context, session_id, slot_id, &cert_chain_size, cert_chain);
             if (LIBSPDM_STATUS_IS_ERROR(status)) {
                 return status;
             }
@@ -75,9 +71,8 @@ libspdm_return_t get_digest_cert_in_session(const uint32_t *session_id)
     return status;
 }
 
-libspdm_return_t do_session_via_spdm(bool use_psk)
+libspdm_return_t do_session_via_spdm(void *spdm_context, bool use_psk, uint8_t slot_id)
 {
-    void *spdm_context;
     libspdm_return_t status;
     uint32_t session_id;
     uint8_t heartbeat_period;
@@ -86,15 +81,13 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
     bool result;
     uint32_t response;
 
-    spdm_context = m_spdm_context;
-
     heartbeat_period = 0;
     libspdm_zero_mem(measurement_hash, sizeof(measurement_hash));
     status = libspdm_start_session(spdm_context, use_psk,
                                    LIBSPDM_TEST_PSK_HINT_STRING,
                                    sizeof(LIBSPDM_TEST_PSK_HINT_STRING),
                                    m_use_measurement_summary_hash_type,
-                                   m_use_slot_id, m_session_policy, &session_id,
+                                   slot_id, m_session_policy, &session_id,
                                    &heartbeat_period, measurement_hash);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("libspdm_start_session - %x\n", (uint32_t)status);
@@ -102,7 +95,7 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
     }
 
     if ((m_exe_session & EXE_SESSION_APP) != 0) {
-        status = do_app_session_via_spdm(session_id);
+        status = do_app_session_via_spdm(spdm_context, session_id);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("do_app_session_via_spdm - %x\n", (uint32_t)status);
             return status;
@@ -139,7 +132,7 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
         case LIBSPDM_KEY_UPDATE_ACTION_RESPONDER:
             response_size = 0;
             result = communicate_platform_data(
-                m_socket,
+                spdm_emu_get_connection(spdm_context)->socket,
                 SOCKET_SPDM_COMMAND_OOB_ENCAP_KEY_UPDATE, NULL,
                 0, &response, &response_size, NULL);
             if (!result) {
@@ -164,7 +157,7 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
 
 #if LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP
     if ((m_exe_session & EXE_SESSION_MEAS) != 0) {
-        status = do_measurement_via_spdm(&session_id);
+        status = do_measurement_via_spdm(spdm_context, &session_id, slot_id);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("do_measurement_via_spdm - %x\n",
                    (uint32_t)status);
@@ -173,7 +166,7 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
 #endif /*LIBSPDM_ENABLE_CAPABILITY_MEAS_CAP*/
 
 #if (LIBSPDM_ENABLE_CAPABILITY_CERT_CAP && LIBSPDM_ENABLE_CAPABILITY_CHAL_CAP)
-    status = get_digest_cert_in_session(&session_id);
+    status = get_digest_cert_in_session(spdm_context, &session_id, slot_id);
     if (LIBSPDM_STATUS_IS_ERROR(status)) {
         printf("get_digest_cert_in_session - %x\n",
                (uint32_t)status);
@@ -181,7 +174,7 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
 #endif
 
     if (m_use_version >= SPDM_MESSAGE_VERSION_12) {
-        status = do_certificate_provising_via_spdm(&session_id);
+        status = do_certificate_provising_via_spdm(spdm_context, &session_id);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("do_certificate_provising_via_spdm - %x\n",
                    (uint32_t)status);
@@ -205,10 +198,8 @@ libspdm_return_t do_session_via_spdm(bool use_psk)
  * These function implements the request and response messages used for provisioning a device with certificate chains.
  * Provisioning of Slot 0 should be only done in a secure environment (such as a secure manufacturing environment)
  */
-libspdm_return_t do_certificate_provising_via_spdm(uint32_t* session_id)
+libspdm_return_t do_certificate_provising_via_spdm(void *spdm_context, uint32_t* session_id)
 {
-    void *spdm_context;
-
 #if LIBSPDM_ENABLE_CAPABILITY_GET_CSR_CAP
     uint8_t csr_form_get[LIBSPDM_MAX_CSR_SIZE];
     size_t csr_len;
@@ -225,7 +216,6 @@ libspdm_return_t do_certificate_provising_via_spdm(uint32_t* session_id)
 #endif /*LIBSPDM_ENABLE_CAPABILITY_SET_CERTIFICATE_CAP*/
 
     libspdm_return_t status;
-    spdm_context = m_spdm_context;
 
 #if LIBSPDM_ENABLE_CAPABILITY_GET_CSR_CAP
 
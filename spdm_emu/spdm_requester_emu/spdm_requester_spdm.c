@@ -6,12 +6,9 @@
 
 #include "spdm_requester_emu.h"
 
-void *m_spdm_context;
 #if LIBSPDM_FIPS_MODE
 void *m_fips_selftest_context;
 #endif /*LIBSPDM_FIPS_MODE*/
-void *m_scratch_buffer;
-SOCKET m_socket;
 
 bool communicate_platform_data(SOCKET socket, uint32_t command,
                                const uint8_t *send_buffer, size_t bytes_to_send,
@@ -53,9 +50,11 @@ libspdm_return_t spdm_device_send_message(void *spdm_context,
                                           size_t request_size, const void *request,
                                           uint64_t timeout)
 {
+    spdm_emu_connection_t *connection;
     bool result;
 
-    result = send_platform_data(m_socket, SOCKET_SPDM_COMMAND_NORMAL,
+    connection = spdm_emu_get_connection(spdm_context);
+    result = send_platform_data(connection->socket, SOCKET_SPDM_COMMAND_NORMAL,
                                 request, (uint32_t)request_size);
     if (!result) {
         printf("send_platform_data Error - %x\n",
@@ -75,10 +74,12 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
                                              void **response,
                                              uint64_t timeout)
 {
+    spdm_emu_connection_t *connection;
     bool result;
     uint32_t command;
 
-    result = receive_platform_data(m_socket, &command, *response,
+    connection = spdm_emu_get_connection(spdm_context);
+    result = receive_platform_data(connection->socket, &command, *response,
                                    response_size);
     if (!result) {
         printf("receive_platform_data Error - %x\n",
@@ -96,6 +97,7 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
 /**
  * Send and receive an DOE message
  *
+ * @param pci_doe_context               the platform connection, or NULL for the default connection.
  * @param request                       the PCI DOE request message, start from pci_doe_data_object_header_t.
  * @param request_size                  size in bytes of request.
  * @param response                      the PCI DOE response message, start from pci_doe_data_object_header_t.
@@ -108,11 +110,13 @@ libspdm_return_t pci_doe_send_receive_data(const void *pci_doe_context,
                                            size_t request_size, const void *request,
                                            size_t *response_size, void *response)
 {
+    const spdm_emu_connection_t *connection;
     bool result;
     uint32_t response_code;
 
+    connection = (pci_doe_context == NULL) ? &m_default_connection : pci_doe_context;
     result = communicate_platform_data(
-        m_socket, SOCKET_SPDM_COMMAND_NORMAL,
+        connection->socket, SOCKET_SPDM_COMMAND_NORMAL,
         request, request_size,
         &response_code, response_size,
         response);
@@ -122,7 +126,17 @@ libspdm_return_t pci_doe_send_receive_data(const void *pci_doe_context,
     return LIBSPDM_STATUS_SUCCESS;
 }
 
-void *spdm_client_init(void)
+/**
+ * Create and provision an SPDM context for one requester connection, then run VCA.
+ *
+ * The context and its scratch buffer are recorded in the connection, and the connection is
+ * attached to the context so that the device IO uses its socket and buffer.
+ *
+ * @param  connection                    The platform connection that owns the new context.
+ *
+ * @return the SPDM context, or NULL on failure.
+ **/
+void *spdm_client_init(spdm_emu_connection_t *connection)
 {
     void *spdm_context;
 #if LIBSPDM_FIPS_MODE
@@ -154,24 +168,27 @@ void *spdm_client_init(void)
 
     printf("context_size - 0x%x\n", (uint32_t)libspdm_get_context_size());
 
-    m_spdm_context = (void *)malloc(libspdm_get_context_size());
-    if (m_spdm_context == NULL) {
+    spdm_context = (void *)malloc(libspdm_get_context_size());
+    if (spdm_context == NULL) {
         return NULL;
     }
-    spdm_context = m_spdm_context;
     libspdm_init_context(spdm_context);
 
 #if LIBSPDM_FIPS_MODE
-    m_fips_selftest_context = (void *)malloc(libspdm_get_fips_selftest_context_size());
     if (m_fips_selftest_context == NULL) {
-        return NULL;
+        m_fips_selftest_context = (void *)malloc(libspdm_get_fips_selftest_context_size());
+        if (m_fips_selftest_context == NULL) {
+            free(spdm_context);
+            return NULL;
+        }
+        libspdm_init_fips_selftest_context(m_fips_selftest_context);
     }
     fips_selftest_context = m_fips_selftest_context;
-    libspdm_init_fips_selftest_context(fips_selftest_context);
 
     if (!libspdm_import_fips_selftest_context_to_spdm_context(
             spdm_context, fips_selftest_context,
             libspdm_get_fips_selftest_context_size())) {
+        free(spdm_context);
         return NULL;
     }
 #endif /*LIBSPDM_FIPS_MODE*/
@@ -180,7 +197,7 @@ void *spdm_client_init(void)
                                     spdm_device_receive_message);
 
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_MCTP) {
-        libspdm_register_transport_layer_func(
+        spdm_requester_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             LIBSPDM_TRANSPORT_HEADER_SIZE,
@@ -188,7 +205,7 @@ void *spdm_client_init(void)
             libspdm_transport_mctp_encode_message,
             libspdm_transport_mctp_decode_message);
     } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
-        libspdm_register_transport_layer_func(
+        spdm_requester_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             LIBSPDM_TRANSPORT_HEADER_SIZE,
@@ -196,7 +213,7 @@ void *spdm_client_init(void)
             libspdm_transport_pci_doe_encode_message,
             libspdm_transport_pci_doe_decode_message);
     } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP) {
-        libspdm_register_transport_layer_func(
+        spdm_requester_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             LIBSPDM_TRANSPORT_HEADER_SIZE,
@@ -204,7 +221,7 @@ void *spdm_client_init(void)
             libspdm_transport_tcp_encode_message,
             libspdm_transport_tcp_decode_message);
     } else if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_NONE) {
-        libspdm_register_transport_layer_func(
+        spdm_requester_register_transport_layer_func(
             spdm_context,
             LIBSPDM_MAX_SPDM_MSG_SIZE,
             0,
@@ -212,8 +229,7 @@ void *spdm_client_init(void)
             spdm_transport_none_encode_message,
             spdm_transport_none_decode_message);
     } else {
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+        free(spdm_context);
         return NULL;
     }
     libspdm_register_device_buffer_func(spdm_context,
@@ -224,25 +240,33 @@ void *spdm_client_init(void)
                                         spdm_device_acquire_receiver_buffer,
                                         spdm_device_release_receiver_buffer);
 
-    scratch_buffer_size = libspdm_get_sizeof_required_scratch_buffer(m_spdm_context);
-    m_scratch_buffer = (void *)malloc(scratch_buffer_size);
-    if (m_scratch_buffer == NULL) {
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+    scratch_buffer_size = libspdm_get_sizeof_required_scratch_buffer(spdm_context);
+    connection->scratch_buffer = (void *)malloc(scratch_buffer_size);
+    if (connection->scratch_buffer == NULL) {
+        free(spdm_context);
         return NULL;
     }
-    libspdm_set_scratch_buffer (spdm_context, m_scratch_buffer, scratch_buffer_size);
+    libspdm_set_scratch_buffer (spdm_context, connection->scratch_buffer, scratch_buffer_size);
 
+    /* Until the context is attached, spdm_client_deinit only frees the scratch buffer.*/
     if (!libspdm_check_context(spdm_context))
     {
+        free(spdm_context);
+        spdm_client_deinit(connection);
+        return NULL;
+    }
+
+    /* VCA below already goes through the connection socket.*/
+    if (!spdm_emu_attach_connection(spdm_context, connection)) {
+        free(spdm_context);
+        spdm_client_deinit(connection);
         return NULL;
     }
 
     if (m_load_state_file_name != NULL) {
         status = spdm_load_negotiated_state(spdm_context, true);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
     }
@@ -315,16 +339,14 @@ void *spdm_client_init(void)
             (m_exe_connection & EXE_CONNECTION_VERSION_ONLY) != 0);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
             printf("libspdm_init_connection - 0x%x\n", (uint32_t)status);
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
         if ((m_exe_connection & EXE_CONNECTION_VERSION_ONLY) != 0) {
             /* GET_VERSION is done, handle special PSK use case*/
             status = spdm_provision_psk_version_only (spdm_context, true);
             if (LIBSPDM_STATUS_IS_ERROR(status)) {
-                free(m_spdm_context);
-                m_spdm_context = NULL;
+                spdm_client_deinit(connection);
                 return NULL;
             }
         }
@@ -432,8 +454,7 @@ void *spdm_client_init(void)
             /* Do not free it.*/
         } else {
             printf("read_responder_public_key fail!\n");
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
         res = libspdm_read_requester_public_key(m_use_req_asym_algo, &data, &data_size);
@@ -446,8 +467,7 @@ void *spdm_client_init(void)
             /* Do not free it.*/
         } else {
             printf("read_requester_public_key fail!\n");
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
     } else {
@@ -466,10 +486,10 @@ void *spdm_client_init(void)
                              LIBSPDM_DATA_PEER_PUBLIC_ROOT_CERT,
                              &parameter, (void *)root_cert, root_cert_size);
             /* Do not free it.*/
+            spdm_requester_cert_cache_add_root(root_cert, root_cert_size);
         } else {
             printf("read_responder_root_public_certificate fail!\n");
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
         res = libspdm_read_responder_root_public_certificate_slot(1,
@@ -488,10 +508,10 @@ void *spdm_client_init(void)
                              LIBSPDM_DATA_PEER_PUBLIC_ROOT_CERT,
                              &parameter, (void *)root_cert1, root_cert1_size);
             /* Do not free it.*/
+            spdm_requester_cert_cache_add_root(root_cert1, root_cert1_size);
         } else {
             printf("read_responder_root_public_certificate fail!\n");
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
     }
@@ -514,8 +534,7 @@ void *spdm_client_init(void)
             /* do not free it*/
         } else {
             printf("read_requester_public_certificate_chain fail!\n");
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_client_deinit(connection);
             return NULL;
         }
     }
@@ -524,5 +543,26 @@ void *spdm_client_init(void)
         spdm_save_negotiated_state(spdm_context, true);
     }
 
-    return m_spdm_context;
+    return spdm_context;
+}
+
+/**
+ * Release an SPDM context created by spdm_client_init and the buffer recorded in its connection.
+ *
+ * @param  connection                    The platform connection that owns the context.
+ **/
+void spdm_client_deinit(spdm_emu_connection_t *connection)
+{
+    if (connection->spdm_context != NULL) {
+#if LIBSPDM_FIPS_MODE
+        libspdm_export_fips_selftest_context_from_spdm_context(
+            connection->spdm_context, m_fips_selftest_context,
+            libspdm_get_fips_selftest_context_size());
+#endif /*LIBSPDM_FIPS_MODE*/
+        libspdm_deinit_context(connection->spdm_context);
+        free(connection->spdm_context);
+        connection->spdm_context = NULL;
+    }
+    free(connection->scratch_buffer);
+    connection->scratch_buffer = NULL;
 }
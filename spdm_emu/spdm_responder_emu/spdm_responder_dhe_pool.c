@@ -0,0 +1,389 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_responder_emu.h"
+
+/* KEY_EXCHANGE generates an ephemeral DHE key pair in libspdm_secured_message_dhe_new and
+ * libspdm_secured_message_dhe_generate_key. For FFDHE_3072, FFDHE_4096 and SECP_521_R1 that is
+ * most of the KEY_EXCHANGE_RSP time.
+ * With --dhe_pool, worker threads generate the key pairs of each --dhe group ahead of time.
+ * libspdm has no hook for that, so the build links the responder with --wrap for the three
+ * functions below (see CMakeLists.txt), and sets SPDM_EMU_DHE_POOL.
+ * A pooled key is used once: its public key copy is wiped when it is handed out, and the
+ * context holding the private key is freed by libspdm as usual.*/
+
+#ifndef SPDM_EMU_DHE_POOL
+#define SPDM_EMU_DHE_POOL 0
+#endif
+
+#if SPDM_EMU_DHE_POOL
+
+void *__real_libspdm_secured_message_dhe_new(spdm_version_number_t spdm_version,
+                                             uint16_t dhe_named_group, bool is_initiator);
+
+bool __real_libspdm_secured_message_dhe_generate_key(uint16_t dhe_named_group,
+                                                     void *dhe_context, uint8_t *public_key,
+                                                     size_t *public_key_size);
+
+void __real_libspdm_secured_message_dhe_free(uint16_t dhe_named_group, void *dhe_context);
+
+typedef struct dhe_pool_key {
+    struct dhe_pool_key *next;
+    void *dhe_context;
+    size_t public_key_size;
+    uint8_t public_key[LIBSPDM_MAX_DHE_KEY_SIZE];
+} dhe_pool_key_t;
+
+typedef struct {
+    uint16_t dhe_named_group;
+    /* The group cannot be generated, do not retry.*/
+    bool disabled;
+    dhe_pool_key_t *keys;
+    uint32_t key_count;
+    /* keys being generated by the workers*/
+    uint32_t pending_count;
+    uint32_t lowest_key_count;
+    uint32_t hit_count;
+    uint32_t miss_count;
+    uint32_t generated_count;
+} dhe_pool_group_t;
+
+#define DHE_POOL_MAX_GROUP_COUNT 16
+
+bool m_dhe_pool_running;
+bool m_dhe_pool_stopping;
+spdm_emu_mutex_t m_dhe_pool_lock;
+spdm_emu_cond_t m_dhe_pool_cond;
+dhe_pool_group_t m_dhe_pool_group[DHE_POOL_MAX_GROUP_COUNT];
+uint32_t m_dhe_pool_group_count;
+spdm_emu_thread_t *m_dhe_pool_thread;
+uint32_t m_dhe_pool_started_thread_count;
+/* The keys handed out to libspdm whose public key is not read yet.*/
+dhe_pool_key_t *m_dhe_pool_issued_keys;
+
+static void dhe_pool_wipe_key(dhe_pool_key_t *key)
+{
+    libspdm_zero_mem(key, sizeof(dhe_pool_key_t));
+    free(key);
+}
+
+static dhe_pool_group_t *dhe_pool_get_group(uint16_t dhe_named_group)
+{
+    uint32_t index;
+
+    for (index = 0; index < m_dhe_pool_group_count; index++) {
+        if (m_dhe_pool_group[index].dhe_named_group == dhe_named_group) {
+            return &m_dhe_pool_group[index];
+        }
+    }
+    return NULL;
+}
+
+/* The group with the fewest keys, or NULL if all the pools are full.*/
+static dhe_pool_group_t *dhe_pool_get_group_to_fill(void)
+{
+    dhe_pool_group_t *group;
+    dhe_pool_group_t *result;
+    uint32_t index;
+
+    result = NULL;
+    for (index = 0; index < m_dhe_pool_group_count; index++) {
+        group = &m_dhe_pool_group[index];
+        if (group->disabled || (group->key_count + group->pending_count >= m_dhe_pool_depth)) {
+            continue;
+        }
+        if ((result == NULL) ||
+            (group->key_count + group->pending_count <
+             result->key_count + result->pending_count)) {
+            result = group;
+        }
+    }
+    return result;
+}
+
+static dhe_pool_key_t *dhe_pool_generate_key(uint16_t dhe_named_group)
+{
+    dhe_pool_key_t *key;
+
+    key = (void *)malloc(sizeof(dhe_pool_key_t));
+    if (key == NULL) {
+        return NULL;
+    }
+    libspdm_zero_mem(key, sizeof(dhe_pool_key_t));
+
+    /* The version only matters for SM2_P256, which is not pooled.*/
+    key->dhe_context = __real_libspdm_secured_message_dhe_new(
+        (spdm_version_number_t)(SPDM_MESSAGE_VERSION_11 << SPDM_VERSION_NUMBER_SHIFT_BIT),
+        dhe_named_group, false);
+    if (key->dhe_context == NULL) {
+        free(key);
+        return NULL;
+    }
+    key->public_key_size = sizeof(key->public_key);
+    if (!__real_libspdm_secured_message_dhe_generate_key(dhe_named_group, key->dhe_context,
+                                                         key->public_key,
+                                                         &key->public_key_size)) {
+        __real_libspdm_secured_message_dhe_free(dhe_named_group, key->dhe_context);
+        dhe_pool_wipe_key(key);
+        return NULL;
+    }
+    return key;
+}
+
+static void dhe_pool_worker_routine(void *context)
+{
+    dhe_pool_group_t *group;
+    dhe_pool_key_t *key;
+
+    spdm_emu_mutex_lock(&m_dhe_pool_lock);
+    while (true) {
+        group = NULL;
+        while (!m_dhe_pool_stopping && ((group = dhe_pool_get_group_to_fill()) == NULL)) {
+            spdm_emu_cond_wait(&m_dhe_pool_cond, &m_dhe_pool_lock);
+        }
+        if (m_dhe_pool_stopping) {
+            break;
+        }
+        group->pending_count++;
+        spdm_emu_mutex_unlock(&m_dhe_pool_lock);
+
+        key = dhe_pool_generate_key(group->dhe_named_group);
+
+        spdm_emu_mutex_lock(&m_dhe_pool_lock);
+        group->pending_count--;
+        if (key == NULL) {
+            printf("DhePool fail - cannot generate dhe 0x%04x\n", group->dhe_named_group);
+            group->disabled = true;
+            continue;
+        }
+        key->next = group->keys;
+        group->keys = key;
+        group->key_count++;
+        group->generated_count++;
+    }
+    spdm_emu_mutex_unlock(&m_dhe_pool_lock);
+}
+
+/* Take a key for libspdm_secured_message_dhe_new, or NULL to generate one inline.*/
+static dhe_pool_key_t *dhe_pool_take_key(uint16_t dhe_named_group, bool is_initiator)
+{
+    dhe_pool_group_t *group;
+    dhe_pool_key_t *key;
+
+    if (!m_dhe_pool_running || is_initiator) {
+        return NULL;
+    }
+    spdm_emu_mutex_lock(&m_dhe_pool_lock);
+    group = dhe_pool_get_group(dhe_named_group);
+    key = NULL;
+    if (group != NULL) {
+        key = group->keys;
+        if (key == NULL) {
+            group->miss_count++;
+        } else {
+            group->keys = key->next;
+            group->key_count--;
+            group->hit_count++;
+            key->next = m_dhe_pool_issued_keys;
+            m_dhe_pool_issued_keys = key;
+        }
+        if (group->key_count < group->lowest_key_count) {
+            group->lowest_key_count = group->key_count;
+        }
+        spdm_emu_cond_signal(&m_dhe_pool_cond);
+    }
+    spdm_emu_mutex_unlock(&m_dhe_pool_lock);
+    return key;
+}
+
+/* Remove the issued key of a context, or return NULL if the context is not from the pool.*/
+static dhe_pool_key_t *dhe_pool_claim_key(const void *dhe_context)
+{
+    dhe_pool_key_t **link;
+    dhe_pool_key_t *key;
+
+    if (!m_dhe_pool_running || (dhe_context == NULL)) {
+        return NULL;
+    }
+    spdm_emu_mutex_lock(&m_dhe_pool_lock);
+    for (link = &m_dhe_pool_issued_keys; *link != NULL; link = &(*link)->next) {
+        if ((*link)->dhe_context == dhe_context) {
+            break;
+        }
+    }
+    key = *link;
+    if (key != NULL) {
+        *link = key->next;
+    }
+    spdm_emu_mutex_unlock(&m_dhe_pool_lock);
+    return key;
+}
+
+void *__wrap_libspdm_secured_message_dhe_new(spdm_version_number_t spdm_version,
+                                             uint16_t dhe_named_group, bool is_initiator)
+{
+    dhe_pool_key_t *key;
+
+    key = dhe_pool_take_key(dhe_named_group, is_initiator);
+    if (key == NULL) {
+        return __real_libspdm_secured_message_dhe_new(spdm_version, dhe_named_group,
+                                                      is_initiator);
+    }
+    return key->dhe_context;
+}
+
+bool __wrap_libspdm_secured_message_dhe_generate_key(uint16_t dhe_named_group,
+                                                     void *dhe_context, uint8_t *public_key,
+                                                     size_t *public_key_size)
+{
+    dhe_pool_key_t *key;
+    bool result;
+
+    key = dhe_pool_claim_key(dhe_context);
+    if (key == NULL) {
+        return __real_libspdm_secured_message_dhe_generate_key(dhe_named_group, dhe_context,
+                                                               public_key, public_key_size);
+    }
+    result = (*public_key_size >= key->public_key_size);
+    if (result) {
+        libspdm_copy_mem(public_key, *public_key_size, key->public_key, key->public_key_size);
+        *public_key_size = key->public_key_size;
+    }
+    dhe_pool_wipe_key(key);
+    return result;
+}
+
+void __wrap_libspdm_secured_message_dhe_free(uint16_t dhe_named_group, void *dhe_context)
+{
+    dhe_pool_key_t *key;
+
+    /* The key was handed out, but its public key was never read.*/
+    key = dhe_pool_claim_key(dhe_context);
+    if (key != NULL) {
+        dhe_pool_wipe_key(key);
+    }
+    __real_libspdm_secured_message_dhe_free(dhe_named_group, dhe_context);
+}
+
+void spdm_responder_dhe_pool_stop(void);
+
+/**
+ * Start the workers that fill a pool of m_dhe_pool_depth key pairs for each group of
+ * m_support_dhe_algo, except SM2_P256.
+ **/
+bool spdm_responder_dhe_pool_start(void)
+{
+    uint16_t dhe_named_group;
+    uint32_t index;
+
+    if (m_dhe_pool_running || (m_dhe_pool_depth == 0)) {
+        return true;
+    }
+
+    libspdm_zero_mem(m_dhe_pool_group, sizeof(m_dhe_pool_group));
+    m_dhe_pool_group_count = 0;
+    for (dhe_named_group = 1; dhe_named_group != 0; dhe_named_group <<= 1) {
+        if (((m_support_dhe_algo & dhe_named_group) == 0) ||
+            (dhe_named_group == SPDM_ALGORITHMS_DHE_NAMED_GROUP_SM2_P256)) {
+            continue;
+        }
+        m_dhe_pool_group[m_dhe_pool_group_count].dhe_named_group = dhe_named_group;
+        m_dhe_pool_group[m_dhe_pool_group_count].lowest_key_count = m_dhe_pool_depth;
+        m_dhe_pool_group_count++;
+    }
+    if (m_dhe_pool_group_count == 0) {
+        printf("DhePool - no dhe group to pool\n");
+        return false;
+    }
+
+    m_dhe_pool_thread = (void *)malloc(sizeof(spdm_emu_thread_t) * m_dhe_pool_thread_count);
+    if (m_dhe_pool_thread == NULL) {
+        return false;
+    }
+    spdm_emu_mutex_init(&m_dhe_pool_lock);
+    spdm_emu_cond_init(&m_dhe_pool_cond);
+    m_dhe_pool_stopping = false;
+    m_dhe_pool_issued_keys = NULL;
+    m_dhe_pool_started_thread_count = 0;
+    for (index = 0; index < m_dhe_pool_thread_count; index++) {
+        if (!spdm_emu_thread_create(&m_dhe_pool_thread[index], dhe_pool_worker_routine, NULL)) {
+            printf("DhePool fail - thread create error\n");
+            break;
+        }
+        m_dhe_pool_started_thread_count++;
+    }
+    m_dhe_pool_running = true;
+    if (m_dhe_pool_started_thread_count == 0) {
+        spdm_responder_dhe_pool_stop();
+        return false;
+    }
+    printf("DhePool - depth %u, %u groups, %u threads\n", m_dhe_pool_depth,
+           m_dhe_pool_group_count, m_dhe_pool_started_thread_count);
+    return true;
+}
+
+/**
+ * Stop the workers, free the unused key pairs and print the pool metrics.
+ * No SPDM context may be in KEY_EXCHANGE.
+ **/
+void spdm_responder_dhe_pool_stop(void)
+{
+    dhe_pool_group_t *group;
+    dhe_pool_key_t *key;
+    uint32_t index;
+
+    if (!m_dhe_pool_running) {
+        return;
+    }
+    spdm_emu_mutex_lock(&m_dhe_pool_lock);
+    m_dhe_pool_stopping = true;
+    spdm_emu_cond_broadcast(&m_dhe_pool_cond);
+    spdm_emu_mutex_unlock(&m_dhe_pool_lock);
+    for (index = 0; index < m_dhe_pool_started_thread_count; index++) {
+        spdm_emu_thread_join(m_dhe_pool_thread[index]);
+    }
+    free(m_dhe_pool_thread);
+    m_dhe_pool_thread = NULL;
+    m_dhe_pool_running = false;
+
+    for (index = 0; index < m_dhe_pool_group_count; index++) {
+        group = &m_dhe_pool_group[index];
+        printf("DhePool dhe 0x%04x - hit %u, miss %u, generated %u, depth %u, lowest depth %u\n",
+               group->dhe_named_group, group->hit_count, group->miss_count,
+               group->generated_count, group->key_count, group->lowest_key_count);
+        while (group->keys != NULL) {
+            key = group->keys;
+            group->keys = key->next;
+            __real_libspdm_secured_message_dhe_free(group->dhe_named_group, key->dhe_context);
+            dhe_pool_wipe_key(key);
+        }
+        group->key_count = 0;
+    }
+    /* A context handed out is freed by libspdm, with its key if still there.*/
+    while (m_dhe_pool_issued_keys != NULL) {
+        key = m_dhe_pool_issued_keys;
+        m_dhe_pool_issued_keys = key->next;
+        dhe_pool_wipe_key(key);
+    }
+    spdm_emu_cond_destroy(&m_dhe_pool_cond);
+    spdm_emu_mutex_destroy(&m_dhe_pool_lock);
+}
+
+#else
+
+bool spdm_responder_dhe_pool_start(void)
+{
+    if (m_dhe_pool_depth != 0) {
+        printf("DhePool - --dhe_pool is not supported by this build\n");
+    }
+    return false;
+}
+
+void spdm_responder_dhe_pool_stop(void)
+{
+}
+
+#endif /* SPDM_EMU_DHE_POOL*/
@@ -4,33 +4,58 @@
  *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
  **/
 
-#include "spdm_responder_emu.h"
-
-uint32_t m_command;
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+#endif
 
-SOCKET m_server_socket;
+#include "spdm_responder_emu.h"
+#ifndef _MSC_VER
+#include <signal.h>
+#endif
 
 extern void *m_spdm_context;
 #if LIBSPDM_FIPS_MODE
 extern void *m_fips_selftest_context;
 #endif /*LIBSPDM_FIPS_MODE*/
-extern void *m_scratch_buffer;
 extern void *m_pci_doe_context;
 
-void *spdm_server_init(void);
+void *spdm_server_init(spdm_emu_connection_t *connection);
+void spdm_server_deinit(spdm_emu_connection_t *connection);
+void spdm_server_process_hello(spdm_emu_connection_t *connection);
+bool spdm_responder_dhe_pool_start(void);
+void spdm_responder_dhe_pool_stop(void);
+bool spdm_responder_measurement_start(void);
+void spdm_responder_measurement_stop(void);
 libspdm_return_t pci_doe_init_responder ();
 
 bool InitConnectionAndHandShake(SOCKET *sock, uint16_t port_number);
 
-bool platform_server(const SOCKET socket)
+/* accept() poll interval, so that a SHUTDOWN from one connection stops the listener promptly*/
+#define SPDM_EMU_ACCEPT_POLL_MS 200
+
+typedef struct {
+    bool in_use;
+    bool finished;
+    spdm_emu_thread_t thread;
+    spdm_emu_connection_t connection;
+} spdm_server_slot_t;
+
+spdm_server_slot_t *m_server_slot;
+spdm_emu_mutex_t m_server_slot_lock;
+spdm_emu_cond_t m_server_slot_cond;
+bool m_server_stop;
+
+bool platform_server(spdm_emu_connection_t *connection)
 {
     bool result;
     libspdm_return_t status;
     uint8_t response[LIBPCIDOE_MAX_NON_SPDM_MESSAGE_SIZE];
     size_t response_size;
+    SOCKET socket;
 
+    socket = connection->socket;
     while (true) {
-        status = libspdm_responder_dispatch_message(m_spdm_context);
+        status = libspdm_responder_dispatch_message(connection->spdm_context);
         if (status == LIBSPDM_STATUS_SUCCESS) {
             /* success dispatch SPDM message*/
         }
@@ -42,8 +67,9 @@ bool platform_server(const SOCKET socket)
         if (status != LIBSPDM_STATUS_UNSUPPORTED_CAP) {
             continue;
         }
-        switch (m_command) {
+        switch (connection->command) {
         case SOCKET_SPDM_COMMAND_TEST:
+            spdm_server_process_hello(connection);
             result = send_platform_data(socket,
                                         SOCKET_SPDM_COMMAND_TEST,
                                         (uint8_t *)"Server Hello!",
@@ -62,7 +88,7 @@ bool platform_server(const SOCKET socket)
 
         case SOCKET_SPDM_COMMAND_OOB_ENCAP_KEY_UPDATE:
 #if (LIBSPDM_ENABLE_CAPABILITY_MUT_AUTH_CAP) || (LIBSPDM_ENABLE_CAPABILITY_ENCAP_CAP)
-            libspdm_init_key_update_encap_state(m_spdm_context);
+            libspdm_init_key_update_encap_state(connection->spdm_context);
             result = send_platform_data(
                 socket,
                 SOCKET_SPDM_COMMAND_OOB_ENCAP_KEY_UPDATE, NULL,
@@ -117,8 +143,9 @@ bool platform_server(const SOCKET socket)
                 SOCKET_TRANSPORT_TYPE_PCI_DOE) {
                 response_size = sizeof(response);
                 status = pci_doe_get_response_doe_request (m_pci_doe_context,
-                                                           m_send_receive_buffer,
-                                                           m_send_receive_buffer_size, response,
+                                                           connection->send_receive_buffer,
+                                                           connection->send_receive_buffer_size,
+                                                           response,
                                                            &response_size);
                 if (LIBSPDM_STATUS_IS_ERROR(status)) {
                     /* unknown message*/
@@ -145,7 +172,7 @@ bool platform_server(const SOCKET socket)
 
         default:
             printf("Unrecognized platform interface command %x\n",
-                   m_command);
+                   connection->command);
             result = send_platform_data(
                 socket, SOCKET_SPDM_COMMAND_UNKOWN, NULL, 0);
             if (!result) {
@@ -177,7 +204,7 @@ bool platform_server_routine(uint16_t port_number)
         if (!result) {
             return false;
         }
-        m_server_socket = responder_socket;
+        m_default_connection.socket = responder_socket;
     }
     else {
         result = create_socket(port_number, &responder_socket);
@@ -196,10 +223,10 @@ bool platform_server_routine(uint16_t port_number)
             printf("Platform server listening on port %d\n", port_number);
 
             length = sizeof(peer_address);
-            m_server_socket =
+            m_default_connection.socket =
                 accept(responder_socket, (struct sockaddr *)&peer_address,
                        (socklen_t *)&length);
-            if (m_server_socket == INVALID_SOCKET) {
+            if (m_default_connection.socket == INVALID_SOCKET) {
                 closesocket(responder_socket);
                 printf("Accept error.  Error is 0x%x\n",
 #ifdef _MSC_VER
@@ -214,8 +241,8 @@ bool platform_server_routine(uint16_t port_number)
                 return false;
             }
         }
-        continue_serving = platform_server(m_server_socket);
-        closesocket(m_server_socket);
+        continue_serving = platform_server(&m_default_connection);
+        closesocket(m_default_connection.socket);
 
     } while (continue_serving);
 
@@ -226,20 +253,244 @@ bool platform_server_routine(uint16_t port_number)
     return true;
 }
 
+/**
+ * Serve one accepted connection on its own thread.
+ *
+ * The connection ends when the requester closes it or sends CONTINUE. A SHUTDOWN
+ * stops the listener, but the other active connections run to completion.
+ **/
+void platform_server_connection_thread(void *context)
+{
+    spdm_server_slot_t *slot;
+    spdm_emu_connection_t *connection;
+
+    slot = context;
+    connection = &slot->connection;
+
+    platform_server(connection);
+    release_pcap_packet_stream(connection->socket);
+    closesocket(connection->socket);
+
+    spdm_server_deinit(connection);
+    free(connection->send_receive_buffer);
+    connection->send_receive_buffer = NULL;
+
+    spdm_emu_mutex_lock(&m_server_slot_lock);
+    if (connection->command == SOCKET_SPDM_COMMAND_SHUTDOWN) {
+        m_server_stop = true;
+    }
+    slot->finished = true;
+    spdm_emu_cond_broadcast(&m_server_slot_cond);
+    spdm_emu_mutex_unlock(&m_server_slot_lock);
+}
+
+/**
+ * Find a free connection slot, joining the threads of finished connections.
+ * Block while all m_max_connection_count slots are busy.
+ *
+ * @return the free slot, or NULL if the server is stopping.
+ **/
+spdm_server_slot_t *platform_server_get_free_slot(void)
+{
+    spdm_server_slot_t *slot;
+    uint32_t index;
+
+    spdm_emu_mutex_lock(&m_server_slot_lock);
+    while (true) {
+        slot = NULL;
+        for (index = 0; index < m_max_connection_count; index++) {
+            if (m_server_slot[index].in_use && m_server_slot[index].finished) {
+                spdm_emu_thread_join(m_server_slot[index].thread);
+                m_server_slot[index].in_use = false;
+            }
+            if (!m_server_slot[index].in_use && (slot == NULL)) {
+                slot = &m_server_slot[index];
+            }
+        }
+        if (m_server_stop) {
+            slot = NULL;
+            break;
+        }
+        if (slot != NULL) {
+            break;
+        }
+        spdm_emu_cond_wait(&m_server_slot_cond, &m_server_slot_lock);
+    }
+    spdm_emu_mutex_unlock(&m_server_slot_lock);
+
+    return slot;
+}
+
+bool platform_server_multi_connection_routine(uint16_t port_number)
+{
+    SOCKET responder_socket;
+    SOCKET client_socket;
+    struct sockaddr_in peer_address;
+    uint32_t length;
+    fd_set read_fds;
+    struct timeval timeout;
+    spdm_server_slot_t *slot;
+    uint32_t index;
+    int ret;
+    bool result;
+
+    result = create_socket(port_number, &responder_socket);
+    if (!result) {
+        printf("Create platform service socket fail\n");
+#ifdef _MSC_VER
+        WSACleanup();
+#endif
+        return false;
+    }
+
+    m_server_slot = (void *)calloc(m_max_connection_count, sizeof(spdm_server_slot_t));
+    if (m_server_slot == NULL) {
+        closesocket(responder_socket);
+#ifdef _MSC_VER
+        WSACleanup();
+#endif
+        return false;
+    }
+    spdm_emu_mutex_init(&m_server_slot_lock);
+    spdm_emu_cond_init(&m_server_slot_cond);
+    m_server_stop = false;
+
+    printf("Platform server listening on port %d (max %d connections)\n", port_number,
+           m_max_connection_count);
+
+    while (true) {
+        slot = platform_server_get_free_slot();
+        if (slot == NULL) {
+            break;
+        }
+
+        /* Poll, so that a SHUTDOWN on another connection is noticed without a new client.*/
+        FD_ZERO(&read_fds);
+        FD_SET(responder_socket, &read_fds);
+        timeout.tv_sec = 0;
+        timeout.tv_usec = SPDM_EMU_ACCEPT_POLL_MS * 1000;
+        ret = select((int)(responder_socket + 1), &read_fds, NULL, NULL, &timeout);
+        if (ret == 0) {
+            continue;
+        }
+        if (ret < 0) {
+#ifndef _MSC_VER
+            if (errno == EINTR) {
+                continue;
+            }
+#endif
+            printf("Select error.  Error is 0x%x\n",
+#ifdef _MSC_VER
+                   WSAGetLastError()
+#else
+                   errno
+#endif
+                   );
+            break;
+        }
+
+        length = sizeof(peer_address);
+        client_socket = accept(responder_socket, (struct sockaddr *)&peer_address,
+                               (socklen_t *)&length);
+        if (client_socket == INVALID_SOCKET) {
+            printf("Accept error.  Error is 0x%x\n",
+#ifdef _MSC_VER
+                   WSAGetLastError()
+#else
+                   errno
+#endif
+                   );
+            break;
+        }
+
+        libspdm_zero_mem(&slot->connection, sizeof(slot->connection));
+        slot->connection.socket = client_socket;
+        slot->connection.send_receive_buffer =
+            (void *)malloc(LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE);
+        if (slot->connection.send_receive_buffer == NULL) {
+            closesocket(client_socket);
+            continue;
+        }
+        if (spdm_server_init(&slot->connection) == NULL) {
+            printf("spdm_server_init fail\n");
+            spdm_server_deinit(&slot->connection);
+            free(slot->connection.send_receive_buffer);
+            closesocket(client_socket);
+            continue;
+        }
+
+        slot->in_use = true;
+        slot->finished = false;
+        if (!spdm_emu_thread_create(&slot->thread, platform_server_connection_thread, slot)) {
+            printf("Create connection thread fail\n");
+            slot->in_use = false;
+            spdm_server_deinit(&slot->connection);
+            free(slot->connection.send_receive_buffer);
+            closesocket(client_socket);
+            continue;
+        }
+    }
+
+    closesocket(responder_socket);
+
+    /* Let the active connections run to completion.*/
+    for (index = 0; index < m_max_connection_count; index++) {
+        if (m_server_slot[index].in_use) {
+            spdm_emu_thread_join(m_server_slot[index].thread);
+            m_server_slot[index].in_use = false;
+        }
+    }
+    spdm_emu_cond_destroy(&m_server_slot_cond);
+    spdm_emu_mutex_destroy(&m_server_slot_lock);
+    free(m_server_slot);
+    m_server_slot = NULL;
+
+#ifdef _MSC_VER
+    WSACleanup();
+#endif
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     libspdm_return_t status;
+    bool multi_connection;
 
     printf("%s version 0.1\n", "spdm_responder_emu");
     srand((unsigned int)time(NULL));
 
     process_args("spdm_responder_emu", argc, argv);
 
-    m_spdm_context = spdm_server_init();
-    if (m_spdm_context == NULL) {
+    /* The TCP handshake mode connects out to a single requester.*/
+    multi_connection = (m_max_connection_count > 1) &&
+                       !(m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP &&
+                         m_use_tcp_handshake == SOCKET_TCP_HANDSHAKE);
+
+#ifndef _MSC_VER
+    /* A requester going away must only end its own connection.*/
+    if (multi_connection) {
+        signal(SIGPIPE, SIG_IGN);
+    }
+#endif
+
+    spdm_emu_cert_cache_init();
+    spdm_responder_dhe_pool_start();
+    if ((m_meas_manifest_file_name != NULL) && !spdm_responder_measurement_start()) {
         return 0;
     }
 
+    /* Keep the state file I/O out of the message dispatch.*/
+    if ((m_save_state_file_name != NULL) || (m_state_store_file_name != NULL)) {
+        spdm_nv_flusher_start();
+    }
+
+    if (!multi_connection) {
+        m_spdm_context = spdm_server_init(&m_default_connection);
+        if (m_spdm_context == NULL) {
+            return 0;
+        }
+    }
+
     if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_PCI_DOE) {
         status = pci_doe_init_responder ();
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
@@ -248,12 +499,10 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (m_use_transport_layer == SOCKET_TRANSPORT_TYPE_TCP) {
-        /* The IANA has assigned port number 4194 for SPDM */
-        platform_server_routine(TCP_SPDM_PLATFORM_PORT);
-    }
-    else {
-        platform_server_routine(DEFAULT_SPDM_PLATFORM_PORT);
+    if (multi_connection) {
+        platform_server_multi_connection_routine(spdm_emu_get_platform_port());
+    } else {
+        platform_server_routine(spdm_emu_get_platform_port());
     }
 
     if (m_spdm_context != NULL) {
@@ -264,11 +513,16 @@ int main(int argc, char *argv[])
             return 0;
         }
 #endif /*LIBSPDM_FIPS_MODE*/
-        libspdm_deinit_context(m_spdm_context);
-        free(m_spdm_context);
-        free(m_scratch_buffer);
+        spdm_server_deinit(&m_default_connection);
+        m_spdm_context = NULL;
     }
 
+    spdm_responder_dhe_pool_stop();
+    spdm_responder_measurement_stop();
+    spdm_emu_cert_cache_free();
+    spdm_nv_flusher_stop();
+    spdm_state_store_close();
+
     printf("Server stopped\n");
 
     close_pcap_packet_file();
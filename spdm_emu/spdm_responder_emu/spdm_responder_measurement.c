@@ -0,0 +1,806 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#ifndef _MSC_VER
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+#endif
+
+#include "spdm_responder_emu.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* With --meas_manifest, the measurements are the digests of the image files listed in the
+ * manifest, instead of the fixed blocks of the libspdm device secret library.
+ * libspdm has no hook for that, so the build links the responder with --wrap for
+ * libspdm_measurement_collection and libspdm_generate_measurement_summary_hash (see
+ * CMakeLists.txt), and sets SPDM_EMU_MEAS_MANIFEST.
+ *
+ * A manifest line is "<index> <type> <LINEAR|TREE> <file>", '#' starts a comment.
+ * A LINEAR image is hashed as one stream. A TREE image is cut in SPDM_EMU_MEAS_CHUNK_SIZE
+ * chunks hashed by --meas_threads threads, and its digest is the hash of the chunk digests.
+ * The digests are computed in the background at startup, and kept until the device, inode,
+ * modification time or size of the file changes. A request for a digest being computed waits
+ * for it rather than hashing the image again.
+ * The manifest is rejected if the blocks of all its images do not fit in one measurement record
+ * with the largest supported measurement hash.
+ * The images are read with buffered I/O rather than mapped, so an image rewritten or truncated
+ * while it is hashed fails that digest instead of faulting the responder. The images are only
+ * reported as digests, a RAW_BIT measurement hash algorithm is not supported.*/
+
+#ifndef SPDM_EMU_MEAS_MANIFEST
+#define SPDM_EMU_MEAS_MANIFEST 0
+#endif
+
+#if SPDM_EMU_MEAS_MANIFEST
+
+libspdm_return_t __real_libspdm_measurement_collection(
+    spdm_version_number_t spdm_version, uint8_t measurement_specification,
+    uint32_t measurement_hash_algo, uint8_t measurements_index, uint8_t request_attribute,
+    uint8_t *content_changed, uint8_t *measurements_count, void *measurements,
+    size_t *measurements_size);
+
+bool __real_libspdm_generate_measurement_summary_hash(
+    spdm_version_number_t spdm_version, uint32_t base_hash_algo,
+    uint8_t measurement_specification, uint32_t measurement_hash_algo,
+    uint8_t measurement_summary_hash_type, uint8_t *measurement_summary_hash,
+    uint32_t measurement_summary_hash_size);
+
+#define SPDM_EMU_MEAS_CHUNK_SIZE (1024 * 1024)
+#define MEAS_MANIFEST_MAX_IMAGE_COUNT 64
+#define MEAS_MANIFEST_MAX_LINE_SIZE 1024
+#define MEAS_MAX_THREAD_COUNT 64
+/* one digest per SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_* bit*/
+#define MEAS_HASH_ALGO_COUNT 8
+
+typedef struct {
+    bool valid;
+    uint64_t device;
+    uint64_t inode;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t size;
+    uint8_t digest[LIBSPDM_MAX_HASH_SIZE];
+} meas_digest_t;
+
+typedef struct {
+    uint8_t index;
+    uint8_t value_type;
+    bool is_tree;
+    char *file_name;
+    /* held while the digest cache of the image is read or updated, not while it is hashed*/
+    spdm_emu_mutex_t lock;
+    /* signaled when a digest is no longer being computed*/
+    spdm_emu_cond_t hashed;
+    meas_digest_t digest[MEAS_HASH_ALGO_COUNT];
+    bool hashing[MEAS_HASH_ALGO_COUNT];
+    uint32_t hit_count;
+    uint32_t hash_count;
+} meas_image_t;
+
+typedef struct {
+    uint32_t measurement_hash_algo;
+    const char *file_name;
+    uint64_t size;
+    size_t chunk_count;
+    uint32_t hash_size;
+    uint8_t *chunk_digest;
+    uint32_t thread_index;
+    uint32_t thread_count;
+    bool result;
+} meas_tree_job_t;
+
+typedef struct {
+    const char *name;
+    uint8_t value_type;
+} meas_type_entry_t;
+
+meas_type_entry_t m_meas_type_table[] = {
+    { "IMMUTABLE_ROM", SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_IMMUTABLE_ROM },
+    { "MUTABLE_FIRMWARE", SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_MUTABLE_FIRMWARE },
+    { "HARDWARE_CONFIG", SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_HARDWARE_CONFIGURATION },
+    { "FIRMWARE_CONFIG", SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_FIRMWARE_CONFIGURATION },
+};
+
+bool m_meas_running;
+meas_image_t m_meas_image[MEAS_MANIFEST_MAX_IMAGE_COUNT];
+uint32_t m_meas_image_count;
+uint32_t m_meas_thread_count;
+spdm_emu_thread_t m_meas_warm_thread;
+bool m_meas_warm_thread_started;
+
+static uint32_t meas_get_algo_slot(uint32_t measurement_hash_algo)
+{
+    uint32_t slot;
+
+    for (slot = 0; slot < MEAS_HASH_ALGO_COUNT; slot++) {
+        if (measurement_hash_algo == ((uint32_t)1 << slot)) {
+            return slot;
+        }
+    }
+    return MEAS_HASH_ALGO_COUNT;
+}
+
+/* The base hash algorithm with the same hash function, for the streaming hash context.*/
+static uint32_t meas_get_base_hash_algo(uint32_t measurement_hash_algo)
+{
+    switch (measurement_hash_algo) {
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SHA_256:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_256;
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SHA_384:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_384;
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SHA_512:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA_512;
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SHA3_256:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA3_256;
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SHA3_384:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA3_384;
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SHA3_512:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SHA3_512;
+    case SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_TPM_ALG_SM3_256:
+        return SPDM_ALGORITHMS_BASE_HASH_ALGO_TPM_ALG_SM3_256;
+    default:
+        return 0;
+    }
+}
+
+/* Get the identity of the file content, the digest cache key.*/
+static bool meas_stat_image(const meas_image_t *image, meas_digest_t *key)
+{
+#ifdef _MSC_VER
+    struct _stat64 file_stat;
+
+    if (_stat64(image->file_name, &file_stat) != 0) {
+        return false;
+    }
+    key->mtime_nsec = 0;
+#else
+    struct stat file_stat;
+
+    if (stat(image->file_name, &file_stat) != 0) {
+        return false;
+    }
+    key->mtime_nsec = (int64_t)file_stat.st_mtim.tv_nsec;
+#endif
+    key->device = (uint64_t)file_stat.st_dev;
+    key->inode = (uint64_t)file_stat.st_ino;
+    key->mtime_sec = (int64_t)file_stat.st_mtime;
+    key->size = (uint64_t)file_stat.st_size;
+    return true;
+}
+
+static bool meas_is_same_file(const meas_digest_t *key1, const meas_digest_t *key2)
+{
+    return (key1->device == key2->device) && (key1->inode == key2->inode) &&
+           (key1->mtime_sec == key2->mtime_sec) && (key1->mtime_nsec == key2->mtime_nsec) &&
+           (key1->size == key2->size);
+}
+
+static bool meas_seek_image(FILE *file, uint64_t offset)
+{
+#ifdef _MSC_VER
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+/* Read the next chunk of an image, a short read means the file changed while it was hashed.*/
+static bool meas_read_chunk(FILE *file, uint64_t offset, uint64_t size, uint8_t *buffer,
+                            size_t *chunk_size)
+{
+    *chunk_size = SPDM_EMU_MEAS_CHUNK_SIZE;
+    if (size - offset < SPDM_EMU_MEAS_CHUNK_SIZE) {
+        *chunk_size = (size_t)(size - offset);
+    }
+    return fread(buffer, 1, *chunk_size, file) == *chunk_size;
+}
+
+static bool meas_hash_linear(uint32_t measurement_hash_algo, const char *file_name,
+                             uint64_t size, uint8_t *digest)
+{
+    uint32_t base_hash_algo;
+    void *hash_context;
+    FILE *file;
+    uint8_t *buffer;
+    uint64_t offset;
+    size_t chunk_size;
+    bool result;
+
+    base_hash_algo = meas_get_base_hash_algo(measurement_hash_algo);
+    if (base_hash_algo == 0) {
+        return false;
+    }
+    buffer = (void *)malloc(SPDM_EMU_MEAS_CHUNK_SIZE);
+    if (buffer == NULL) {
+        return false;
+    }
+    file = fopen(file_name, "rb");
+    if (file == NULL) {
+        free(buffer);
+        return false;
+    }
+    hash_context = libspdm_hash_new(base_hash_algo);
+    if (hash_context == NULL) {
+        fclose(file);
+        free(buffer);
+        return false;
+    }
+    result = libspdm_hash_init(base_hash_algo, hash_context);
+    for (offset = 0; result && (offset < size); offset += chunk_size) {
+        result = meas_read_chunk(file, offset, size, buffer, &chunk_size) &&
+                 libspdm_hash_update(base_hash_algo, hash_context, buffer, chunk_size);
+    }
+    if (result) {
+        result = libspdm_hash_final(base_hash_algo, hash_context, digest);
+    }
+    libspdm_hash_free(base_hash_algo, hash_context);
+    fclose(file);
+    free(buffer);
+    return result;
+}
+
+/* Each worker reads its own chunks through its own file handle and buffer.*/
+static void meas_tree_worker(void *context)
+{
+    meas_tree_job_t *job;
+    FILE *file;
+    uint8_t *buffer;
+    size_t chunk;
+    uint64_t offset;
+    size_t chunk_size;
+
+    job = context;
+    job->result = false;
+    buffer = (void *)malloc(SPDM_EMU_MEAS_CHUNK_SIZE);
+    if (buffer == NULL) {
+        return;
+    }
+    file = fopen(job->file_name, "rb");
+    if (file == NULL) {
+        free(buffer);
+        return;
+    }
+    job->result = true;
+    for (chunk = job->thread_index; chunk < job->chunk_count; chunk += job->thread_count) {
+        offset = (uint64_t)chunk * SPDM_EMU_MEAS_CHUNK_SIZE;
+        if (!meas_seek_image(file, offset) ||
+            !meas_read_chunk(file, offset, job->size, buffer, &chunk_size) ||
+            !libspdm_measurement_hash_all(job->measurement_hash_algo, buffer, chunk_size,
+                                          job->chunk_digest + chunk * job->hash_size)) {
+            job->result = false;
+            break;
+        }
+    }
+    fclose(file);
+    free(buffer);
+}
+
+static bool meas_hash_tree(uint32_t measurement_hash_algo, const char *file_name,
+                           uint64_t size, uint8_t *digest)
+{
+    meas_tree_job_t job[MEAS_MAX_THREAD_COUNT];
+    spdm_emu_thread_t thread[MEAS_MAX_THREAD_COUNT];
+    bool thread_started[MEAS_MAX_THREAD_COUNT];
+    uint8_t *chunk_digest;
+    size_t chunk_count;
+    uint32_t hash_size;
+    uint32_t thread_count;
+    uint32_t index;
+    bool result;
+
+    hash_size = libspdm_get_measurement_hash_size(measurement_hash_algo);
+    chunk_count = (size_t)((size + SPDM_EMU_MEAS_CHUNK_SIZE - 1) / SPDM_EMU_MEAS_CHUNK_SIZE);
+    if (chunk_count == 0) {
+        return libspdm_measurement_hash_all(measurement_hash_algo, NULL, 0, digest);
+    }
+    chunk_digest = (void *)malloc(chunk_count * hash_size);
+    if (chunk_digest == NULL) {
+        return false;
+    }
+
+    thread_count = m_meas_thread_count;
+    if (thread_count > chunk_count) {
+        thread_count = (uint32_t)chunk_count;
+    }
+    for (index = 0; index < thread_count; index++) {
+        job[index].measurement_hash_algo = measurement_hash_algo;
+        job[index].file_name = file_name;
+        job[index].size = size;
+        job[index].chunk_count = chunk_count;
+        job[index].hash_size = hash_size;
+        job[index].chunk_digest = chunk_digest;
+        job[index].thread_index = index;
+        job[index].thread_count = thread_count;
+        job[index].result = false;
+    }
+    /* The calling thread takes the first share.*/
+    for (index = 1; index < thread_count; index++) {
+        thread_started[index] = spdm_emu_thread_create(&thread[index], meas_tree_worker,
+                                                       &job[index]);
+    }
+    meas_tree_worker(&job[0]);
+    result = job[0].result;
+    for (index = 1; index < thread_count; index++) {
+        if (thread_started[index]) {
+            spdm_emu_thread_join(thread[index]);
+        } else {
+            meas_tree_worker(&job[index]);
+        }
+        result = result && job[index].result;
+    }
+
+    if (result) {
+        result = libspdm_measurement_hash_all(measurement_hash_algo, chunk_digest,
+                                              chunk_count * hash_size, digest);
+    }
+    free(chunk_digest);
+    return result;
+}
+
+/**
+ * Get the digest of an image, from the cache if the file did not change.
+ *
+ * The image lock only covers the cache, a digest is computed without it. A thread asking for a
+ * digest that another thread is computing waits for that one, and only hashes the image itself
+ * if the file changed or the other thread failed.
+ *
+ * @param  image                         The manifest image.
+ * @param  measurement_hash_algo         The SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_* of the digest.
+ * @param  digest                        The digest, of the measurement hash size.
+ **/
+static bool meas_get_image_digest(meas_image_t *image, uint32_t measurement_hash_algo,
+                                  uint8_t *digest)
+{
+    meas_digest_t key;
+    meas_digest_t key_after;
+    meas_digest_t *cached;
+    uint32_t slot;
+    uint32_t hash_size;
+    bool is_same_file;
+    bool result;
+
+    slot = meas_get_algo_slot(measurement_hash_algo);
+    hash_size = libspdm_get_measurement_hash_size(measurement_hash_algo);
+    if ((slot == MEAS_HASH_ALGO_COUNT) || (hash_size == 0)) {
+        return false;
+    }
+    cached = &image->digest[slot];
+
+    if (!meas_stat_image(image, &key)) {
+        printf("MeasManifest fail - stat %s error\n", image->file_name);
+        return false;
+    }
+    spdm_emu_mutex_lock(&image->lock);
+    while (image->hashing[slot]) {
+        spdm_emu_cond_wait(&image->hashed, &image->lock);
+    }
+    if (cached->valid && meas_is_same_file(cached, &key)) {
+        libspdm_copy_mem(digest, hash_size, cached->digest, hash_size);
+        image->hit_count++;
+        spdm_emu_mutex_unlock(&image->lock);
+        return true;
+    }
+    image->hashing[slot] = true;
+    spdm_emu_mutex_unlock(&image->lock);
+
+    if (image->is_tree) {
+        result = meas_hash_tree(measurement_hash_algo, image->file_name, key.size, digest);
+    } else {
+        result = meas_hash_linear(measurement_hash_algo, image->file_name, key.size, digest);
+    }
+
+    /* A file replaced while it was hashed is hashed again on the next request.*/
+    is_same_file = result && meas_stat_image(image, &key_after) &&
+                   meas_is_same_file(&key, &key_after);
+    spdm_emu_mutex_lock(&image->lock);
+    if (is_same_file) {
+        *cached = key;
+        libspdm_copy_mem(cached->digest, sizeof(cached->digest), digest, hash_size);
+        cached->valid = true;
+    }
+    image->hash_count++;
+    image->hashing[slot] = false;
+    spdm_emu_cond_broadcast(&image->hashed);
+    spdm_emu_mutex_unlock(&image->lock);
+    if (!result) {
+        printf("MeasManifest fail - hash %s error\n", image->file_name);
+    }
+    return result;
+}
+
+/* Hash the images with each supported measurement hash algorithm before they are requested.*/
+static void meas_warm_routine(void *context)
+{
+    uint8_t digest[LIBSPDM_MAX_HASH_SIZE];
+    uint32_t index;
+    uint32_t slot;
+
+    for (slot = 0; slot < MEAS_HASH_ALGO_COUNT; slot++) {
+        if ((m_support_measurement_hash_algo & ((uint32_t)1 << slot)) == 0) {
+            continue;
+        }
+        if (((uint32_t)1 << slot) == SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_RAW_BIT_STREAM_ONLY) {
+            continue;
+        }
+        for (index = 0; index < m_meas_image_count; index++) {
+            meas_get_image_digest(&m_meas_image[index], (uint32_t)1 << slot, digest);
+        }
+    }
+}
+
+static bool meas_parse_manifest_line(char *line, uint32_t line_number)
+{
+    meas_image_t *image;
+    uint32_t index;
+    uint32_t type_index;
+    char type_name[32];
+    char format_name[16];
+    char file_name[MEAS_MANIFEST_MAX_LINE_SIZE];
+    size_t file_name_size;
+
+    if (sscanf(line, "%u %31s %15s %1023[^\r\n]", &index, type_name, format_name,
+               file_name) != 4) {
+        printf("MeasManifest fail - invalid line %u\n", line_number);
+        return false;
+    }
+    if ((index == 0) || (index >= SPDM_MEASUREMENT_BLOCK_MEASUREMENT_INDEX_MEASUREMENT_MANIFEST) ||
+        (m_meas_image_count == MEAS_MANIFEST_MAX_IMAGE_COUNT)) {
+        printf("MeasManifest fail - invalid index at line %u\n", line_number);
+        return false;
+    }
+    for (type_index = 0; type_index < LIBSPDM_ARRAY_SIZE(m_meas_type_table); type_index++) {
+        if (strcmp(type_name, m_meas_type_table[type_index].name) == 0) {
+            break;
+        }
+    }
+    if (type_index == LIBSPDM_ARRAY_SIZE(m_meas_type_table)) {
+        printf("MeasManifest fail - invalid type %s at line %u\n", type_name, line_number);
+        return false;
+    }
+    if ((strcmp(format_name, "LINEAR") != 0) && (strcmp(format_name, "TREE") != 0)) {
+        printf("MeasManifest fail - invalid format %s at line %u\n", format_name, line_number);
+        return false;
+    }
+
+    image = &m_meas_image[m_meas_image_count];
+    libspdm_zero_mem(image, sizeof(meas_image_t));
+    image->index = (uint8_t)index;
+    image->value_type = m_meas_type_table[type_index].value_type;
+    image->is_tree = (strcmp(format_name, "TREE") == 0);
+    file_name_size = strlen(file_name) + 1;
+    image->file_name = (void *)malloc(file_name_size);
+    if (image->file_name == NULL) {
+        return false;
+    }
+    libspdm_copy_mem(image->file_name, file_name_size, file_name, file_name_size);
+    spdm_emu_mutex_init(&image->lock);
+    spdm_emu_cond_init(&image->hashed);
+    m_meas_image_count++;
+    return true;
+}
+
+/* The size of the measurement record with all the images, for the largest supported hash.*/
+static size_t meas_get_max_record_size(void)
+{
+    uint32_t slot;
+    uint32_t hash_size;
+    uint32_t max_hash_size;
+
+    max_hash_size = 0;
+    for (slot = 0; slot < MEAS_HASH_ALGO_COUNT; slot++) {
+        if (((m_support_measurement_hash_algo & ((uint32_t)1 << slot)) == 0) ||
+            (((uint32_t)1 << slot) == SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_RAW_BIT_STREAM_ONLY)) {
+            continue;
+        }
+        hash_size = libspdm_get_measurement_hash_size((uint32_t)1 << slot);
+        if (hash_size > max_hash_size) {
+            max_hash_size = hash_size;
+        }
+    }
+    return (size_t)m_meas_image_count * (sizeof(spdm_measurement_block_dmtf_t) + max_hash_size);
+}
+
+static bool meas_load_manifest(const char *manifest_file_name)
+{
+    spdm_emu_file_view_t *view;
+    const void *data;
+    size_t size;
+    const char *text;
+    char line[MEAS_MANIFEST_MAX_LINE_SIZE];
+    size_t offset;
+    size_t line_size;
+    size_t start;
+    uint32_t line_number;
+    uint32_t index;
+    bool result;
+
+    view = spdm_emu_map_input_file(manifest_file_name, &data, &size);
+    if (view == NULL) {
+        return false;
+    }
+    text = data;
+    result = true;
+    line_number = 0;
+    for (offset = 0; result && (offset < size); offset += line_size + 1) {
+        line_number++;
+        for (line_size = 0; (offset + line_size < size) && (text[offset + line_size] != '\n');
+             line_size++) {
+        }
+        if (line_size >= sizeof(line)) {
+            printf("MeasManifest fail - line %u is too long\n", line_number);
+            result = false;
+            break;
+        }
+        libspdm_copy_mem(line, sizeof(line), text + offset, line_size);
+        line[line_size] = '\0';
+        for (start = 0; (line[start] == ' ') || (line[start] == '\t'); start++) {
+        }
+        if ((line[start] == '\0') || (line[start] == '\r') || (line[start] == '#')) {
+            continue;
+        }
+        result = meas_parse_manifest_line(line + start, line_number);
+        for (index = 0; result && (index + 1 < m_meas_image_count); index++) {
+            if (m_meas_image[index].index == m_meas_image[m_meas_image_count - 1].index) {
+                printf("MeasManifest fail - duplicated index at line %u\n", line_number);
+                result = false;
+            }
+        }
+    }
+    spdm_emu_release_file_view(view);
+    if (result && (m_meas_image_count == 0)) {
+        printf("MeasManifest fail - no image in %s\n", manifest_file_name);
+        result = false;
+    }
+    if (result && (meas_get_max_record_size() > LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE)) {
+        printf("MeasManifest fail - %u images exceed the measurement record size %u\n",
+               m_meas_image_count, (uint32_t)LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE);
+        result = false;
+    }
+    return result;
+}
+
+libspdm_return_t __wrap_libspdm_measurement_collection(
+    spdm_version_number_t spdm_version, uint8_t measurement_specification,
+    uint32_t measurement_hash_algo, uint8_t measurements_index, uint8_t request_attribute,
+    uint8_t *content_changed, uint8_t *measurements_count, void *measurements,
+    size_t *measurements_size)
+{
+    spdm_measurement_block_dmtf_t *measurement_block;
+    size_t total_size;
+    size_t block_size;
+    uint32_t hash_size;
+    uint32_t index;
+    uint8_t count;
+
+    if (!m_meas_running) {
+        return __real_libspdm_measurement_collection(
+            spdm_version, measurement_specification, measurement_hash_algo, measurements_index,
+            request_attribute, content_changed, measurements_count, measurements,
+            measurements_size);
+    }
+
+    /* The images are only reported as digests, there is no raw bit stream form of an image.*/
+    if ((measurement_specification != SPDM_MEASUREMENT_BLOCK_HEADER_SPECIFICATION_DMTF) ||
+        (measurement_hash_algo == 0) ||
+        (measurement_hash_algo == SPDM_ALGORITHMS_MEASUREMENT_HASH_ALGO_RAW_BIT_STREAM_ONLY)) {
+        return LIBSPDM_STATUS_UNSUPPORTED_CAP;
+    }
+    hash_size = libspdm_get_measurement_hash_size(measurement_hash_algo);
+    LIBSPDM_ASSERT(hash_size != 0);
+
+    if (measurements_index ==
+        SPDM_GET_MEASUREMENTS_REQUEST_MEASUREMENT_OPERATION_TOTAL_NUMBER_OF_MEASUREMENTS) {
+        *measurements_count = (uint8_t)m_meas_image_count;
+    } else {
+        block_size = sizeof(spdm_measurement_block_dmtf_t) + hash_size;
+        total_size = 0;
+        count = 0;
+        measurement_block = measurements;
+        for (index = 0; index < m_meas_image_count; index++) {
+            if ((measurements_index !=
+                 SPDM_GET_MEASUREMENTS_REQUEST_MEASUREMENT_OPERATION_ALL_MEASUREMENTS) &&
+                (measurements_index != m_meas_image[index].index)) {
+                continue;
+            }
+            if (total_size + block_size > *measurements_size) {
+                return LIBSPDM_STATUS_BUFFER_TOO_SMALL;
+            }
+            measurement_block->measurement_block_common_header.index =
+                m_meas_image[index].index;
+            measurement_block->measurement_block_common_header.measurement_specification =
+                SPDM_MEASUREMENT_BLOCK_HEADER_SPECIFICATION_DMTF;
+            measurement_block->measurement_block_common_header.measurement_size =
+                (uint16_t)(sizeof(spdm_measurement_block_dmtf_header_t) + hash_size);
+            measurement_block->measurement_block_dmtf_header.dmtf_spec_measurement_value_type =
+                m_meas_image[index].value_type;
+            measurement_block->measurement_block_dmtf_header.dmtf_spec_measurement_value_size =
+                (uint16_t)hash_size;
+            if (!meas_get_image_digest(&m_meas_image[index], measurement_hash_algo,
+                                       (void *)(measurement_block + 1))) {
+                return LIBSPDM_STATUS_MEAS_INTERNAL_ERROR;
+            }
+            measurement_block = (void *)((uint8_t *)measurement_block + block_size);
+            total_size += block_size;
+            count++;
+        }
+        if (count == 0) {
+            *measurements_count = 0;
+            return LIBSPDM_STATUS_MEAS_INVALID_INDEX;
+        }
+        *measurements_count = count;
+        *measurements_size = total_size;
+    }
+
+    if ((content_changed != NULL) &&
+        ((spdm_version >> SPDM_VERSION_NUMBER_SHIFT_BIT) >= SPDM_MESSAGE_VERSION_12)) {
+        if ((request_attribute & SPDM_GET_MEASUREMENTS_REQUEST_ATTRIBUTES_GENERATE_SIGNATURE) !=
+            0) {
+            *content_changed = SPDM_MEASUREMENTS_RESPONSE_CONTENT_NO_CHANGE_DETECTED;
+        } else {
+            *content_changed = SPDM_MEASUREMENTS_RESPONSE_CONTENT_CHANGE_NO_DETECTION;
+        }
+    }
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+bool __wrap_libspdm_generate_measurement_summary_hash(
+    spdm_version_number_t spdm_version, uint32_t base_hash_algo,
+    uint8_t measurement_specification, uint32_t measurement_hash_algo,
+    uint8_t measurement_summary_hash_type, uint8_t *measurement_summary_hash,
+    uint32_t measurement_summary_hash_size)
+{
+    uint8_t device_measurement[LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE];
+    uint8_t measurement_data[LIBSPDM_MAX_MEASUREMENT_RECORD_SIZE];
+    uint8_t device_measurement_count;
+    size_t device_measurement_size;
+    size_t measurement_data_size;
+    size_t block_size;
+    size_t hashed_size;
+    const spdm_measurement_block_dmtf_t *measurement_block;
+    const uint8_t *hashed_data;
+    uint8_t index;
+
+    if (!m_meas_running) {
+        return __real_libspdm_generate_measurement_summary_hash(
+            spdm_version, base_hash_algo, measurement_specification, measurement_hash_algo,
+            measurement_summary_hash_type, measurement_summary_hash,
+            measurement_summary_hash_size);
+    }
+
+    switch (measurement_summary_hash_type) {
+    case SPDM_CHALLENGE_REQUEST_NO_MEASUREMENT_SUMMARY_HASH:
+        return true;
+    case SPDM_CHALLENGE_REQUEST_TCB_COMPONENT_MEASUREMENT_HASH:
+    case SPDM_CHALLENGE_REQUEST_ALL_MEASUREMENTS_HASH:
+        break;
+    default:
+        return false;
+    }
+    if (measurement_summary_hash_size != libspdm_get_hash_size(base_hash_algo)) {
+        return false;
+    }
+
+    device_measurement_size = sizeof(device_measurement);
+    if (LIBSPDM_STATUS_IS_ERROR(__wrap_libspdm_measurement_collection(
+                                    spdm_version, measurement_specification,
+                                    measurement_hash_algo,
+                                    SPDM_GET_MEASUREMENTS_REQUEST_MEASUREMENT_OPERATION_ALL_MEASUREMENTS,
+                                    0, NULL, &device_measurement_count, device_measurement,
+                                    &device_measurement_size))) {
+        return false;
+    }
+
+    /* The TCB summary only covers the immutable ROM. SPDM 1.2 hashes whole blocks, the older
+     * versions hash them without the common header.*/
+    measurement_data_size = 0;
+    measurement_block = (void *)device_measurement;
+    for (index = 0; index < device_measurement_count; index++) {
+        block_size = sizeof(spdm_measurement_block_common_header_t) +
+                     measurement_block->measurement_block_common_header.measurement_size;
+        if ((measurement_summary_hash_type == SPDM_CHALLENGE_REQUEST_ALL_MEASUREMENTS_HASH) ||
+            ((measurement_block->measurement_block_dmtf_header.dmtf_spec_measurement_value_type &
+              SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_MASK) ==
+             SPDM_MEASUREMENT_BLOCK_MEASUREMENT_TYPE_IMMUTABLE_ROM)) {
+            if (spdm_version < (SPDM_MESSAGE_VERSION_12 << SPDM_VERSION_NUMBER_SHIFT_BIT)) {
+                hashed_data = (const void *)&measurement_block->measurement_block_dmtf_header;
+                hashed_size = measurement_block->measurement_block_common_header.measurement_size;
+            } else {
+                hashed_data = (const void *)measurement_block;
+                hashed_size = block_size;
+            }
+            libspdm_copy_mem(measurement_data + measurement_data_size,
+                             sizeof(measurement_data) - measurement_data_size,
+                             hashed_data, hashed_size);
+            measurement_data_size += hashed_size;
+        }
+        measurement_block = (const void *)((const uint8_t *)measurement_block + block_size);
+    }
+
+    return libspdm_hash_all(base_hash_algo, measurement_data, measurement_data_size,
+                            measurement_summary_hash);
+}
+
+void spdm_responder_measurement_stop(void);
+
+/**
+ * Load --meas_manifest and start hashing its images in the background.
+ **/
+bool spdm_responder_measurement_start(void)
+{
+    if ((m_meas_manifest_file_name == NULL) || m_meas_running) {
+        return true;
+    }
+    m_meas_thread_count = m_meas_hash_thread_count;
+    if (m_meas_thread_count == 0) {
+        m_meas_thread_count = spdm_emu_get_cpu_count();
+    }
+    if (m_meas_thread_count > MEAS_MAX_THREAD_COUNT) {
+        m_meas_thread_count = MEAS_MAX_THREAD_COUNT;
+    }
+    if (m_meas_thread_count == 0) {
+        m_meas_thread_count = 1;
+    }
+
+    m_meas_running = true;
+    if (!meas_load_manifest(m_meas_manifest_file_name)) {
+        spdm_responder_measurement_stop();
+        return false;
+    }
+    printf("MeasManifest - %u images, %u hash threads\n", m_meas_image_count,
+           m_meas_thread_count);
+    m_meas_warm_thread_started = spdm_emu_thread_create(&m_meas_warm_thread, meas_warm_routine,
+                                                        NULL);
+    if (!m_meas_warm_thread_started) {
+        /* The digests are computed on the first request instead.*/
+        printf("MeasManifest - thread create error\n");
+    }
+    return true;
+}
+
+/**
+ * Wait for the background hashing, print the digest cache hits and free the manifest.
+ * No SPDM context may be in GET_MEASUREMENTS.
+ **/
+void spdm_responder_measurement_stop(void)
+{
+    uint32_t index;
+
+    if (!m_meas_running) {
+        return;
+    }
+    if (m_meas_warm_thread_started) {
+        spdm_emu_thread_join(m_meas_warm_thread);
+        m_meas_warm_thread_started = false;
+    }
+    for (index = 0; index < m_meas_image_count; index++) {
+        printf("MeasManifest index %u - hit %u, hashed %u\n", m_meas_image[index].index,
+               m_meas_image[index].hit_count, m_meas_image[index].hash_count);
+        spdm_emu_mutex_destroy(&m_meas_image[index].lock);
+        spdm_emu_cond_destroy(&m_meas_image[index].hashed);
+        free(m_meas_image[index].file_name);
+    }
+    libspdm_zero_mem(m_meas_image, sizeof(m_meas_image));
+    m_meas_image_count = 0;
+    m_meas_running = false;
+}
+
+#else
+
+bool spdm_responder_measurement_start(void)
+{
+    if (m_meas_manifest_file_name != NULL) {
+        printf("MeasManifest - --meas_manifest is not supported by this build\n");
+    }
+    return false;
+}
+
+void spdm_responder_measurement_stop(void)
+{
+}
+
+#endif /* SPDM_EMU_MEAS_MANIFEST*/
@@ -10,11 +10,6 @@ void *m_spdm_context;
 #if LIBSPDM_FIPS_MODE
 void *m_fips_selftest_context;
 #endif /*LIBSPDM_FIPS_MODE*/
-void *m_scratch_buffer;
-
-extern uint32_t m_command;
-
-extern SOCKET m_server_socket;
 
 /**
  * Notify the session state to a session APP.
@@ -36,6 +31,8 @@ void spdm_server_session_state_callback(void *spdm_context,
 void spdm_server_connection_state_callback(
     void *spdm_context, libspdm_connection_state_t connection_state);
 
+void spdm_server_deinit(spdm_emu_connection_t *connection);
+
 libspdm_return_t spdm_get_response_vendor_defined_request(
     void *spdm_context, const uint32_t *session_id, bool is_app_message,
     size_t request_size, const void *request, size_t *response_size,
@@ -46,8 +43,10 @@ libspdm_return_t spdm_device_send_message(void *spdm_context,
                                           uint64_t timeout)
 {
     bool result;
+    spdm_emu_connection_t *connection;
 
-    result = send_platform_data(m_server_socket, SOCKET_SPDM_COMMAND_NORMAL,
+    connection = spdm_emu_get_connection(spdm_context);
+    result = send_platform_data(connection->socket, SOCKET_SPDM_COMMAND_NORMAL,
                                 response, (uint32_t)response_size);
     if (!result) {
         printf("send_platform_data Error - %x\n",
@@ -68,12 +67,15 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
                                              uint64_t timeout)
 {
     bool result;
+    spdm_emu_connection_t *connection;
 
-    assert (*request == m_send_receive_buffer);
-    m_send_receive_buffer_size = sizeof(m_send_receive_buffer);
+    connection = spdm_emu_get_connection(spdm_context);
+    assert (*request == connection->send_receive_buffer);
+    connection->send_receive_buffer_size = LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE;
     result =
-        receive_platform_data(m_server_socket, &m_command,
-                              m_send_receive_buffer, &m_send_receive_buffer_size);
+        receive_platform_data(connection->socket, &connection->command,
+                              connection->send_receive_buffer,
+                              &connection->send_receive_buffer_size);
     if (!result) {
         printf("receive_platform_data Error - %x\n",
 #ifdef _MSC_VER
@@ -84,7 +86,7 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
                );
         return LIBSPDM_STATUS_RECEIVE_FAIL;
     }
-    if (m_command == SOCKET_SPDM_COMMAND_NORMAL) {
+    if (connection->command == SOCKET_SPDM_COMMAND_NORMAL) {
 
         /* Cache the message in case it is not for SPDM.*/
 
@@ -94,13 +96,24 @@ libspdm_return_t spdm_device_receive_message(void *spdm_context,
 
         return LIBSPDM_STATUS_UNSUPPORTED_CAP;
     }
-    *request = m_send_receive_buffer;
-    *request_size = m_send_receive_buffer_size;
+    *request = connection->send_receive_buffer;
+    *request_size = connection->send_receive_buffer_size;
 
     return LIBSPDM_STATUS_SUCCESS;
 }
 
-void *spdm_server_init(void)
+/**
+ * Create and provision an SPDM context for one requester connection.
+ *
+ * The context, its scratch buffer and its certificate chain buffer are recorded in the connection,
+ * and the connection is attached to the context so that the device IO uses its socket and buffer.
+ * On failure, they are released with spdm_server_deinit.
+ *
+ * @param  connection                    The platform connection that owns the new context.
+ *
+ * @return the SPDM context, or NULL on failure.
+ **/
+void *spdm_server_init(spdm_emu_connection_t *connection)
 {
     void *spdm_context;
 #if LIBSPDM_FIPS_MODE
@@ -117,24 +130,34 @@ void *spdm_server_init(void)
 
     printf("context_size - 0x%x\n", (uint32_t)libspdm_get_context_size());
 
-    m_spdm_context = (void *)malloc(libspdm_get_context_size());
-    if (m_spdm_context == NULL) {
+    spdm_context = (void *)malloc(libspdm_get_context_size());
+    if (spdm_context == NULL) {
         return NULL;
     }
-    spdm_context = m_spdm_context;
     libspdm_init_context(spdm_context);
 
+    /* Attached first, the --load_state callback below looks the connection up.*/
+    if (!spdm_emu_attach_connection(spdm_context, connection)) {
+        libspdm_deinit_context(spdm_context);
+        free(spdm_context);
+        return NULL;
+    }
+
 #if LIBSPDM_FIPS_MODE
-    m_fips_selftest_context = (void *)malloc(libspdm_get_fips_selftest_context_size());
     if (m_fips_selftest_context == NULL) {
-        return NULL;
+        m_fips_selftest_context = (void *)malloc(libspdm_get_fips_selftest_context_size());
+        if (m_fips_selftest_context == NULL) {
+            spdm_server_deinit(connection);
+            return NULL;
+        }
+        libspdm_init_fips_selftest_context(m_fips_selftest_context);
     }
     fips_selftest_context = m_fips_selftest_context;
-    libspdm_init_fips_selftest_context(fips_selftest_context);
 
     if (!libspdm_import_fips_selftest_context_to_spdm_context(
             spdm_context, fips_selftest_context,
             libspdm_get_fips_selftest_context_size())) {
+        spdm_server_deinit(connection);
         return NULL;
     }
 #endif /*LIBSPDM_FIPS_MODE*/
@@ -175,8 +198,7 @@ void *spdm_server_init(void)
             spdm_transport_none_encode_message,
             spdm_transport_none_decode_message);
     } else {
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+        spdm_server_deinit(connection);
         return NULL;
     }
     libspdm_register_device_buffer_func(spdm_context,
@@ -187,33 +209,34 @@ void *spdm_server_init(void)
                                         spdm_device_acquire_receiver_buffer,
                                         spdm_device_release_receiver_buffer);
 
-    scratch_buffer_size = libspdm_get_sizeof_required_scratch_buffer(m_spdm_context);
-    m_scratch_buffer = (void *)malloc(scratch_buffer_size);
-    if (m_scratch_buffer == NULL) {
-        free(m_spdm_context);
-        m_spdm_context = NULL;
+    scratch_buffer_size = libspdm_get_sizeof_required_scratch_buffer(spdm_context);
+    connection->scratch_buffer = (void *)malloc(scratch_buffer_size);
+    if (connection->scratch_buffer == NULL) {
+        spdm_server_deinit(connection);
         return NULL;
     }
-    libspdm_set_scratch_buffer (spdm_context, m_scratch_buffer, scratch_buffer_size);
+    libspdm_set_scratch_buffer (spdm_context, connection->scratch_buffer, scratch_buffer_size);
 
     requester_cert_chain_buffer = (void *)malloc(SPDM_MAX_CERTIFICATE_CHAIN_SIZE);
     if (requester_cert_chain_buffer == NULL)
     {
+        spdm_server_deinit(connection);
         return NULL;
     }
+    connection->cert_chain_buffer = requester_cert_chain_buffer;
     libspdm_register_cert_chain_buffer(spdm_context, requester_cert_chain_buffer,
                                        SPDM_MAX_CERTIFICATE_CHAIN_SIZE);
 
     if (!libspdm_check_context(spdm_context))
     {
+        spdm_server_deinit(connection);
         return NULL;
     }
 
     if (m_load_state_file_name != NULL) {
         status = spdm_load_negotiated_state(spdm_context, false);
         if (LIBSPDM_STATUS_IS_ERROR(status)) {
-            free(m_spdm_context);
-            m_spdm_context = NULL;
+            spdm_server_deinit(connection);
             return NULL;
         }
     }
@@ -304,7 +327,68 @@ void *spdm_server_init(void)
             spdm_context, LIBSPDM_CONNECTION_STATE_NEGOTIATED);
     }
 
-    return m_spdm_context;
+    return spdm_context;
+}
+
+/**
+ * Release an SPDM context created by spdm_server_init and the buffers recorded in its connection.
+ *
+ * @param  connection                    The platform connection that owns the context.
+ **/
+void spdm_server_deinit(spdm_emu_connection_t *connection)
+{
+    if (connection->spdm_context != NULL) {
+        libspdm_deinit_context(connection->spdm_context);
+        free(connection->spdm_context);
+        connection->spdm_context = NULL;
+    }
+    free(connection->scratch_buffer);
+    connection->scratch_buffer = NULL;
+    free(connection->cert_chain_buffer);
+    connection->cert_chain_buffer = NULL;
+}
+
+/**
+ * Handle the platform hello of a requester. With --state_store, take the --peer_id that the
+ * requester sent after "Client Hello!" and provision the negotiated state saved for it.
+ *
+ * @param  connection                    The connection that received SOCKET_SPDM_COMMAND_TEST.
+ **/
+void spdm_server_process_hello(spdm_emu_connection_t *connection)
+{
+    size_t offset;
+    size_t peer_id_size;
+    libspdm_return_t status;
+
+    if (m_state_store_file_name == NULL) {
+        return;
+    }
+    offset = sizeof("Client Hello!");
+    if ((connection->send_receive_buffer_size <= offset) ||
+        (memcmp(connection->send_receive_buffer, "Client Hello!", offset) != 0)) {
+        return;
+    }
+    peer_id_size = 0;
+    while ((offset + peer_id_size < connection->send_receive_buffer_size) &&
+           (connection->send_receive_buffer[offset + peer_id_size] != '\0')) {
+        peer_id_size++;
+    }
+    if ((peer_id_size == 0) || (peer_id_size > SPDM_STATE_STORE_MAX_KEY_SIZE)) {
+        return;
+    }
+    libspdm_copy_mem(connection->peer_id, sizeof(connection->peer_id),
+                     connection->send_receive_buffer + offset, peer_id_size);
+    connection->peer_id[peer_id_size] = '\0';
+    printf("peer_id - %s\n", connection->peer_id);
+
+    status = spdm_load_peer_negotiated_state(connection->spdm_context, false,
+                                             connection->peer_id);
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        return;
+    }
+    /* Provision the rest, as for --load_state.*/
+    spdm_server_connection_state_callback(
+        connection->spdm_context, LIBSPDM_CONNECTION_STATE_NEGOTIATED);
 }
 
 /**
@@ -317,8 +401,8 @@ void spdm_server_connection_state_callback(
     void *spdm_context, libspdm_connection_state_t connection_state)
 {
     bool res;
-    void *data;
-    void *data1;
+    const void *data;
+    const void *data1;
     size_t data_size;
     size_t data1_size;
     libspdm_data_parameter_t parameter;
@@ -326,19 +410,20 @@ void spdm_server_connection_state_callback(
     uint16_t data16;
     uint32_t data32;
     libspdm_return_t status;
-    void *hash;
-    size_t hash_size;
-    const uint8_t *root_cert;
-    size_t root_cert_size;
     uint8_t index;
     spdm_version_number_t spdm_version;
+    uint32_t hash_algo;
+    uint32_t asym_algo;
+    uint16_t req_asym_algo;
+    uint8_t slot_id;
+    uint8_t mut_auth;
 
     switch (connection_state) {
     case LIBSPDM_CONNECTION_STATE_NOT_STARTED:
 
         /* clear perserved state*/
 
-        if (m_save_state_file_name != NULL) {
+        if ((m_save_state_file_name != NULL) || (m_state_store_file_name != NULL)) {
             spdm_clear_negotiated_state(spdm_context);
         }
         break;
@@ -359,7 +444,9 @@ void spdm_server_connection_state_callback(
 
     case LIBSPDM_CONNECTION_STATE_NEGOTIATED:
 
-        if (m_use_version == 0) {
+        /* Only pin the version in single connection mode. A concurrent server keeps
+         * m_use_version untouched so that later connections can still negotiate.*/
+        if ((m_use_version == 0) && (m_max_connection_count == 1)) {
             libspdm_zero_mem(&parameter, sizeof(parameter));
             parameter.location = LIBSPDM_DATA_LOCATION_CONNECTION;
             data_size = sizeof(spdm_version);
@@ -373,32 +460,28 @@ void spdm_server_connection_state_callback(
         libspdm_zero_mem(&parameter, sizeof(parameter));
         parameter.location = LIBSPDM_DATA_LOCATION_CONNECTION;
 
-        data_size = sizeof(data32);
-        libspdm_get_data(spdm_context, LIBSPDM_DATA_MEASUREMENT_HASH_ALGO,
-                         &parameter, &data32, &data_size);
-        m_use_measurement_hash_algo = data32;
+        /* The negotiated algorithms belong to this context only. Keep them local, because
+         * a concurrent server runs this callback for several connections at the same time.*/
         data_size = sizeof(data32);
         libspdm_get_data(spdm_context, LIBSPDM_DATA_BASE_ASYM_ALGO,
                          &parameter, &data32, &data_size);
-        m_use_asym_algo = data32;
+        asym_algo = data32;
         data_size = sizeof(data32);
         libspdm_get_data(spdm_context, LIBSPDM_DATA_BASE_HASH_ALGO,
                          &parameter, &data32, &data_size);
-        m_use_hash_algo = data32;
+        hash_algo = data32;
         data_size = sizeof(data16);
         libspdm_get_data(spdm_context, LIBSPDM_DATA_REQ_BASE_ASYM_ALG,
                          &parameter, &data16, &data_size);
-        m_use_req_asym_algo = data16;
-
-        res = libspdm_read_responder_public_certificate_chain(m_use_hash_algo,
-                                                              m_use_asym_algo,
-                                                              &data, &data_size,
-                                                              NULL, NULL);
-        res = libspdm_read_responder_public_certificate_chain_per_slot(1,
-                                                                       m_use_hash_algo,
-                                                                       m_use_asym_algo,
-                                                                       &data1, &data1_size,
-                                                                       NULL, NULL);
+        req_asym_algo = data16;
+        slot_id = m_use_slot_id;
+        mut_auth = m_use_mut_auth;
+
+        /* The chains and keys come from the process-wide cache, which owns them.*/
+        res = spdm_emu_cert_cache_get(SPDM_EMU_CERT_CACHE_RESPONDER_CERT_CHAIN,
+                                      hash_algo, asym_algo, 0, &data, &data_size);
+        res = res && spdm_emu_cert_cache_get(SPDM_EMU_CERT_CACHE_RESPONDER_CERT_CHAIN,
+                                             hash_algo, asym_algo, 1, &data1, &data1_size);
         if (res) {
             libspdm_zero_mem(&parameter, sizeof(parameter));
             parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
@@ -408,81 +491,75 @@ void spdm_server_connection_state_callback(
                 if (index == 1) {
                     libspdm_set_data(spdm_context,
                                      LIBSPDM_DATA_LOCAL_PUBLIC_CERT_CHAIN,
-                                     &parameter, data1, data1_size);
+                                     &parameter, (void *)data1, data1_size);
                 } else {
                     libspdm_set_data(spdm_context,
                                      LIBSPDM_DATA_LOCAL_PUBLIC_CERT_CHAIN,
-                                     &parameter, data, data_size);
+                                     &parameter, (void *)data, data_size);
                 }
             }
-            /* do not free it*/
         }
 
-        if (m_use_req_asym_algo != 0) {
+        if (req_asym_algo != 0) {
             if ((m_use_responder_capability_flags &
                  SPDM_GET_CAPABILITIES_RESPONSE_FLAGS_PUB_KEY_ID_CAP) != 0) {
-                m_use_slot_id = 0xFF;
+                slot_id = 0xFF;
             }
-            if (m_use_slot_id == 0xFF) {
-                res = libspdm_read_responder_public_key(m_use_asym_algo, &data, &data_size);
+            if (slot_id == 0xFF) {
+                res = spdm_emu_cert_cache_get(SPDM_EMU_CERT_CACHE_RESPONDER_PUBLIC_KEY,
+                                              0, asym_algo, 0, &data, &data_size);
                 if (res) {
                     libspdm_zero_mem(&parameter, sizeof(parameter));
                     parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
                     libspdm_set_data(spdm_context,
                                      LIBSPDM_DATA_LOCAL_PUBLIC_KEY,
-                                     &parameter, data, data_size);
-                    /* Do not free it.*/
+                                     &parameter, (void *)data, data_size);
                 }
-                res = libspdm_read_requester_public_key(m_use_req_asym_algo, &data, &data_size);
+                res = spdm_emu_cert_cache_get(SPDM_EMU_CERT_CACHE_REQUESTER_PUBLIC_KEY,
+                                              0, req_asym_algo, 0, &data, &data_size);
                 if (res) {
                     libspdm_zero_mem(&parameter, sizeof(parameter));
                     parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
                     libspdm_set_data(spdm_context,
                                      LIBSPDM_DATA_PEER_PUBLIC_KEY,
-                                     &parameter, data, data_size);
-                    /* Do not free it.*/
+                                     &parameter, (void *)data, data_size);
                 }
             } else {
-                res = libspdm_read_requester_root_public_certificate(
-                    m_use_hash_algo, m_use_req_asym_algo, &data,
-                    &data_size, &hash, &hash_size);
-                libspdm_x509_get_cert_from_cert_chain(
-                    (uint8_t *)data + sizeof(spdm_cert_chain_t) + hash_size,
-                    data_size - sizeof(spdm_cert_chain_t) - hash_size, 0,
-                    &root_cert, &root_cert_size);
+                res = spdm_emu_cert_cache_get(SPDM_EMU_CERT_CACHE_REQUESTER_ROOT_CERT,
+                                              hash_algo, req_asym_algo, 0,
+                                              &data, &data_size);
                 if (res) {
                     libspdm_zero_mem(&parameter, sizeof(parameter));
                     parameter.location = LIBSPDM_DATA_LOCATION_LOCAL;
                     libspdm_set_data(
                         spdm_context,
                         LIBSPDM_DATA_PEER_PUBLIC_ROOT_CERT,
-                        &parameter, (void *)root_cert, root_cert_size);
-                    /* Do not free it.*/
+                        &parameter, (void *)data, data_size);
                 }
             }
 
             if (res) {
-                if (m_use_slot_id == 0xFF) {
+                if (slot_id == 0xFF) {
                     /* 0xFF slot is only allowed in */
-                    m_use_mut_auth = SPDM_KEY_EXCHANGE_RESPONSE_MUT_AUTH_REQUESTED;
+                    mut_auth = SPDM_KEY_EXCHANGE_RESPONSE_MUT_AUTH_REQUESTED;
                 }
-                data8 = m_use_mut_auth;
+                data8 = mut_auth;
                 parameter.additional_data[0] =
-                    m_use_slot_id; /* req_slot_id;*/
+                    slot_id; /* req_slot_id;*/
                 libspdm_set_data(spdm_context,
                                  LIBSPDM_DATA_MUT_AUTH_REQUESTED, &parameter,
                                  &data8, sizeof(data8));
 
                 data8 = m_use_basic_mut_auth;
                 parameter.additional_data[0] =
-                    m_use_slot_id; /* req_slot_id;*/
+                    slot_id; /* req_slot_id;*/
                 libspdm_set_data(spdm_context,
                                  LIBSPDM_DATA_BASIC_MUT_AUTH_REQUESTED,
                                  &parameter, &data8, sizeof(data8));
             }
         }
 
-        if (m_save_state_file_name != NULL) {
+        if ((m_save_state_file_name != NULL) || (m_state_store_file_name != NULL)) {
             spdm_save_negotiated_state(spdm_context, false);
         }
 
@@ -509,12 +586,13 @@ void spdm_server_session_state_callback(void *spdm_context,
     size_t data_size;
     libspdm_data_parameter_t parameter;
     uint8_t data8;
+    spdm_version_number_t spdm_version;
 
     switch (session_state) {
     case LIBSPDM_SESSION_STATE_NOT_STARTED:
         /* Session end*/
 
-        if (m_save_state_file_name != NULL) {
+        if ((m_save_state_file_name != NULL) || (m_state_store_file_name != NULL)) {
             libspdm_zero_mem(&parameter, sizeof(parameter));
             parameter.location = LIBSPDM_DATA_LOCATION_SESSION;
             *(uint32_t *)parameter.additional_data = session_id;
@@ -536,8 +614,15 @@ void spdm_server_session_state_callback(void *spdm_context,
         break;
 
     case LIBSPDM_SESSION_STATE_HANDSHAKING:
-        /* collect session policy*/
-        if (m_use_version >= SPDM_MESSAGE_VERSION_12) {
+        /* collect session policy. m_use_version is not pinned by a concurrent server,
+         * so check the version negotiated by this connection.*/
+        libspdm_zero_mem(&parameter, sizeof(parameter));
+        parameter.location = LIBSPDM_DATA_LOCATION_CONNECTION;
+        spdm_version = 0;
+        data_size = sizeof(spdm_version);
+        libspdm_get_data(spdm_context, LIBSPDM_DATA_SPDM_VERSION, &parameter,
+                         &spdm_version, &data_size);
+        if ((spdm_version >> SPDM_VERSION_NUMBER_SHIFT_BIT) >= SPDM_MESSAGE_VERSION_12) {
             libspdm_zero_mem(&parameter, sizeof(parameter));
             parameter.location = LIBSPDM_DATA_LOCATION_SESSION;
             *(uint32_t *)parameter.additional_data = session_id;
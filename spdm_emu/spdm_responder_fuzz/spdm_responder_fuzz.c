@@ -0,0 +1,537 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_responder_emu.h"
+#include "library/pci_tdisp_device_lib.h"
+#include "library/pci_ide_km_device_lib.h"
+#include "library/cxl_ide_km_device_lib.h"
+
+/* A fuzz input is a sequence of records, each one a message for a dispatcher of the responder:
+ * 1 byte dispatcher, 2 byte little endian message size, then the message. The size of the
+ * last record is cut to the end of the input, so that every input is valid.
+ *
+ * The responder is set up once, as spdm_responder_emu does for a connection, and the device
+ * IO of its SPDM context reads and writes memory. The context, its connection and the state of
+ * the TDISP, IDE_KM and CXL IDE_KM device samples are saved before the first message, and
+ * restored before each input instead of initializing a new context.*/
+
+#define FUZZ_DISPATCH_SPDM 0
+#define FUZZ_DISPATCH_DOE 1
+#define FUZZ_DISPATCH_SPDM_VENDOR 2
+#define FUZZ_DISPATCH_MCTP_APP 3
+#define FUZZ_DISPATCH_COUNT 4
+
+#define FUZZ_RECORD_HEADER_SIZE 3
+#define FUZZ_MAX_RECORD_SIZE 0xFFFF
+
+/* Largest input read from a file or the standard input.*/
+#define FUZZ_MAX_INPUT_SIZE (1024 * 1024)
+
+/* Inputs run by one AFL persistent mode process before it restarts.*/
+#define FUZZ_AFL_LOOP_COUNT 10000
+
+/* The session given to the dispatchers of the messages that only exist in a session.*/
+#define FUZZ_SESSION_ID 0xFFFFFFFF
+
+extern void *m_spdm_context;
+extern void *m_pci_doe_context;
+extern void *m_mctp_context;
+extern libtdisp_interface_context g_tdisp_interface_context;
+extern libidekm_device_port_context g_idekm_device_port_context;
+extern libcxlidekm_device_port_context g_cxlidekm_device_port_context;
+
+void *spdm_server_init(spdm_emu_connection_t *connection);
+void spdm_server_deinit(spdm_emu_connection_t *connection);
+libspdm_return_t pci_doe_init_responder(void);
+
+char *m_fuzz_input_file_name;
+uint32_t m_fuzz_loop_count = 1;
+char *m_fuzz_capture_file_name;
+char *m_fuzz_output_file_name;
+
+/* the message the next spdm_fuzz_receive_message returns*/
+const uint8_t *m_fuzz_request;
+size_t m_fuzz_request_size;
+
+uint8_t m_fuzz_request_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
+uint8_t m_fuzz_response_buffer[LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE];
+
+size_t m_fuzz_context_size;
+void *m_fuzz_context_snapshot;
+spdm_emu_connection_t m_fuzz_connection_snapshot;
+libtdisp_interface_context m_fuzz_tdisp_snapshot;
+libidekm_device_port_context m_fuzz_idekm_snapshot;
+libcxlidekm_device_port_context m_fuzz_cxlidekm_snapshot;
+uint8_t m_fuzz_use_version;
+
+/* the fuzz input being written from --capture*/
+uint8_t *m_fuzz_output;
+size_t m_fuzz_output_size;
+size_t m_fuzz_output_capacity;
+uint32_t m_fuzz_output_record_count;
+uint32_t m_fuzz_skipped_record_count;
+
+void print_fuzz_usage(const char *name)
+{
+    printf("\n%s [--input <fuzz_input_file_name>]\n", name);
+    printf("   [--loop <count>]\n");
+    printf("   [--capture <pcap_file_name> --output <fuzz_input_file_name>]\n");
+    printf("   [spdm_responder_emu options]\n");
+    printf("\n");
+    printf("NOTE:\n");
+    printf(
+        "   A fuzz input is a sequence of records: 1 byte dispatcher, 2 byte little endian size, then the message. The dispatcher is taken modulo 4:\n");
+    printf(
+        "           0 - a transport message for libspdm_responder_dispatch_message. With PCI_DOE, a DOE object that is not SPDM goes to the DOE dispatcher.\n");
+    printf(
+        "           1 - a DOE data object for the DOE dispatcher, such as a DOE discovery.\n");
+    printf(
+        "           2 - an SPDM VENDOR_DEFINED_REQUEST for the PCI-SIG protocols: IDE_KM, TDISP and CXL IDE_KM.\n");
+    printf(
+        "           3 - an MCTP secured application message, such as PLDM.\n");
+    printf(
+        "           The responder state is restored before each input, and the messages of an input are dispatched in order.\n");
+    printf(
+        "   [--input] is the fuzz input to run. By default, it is read from the standard input. In an AFL persistent mode build, it is read again for each run.\n");
+    printf(
+        "   [--loop] is used to run the input several times and print the executions per second. By default, it is 1.\n");
+    printf(
+        "   [--capture] is the pcap or pcap-ng file recorded with --pcap. Its requester messages are written to --output as a fuzz input for dispatcher 0,\n");
+    printf(
+        "           to seed a corpus. Fuzz with the --trans of the capture.\n");
+    printf(
+        "   With TOOLCHAIN=LIBFUZZER, spdm_responder_emu options are taken from the SPDM_FUZZ_OPTIONS environment variable, separated by spaces.\n");
+}
+
+libspdm_return_t spdm_fuzz_send_message(void *spdm_context, size_t response_size,
+                                        const void *response, uint64_t timeout)
+{
+    append_pcap_packet_data(INVALID_SOCKET, true, response, response_size);
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+libspdm_return_t spdm_fuzz_receive_message(void *spdm_context, size_t *request_size,
+                                           void **request, uint64_t timeout)
+{
+    spdm_emu_connection_t *connection;
+
+    if (m_fuzz_request == NULL) {
+        return LIBSPDM_STATUS_RECEIVE_FAIL;
+    }
+    connection = spdm_emu_get_connection(spdm_context);
+    libspdm_copy_mem(connection->send_receive_buffer, LIBSPDM_MAX_SENDER_RECEIVER_BUFFER_SIZE,
+                     m_fuzz_request, m_fuzz_request_size);
+    connection->send_receive_buffer_size = m_fuzz_request_size;
+    connection->command = SOCKET_SPDM_COMMAND_NORMAL;
+    m_fuzz_request = NULL;
+    append_pcap_packet_data(INVALID_SOCKET, false, connection->send_receive_buffer,
+                            connection->send_receive_buffer_size);
+
+    *request = connection->send_receive_buffer;
+    *request_size = connection->send_receive_buffer_size;
+    return LIBSPDM_STATUS_SUCCESS;
+}
+
+/**
+ * Set up the responder and save the state each input starts from.
+ **/
+bool spdm_fuzz_start(void)
+{
+    libspdm_return_t status;
+
+    if ((m_save_state_file_name != NULL) || (m_state_store_file_name != NULL)) {
+        printf("--save_state and --state_store are not supported by the fuzzing\n");
+        return false;
+    }
+
+    spdm_emu_cert_cache_init();
+    m_spdm_context = spdm_server_init(&m_default_connection);
+    if (m_spdm_context == NULL) {
+        return false;
+    }
+    libspdm_register_device_io_func(m_spdm_context, spdm_fuzz_send_message,
+                                    spdm_fuzz_receive_message);
+
+    /* The vendor functions are added to a fixed table, so they are registered only once.*/
+    status = pci_doe_init_responder();
+    if (LIBSPDM_STATUS_IS_ERROR(status)) {
+        printf("pci_doe_init_responder - %x\n", (uint32_t)status);
+        return false;
+    }
+
+    /* No message has been dispatched, so the context owns no allocation yet and a copy of
+     * it can be restored in place. Its pointers into itself stay valid.*/
+    m_fuzz_context_size = libspdm_get_context_size();
+    m_fuzz_context_snapshot = (void *)malloc(m_fuzz_context_size);
+    if (m_fuzz_context_snapshot == NULL) {
+        return false;
+    }
+    libspdm_copy_mem(m_fuzz_context_snapshot, m_fuzz_context_size, m_spdm_context,
+                     m_fuzz_context_size);
+    m_fuzz_connection_snapshot = m_default_connection;
+    m_fuzz_tdisp_snapshot = g_tdisp_interface_context;
+    m_fuzz_idekm_snapshot = g_idekm_device_port_context;
+    m_fuzz_cxlidekm_snapshot = g_cxlidekm_device_port_context;
+    /* pinned by the connection state callback once a version is negotiated*/
+    m_fuzz_use_version = m_use_version;
+    return true;
+}
+
+void spdm_fuzz_stop(void)
+{
+    if (m_spdm_context != NULL) {
+        spdm_server_deinit(&m_default_connection);
+        m_spdm_context = NULL;
+    }
+    free(m_fuzz_context_snapshot);
+    m_fuzz_context_snapshot = NULL;
+    spdm_emu_cert_cache_free();
+}
+
+static void spdm_fuzz_restore(void)
+{
+    /* Release what the previous input allocated, such as the transcript hash contexts.*/
+    libspdm_deinit_context(m_spdm_context);
+    libspdm_copy_mem(m_spdm_context, m_fuzz_context_size, m_fuzz_context_snapshot,
+                     m_fuzz_context_size);
+    m_default_connection = m_fuzz_connection_snapshot;
+    g_tdisp_interface_context = m_fuzz_tdisp_snapshot;
+    g_idekm_device_port_context = m_fuzz_idekm_snapshot;
+    g_cxlidekm_device_port_context = m_fuzz_cxlidekm_snapshot;
+    m_use_version = m_fuzz_use_version;
+}
+
+static void spdm_fuzz_dispatch(uint8_t dispatcher, const uint8_t *message, size_t message_size)
+{
+    libspdm_return_t status;
+    size_t response_size;
+    uint32_t session_id;
+
+    if (message_size > sizeof(m_fuzz_request_buffer)) {
+        message_size = sizeof(m_fuzz_request_buffer);
+    }
+    response_size = sizeof(m_fuzz_response_buffer);
+    session_id = FUZZ_SESSION_ID;
+
+    switch (dispatcher % FUZZ_DISPATCH_COUNT) {
+    case FUZZ_DISPATCH_SPDM:
+        m_fuzz_request = message;
+        m_fuzz_request_size = message_size;
+        status = libspdm_responder_dispatch_message(m_spdm_context);
+        m_fuzz_request = NULL;
+        /* as platform_server does*/
+        if ((status != LIBSPDM_STATUS_UNSUPPORTED_CAP) ||
+            (m_use_transport_layer != SOCKET_TRANSPORT_TYPE_PCI_DOE)) {
+            break;
+        }
+        status = pci_doe_get_response_doe_request(m_pci_doe_context,
+                                                  m_default_connection.send_receive_buffer,
+                                                  m_default_connection.send_receive_buffer_size,
+                                                  m_fuzz_response_buffer, &response_size);
+        if (!LIBSPDM_STATUS_IS_ERROR(status)) {
+            append_pcap_packet_data(INVALID_SOCKET, true, m_fuzz_response_buffer, response_size);
+        }
+        break;
+
+    /* The records below are copied first, the dispatchers expect an aligned request.*/
+    case FUZZ_DISPATCH_DOE:
+        libspdm_copy_mem(m_fuzz_request_buffer, sizeof(m_fuzz_request_buffer), message,
+                         message_size);
+        pci_doe_get_response_doe_request(m_pci_doe_context, m_fuzz_request_buffer, message_size,
+                                         m_fuzz_response_buffer, &response_size);
+        break;
+
+    case FUZZ_DISPATCH_SPDM_VENDOR:
+        libspdm_copy_mem(m_fuzz_request_buffer, sizeof(m_fuzz_request_buffer), message,
+                         message_size);
+        pci_doe_get_response_spdm_vendor_defined_request(
+            m_pci_doe_context, m_spdm_context, &session_id, m_fuzz_request_buffer,
+            message_size, m_fuzz_response_buffer, &response_size);
+        break;
+
+    case FUZZ_DISPATCH_MCTP_APP:
+        libspdm_copy_mem(m_fuzz_request_buffer, sizeof(m_fuzz_request_buffer), message,
+                         message_size);
+        mctp_get_response_secured_app_request(
+            m_mctp_context, m_spdm_context, &session_id, m_fuzz_request_buffer,
+            message_size, m_fuzz_response_buffer, &response_size);
+        break;
+
+    default:
+        break;
+    }
+}
+
+/**
+ * Restore the responder state and dispatch the records of one fuzz input.
+ **/
+void spdm_fuzz_run_input(const uint8_t *data, size_t size)
+{
+    size_t offset;
+    size_t message_size;
+
+    spdm_fuzz_restore();
+
+    offset = 0;
+    while (size - offset >= FUZZ_RECORD_HEADER_SIZE) {
+        message_size = data[offset + 1] | ((size_t)data[offset + 2] << 8);
+        if (message_size > size - offset - FUZZ_RECORD_HEADER_SIZE) {
+            message_size = size - offset - FUZZ_RECORD_HEADER_SIZE;
+        }
+        spdm_fuzz_dispatch(data[offset], data + offset + FUZZ_RECORD_HEADER_SIZE, message_size);
+        offset += FUZZ_RECORD_HEADER_SIZE + message_size;
+    }
+}
+
+static bool spdm_fuzz_add_record(void *context, const pcap_packet_record_t *record)
+{
+    uint8_t *output;
+
+    if (!record->is_request) {
+        return true;
+    }
+    if (record->is_truncated || (record->size > FUZZ_MAX_RECORD_SIZE)) {
+        m_fuzz_skipped_record_count++;
+        return true;
+    }
+
+    while (m_fuzz_output_size + FUZZ_RECORD_HEADER_SIZE + record->size > m_fuzz_output_capacity) {
+        m_fuzz_output_capacity = (m_fuzz_output_capacity == 0) ? 4096 : m_fuzz_output_capacity * 2;
+        output = (void *)realloc(m_fuzz_output, m_fuzz_output_capacity);
+        if (output == NULL) {
+            printf("No sufficient memory to load %s\n", m_fuzz_capture_file_name);
+            return false;
+        }
+        m_fuzz_output = output;
+    }
+
+    output = m_fuzz_output + m_fuzz_output_size;
+    output[0] = FUZZ_DISPATCH_SPDM;
+    output[1] = (uint8_t)record->size;
+    output[2] = (uint8_t)(record->size >> 8);
+    libspdm_copy_mem(output + FUZZ_RECORD_HEADER_SIZE,
+                     m_fuzz_output_capacity - m_fuzz_output_size - FUZZ_RECORD_HEADER_SIZE,
+                     record->data, record->size);
+    m_fuzz_output_size += FUZZ_RECORD_HEADER_SIZE + record->size;
+    m_fuzz_output_record_count++;
+    return true;
+}
+
+/**
+ * Write the requester messages of --capture to --output as one fuzz input.
+ **/
+bool spdm_fuzz_write_capture_input(void)
+{
+    uint32_t transport_layer;
+    bool result;
+
+    result = read_pcap_packet_file(m_fuzz_capture_file_name, &transport_layer,
+                                   spdm_fuzz_add_record, NULL);
+    if (result) {
+        result = libspdm_write_output_file(m_fuzz_output_file_name, m_fuzz_output,
+                                           m_fuzz_output_size);
+        if (!result) {
+            printf("!!!Unable to write file %s\n", m_fuzz_output_file_name);
+        }
+    }
+    if (result) {
+        printf("%u requests written to %s, %u truncated skipped - fuzz with trans 0x%x\n",
+               m_fuzz_output_record_count, m_fuzz_output_file_name,
+               m_fuzz_skipped_record_count, transport_layer);
+    }
+    free(m_fuzz_output);
+    m_fuzz_output = NULL;
+    return result;
+}
+
+/**
+ * Take the fuzz options out of argv. The other options are left for process_args.
+ **/
+void process_fuzz_args(char *program_name, int *argc, char *argv[])
+{
+    int index;
+    int common_argc;
+
+    common_argc = 1;
+    for (index = 1; index < *argc; index++) {
+        if ((strcmp(argv[index], "-h") == 0) || (strcmp(argv[index], "--help") == 0)) {
+            print_fuzz_usage(program_name);
+            exit(0);
+        }
+
+        if ((strcmp(argv[index], "--input") == 0) ||
+            (strcmp(argv[index], "--loop") == 0) ||
+            (strcmp(argv[index], "--capture") == 0) ||
+            (strcmp(argv[index], "--output") == 0)) {
+            if (index + 1 >= *argc) {
+                printf("invalid %s\n", argv[index]);
+                print_fuzz_usage(program_name);
+                exit(0);
+            }
+        } else {
+            argv[common_argc++] = argv[index];
+            continue;
+        }
+
+        if (strcmp(argv[index], "--input") == 0) {
+            m_fuzz_input_file_name = argv[index + 1];
+            printf("input - %s\n", m_fuzz_input_file_name);
+        } else if (strcmp(argv[index], "--loop") == 0) {
+            m_fuzz_loop_count = (uint32_t)strtoul(argv[index + 1], NULL, 0);
+            if (m_fuzz_loop_count == 0) {
+                printf("invalid --loop %s\n", argv[index + 1]);
+                print_fuzz_usage(program_name);
+                exit(0);
+            }
+            printf("loop - %d\n", m_fuzz_loop_count);
+        } else if (strcmp(argv[index], "--capture") == 0) {
+            m_fuzz_capture_file_name = argv[index + 1];
+            printf("capture - %s\n", m_fuzz_capture_file_name);
+        } else {
+            m_fuzz_output_file_name = argv[index + 1];
+            printf("output - %s\n", m_fuzz_output_file_name);
+        }
+        index++;
+    }
+    *argc = common_argc;
+
+    if ((m_fuzz_capture_file_name == NULL) != (m_fuzz_output_file_name == NULL)) {
+        printf("--capture and --output go together\n");
+        print_fuzz_usage(program_name);
+        exit(0);
+    }
+}
+
+#ifdef TEST_WITH_LIBFUZZER
+
+#define FUZZ_MAX_OPTION_COUNT 64
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    static char *option_argv[FUZZ_MAX_OPTION_COUNT];
+    const char *options;
+    char *option_string;
+    char *option;
+    int option_argc;
+
+    /* libFuzzer owns the command line.*/
+    option_argc = 0;
+    option_argv[option_argc++] = "spdm_responder_fuzz";
+    options = getenv("SPDM_FUZZ_OPTIONS");
+    if (options != NULL) {
+        option_string = (void *)malloc(strlen(options) + 1);
+        if (option_string == NULL) {
+            exit(1);
+        }
+        libspdm_copy_mem(option_string, strlen(options) + 1, options, strlen(options) + 1);
+        for (option = strtok(option_string, " "); option != NULL; option = strtok(NULL, " ")) {
+            if (option_argc == FUZZ_MAX_OPTION_COUNT) {
+                printf("too many SPDM_FUZZ_OPTIONS\n");
+                exit(1);
+            }
+            option_argv[option_argc++] = option;
+        }
+    }
+    process_args("spdm_responder_fuzz", option_argc, option_argv);
+    if (!spdm_fuzz_start()) {
+        exit(1);
+    }
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    spdm_fuzz_run_input(data, size);
+    return 0;
+}
+
+#else
+
+static bool spdm_fuzz_read_input(uint8_t *buffer, size_t *size)
+{
+    FILE *file;
+
+    if (m_fuzz_input_file_name == NULL) {
+        *size = fread(buffer, 1, FUZZ_MAX_INPUT_SIZE, stdin);
+        return !ferror(stdin);
+    }
+    file = fopen(m_fuzz_input_file_name, "rb");
+    if (file == NULL) {
+        printf("!!!Unable to open file %s\n", m_fuzz_input_file_name);
+        return false;
+    }
+    *size = fread(buffer, 1, FUZZ_MAX_INPUT_SIZE, file);
+    fclose(file);
+    return true;
+}
+
+#ifndef __AFL_LOOP
+static void spdm_fuzz_run_loop(const uint8_t *input, size_t input_size)
+{
+    uint32_t loop;
+    uint64_t start;
+    uint64_t elapsed;
+    char value[16];
+
+    start = spdm_emu_get_monotonic_ns();
+    for (loop = 0; loop < m_fuzz_loop_count; loop++) {
+        spdm_fuzz_run_input(input, input_size);
+    }
+    elapsed = spdm_emu_get_monotonic_ns() - start;
+    if (elapsed == 0) {
+        elapsed = 1;
+    }
+    printf("%u executions of %u bytes in %s: %.0f exec/s\n", m_fuzz_loop_count,
+           (uint32_t)input_size, spdm_emu_format_duration(value, sizeof(value), elapsed),
+           (double)m_fuzz_loop_count * 1000000000 / (double)elapsed);
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    uint8_t *input;
+    size_t input_size;
+    bool result;
+
+    printf("%s version 0.1\n", "spdm_responder_fuzz");
+
+    process_fuzz_args("spdm_responder_fuzz", &argc, argv);
+    if (m_fuzz_capture_file_name != NULL) {
+        return spdm_fuzz_write_capture_input() ? 0 : 1;
+    }
+    process_args("spdm_responder_fuzz", argc, argv);
+
+    input = (void *)malloc(FUZZ_MAX_INPUT_SIZE);
+    if (input == NULL) {
+        return 1;
+    }
+    result = spdm_fuzz_start();
+
+#ifdef __AFL_LOOP
+    while (result && __AFL_LOOP(FUZZ_AFL_LOOP_COUNT)) {
+        if (spdm_fuzz_read_input(input, &input_size)) {
+            spdm_fuzz_run_input(input, input_size);
+        }
+        if (m_fuzz_input_file_name == NULL) {
+            clearerr(stdin);
+        }
+    }
+#else
+    if (result) {
+        result = spdm_fuzz_read_input(input, &input_size);
+    }
+    if (result) {
+        spdm_fuzz_run_loop(input, input_size);
+    }
+#endif
+
+    spdm_fuzz_stop();
+    close_pcap_packet_file();
+    free(input);
+    return result ? 0 : 1;
+}
+
+#endif /* TEST_WITH_LIBFUZZER*/
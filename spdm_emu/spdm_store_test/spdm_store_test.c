@@ -0,0 +1,330 @@
+/**
+ *  Copyright Notice:
+ *  Copyright 2023 DMTF. All rights reserved.
+ *  License: BSD 3-Clause License. For full text see link: https://github.com/DMTF/spdm-emu/blob/main/LICENSE.md
+ **/
+
+#include "spdm_emu.h"
+
+/* Unit tests of the crash recovery of the stores. A crash is reproduced by writing the files as
+ * the store left them in the middle of a write, then the store is opened again. The atomic
+ * replacement of the files written by several threads at once is checked too.
+ *
+ * The files are created in the directory given as first argument, the current one by default.*/
+
+#define STORE_TEST_MAX_FILE_NAME_SIZE 1024
+#define STORE_TEST_WRITER_COUNT 4
+#define STORE_TEST_WRITE_COUNT 200
+#define STORE_TEST_WRITE_SIZE 4096
+
+char *m_store_test_dir = ".";
+uint32_t m_store_test_fail_count;
+
+#define STORE_TEST_CHECK(expression) \
+    do { \
+        if (!(expression)) { \
+            printf("!!!%s:%d - %s\n", __FILE__, __LINE__, #expression); \
+            m_store_test_fail_count++; \
+            return; \
+        } \
+    } while (0)
+
+static void store_test_get_file_name(const char *name, char *file_name, size_t file_name_size)
+{
+    snprintf(file_name, file_name_size, "%s/%s", m_store_test_dir, name);
+}
+
+/* Get the size of a file, 0 if it does not exist.*/
+static size_t store_test_get_file_size(const char *file_name)
+{
+    spdm_emu_file_view_t *view;
+    const void *data;
+    size_t size;
+
+    view = spdm_emu_map_input_file(file_name, &data, &size);
+    if (view == NULL) {
+        return 0;
+    }
+    spdm_emu_release_file_view(view);
+    return size;
+}
+
+/* Keep the first size bytes of a file, as a write cut short leaves it.*/
+static bool store_test_truncate_file(const char *file_name, size_t size)
+{
+    void *data;
+    size_t file_size;
+    bool result;
+
+    if (!libspdm_read_input_file(file_name, &data, &file_size) || (size > file_size)) {
+        return false;
+    }
+    result = libspdm_write_output_file(file_name, data, size);
+    free(data);
+    return result;
+}
+
+static bool store_test_append_file(const char *file_name, const void *data, size_t size)
+{
+    FILE *file;
+    bool result;
+
+    file = fopen(file_name, "ab");
+    if (file == NULL) {
+        return false;
+    }
+    result = fwrite(data, 1, size, file) == size;
+    fclose(file);
+    return result;
+}
+
+/* A record cut short, then garbage after the last record, are both dropped on open. The store
+ * keeps the values written before them and appends after them.*/
+static void store_test_state_store_torn_write(void)
+{
+    char file_name[STORE_TEST_MAX_FILE_NAME_SIZE];
+    const uint8_t torn_header[] = { 0x53, 0x45, 0x54, 0x53, 0x05 };
+    uint32_t value;
+    size_t good_size;
+
+    store_test_get_file_name("state_store_test.bin", file_name, sizeof(file_name));
+    remove(file_name);
+    m_state_store_file_name = file_name;
+
+    STORE_TEST_CHECK(spdm_state_store_open());
+    value = 1;
+    STORE_TEST_CHECK(spdm_state_store_put("key1", &value, sizeof(value)));
+    value = 2;
+    STORE_TEST_CHECK(spdm_state_store_put("key2", &value, sizeof(value)));
+    spdm_state_store_close();
+    good_size = store_test_get_file_size(file_name);
+
+    /* The second value of key2 is cut in the middle of its value.*/
+    STORE_TEST_CHECK(spdm_state_store_open());
+    value = 3;
+    STORE_TEST_CHECK(spdm_state_store_put("key2", &value, sizeof(value)));
+    spdm_state_store_close();
+    STORE_TEST_CHECK(store_test_get_file_size(file_name) > good_size + 2);
+    STORE_TEST_CHECK(store_test_truncate_file(file_name,
+                                              store_test_get_file_size(file_name) - 2));
+
+    STORE_TEST_CHECK(spdm_state_store_open());
+    STORE_TEST_CHECK(store_test_get_file_size(file_name) == good_size);
+    STORE_TEST_CHECK(spdm_state_store_get("key1", &value, sizeof(value)) && (value == 1));
+    STORE_TEST_CHECK(spdm_state_store_get("key2", &value, sizeof(value)) && (value == 2));
+    value = 4;
+    STORE_TEST_CHECK(spdm_state_store_put("key3", &value, sizeof(value)));
+    spdm_state_store_close();
+
+    /* Only the first bytes of a header were written.*/
+    STORE_TEST_CHECK(store_test_append_file(file_name, torn_header, sizeof(torn_header)));
+    STORE_TEST_CHECK(spdm_state_store_open());
+    STORE_TEST_CHECK(spdm_state_store_get("key1", &value, sizeof(value)) && (value == 1));
+    STORE_TEST_CHECK(spdm_state_store_get("key2", &value, sizeof(value)) && (value == 2));
+    STORE_TEST_CHECK(spdm_state_store_get("key3", &value, sizeof(value)) && (value == 4));
+    STORE_TEST_CHECK(spdm_state_store_delete("key1"));
+    spdm_state_store_close();
+
+    STORE_TEST_CHECK(spdm_state_store_open());
+    STORE_TEST_CHECK(!spdm_state_store_get("key1", &value, sizeof(value)));
+    STORE_TEST_CHECK(spdm_state_store_get("key3", &value, sizeof(value)) && (value == 4));
+    spdm_state_store_close();
+
+    remove(file_name);
+    m_state_store_file_name = NULL;
+}
+
+/* Check that the last collection of a device before a time holds the data, in kind order.*/
+static bool store_test_check_collection(const char *device, uint64_t timestamp,
+                                        const char *data1, const char *data2)
+{
+    const spdm_emu_evidence_record_t *record;
+    size_t record_count;
+    const void *data;
+    size_t size;
+    const char *expected[2];
+    size_t index;
+
+    expected[0] = data1;
+    expected[1] = data2;
+    record = spdm_emu_evidence_store_find(device, timestamp, &record_count);
+    if ((record == NULL) || (record_count != ((data2 == NULL) ? 1 : 2)) ||
+        (record[0].timestamp != timestamp)) {
+        return false;
+    }
+    for (index = 0; index < record_count; index++) {
+        if (!spdm_emu_evidence_store_get_data(&record[index], &data, &size) ||
+            (size != strlen(expected[index])) || (memcmp(data, expected[index], size) != 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* The files of a crash in the middle of an add: the chunk written only in part, after the
+ * records of the journal, the last one cut short. Opening for writing merges the complete
+ * records, and the next chunk is appended past the torn one.*/
+static void store_test_evidence_store_torn_write(void)
+{
+    char index_file_name[STORE_TEST_MAX_FILE_NAME_SIZE];
+    char journal_file_name[STORE_TEST_MAX_FILE_NAME_SIZE];
+    char chunk_file_name[STORE_TEST_MAX_FILE_NAME_SIZE];
+    const uint8_t torn_chunk[] = { 0x45, 0x43, 0x48, 0x4B, 0x10, 0x00, 0x00, 0x00, 0x01, 0x02 };
+    void *index_data;
+    size_t index_size;
+    void *journal_data;
+    size_t journal_size;
+    void *chunk_data;
+    size_t chunk_size;
+    size_t record_count;
+    bool result;
+
+    store_test_get_file_name("index.bin", index_file_name, sizeof(index_file_name));
+    store_test_get_file_name("journal.bin", journal_file_name, sizeof(journal_file_name));
+    store_test_get_file_name("chunks.bin", chunk_file_name, sizeof(chunk_file_name));
+    remove(index_file_name);
+    remove(journal_file_name);
+    remove(chunk_file_name);
+    m_evidence_store_dir = m_store_test_dir;
+
+    STORE_TEST_CHECK(spdm_emu_evidence_store_open(true));
+    STORE_TEST_CHECK(spdm_emu_evidence_store_add("dev0", 1, SPDM_EMU_EVIDENCE_KIND_MEASUREMENT, 0,
+                                                 "measurement0", strlen("measurement0")));
+    STORE_TEST_CHECK(spdm_emu_evidence_store_add("dev0", 1, SPDM_EMU_EVIDENCE_KIND_CERT_CHAIN, 0,
+                                                 "chain", strlen("chain")));
+    spdm_emu_evidence_store_close();
+    STORE_TEST_CHECK(libspdm_read_input_file(index_file_name, &index_data, &index_size));
+
+    /* Keep the journal and the chunks as they are before the store is closed.*/
+    STORE_TEST_CHECK(spdm_emu_evidence_store_open(true));
+    STORE_TEST_CHECK(spdm_emu_evidence_store_add("dev1", 2, SPDM_EMU_EVIDENCE_KIND_MEASUREMENT, 0,
+                                                 "measurement1", strlen("measurement1")));
+    result = libspdm_read_input_file(journal_file_name, &journal_data, &journal_size);
+    if (result) {
+        result = libspdm_read_input_file(chunk_file_name, &chunk_data, &chunk_size);
+        if (!result) {
+            free(journal_data);
+        }
+    }
+    spdm_emu_evidence_store_close();
+    if (!result) {
+        free(index_data);
+    }
+    STORE_TEST_CHECK(result);
+
+    result = (journal_size == sizeof(spdm_emu_evidence_record_t)) &&
+             libspdm_write_output_file(index_file_name, index_data, index_size) &&
+             libspdm_write_output_file(journal_file_name, journal_data, journal_size) &&
+             store_test_append_file(journal_file_name, journal_data, journal_size / 2) &&
+             libspdm_write_output_file(chunk_file_name, chunk_data, chunk_size) &&
+             store_test_append_file(chunk_file_name, torn_chunk, sizeof(torn_chunk));
+    free(index_data);
+    free(journal_data);
+    free(chunk_data);
+    STORE_TEST_CHECK(result);
+
+    STORE_TEST_CHECK(spdm_emu_evidence_store_open(true));
+    STORE_TEST_CHECK(store_test_get_file_size(journal_file_name) == 0);
+    STORE_TEST_CHECK(spdm_emu_evidence_store_add("dev2", 3, SPDM_EMU_EVIDENCE_KIND_MEASUREMENT, 0,
+                                                 "measurement0", strlen("measurement0")));
+    STORE_TEST_CHECK(spdm_emu_evidence_store_add("dev2", 3, SPDM_EMU_EVIDENCE_KIND_CERT_CHAIN, 0,
+                                                 "chain2", strlen("chain2")));
+    spdm_emu_evidence_store_close();
+
+    STORE_TEST_CHECK(spdm_emu_evidence_store_open(false));
+    spdm_emu_evidence_store_get_records(&record_count);
+    result = (record_count == 5) &&
+             store_test_check_collection("dev0", 1, "measurement0", "chain") &&
+             store_test_check_collection("dev1", 2, "measurement1", NULL) &&
+             store_test_check_collection("dev2", 3, "measurement0", "chain2");
+    spdm_emu_evidence_store_close();
+    STORE_TEST_CHECK(result);
+
+    remove(index_file_name);
+    remove(chunk_file_name);
+    m_evidence_store_dir = NULL;
+}
+
+typedef struct {
+    const char *file_name;
+    uint8_t fill;
+    bool result;
+} store_test_writer_t;
+
+static void store_test_writer_routine(void *context)
+{
+    store_test_writer_t *writer;
+    uint8_t data[STORE_TEST_WRITE_SIZE];
+    uint32_t index;
+
+    writer = context;
+    libspdm_set_mem(data, sizeof(data), writer->fill);
+    writer->result = true;
+    for (index = 0; index < STORE_TEST_WRITE_COUNT; index++) {
+        writer->result = writer->result &&
+                         libspdm_write_output_file(writer->file_name, data, sizeof(data));
+    }
+}
+
+/* Several threads replacing the same file never mix their content, and never fail because
+ * another one renamed the temporary file away.*/
+static void store_test_concurrent_write(void)
+{
+    char file_name[STORE_TEST_MAX_FILE_NAME_SIZE];
+    store_test_writer_t writer[STORE_TEST_WRITER_COUNT];
+    spdm_emu_thread_t thread[STORE_TEST_WRITER_COUNT];
+    bool thread_started[STORE_TEST_WRITER_COUNT];
+    const uint8_t *data;
+    size_t size;
+    spdm_emu_file_view_t *view;
+    uint32_t index;
+    bool result;
+
+    store_test_get_file_name("write_test.bin", file_name, sizeof(file_name));
+    for (index = 0; index < STORE_TEST_WRITER_COUNT; index++) {
+        writer[index].file_name = file_name;
+        writer[index].fill = (uint8_t)(index + 1);
+        writer[index].result = false;
+        thread_started[index] = spdm_emu_thread_create(&thread[index],
+                                                       store_test_writer_routine,
+                                                       &writer[index]);
+    }
+    result = true;
+    for (index = 0; index < STORE_TEST_WRITER_COUNT; index++) {
+        if (thread_started[index]) {
+            spdm_emu_thread_join(thread[index]);
+        }
+        result = result && thread_started[index] && writer[index].result;
+    }
+    STORE_TEST_CHECK(result);
+
+    view = spdm_emu_map_input_file(file_name, (const void **)&data, &size);
+    STORE_TEST_CHECK(view != NULL);
+    result = (size == STORE_TEST_WRITE_SIZE) && (data[0] != 0) &&
+             (data[0] <= STORE_TEST_WRITER_COUNT);
+    for (index = 1; result && (index < size); index++) {
+        result = (data[index] == data[0]);
+    }
+    spdm_emu_release_file_view(view);
+    STORE_TEST_CHECK(result);
+
+    remove(file_name);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1) {
+        m_store_test_dir = argv[1];
+    }
+
+    store_test_state_store_torn_write();
+    store_test_evidence_store_torn_write();
+    store_test_concurrent_write();
+
+    if (m_store_test_fail_count != 0) {
+        printf("spdm_store_test - %u failed\n", m_store_test_fail_count);
+        return 1;
+    }
+    printf("spdm_store_test - passed\n");
+    return 0;
+}